@@ -0,0 +1,14 @@
+# Renames the profiles written by <name>-pgo-gen so <name>-pgo finds them.
+#
+# GCC mangles the object file path into each .gcda name, e.g.
+#   #build#week3#CMakeFiles#day21-pgo-gen.dir#day21.cpp.gcda
+# and the optimized target compiles into day21-pgo.dir instead.
+#
+# Usage: cmake -DPGO_DIR=<dir> -P RenameProfiles.cmake
+file(GLOB profiles "${PGO_DIR}/*.gcda")
+foreach(profile ${profiles})
+    string(REPLACE "-pgo-gen.dir#" "-pgo.dir#" renamed "${profile}")
+    if(NOT renamed STREQUAL profile)
+        file(RENAME "${profile}" "${renamed}")
+    endif()
+endforeach()
@@ -1,54 +1,49 @@
 #include <iostream>
 #include <stdexcept>
-#include <limits>
+#include <string>
+
+#include "expression.h"
+
+// The engine reports errors as expr::Status; this interactive front end turns
+// them back into exceptions, since it only ever evaluates one line.
+double evaluate(const std::string& line) {
+    expr::Program program;
+    std::size_t errorPos = 0;
+    expr::Status status = expr::compile(line, program, &errorPos);
+    if (status == expr::Status::SyntaxError) {
+        throw std::invalid_argument("Invalid input at position " + std::to_string(errorPos));
+    }
+    if (status == expr::Status::DivisionByZero) {
+        throw std::runtime_error("Division by zero error");
+    }
+    if (status != expr::Status::Ok) {
+        throw std::invalid_argument(expr::statusMessage(status));
+    }
+    if (!program.variables().empty()) {
+        throw std::invalid_argument("Unknown name: " + program.variables().front());
+    }
 
-double divide(double a, double b) {
-    if (b == 0) {
+    double result = 0;
+    if (program.evaluate(nullptr, result) == expr::Status::DivisionByZero) {
         throw std::runtime_error("Division by zero error");
     }
-    return a / b;
+    return result;
 }
 
 int main() {
-    double num1, num2;
-    char op;
+    std::string line;
 
     try {
-        std::cout << "Enter first number: ";
-        if (!(std::cin >> num1)) {
-            throw std::invalid_argument("Invalid input, not a number");
-        }
-
-        std::cout << "Enter an operator (+, -, *, /): ";
-        std::cin >> op;
-
-        std::cout << "Enter second number: ";
-        if (!(std::cin >> num2)) {
-            throw std::invalid_argument("Invalid input, not a number");
-        }
-
-        double result;
-        switch (op) {
-            case '+':
-                result = num1 + num2;
-                break;
-            case '-':
-                result = num1 - num2;
-                break;
-            case '*':
-                result = num1 * num2;
-                break;
-            case '/':
-                result = divide(num1, num2);
-                break;
-            default:
-                throw std::invalid_argument("Invalid operator");
+        std::cout << "Enter an expression (e.g. 3 * (4 - 1) / 2): ";
+        if (!std::getline(std::cin, line)) {
+            throw std::invalid_argument("Invalid input, no expression");
         }
 
+        double result = evaluate(line);
         std::cout << "Result: " << result << std::endl;
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << std::endl;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <string>
 
+#include "ledger.h"
+
 class Account {
 public:
     Account(const std::string& owner, double balance)
@@ -59,5 +61,22 @@ int main() {
     savAcc.addInterest();
     savAcc.display();
 
+    // The same accounts in the concurrent ledger: exact cents, status codes
+    // instead of printing, and interest for every account in one call.
+    Ledger ledger(2, 16);
+    Ledger::AccountId john = ledger.open("John Doe", toCents(1000.0));
+    Ledger::AccountId jane = ledger.open("Jane Doe", toCents(2000.0), 500);
+    ledger.deposit(john, toCents(500.0));
+    ledger.withdraw(john, toCents(200.0));
+    ledger.deposit(jane, toCents(1000.0));
+    if (ledger.transfer(john, jane, toCents(5000.0)) == TxStatus::InsufficientFunds) {
+        std::cout << "Transfer refused: insufficient funds" << std::endl;
+    }
+    ledger.accrueInterest();
+    ledger.drainLog(std::cout);
+    for (Ledger::AccountId id : {john, jane}) {
+        std::cout << "Owner: " << ledger.owner(id) << ", Balance: " << formatCents(ledger.balance(id)) << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,580 @@
+#pragma once
+
+// Arithmetic expressions compiled once to bytecode and evaluated over columns.
+//
+//   expr::Program p;
+//   if (expr::compile("price * (1 - discount) / qty", p) == expr::Status::Ok) {
+//       const double* columns[] = {price, discount, qty}; // order of p.variables()
+//       p.evaluate(columns, n, out);
+//   }
+//
+// Grammar: + - * / with the usual precedence, unary minus, parentheses,
+// numbers and variable names. Errors are reported through Status; nothing
+// on the evaluation path throws or allocates.
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace expr {
+
+enum class Status {
+    Ok,
+    SyntaxError,
+    TooComplex,       // needs more than kMaxDepth stack slots, or nests past kMaxNesting
+    DivisionByZero,
+};
+
+inline const char* statusMessage(Status status) {
+    switch (status) {
+        case Status::Ok:
+            return "ok";
+        case Status::SyntaxError:
+            return "syntax error";
+        case Status::TooComplex:
+            return "expression too complex";
+        case Status::DivisionByZero:
+            return "division by zero";
+    }
+    return "unknown status";
+}
+
+// Rows evaluated per instruction, and the evaluation stack depth. One batch of
+// the stack is kMaxDepth * kBatch doubles (32 KB) and lives on the C++ stack.
+constexpr std::size_t kBatch = 256;
+constexpr std::size_t kMaxDepth = 16;
+
+// Parentheses and unary operators nest, and operator chains grow the tree,
+// at most this deep. The compiler recurses over both, so deeper input fails
+// with TooComplex instead of running off the C++ stack.
+constexpr std::size_t kMaxNesting = 1000;
+
+enum class Op : std::uint8_t {
+    LoadVar,    // push column[arg]
+    LoadConst,  // push constants[arg]
+    Neg,
+    // Both operands on the stack.
+    Add, Sub, Mul, Div,
+    // Right operand is column[arg].
+    AddVar, SubVar, MulVar, DivVar,
+    // Right operand is constants[arg].
+    AddConst, SubConst, MulConst, DivConst,
+    // Left operand is constants[arg], right operand on the stack.
+    ConstSub, ConstDiv,
+};
+
+struct Instruction {
+    Op op;
+    std::uint32_t arg;
+};
+
+class Program {
+public:
+    // Variable names in column order for evaluate().
+    const std::vector<std::string>& variables() const { return variables_; }
+
+    // Column index of a variable, or -1 when the expression does not use it.
+    int variableIndex(std::string_view name) const {
+        for (std::size_t i = 0; i < variables_.size(); ++i) {
+            if (variables_[i] == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    const std::vector<Instruction>& code() const { return code_; }
+
+    // out[i] = expression over columns[v][i]. Rows with a zero divisor get the
+    // IEEE result (inf/nan) and the call returns DivisionByZero; errorRow, if
+    // given, receives the first such row.
+    Status evaluate(const double* const* columns, std::size_t n, double* out,
+                    std::size_t* errorRow = nullptr) const {
+        std::size_t firstBad = n;
+        std::size_t begin = 0;
+        for (; begin + kBatch <= n; begin += kBatch) {
+            runBatch<true>(columns, begin, kBatch, out + begin, firstBad);
+        }
+        if (begin < n) {
+            runBatch<false>(columns, begin, n - begin, out + begin, firstBad);
+        }
+        if (firstBad < n) {
+            if (errorRow) {
+                *errorRow = firstBad;
+            }
+            return Status::DivisionByZero;
+        }
+        return Status::Ok;
+    }
+
+    // One row; values[v] is the value of variables()[v].
+    Status evaluate(const double* values, double& result) const {
+        const double* columns[kMaxVariables];
+        std::size_t count = std::min(variables_.size(), kMaxVariables);
+        for (std::size_t v = 0; v < count; ++v) {
+            columns[v] = values + v;
+        }
+        return evaluate(columns, 1, &result);
+    }
+
+    static constexpr std::size_t kMaxVariables = 256;
+
+private:
+    friend class Compiler;
+
+    // Each instruction runs over the whole batch before the next one, so the
+    // dispatch switch is paid once per kBatch rows and the loops vectorize.
+    // Full batches use the constant trip count kBatch.
+    template <bool Full>
+    void runBatch(const double* const* columns, std::size_t begin, std::size_t m, double* out,
+                  std::size_t& firstBad) const {
+        alignas(64) double stack[kMaxDepth][kBatch];
+        const std::size_t len = Full ? kBatch : m;
+        std::size_t top = 0; // number of occupied slots
+        std::size_t bad = kBatch;
+        for (const Instruction& ins : code_) {
+            double* a = top > 0 ? stack[top - 1] : nullptr; // top of stack
+            switch (ins.op) {
+                case Op::LoadVar:
+                    std::copy(columns[ins.arg] + begin, columns[ins.arg] + begin + len, stack[top++]);
+                    break;
+                case Op::LoadConst:
+                    std::fill(stack[top], stack[top] + len, constants_[ins.arg]);
+                    ++top;
+                    break;
+                case Op::Neg:
+                    for (std::size_t i = 0; i < len; ++i) a[i] = -a[i];
+                    break;
+                case Op::Add: binary(stack[top - 2], a, len, std::plus<double>()); --top; break;
+                case Op::Sub: binary(stack[top - 2], a, len, std::minus<double>()); --top; break;
+                case Op::Mul: binary(stack[top - 2], a, len, std::multiplies<double>()); --top; break;
+                case Op::Div:
+                    checkDivisor(a, len, bad);
+                    binary(stack[top - 2], a, len, std::divides<double>());
+                    --top;
+                    break;
+                case Op::AddVar: binary(a, columns[ins.arg] + begin, len, std::plus<double>()); break;
+                case Op::SubVar: binary(a, columns[ins.arg] + begin, len, std::minus<double>()); break;
+                case Op::MulVar: binary(a, columns[ins.arg] + begin, len, std::multiplies<double>()); break;
+                case Op::DivVar:
+                    checkDivisor(columns[ins.arg] + begin, len, bad);
+                    binary(a, columns[ins.arg] + begin, len, std::divides<double>());
+                    break;
+                case Op::AddConst: addConstant(a, len, constants_[ins.arg]); break;
+                case Op::SubConst: addConstant(a, len, -constants_[ins.arg]); break;
+                case Op::MulConst: mulConstant(a, len, constants_[ins.arg]); break;
+                case Op::DivConst: {
+                    // Constant divisors are never zero: the compiler rejects them.
+                    double c = constants_[ins.arg];
+                    for (std::size_t i = 0; i < len; ++i) a[i] /= c;
+                    break;
+                }
+                case Op::ConstSub: {
+                    double c = constants_[ins.arg];
+                    for (std::size_t i = 0; i < len; ++i) a[i] = c - a[i];
+                    break;
+                }
+                case Op::ConstDiv: {
+                    checkDivisor(a, len, bad);
+                    double c = constants_[ins.arg];
+                    for (std::size_t i = 0; i < len; ++i) a[i] = c / a[i];
+                    break;
+                }
+            }
+        }
+        std::copy(stack[0], stack[0] + len, out);
+        if (bad < kBatch) {
+            firstBad = std::min(firstBad, begin + bad);
+        }
+    }
+
+    template <typename F>
+    static void binary(double* __restrict a, const double* __restrict b, std::size_t len, F f) {
+        for (std::size_t i = 0; i < len; ++i) {
+            a[i] = f(a[i], b[i]);
+        }
+    }
+
+    // Constants are passed by value: read through constants_ inside the loop,
+    // they could alias the stack and would be reloaded every iteration.
+    static void addConstant(double* a, std::size_t len, double c) {
+        for (std::size_t i = 0; i < len; ++i) a[i] += c;
+    }
+
+    static void mulConstant(double* a, std::size_t len, double c) {
+        for (std::size_t i = 0; i < len; ++i) a[i] *= c;
+    }
+
+    // A branch-free count keeps the common no-zero case vectorized; the
+    // offending row is only searched for when there is one.
+    static void checkDivisor(const double* b, std::size_t len, std::size_t& bad) {
+        std::size_t zeros = 0;
+        for (std::size_t i = 0; i < len; ++i) {
+            zeros += b[i] == 0.0;
+        }
+        if (zeros != 0) {
+            std::size_t i = 0;
+            while (b[i] != 0.0) {
+                ++i;
+            }
+            bad = std::min(bad, i);
+        }
+    }
+
+    std::vector<Instruction> code_;
+    std::vector<double> constants_;
+    std::vector<std::string> variables_;
+};
+
+// Recursive-descent parser to a small tree, constant folding, then bytecode
+// emission. Only compile() allocates.
+class Compiler {
+public:
+    static Status compile(std::string_view source, Program& program, std::size_t* errorPos) {
+        Compiler c(source);
+        int root = c.parseExpression();
+        c.skipSpace();
+        if (c.status_ == Status::Ok && c.pos_ != source.size()) {
+            c.status_ = Status::SyntaxError;
+        }
+        if (c.status_ == Status::Ok) {
+            c.emit(root, 0);
+        }
+        if (c.status_ != Status::Ok) {
+            if (errorPos) {
+                *errorPos = c.pos_;
+            }
+            return c.status_;
+        }
+        program.code_ = std::move(c.program_.code_);
+        program.constants_ = std::move(c.program_.constants_);
+        program.variables_ = std::move(c.program_.variables_);
+        return Status::Ok;
+    }
+
+private:
+    enum class Kind { Const, Var, Neg, Add, Sub, Mul, Div };
+
+    struct Node {
+        Kind kind;
+        double value;   // Const
+        std::uint32_t var; // Var
+        int lhs, rhs;   // operand nodes, -1 if unused
+        std::uint32_t height = 1;
+    };
+
+    explicit Compiler(std::string_view source) : source_(source) {}
+
+    // Grammar functions return a node index; on error they set status_ and
+    // return -1, and every caller stops as soon as status_ is not Ok.
+    int parseExpression() {
+        int lhs = parseTerm();
+        while (status_ == Status::Ok) {
+            char c = peek();
+            if (c != '+' && c != '-') {
+                break;
+            }
+            ++pos_;
+            int rhs = parseTerm();
+            lhs = makeBinary(c == '+' ? Kind::Add : Kind::Sub, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    int parseTerm() {
+        int lhs = parseUnary();
+        while (status_ == Status::Ok) {
+            char c = peek();
+            if (c != '*' && c != '/') {
+                break;
+            }
+            ++pos_;
+            int rhs = parseUnary();
+            lhs = makeBinary(c == '*' ? Kind::Mul : Kind::Div, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    int parseUnary() {
+        char c = peek();
+        if (c == '-' || c == '+') {
+            ++pos_;
+            if (!enter()) {
+                return -1;
+            }
+            int operand = parseUnary();
+            --nesting_;
+            if (status_ != Status::Ok || c == '+') {
+                return operand;
+            }
+            if (nodes_[operand].kind == Kind::Const) {
+                nodes_[operand].value = -nodes_[operand].value;
+                return operand;
+            }
+            return addNode({Kind::Neg, 0, 0, operand, -1});
+        }
+        return parsePrimary();
+    }
+
+    int parsePrimary() {
+        char c = peek();
+        if (c == '(') {
+            ++pos_;
+            if (!enter()) {
+                return -1;
+            }
+            int inner = parseExpression();
+            --nesting_;
+            if (status_ == Status::Ok && peek() != ')') {
+                status_ = Status::SyntaxError;
+            }
+            ++pos_;
+            return inner;
+        }
+        if ((c >= '0' && c <= '9') || c == '.') {
+            double value = 0;
+            auto result = std::from_chars(source_.data() + pos_, source_.data() + source_.size(), value);
+            if (result.ec != std::errc()) {
+                status_ = Status::SyntaxError;
+                return -1;
+            }
+            pos_ = static_cast<std::size_t>(result.ptr - source_.data());
+            return addNode({Kind::Const, value, 0, -1, -1});
+        }
+        if (isIdentifierStart(c)) {
+            std::size_t start = pos_;
+            while (pos_ < source_.size() && (isIdentifierStart(source_[pos_]) ||
+                                             (source_[pos_] >= '0' && source_[pos_] <= '9'))) {
+                ++pos_;
+            }
+            return addNode({Kind::Var, 0, variableSlot(source_.substr(start, pos_ - start)), -1, -1});
+        }
+        status_ = Status::SyntaxError;
+        return -1;
+    }
+
+    // One more level of parentheses or unary operators, if allowed.
+    bool enter() {
+        if (nesting_ == kMaxNesting) {
+            status_ = Status::TooComplex;
+            return false;
+        }
+        ++nesting_;
+        return true;
+    }
+
+    // Folds constant operands so "2 * 3 * x" emits one MulConst.
+    int makeBinary(Kind kind, int lhs, int rhs) {
+        if (status_ != Status::Ok) {
+            return -1;
+        }
+        const Node& l = nodes_[lhs];
+        const Node& r = nodes_[rhs];
+        if (kind == Kind::Div && r.kind == Kind::Const && r.value == 0.0) {
+            status_ = Status::DivisionByZero;
+            return -1;
+        }
+        if (l.kind == Kind::Const && r.kind == Kind::Const) {
+            double v = kind == Kind::Add ? l.value + r.value
+                     : kind == Kind::Sub ? l.value - r.value
+                     : kind == Kind::Mul ? l.value * r.value
+                                         : l.value / r.value;
+            return addNode({Kind::Const, v, 0, -1, -1});
+        }
+        return addNode({kind, 0, 0, lhs, rhs});
+    }
+
+    // Emits code for node with `depth` slots already in use. Leaves fold into
+    // the instruction that consumes them, and a commutative node with a leaf on
+    // the left is swapped so the bigger subtree is evaluated first.
+    void emit(int index, std::size_t depth) {
+        if (status_ != Status::Ok) {
+            return;
+        }
+        const Node& n = nodes_[index];
+        switch (n.kind) {
+            case Kind::Const:
+                push(depth, Op::LoadConst, constantSlot(n.value));
+                return;
+            case Kind::Var:
+                push(depth, Op::LoadVar, n.var);
+                return;
+            case Kind::Neg:
+                emit(n.lhs, depth);
+                program_.code_.push_back({Op::Neg, 0});
+                return;
+            default:
+                break;
+        }
+        int lhs = n.lhs;
+        int rhs = n.rhs;
+        bool commutative = n.kind == Kind::Add || n.kind == Kind::Mul;
+        if (commutative && isLeaf(lhs) && !isLeaf(rhs)) {
+            std::swap(lhs, rhs);
+        }
+        const Node& r = nodes_[rhs];
+        if (nodes_[lhs].kind == Kind::Const && (n.kind == Kind::Sub || n.kind == Kind::Div)) {
+            emit(rhs, depth);
+            program_.code_.push_back(
+                {n.kind == Kind::Sub ? Op::ConstSub : Op::ConstDiv, constantSlot(nodes_[lhs].value)});
+            return;
+        }
+        emit(lhs, depth);
+        if (r.kind == Kind::Var) {
+            program_.code_.push_back({withOperand(n.kind, Op::AddVar), r.var});
+        } else if (r.kind == Kind::Const) {
+            program_.code_.push_back({withOperand(n.kind, Op::AddConst), constantSlot(r.value)});
+        } else {
+            emit(rhs, depth + 1);
+            program_.code_.push_back({withOperand(n.kind, Op::Add), 0});
+        }
+    }
+
+    void push(std::size_t depth, Op op, std::uint32_t arg) {
+        if (depth >= kMaxDepth) {
+            status_ = Status::TooComplex;
+            return;
+        }
+        program_.code_.push_back({op, arg});
+    }
+
+    // Add/Sub/Mul/Div are consecutive in every operand group of Op.
+    static Op withOperand(Kind kind, Op group) {
+        int offset = kind == Kind::Add ? 0 : kind == Kind::Sub ? 1 : kind == Kind::Mul ? 2 : 3;
+        return static_cast<Op>(static_cast<int>(group) + offset);
+    }
+
+    bool isLeaf(int index) const {
+        return nodes_[index].kind == Kind::Const || nodes_[index].kind == Kind::Var;
+    }
+
+    std::uint32_t constantSlot(double value) {
+        auto& constants = program_.constants_;
+        for (std::size_t i = 0; i < constants.size(); ++i) {
+            if (constants[i] == value) {
+                return static_cast<std::uint32_t>(i);
+            }
+        }
+        constants.push_back(value);
+        return static_cast<std::uint32_t>(constants.size() - 1);
+    }
+
+    std::uint32_t variableSlot(std::string_view name) {
+        auto& variables = program_.variables_;
+        for (std::size_t i = 0; i < variables.size(); ++i) {
+            if (variables[i] == name) {
+                return static_cast<std::uint32_t>(i);
+            }
+        }
+        if (variables.size() == Program::kMaxVariables) {
+            status_ = Status::TooComplex;
+        }
+        variables.emplace_back(name);
+        return static_cast<std::uint32_t>(variables.size() - 1);
+    }
+
+    // A node taller than kMaxNesting (a long chain like "x + x + ... + x")
+    // sets TooComplex: emit() would recurse that deep.
+    int addNode(Node node) {
+        for (int child : {node.lhs, node.rhs}) {
+            if (child >= 0) {
+                node.height = std::max(node.height, nodes_[child].height + 1);
+            }
+        }
+        if (node.height > kMaxNesting) {
+            status_ = Status::TooComplex;
+        }
+        nodes_.push_back(node);
+        return static_cast<int>(nodes_.size() - 1);
+    }
+
+    char peek() {
+        skipSpace();
+        return pos_ < source_.size() ? source_[pos_] : '\0';
+    }
+
+    void skipSpace() {
+        while (pos_ < source_.size() && (source_[pos_] == ' ' || source_[pos_] == '\t')) {
+            ++pos_;
+        }
+    }
+
+    static bool isIdentifierStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    std::string_view source_;
+    std::size_t pos_ = 0;
+    std::size_t nesting_ = 0;  // open parentheses and unary operators
+    Status status_ = Status::Ok;
+    std::vector<Node> nodes_;
+    Program program_;
+};
+
+// errorPos, if given, receives the offset in source where compilation stopped.
+inline Status compile(std::string_view source, Program& program, std::size_t* errorPos = nullptr) {
+    return Compiler::compile(source, program, errorPos);
+}
+
+// Compiled programs keyed by source text. Lookups hash the string_view and do
+// not allocate; failed compilations are cached too, so a bad formula repeated
+// a million times is parsed once. Safe to share between threads.
+class ExpressionCache {
+public:
+    // Returns the program for source, or nullptr with status set on error.
+    std::shared_ptr<const Program> get(std::string_view source, Status* status = nullptr) {
+        std::size_t hash = std::hash<std::string_view>()(source);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& bucket = entries_[hash];
+        for (const Entry& e : bucket) {
+            if (e.source == source) {
+                if (status) {
+                    *status = e.status;
+                }
+                return e.program;
+            }
+        }
+        auto program = std::make_shared<Program>();
+        Status result = compile(source, *program);
+        if (result != Status::Ok) {
+            program.reset();
+        }
+        bucket.push_back({std::string(source), result, program});
+        ++size_;
+        if (status) {
+            *status = result;
+        }
+        return program;
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return size_;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        size_ = 0;
+    }
+
+private:
+    struct Entry {
+        std::string source;
+        Status status;
+        std::shared_ptr<const Program> program;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::size_t, std::vector<Entry>> entries_;
+    std::size_t size_ = 0;
+};
+
+} // namespace expr
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../week3/thread_pool.h"
+
+// Concurrent ledger for the day7 accounts.
+//
+// Amounts are fixed-point cents in an int64, so sums are exact and an update
+// is one atomic instruction. Each account's hot state sits in its own cache
+// line. Deposits and withdrawals are lock-free (CAS on the balance). A
+// transfer locks both accounts, lower id first, so transfers can never
+// deadlock and total() never sees money in flight.
+
+using Cents = std::int64_t;
+
+inline Cents toCents(double amount) {
+    return static_cast<Cents>(std::llround(amount * 100));
+}
+
+inline std::string formatCents(Cents cents) {
+    std::string sign = cents < 0 ? "-" : "";
+    Cents magnitude = cents < 0 ? -cents : cents;
+    std::string fraction = std::to_string(magnitude % 100);
+    return sign + std::to_string(magnitude / 100) + "." + (fraction.size() == 1 ? "0" : "") + fraction;
+}
+
+enum class TxStatus : std::uint8_t {
+    Ok,
+    InvalidAmount,
+    InsufficientFunds,
+    UnknownAccount,
+};
+
+struct LedgerEvent {
+    enum class Kind : std::uint8_t { Deposit, Withdraw, Transfer, Interest };
+
+    Kind kind;
+    TxStatus status;
+    std::uint32_t from; // the account for single-account events
+    std::uint32_t to;
+    Cents amount;
+};
+
+class Ledger {
+public:
+    using AccountId = std::uint32_t;
+
+    // Account slots are allocated up front so open() never moves them under
+    // concurrent updates. logCapacity > 0 turns on the event log: a ring of
+    // that many events (rounded up to a power of two), drained by drainLog().
+    explicit Ledger(std::size_t maxAccounts, std::size_t logCapacity = 0)
+        : slots_(new Slot[maxAccounts]), owners_(maxAccounts), maxAccounts_(maxAccounts) {
+        if (logCapacity > 0) {
+            std::size_t capacity = 1;
+            while (capacity < logCapacity) {
+                capacity <<= 1;
+            }
+            log_.reset(new LogSlot[capacity]);
+            logMask_ = capacity - 1;
+        }
+    }
+
+    Ledger(const Ledger&) = delete;
+    Ledger& operator=(const Ledger&) = delete;
+
+    // interestBasisPoints is the SavingsAccount rate in 1/100 of a percent
+    // (5% = 500). Throws when the ledger is full; safe to call concurrently.
+    //
+    // Everything else treats ids below size() as live, so the slot is filled
+    // before size() is advanced past it (release; size() acquires). Openers
+    // take a mutex to do that in id order: opening is rare, and the updates
+    // never touch it.
+    AccountId open(const std::string& owner, Cents initial, std::int32_t interestBasisPoints = 0) {
+        std::lock_guard<std::mutex> lock(openMutex_);
+        std::size_t id = opened_.load(std::memory_order_relaxed);
+        if (id == maxAccounts_) {
+            throw std::length_error("Ledger is full");
+        }
+        owners_[id] = owner;
+        slots_[id].interestBasisPoints = interestBasisPoints;
+        slots_[id].balance.store(initial, std::memory_order_relaxed);
+        opened_.store(id + 1, std::memory_order_release);
+        return static_cast<AccountId>(id);
+    }
+
+    std::size_t size() const { return opened_.load(std::memory_order_acquire); }
+
+    const std::string& owner(AccountId id) const { return owners_[id]; }
+
+    Cents balance(AccountId id) const {
+        return slots_[id].balance.load(std::memory_order_acquire);
+    }
+
+    TxStatus deposit(AccountId id, Cents amount) {
+        TxStatus status = checkArguments(id, id, amount);
+        if (status == TxStatus::Ok) {
+            slots_[id].balance.fetch_add(amount, std::memory_order_acq_rel);
+        }
+        record(LedgerEvent::Kind::Deposit, status, id, id, amount);
+        return status;
+    }
+
+    TxStatus withdraw(AccountId id, Cents amount) {
+        TxStatus status = checkArguments(id, id, amount);
+        if (status == TxStatus::Ok) {
+            status = tryDebit(slots_[id], amount);
+        }
+        record(LedgerEvent::Kind::Withdraw, status, id, id, amount);
+        return status;
+    }
+
+    TxStatus transfer(AccountId from, AccountId to, Cents amount) {
+        TxStatus status = checkArguments(from, to, amount);
+        if (status == TxStatus::Ok) {
+            if (from == to) {
+                status = balance(from) >= amount ? TxStatus::Ok : TxStatus::InsufficientFunds;
+            } else {
+                Slot& first = slots_[std::min(from, to)];
+                Slot& second = slots_[std::max(from, to)];
+                first.lock();
+                second.lock();
+                // Deposits and withdrawals do not take the locks, so the debit
+                // still has to be a CAS.
+                status = tryDebit(slots_[from], amount);
+                if (status == TxStatus::Ok) {
+                    slots_[to].balance.fetch_add(amount, std::memory_order_acq_rel);
+                }
+                second.unlock();
+                first.unlock();
+            }
+        }
+        record(LedgerEvent::Kind::Transfer, status, from, to, amount);
+        return status;
+    }
+
+    // Sum of all balances. Holds every account lock (in id order) while
+    // reading, so it is consistent with respect to transfers.
+    Cents total() const {
+        std::size_t n = size();
+        for (std::size_t i = 0; i < n; ++i) {
+            slots_[i].lock();
+        }
+        Cents sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += slots_[i].balance.load(std::memory_order_acquire);
+        }
+        for (std::size_t i = n; i-- > 0;) {
+            slots_[i].unlock();
+        }
+        return sum;
+    }
+
+    // SavingsAccount::addInterest for every account at once, split across the
+    // pool when one is given. Concurrent updates are safe: each credit is a CAS
+    // against the balance the interest was computed from. Returns the total paid.
+    Cents accrueInterest(ThreadPool* pool = nullptr, std::size_t threads = 0) {
+        std::size_t n = size();
+        if (!pool || threads <= 1 || n < kParallelInterestThreshold) {
+            return accrueRange(0, n);
+        }
+        std::size_t chunk = (n + threads - 1) / threads;
+        std::vector<std::future<Cents>> parts;
+        for (std::size_t begin = 0; begin < n; begin += chunk) {
+            std::size_t end = std::min(n, begin + chunk);
+            parts.push_back(pool->enqueue([this, begin, end] { return accrueRange(begin, end); }));
+        }
+        Cents paid = 0;
+        for (auto& part : parts) {
+            paid += part.get();
+        }
+        return paid;
+    }
+
+    bool logging() const { return log_ != nullptr; }
+
+    // Writes the events logged since the last drain, oldest first, and returns
+    // how many were written. Events overwritten by a full ring, or dropped by
+    // record() (see logDropped()), are reported as dropped in their place.
+    // Must not run concurrently with updates.
+    std::size_t drainLog(std::ostream& os) {
+        if (!log_) {
+            return 0;
+        }
+        std::uint64_t head = logHead_.load(std::memory_order_acquire);
+        std::uint64_t capacity = logMask_ + 1;
+        std::uint64_t dropped = 0;
+        if (head - logTail_ > capacity) {
+            dropped = head - logTail_ - capacity;
+            logTail_ = head - capacity;
+        }
+        static const char* const kinds[] = {"deposit", "withdraw", "transfer", "interest"};
+        static const char* const statuses[] = {"ok", "invalid amount", "insufficient funds", "unknown account"};
+        std::size_t written = 0;
+        for (; logTail_ < head; ++logTail_) {
+            const LogSlot& slot = log_[logTail_ & logMask_];
+            if (slot.sequence.load(std::memory_order_acquire) != logTail_ + 1) {
+                ++dropped;  // this event never made it into the slot
+                continue;
+            }
+            if (dropped != 0) {
+                os << "(" << dropped << " events dropped)\n";
+                dropped = 0;
+            }
+            const LedgerEvent& e = slot.event;
+            os << kinds[static_cast<int>(e.kind)] << " " << formatCents(e.amount) << " #" << e.from;
+            if (e.kind == LedgerEvent::Kind::Transfer) {
+                os << " -> #" << e.to;
+            }
+            os << ": " << statuses[static_cast<int>(e.status)] << "\n";
+            ++written;
+        }
+        if (dropped != 0) {
+            os << "(" << dropped << " events dropped)\n";
+        }
+        return written;
+    }
+
+    // Events record() gave up on because their ring slot was busy.
+    std::uint64_t logDropped() const { return logDropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr std::size_t kParallelInterestThreshold = 1 << 14;
+
+    struct alignas(64) Slot {
+        std::atomic<Cents> balance{0};
+        mutable std::atomic<bool> locked{false};
+        std::int32_t interestBasisPoints = 0;
+
+        // Test-and-test-and-set: spin on a plain load so waiting threads do
+        // not bounce the line, and yield if the holder was descheduled.
+        void lock() const {
+            for (int spins = 0;; ++spins) {
+                if (!locked.exchange(true, std::memory_order_acquire)) {
+                    return;
+                }
+                while (locked.load(std::memory_order_relaxed)) {
+                    if (++spins > 64) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        }
+
+        void unlock() const { locked.store(false, std::memory_order_release); }
+    };
+
+    static_assert(sizeof(Slot) == 64, "one account per cache line");
+
+    // An event and the number of the event it holds plus one, or kWriting
+    // while a writer fills it (as MpmcQueue's cells are stamped).
+    struct LogSlot {
+        static constexpr std::uint64_t kWriting = ~std::uint64_t(0);
+
+        std::atomic<std::uint64_t> sequence{0};
+        LedgerEvent event;
+    };
+
+    static TxStatus tryDebit(Slot& slot, Cents amount) {
+        Cents current = slot.balance.load(std::memory_order_relaxed);
+        do {
+            if (current < amount) {
+                return TxStatus::InsufficientFunds;
+            }
+        } while (!slot.balance.compare_exchange_weak(current, current - amount, std::memory_order_acq_rel,
+                                                     std::memory_order_relaxed));
+        return TxStatus::Ok;
+    }
+
+    TxStatus checkArguments(AccountId from, AccountId to, Cents amount) const {
+        if (from >= size() || to >= size()) {
+            return TxStatus::UnknownAccount;
+        }
+        return amount > 0 ? TxStatus::Ok : TxStatus::InvalidAmount;
+    }
+
+    Cents accrueRange(std::size_t begin, std::size_t end) {
+        Cents paid = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            Slot& slot = slots_[i];
+            if (slot.interestBasisPoints == 0) {
+                continue;
+            }
+            Cents current = slot.balance.load(std::memory_order_relaxed);
+            Cents interest;
+            do {
+                interest = interestOn(current, slot.interestBasisPoints);
+            } while (!slot.balance.compare_exchange_weak(current, current + interest, std::memory_order_acq_rel,
+                                                         std::memory_order_relaxed));
+            paid += interest;
+            record(LedgerEvent::Kind::Interest, TxStatus::Ok, static_cast<AccountId>(i),
+                   static_cast<AccountId>(i), interest);
+        }
+        return paid;
+    }
+
+    // balance * rate, rounded half away from zero. 128-bit so large balances
+    // cannot overflow the product.
+    static Cents interestOn(Cents balance, std::int32_t basisPoints) {
+        __int128 product = static_cast<__int128>(balance) * basisPoints;
+        __int128 half = product < 0 ? -5000 : 5000;
+        return static_cast<Cents>((product + half) / 10000);
+    }
+
+    // With logging off this is one predictable branch. With it on, a writer
+    // claims an event number with one fetch_add, then its ring slot with a
+    // CAS on the slot's sequence; nothing is formatted or printed until
+    // drainLog(). Once the ring wraps, a writer a whole lap ahead can reach
+    // the slot first, or still be writing it: then this event is dropped
+    // rather than written over it.
+    void record(LedgerEvent::Kind kind, TxStatus status, AccountId from, AccountId to, Cents amount) {
+        if (!log_) {
+            return;
+        }
+        std::uint64_t at = logHead_.fetch_add(1, std::memory_order_acq_rel);
+        LogSlot& slot = log_[at & logMask_];
+        std::uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        do {
+            if (sequence == LogSlot::kWriting || sequence > at) {
+                logDropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        } while (!slot.sequence.compare_exchange_weak(sequence, LogSlot::kWriting, std::memory_order_acquire,
+                                                      std::memory_order_relaxed));
+        slot.event = LedgerEvent{kind, status, from, to, amount};
+        slot.sequence.store(at + 1, std::memory_order_release);
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    std::vector<std::string> owners_;
+    std::size_t maxAccounts_;
+    std::mutex openMutex_;
+    std::atomic<std::size_t> opened_{0};  // accounts ready for use
+
+    std::unique_ptr<LogSlot[]> log_;
+    std::uint64_t logMask_ = 0;
+    std::atomic<std::uint64_t> logHead_{0};
+    std::atomic<std::uint64_t> logDropped_{0};
+    std::uint64_t logTail_ = 0;
+};
@@ -0,0 +1,288 @@
+// Transfers per second: day7-style accounts behind one mutex vs the lock-free/ordered-lock Ledger.
+// Build: g++ -std=c++17 -O2 ledger_bench.cpp -o ledger_bench -pthread
+// Usage: ./ledger_bench [transfers] [accounts] [threads]   (default 10M, 100K, hardware threads)
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ledger.h"
+
+// day7's Account made thread-safe the obvious way: one mutex over double balances.
+class MutexBank {
+public:
+    explicit MutexBank(std::size_t accounts, double initial) : balances_(accounts, initial) {}
+
+    // With a log stream it also prints every call the way day7 does.
+    bool transfer(std::size_t from, std::size_t to, double amount, std::ostream* log = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (amount <= 0 || amount > balances_[from]) {
+            if (log) *log << "Invalid withdrawal amount" << std::endl;
+            return false;
+        }
+        balances_[from] -= amount;
+        balances_[to] += amount;
+        if (log) *log << "Withdrew: " << amount << std::endl << "Deposited: " << amount << std::endl;
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<double> balances_;
+};
+
+struct Op {
+    std::uint32_t from;
+    std::uint32_t to;
+    Cents amount;
+};
+
+std::vector<Op> makeOps(std::size_t n, std::size_t accounts, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<Op> ops(n);
+    for (auto& op : ops) {
+        op = {static_cast<std::uint32_t>(rng() % accounts), static_cast<std::uint32_t>(rng() % accounts),
+              static_cast<Cents>(1 + rng() % 5000)};
+    }
+    return ops;
+}
+
+// Runs body(thread, begin, end) over ops split evenly across threads.
+template <typename Body>
+double runThreads(std::size_t threads, std::size_t n, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        workers.emplace_back(body, t, n * t / threads, n * (t + 1) / threads);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+bool check() {
+    // Mixed concurrent traffic: money is conserved and no balance goes negative.
+    const std::size_t accounts = 64, threads = 4, n = 200000;
+    Ledger ledger(accounts);
+    for (std::size_t i = 0; i < accounts; ++i) {
+        ledger.open("owner" + std::to_string(i), 10000);
+    }
+    Cents before = ledger.total();
+    auto ops = makeOps(n, accounts, 1);
+    std::vector<Cents> net(threads, 0);
+    std::atomic<bool> sawNegative{false};
+    runThreads(threads, n, [&](std::size_t t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const Op& op = ops[i];
+            switch (i % 4) {
+                case 0:
+                    if (ledger.deposit(op.from, op.amount) == TxStatus::Ok) net[t] += op.amount;
+                    break;
+                case 1:
+                    if (ledger.withdraw(op.from, op.amount) == TxStatus::Ok) net[t] -= op.amount;
+                    break;
+                default:
+                    ledger.transfer(op.from, op.to, op.amount);
+                    break;
+            }
+            if (i % 1024 == 0 && ledger.balance(op.to) < 0) {
+                sawNegative = true;
+            }
+        }
+    });
+    Cents expected = before;
+    for (Cents c : net) {
+        expected += c;
+    }
+    if (ledger.total() != expected || sawNegative) {
+        std::cerr << "ledger total " << ledger.total() << ", expected " << expected << std::endl;
+        return false;
+    }
+
+    // Accounts opened while another thread reads and updates the ones already
+    // open: none is seen half-written and no deposit is lost. The -tsan build
+    // checks the ordering.
+    const std::size_t opened = 4000;
+    Ledger growing(opened);
+    std::atomic<bool> opening{true};
+    std::atomic<bool> sawHalfOpen{false};
+    Cents paid = 0, deposited = 0;
+    std::thread reader([&] {
+        while (opening.load()) {
+            growing.total();
+            paid += growing.accrueInterest();
+            std::size_t size = growing.size();
+            if (size > 0) {
+                if (growing.owner(static_cast<Ledger::AccountId>(size - 1)).compare(0, 5, "owner") != 0) {
+                    sawHalfOpen = true;
+                }
+                if (growing.deposit(static_cast<Ledger::AccountId>(size - 1), 1) == TxStatus::Ok) {
+                    ++deposited;
+                }
+            }
+        }
+    });
+    runThreads(threads, opened, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            growing.open("owner" + std::to_string(i), 100, 100);
+        }
+    });
+    opening = false;
+    reader.join();
+    if (growing.size() != opened || growing.total() != static_cast<Cents>(opened) * 100 + paid + deposited ||
+        sawHalfOpen) {
+        std::cerr << "concurrent open: total " << growing.total() << std::endl;
+        return false;
+    }
+
+    // Argument errors are statuses.
+    if (ledger.deposit(0, 0) != TxStatus::InvalidAmount || ledger.withdraw(0, -5) != TxStatus::InvalidAmount ||
+        ledger.transfer(0, accounts, 1) != TxStatus::UnknownAccount ||
+        ledger.withdraw(1, ledger.balance(1) + 1) != TxStatus::InsufficientFunds) {
+        return false;
+    }
+
+    // Parallel interest equals the sequential result.
+    const std::size_t many = 50000;
+    Ledger sequential(many), parallel(many);
+    std::mt19937 rng(3);
+    for (std::size_t i = 0; i < many; ++i) {
+        Cents initial = rng() % 10000000;
+        std::int32_t rate = static_cast<std::int32_t>(rng() % 800);
+        sequential.open("", initial, rate);
+        parallel.open("", initial, rate);
+    }
+    ThreadPool pool(4);
+    if (sequential.accrueInterest() != parallel.accrueInterest(&pool, 4) ||
+        sequential.total() != parallel.total()) {
+        return false;
+    }
+    Ledger one(1);
+    one.open("Jane Doe", toCents(3000.0), 500);
+    if (one.accrueInterest() != toCents(150.0) || formatCents(one.balance(0)) != "3150.00") {
+        return false;
+    }
+
+    // The log records every call, including the failed ones, and only prints on drain.
+    Ledger logged(2, 8);
+    logged.open("a", 100);
+    logged.open("b", 0);
+    logged.transfer(0, 1, 30);
+    logged.withdraw(1, 31);
+    std::ostringstream os;
+    if (logged.drainLog(os) != 2 || os.str() != "transfer 0.30 #0 -> #1: ok\nwithdraw 0.31 #1: insufficient funds\n" ||
+        logged.drainLog(os) != 0) {
+        return false;
+    }
+
+    // Many writers wrapping a small ring: every event is either drained or
+    // reported as dropped, and none is torn (the -tsan build checks that
+    // slots are never written concurrently).
+    Ledger busy(2, 16);
+    busy.open("a", 0);
+    const std::size_t events = 40000;
+    runThreads(threads, events, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            busy.deposit(0, 1);
+        }
+    });
+    std::ostringstream drained;
+    std::size_t written = busy.drainLog(drained);
+    std::size_t lines = 0, dropped = 0;
+    std::istringstream in(drained.str());
+    for (std::string line; std::getline(in, line); ++lines) {
+        if (line[0] == '(') {
+            dropped += std::stoull(line.substr(1));
+        } else if (line != "deposit 0.01 #0: ok") {
+            std::cerr << "torn log event: " << line << std::endl;
+            return false;
+        }
+    }
+    if (written > 16 || written + dropped != events || lines < written) {
+        std::cerr << "log: " << written << " written, " << dropped << " dropped of " << events << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t n = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    std::size_t accounts = argc > 2 ? std::stoull(argv[2]) : 100000;
+    std::size_t threads = argc > 3 ? std::stoull(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    if (!check()) {
+        std::cerr << "ledger check failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Ledger invariants hold under concurrent transfers." << std::endl;
+
+    auto ops = makeOps(n, accounts, 7);
+    std::cout << "\n" << n << " transfers over " << accounts << " accounts, " << threads
+              << " thread(s), million transfers per second" << std::endl;
+
+    // Printing is slow enough that a slice is plenty to measure it.
+    std::size_t slice = std::min<std::size_t>(n, 1000000);
+    MutexBank printingBank(accounts, 100.0);
+    std::ostringstream sink;
+    double printingTime = runThreads(1, slice, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            printingBank.transfer(ops[i].from, ops[i].to, static_cast<double>(ops[i].amount) / 100, &sink);
+        }
+    });
+
+    MutexBank bank(accounts, 100.0);
+    double mutexTime = runThreads(threads, n, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            bank.transfer(ops[i].from, ops[i].to, static_cast<double>(ops[i].amount) / 100);
+        }
+    });
+
+    auto ledgerRun = [&](std::size_t logCapacity) {
+        Ledger ledger(accounts, logCapacity);
+        for (std::size_t i = 0; i < accounts; ++i) {
+            ledger.open("", toCents(100.0), 250);
+        }
+        return runThreads(threads, n, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                ledger.transfer(ops[i].from, ops[i].to, ops[i].amount);
+            }
+        });
+    };
+    double ledgerTime = ledgerRun(0);
+    double loggedTime = ledgerRun(1 << 20);
+
+    double base = static_cast<double>(n) / mutexTime / 1e6;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  day7 style, prints every call " << std::setw(8) << slice / printingTime / 1e6 << std::endl;
+    std::cout << "  one mutex + double balances   " << std::setw(8) << base << std::endl;
+    std::cout << "  Ledger, log off               " << std::setw(8) << n / ledgerTime / 1e6 << "   "
+              << mutexTime / ledgerTime << "x" << std::endl;
+    std::cout << "  Ledger, log on (ring buffer)  " << std::setw(8) << n / loggedTime / 1e6 << "   "
+              << mutexTime / loggedTime << "x" << std::endl;
+
+    // Interest accrual over every account.
+    const std::size_t interestAccounts = std::max<std::size_t>(accounts, 1000000);
+    Ledger savings(interestAccounts);
+    for (std::size_t i = 0; i < interestAccounts; ++i) {
+        savings.open("", toCents(1000.0), 500);
+    }
+    ThreadPool pool(threads);
+    auto timeIt = [](auto&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    double serial = timeIt([&] { savings.accrueInterest(); });
+    double pooled = timeIt([&] { savings.accrueInterest(&pool, threads); });
+    std::cout << "\nInterest on " << interestAccounts << " accounts: " << std::setprecision(1) << serial
+              << " ms serial, " << pooled << " ms on " << threads << " thread(s)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,545 @@
+#pragma once
+
+// Micro-benchmark harness.
+//
+//   bench::Runner runner(argc, argv);
+//   runner.run("copy", [] { return BigObject(n); },           // setup, not timed
+//              [](BigObject& o) { BigObject c(o); bench::doNotOptimize(c); });
+//   runner.run("sum", [&] { bench::doNotOptimize(sum(v)); }); // whole call timed
+//   return runner.finish();
+//
+// Each benchmark is warmed up, calibrated so one sample lasts at least
+// --min-time, then sampled --samples times. Reported per iteration: median,
+// p99, mean and stddev of the samples, heap allocations and bytes (when the
+// operator new hook is compiled in), and hardware counters from
+// perf_event_open when the kernel allows them.
+//
+// Flags: --filter=<substring>  --samples=<n>  --min-time=<ms>  --json
+// Other arguments are left for the program in runner.args().
+//
+// To count allocations, define BENCH_COUNT_ALLOCATIONS in exactly one
+// translation unit before including this header: it replaces the global
+// operator new/delete with counting versions.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_HAVE_PERF 1
+#else
+#define BENCH_HAVE_PERF 0
+#endif
+
+namespace bench {
+
+// Forces value to be materialized, so the computation producing it cannot
+// be optimized away. The empty asm claims to read it from a register or
+// memory and to clobber memory.
+template <typename T>
+inline void doNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename T>
+inline void doNotOptimize(T& value) {
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+// Forces pending stores to memory to happen before this point.
+inline void clobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+// For the checks a benchmark runs first: prints what went wrong and
+// returns false, as in `return ok || bench::fail("lost a key");`.
+inline bool fail(const std::string& what) {
+    std::cerr << what << std::endl;
+    return false;
+}
+
+namespace detail {
+
+struct AllocationCounters {
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> bytes{0};
+};
+
+inline AllocationCounters& allocationCounters() {
+    static AllocationCounters counters;
+    return counters;
+}
+
+inline bool& allocationHookInstalled() {
+    static bool installed = false;
+    return installed;
+}
+
+inline void* countedAllocate(std::size_t size, std::size_t alignment) {
+    auto& counters = allocationCounters();
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    void* p = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        p = std::malloc(size);
+    } else if (posix_memalign(&p, alignment, size) != 0) {
+        p = nullptr;
+    }
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+#if BENCH_HAVE_PERF
+// One group of hardware counters read together: cycles, instructions,
+// cache misses and branch misses, user space only.
+class PerfCounters {
+public:
+    static constexpr int kCount = 4;
+
+    PerfCounters() {
+        const std::uint64_t configs[kCount] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                               PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < kCount; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds_[0], 0));
+            if (fd < 0) {
+                close();
+                return;
+            }
+            fds_[i] = fd;
+        }
+    }
+
+    ~PerfCounters() { close(); }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return fds_[0] >= 0; }
+
+    void start() {
+        ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    // Fills values with the counts since start().
+    bool stop(std::uint64_t (&values)[kCount]) {
+        ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        std::uint64_t buffer[1 + kCount];
+        if (read(fds_[0], buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer)) || buffer[0] != kCount) {
+            return false;
+        }
+        std::copy(buffer + 1, buffer + 1 + kCount, values);
+        return true;
+    }
+
+private:
+    void close() {
+        for (int& fd : fds_) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+
+    int fds_[kCount] = {-1, -1, -1, -1};
+};
+#else
+class PerfCounters {
+public:
+    static constexpr int kCount = 4;
+    bool available() const { return false; }
+    void start() {}
+    bool stop(std::uint64_t (&)[kCount]) { return false; }
+};
+#endif
+
+inline std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+} // namespace detail
+
+struct Result {
+    std::string name;
+    std::size_t iterations = 0; // per sample
+    std::size_t samples = 0;
+    double medianNs = 0;
+    double p99Ns = 0;
+    double meanNs = 0;
+    double stddevNs = 0;
+    double minNs = 0;
+    // Per iteration; negative when not measured.
+    double allocations = -1;
+    double allocatedBytes = -1;
+    double cycles = -1;
+    double instructions = -1;
+    double cacheMisses = -1;
+    double branchMisses = -1;
+};
+
+class Runner {
+public:
+    Runner(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--filter=", 0) == 0) {
+                filter_ = arg.substr(9);
+            } else if (arg.rfind("--samples=", 0) == 0) {
+                samples_ = std::max(1, std::atoi(arg.c_str() + 10));
+            } else if (arg.rfind("--min-time=", 0) == 0) {
+                minSampleSeconds_ = std::atof(arg.c_str() + 11) / 1000.0;
+            } else if (arg == "--json") {
+                json_ = true;
+            } else {
+                args_.push_back(arg);
+            }
+        }
+    }
+
+    // Arguments not consumed by the harness, in order.
+    const std::vector<std::string>& args() const { return args_; }
+
+    bool selected(const std::string& name) const {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    // Times fn() as one iteration; each sample runs it in a tight loop.
+    template <typename Fn>
+    void run(const std::string& name, Fn&& fn) {
+        if (!selected(name)) {
+            return;
+        }
+        runSamples(name, [&](std::size_t iterations, Measurement& m) {
+            measure(m, [&] {
+                for (std::size_t i = 0; i < iterations; ++i) {
+                    fn();
+                }
+            });
+        });
+    }
+
+    // Times fn(input) as one iteration, with input = setup() created before
+    // the clock starts and destroyed after it stops. Only one input exists at
+    // a time, so each call is timed on its own and the cost of reading the
+    // clock is subtracted; results below ~50 ns are dominated by that noise.
+    template <typename Setup, typename Fn>
+    void run(const std::string& name, Setup&& setup, Fn&& fn) {
+        if (!selected(name)) {
+            return;
+        }
+        runSamples(name, [&](std::size_t iterations, Measurement& m) {
+            m = Measurement();
+            Measurement one;
+            for (std::size_t i = 0; i < iterations; ++i) {
+                auto input = setup();
+                measure(one, [&] { fn(input); });
+                one.seconds = std::max(0.0, one.seconds - clockOverhead_);
+                m.add(one);
+            }
+        });
+    }
+
+    const std::vector<Result>& results() const { return results_; }
+
+    // The result of the benchmark called name, or null if it did not run.
+    const Result* result(const std::string& name) const {
+        for (const Result& r : results_) {
+            if (r.name == name) {
+                return &r;
+            }
+        }
+        return nullptr;
+    }
+
+    // Prints the JSON document if --json was given. Returns main's exit code.
+    int finish() {
+        if (json_) {
+            printJson(std::cout);
+        }
+        return 0;
+    }
+
+private:
+    struct Measurement {
+        double seconds = 0;
+        std::uint64_t allocations = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t counters[detail::PerfCounters::kCount] = {};
+        bool countersValid = false;
+
+        void add(const Measurement& m) {
+            seconds += m.seconds;
+            allocations += m.allocations;
+            bytes += m.bytes;
+            for (int i = 0; i < detail::PerfCounters::kCount; ++i) {
+                counters[i] += m.counters[i];
+            }
+            countersValid = m.countersValid;
+        }
+    };
+
+    // Warmup, then grow iterations until a sample lasts --min-time of wall
+    // clock (setup included, so per-call timing cannot run away), then take
+    // the samples.
+    template <typename Sample>
+    void runSamples(const std::string& name, Sample&& sample) {
+        Measurement m;
+        std::size_t iterations = 1;
+        double wall = wallSeconds([&] { sample(iterations, m); });
+        while (wall < minSampleSeconds_ && iterations < (std::size_t(1) << 30)) {
+            double scale = wall > 0 ? minSampleSeconds_ / wall : 100.0;
+            iterations = std::max(iterations + 1, static_cast<std::size_t>(static_cast<double>(iterations) *
+                                                                            std::min(scale * 1.2, 100.0)));
+            wall = wallSeconds([&] { sample(iterations, m); });
+        }
+
+        std::vector<double> perIteration;
+        Measurement total;
+        for (int s = 0; s < samples_; ++s) {
+            sample(iterations, m);
+            perIteration.push_back(m.seconds * 1e9 / static_cast<double>(iterations));
+            total.add(m);
+        }
+        report(summarize(name, iterations, perIteration, total));
+    }
+
+    template <typename F>
+    static double wallSeconds(F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Median time measure() reports for an empty body.
+    double measureClockOverhead() {
+        std::vector<double> times;
+        Measurement m;
+        for (int i = 0; i < 201; ++i) {
+            measure(m, [] {});
+            times.push_back(m.seconds);
+        }
+        std::nth_element(times.begin(), times.begin() + 100, times.end());
+        return times[100];
+    }
+
+    template <typename Body>
+    void measure(Measurement& m, Body&& body) {
+        auto& counters = detail::allocationCounters();
+        std::uint64_t allocations = counters.count.load(std::memory_order_relaxed);
+        std::uint64_t bytes = counters.bytes.load(std::memory_order_relaxed);
+        if (perf_.available()) {
+            perf_.start();
+        }
+        clobberMemory();
+        auto start = std::chrono::steady_clock::now();
+        body();
+        clobberMemory();
+        auto end = std::chrono::steady_clock::now();
+        m.countersValid = perf_.available() && perf_.stop(m.counters);
+        m.seconds = std::chrono::duration<double>(end - start).count();
+        m.allocations = counters.count.load(std::memory_order_relaxed) - allocations;
+        m.bytes = counters.bytes.load(std::memory_order_relaxed) - bytes;
+    }
+
+    Result summarize(const std::string& name, std::size_t iterations, std::vector<double> ns,
+                     const Measurement& total) const {
+        Result r;
+        r.name = name;
+        r.iterations = iterations;
+        r.samples = ns.size();
+        std::sort(ns.begin(), ns.end());
+        r.minNs = ns.front();
+        r.medianNs = ns.size() % 2 ? ns[ns.size() / 2] : (ns[ns.size() / 2 - 1] + ns[ns.size() / 2]) / 2;
+        std::size_t p99 = static_cast<std::size_t>(std::ceil(0.99 * static_cast<double>(ns.size()))) - 1;
+        r.p99Ns = ns[std::min(p99, ns.size() - 1)];
+        double sum = 0;
+        for (double x : ns) {
+            sum += x;
+        }
+        r.meanNs = sum / static_cast<double>(ns.size());
+        double squares = 0;
+        for (double x : ns) {
+            squares += (x - r.meanNs) * (x - r.meanNs);
+        }
+        r.stddevNs = ns.size() > 1 ? std::sqrt(squares / static_cast<double>(ns.size() - 1)) : 0.0;
+
+        double runs = static_cast<double>(iterations) * static_cast<double>(ns.size());
+        if (detail::allocationHookInstalled()) {
+            r.allocations = static_cast<double>(total.allocations) / runs;
+            r.allocatedBytes = static_cast<double>(total.bytes) / runs;
+        }
+        if (total.countersValid) {
+            r.cycles = static_cast<double>(total.counters[0]) / runs;
+            r.instructions = static_cast<double>(total.counters[1]) / runs;
+            r.cacheMisses = static_cast<double>(total.counters[2]) / runs;
+            r.branchMisses = static_cast<double>(total.counters[3]) / runs;
+        }
+        return r;
+    }
+
+    static std::string formatNs(double ns) {
+        std::ostringstream os;
+        os << std::fixed << std::setprecision(ns < 10 ? 2 : ns < 1000 ? 1 : 0);
+        if (ns >= 1e9) {
+            os << ns / 1e9 << " s";
+        } else if (ns >= 1e6) {
+            os << ns / 1e6 << " ms";
+        } else if (ns >= 1e3) {
+            os << ns / 1e3 << " us";
+        } else {
+            os << ns << " ns";
+        }
+        return os.str();
+    }
+
+    static std::string formatCount(double value) {
+        if (value < 0) {
+            return "-";
+        }
+        std::ostringstream os;
+        os << std::fixed << std::setprecision(value < 100 ? 1 : 0) << value;
+        return os.str();
+    }
+
+    void report(const Result& r) {
+        results_.push_back(r);
+        if (json_) {
+            return;
+        }
+        if (!headerPrinted_) {
+            std::cout << std::left << std::setw(32) << "benchmark" << std::right << std::setw(12) << "median"
+                      << std::setw(12) << "p99" << std::setw(10) << "stddev" << std::setw(10) << "allocs"
+                      << std::setw(12) << "bytes" << std::setw(12) << "cycles" << std::setw(8) << "IPC" << std::endl;
+            headerPrinted_ = true;
+        }
+        double relative = r.meanNs > 0 ? 100.0 * r.stddevNs / r.meanNs : 0.0;
+        std::ostringstream stddev;
+        stddev << std::fixed << std::setprecision(1) << relative << "%";
+        std::string ipc = "-";
+        if (r.cycles > 0) {
+            std::ostringstream os;
+            os << std::fixed << std::setprecision(2) << r.instructions / r.cycles;
+            ipc = os.str();
+        }
+        std::cout << std::left << std::setw(32) << r.name << std::right << std::setw(12) << formatNs(r.medianNs)
+                  << std::setw(12) << formatNs(r.p99Ns) << std::setw(10) << stddev.str() << std::setw(10)
+                  << formatCount(r.allocations) << std::setw(12) << formatCount(r.allocatedBytes) << std::setw(12)
+                  << formatCount(r.cycles) << std::setw(8) << ipc << std::endl;
+    }
+
+    void printJson(std::ostream& os) const {
+        auto number = [](double v) {
+            std::ostringstream s;
+            if (v < 0) {
+                s << "null";
+            } else {
+                s << std::setprecision(9) << v;
+            }
+            return s.str();
+        };
+        os << "{\"benchmarks\": [";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const Result& r = results_[i];
+            os << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << detail::jsonEscape(r.name) << "\""
+               << ", \"iterations\": " << r.iterations << ", \"samples\": " << r.samples
+               << ", \"median_ns\": " << number(r.medianNs) << ", \"p99_ns\": " << number(r.p99Ns)
+               << ", \"mean_ns\": " << number(r.meanNs) << ", \"stddev_ns\": " << number(r.stddevNs)
+               << ", \"min_ns\": " << number(r.minNs) << ", \"allocations\": " << number(r.allocations)
+               << ", \"allocated_bytes\": " << number(r.allocatedBytes) << ", \"cycles\": " << number(r.cycles)
+               << ", \"instructions\": " << number(r.instructions) << ", \"cache_misses\": " << number(r.cacheMisses)
+               << ", \"branch_misses\": " << number(r.branchMisses) << "}";
+        }
+        os << "\n]}" << std::endl;
+    }
+
+    std::string filter_;
+    int samples_ = 20;
+    double minSampleSeconds_ = 0.01;
+    bool json_ = false;
+    bool headerPrinted_ = false;
+    std::vector<std::string> args_;
+    std::vector<Result> results_;
+    detail::PerfCounters perf_;
+    double clockOverhead_ = measureClockOverhead();
+};
+
+} // namespace bench
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+namespace {
+struct BenchAllocationHook {
+    BenchAllocationHook() { bench::detail::allocationHookInstalled() = true; }
+} benchAllocationHook;
+} // namespace
+
+void* operator new(std::size_t size) {
+    return bench::detail::countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size) {
+    return bench::detail::countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return bench::detail::countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return bench::detail::countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+// Not inlined: GCC would otherwise see free() paired with operator new at
+// the call site and warn (-Wmismatched-new-delete).
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
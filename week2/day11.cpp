@@ -1,6 +1,7 @@
 #include <iostream>
 #include <memory>
-#include <fstream>
+
+#include "../week3/log_file.h"
 
 // Function to demonstrate unique_ptr with dynamic array
 void uniquePtrExample() {
@@ -16,8 +17,10 @@ void uniquePtrExample() {
 
 // Function to demonstrate shared_ptr with a shared resource (log file)
 void sharedPtrExample() {
-    auto logFile = std::make_shared<std::ofstream>("log.txt", std::ios::app);
-    if (!logFile->is_open()) {
+    // Compressed into log.txt.lz when CPP30_LOG_COMPRESS is set.
+    LogFile::Options options = LogFile::Options::fromEnvironment();
+    auto logFile = std::make_shared<LogFile>(LogFile::pathFor("log.txt", options), options);
+    if (!*logFile) {
         std::cerr << "Failed to open log file" << std::endl;
         return;
     }
@@ -25,8 +28,8 @@ void sharedPtrExample() {
     auto logWriter1 = logFile;
     auto logWriter2 = logFile;
 
-    *logWriter1 << "Log entry from writer 1" << std::endl;
-    *logWriter2 << "Log entry from writer 2" << std::endl;
+    logWriter1->writeLine("Log entry from writer 1");
+    logWriter2->writeLine("Log entry from writer 2");
 }
 
 int main() {
@@ -1,45 +1,74 @@
+#define BENCH_COUNT_ALLOCATIONS
 #include <iostream>
+#include <optional>
 #include <vector>
-#include <chrono>
+
+#include "bench.h"
 
 class BigObject {
 public:
-    BigObject(size_t size) : data(size) {
-        std::cout << "Constructing BigObject of size " << size << std::endl;
-    }
+    BigObject(size_t size) : data(size) {}
 
     // Copy constructor
-    BigObject(const BigObject& other) : data(other.data) {
-        std::cout << "Copy constructing BigObject" << std::endl;
-    }
+    BigObject(const BigObject& other) : data(other.data) {}
 
     // Move constructor
-    BigObject(BigObject&& other) noexcept : data(std::move(other.data)) {
-        std::cout << "Move constructing BigObject" << std::endl;
-    }
+    BigObject(BigObject&& other) noexcept : data(std::move(other.data)) {}
+
+    size_t size() const { return data.size(); }
 
 private:
     std::vector<int> data;
 };
 
-int main() {
-    const size_t size = 10000000;
+// Source and destination of one copy or move. The destination is filled in
+// the timed region but destroyed outside it, so freeing its buffer is not
+// counted against the constructor.
+struct Construction {
+    BigObject source;
+    std::optional<BigObject> target;
+};
+
+// Usage: ./day12 [elements] [--filter=copy] [--samples=n] [--min-time=ms] [--json]
+int main(int argc, char* argv[]) {
+    bench::Runner runner(argc, argv);
+    const size_t size = runner.args().empty() ? 10000000 : std::stoul(runner.args()[0]);
+
+    auto setup = [size] { return Construction{BigObject(size), std::nullopt}; };
+
+    runner.run("construct", [size] {
+        BigObject obj(size);
+        bench::doNotOptimize(obj);
+    });
 
     // Measure copy constructor performance
-    auto start = std::chrono::high_resolution_clock::now();
-    BigObject obj1(size);
-    BigObject obj2 = obj1; // Copy constructor
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> copy_duration = end - start;
-    std::cout << "Copy constructor took " << copy_duration.count() << " seconds" << std::endl;
+    runner.run("copy construct", setup, [](Construction& c) {
+        c.target.emplace(c.source);
+        bench::doNotOptimize(c.target);
+    });
 
     // Measure move constructor performance
-    start = std::chrono::high_resolution_clock::now();
-    BigObject obj3(size);
-    BigObject obj4 = std::move(obj3); // Move constructor
-    end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> move_duration = end - start;
-    std::cout << "Move constructor took " << move_duration.count() << " seconds" << std::endl;
-
-    return 0;
-}
\ No newline at end of file
+    runner.run("move construct", setup, [](Construction& c) {
+        c.target.emplace(std::move(c.source));
+        bench::doNotOptimize(c.target);
+    });
+
+    // Copies and moves of a vector<BigObject> that reallocates as it grows.
+    runner.run("push_back copies", [size] {
+        BigObject obj(size / 100);
+        std::vector<BigObject> objects;
+        for (int i = 0; i < 100; ++i) {
+            objects.push_back(obj);
+        }
+        bench::doNotOptimize(objects);
+    });
+    runner.run("emplace_back + move", [size] {
+        std::vector<BigObject> objects;
+        for (int i = 0; i < 100; ++i) {
+            objects.emplace_back(size / 100);
+        }
+        bench::doNotOptimize(objects);
+    });
+
+    return runner.finish();
+}
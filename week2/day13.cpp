@@ -1,7 +1,11 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
+
+#include "../week3/async_io.h"
+#include "serialize.h"
+#include "student_table.h"
 
 class Student {
 public:
@@ -13,39 +17,51 @@ public:
     Student(const std::string& name, int age, const std::string& id)
         : name(name), age(age), id(id) {}
 
-    void serialize(std::ofstream& ofs) const {
-        ofs << name << '\n' << age << '\n' << id << '\n';
-    }
+    // One field per line, generated from refl::Describe<Student>.
+    void serialize(std::string& out) const;
+    bool deserialize(aio::LineReader& ifs);
+};
 
-    void deserialize(std::ifstream& ifs) {
-        std::getline(ifs, name);
-        ifs >> age;
-        ifs.ignore(); // Ignore the newline character after age
-        std::getline(ifs, id);
-    }
+template <>
+struct refl::Describe<Student> {
+    static constexpr auto fields = std::make_tuple(refl::field("name", &Student::name), refl::field("age", &Student::age),
+                                                   refl::field("id", &Student::id));
 };
 
+void Student::serialize(std::string& out) const {
+    refl::lines::encode(*this, out);
+}
+
+bool Student::deserialize(aio::LineReader& ifs) {
+    return refl::lines::decodeFrom([&ifs](std::string_view& line) { return ifs.next(line); }, *this);
+}
+
+// Both sides overlap the disk with the work: the writer sends full
+// buffers in the background, the reader fetches the next chunk while
+// this one is parsed.
 void saveStudents(const std::vector<Student>& students, const std::string& filename) {
-    std::ofstream ofs(filename);
+    aio::FileWriter ofs(filename);
     if (!ofs) {
         std::cerr << "Error opening file for writing: " << filename << std::endl;
         return;
     }
+    std::string record;
     for (const auto& student : students) {
-        student.serialize(ofs);
+        record.clear();
+        student.serialize(record);
+        ofs.write(record);
     }
 }
 
 std::vector<Student> loadStudents(const std::string& filename) {
     std::vector<Student> students;
-    std::ifstream ifs(filename);
+    aio::LineReader ifs(filename);
     if (!ifs) {
         std::cerr << "Error opening file for reading: " << filename << std::endl;
         return students;
     }
-    while (ifs.peek() != EOF) {
-        Student student;
-        student.deserialize(ifs);
+    Student student;
+    while (student.deserialize(ifs)) {
         students.push_back(student);
     }
     return students;
@@ -71,5 +87,15 @@ int main() {
         std::cout << "Name: " << student.name << ", Age: " << student.age << ", ID: " << student.id << std::endl;
     }
 
+    // Same file, loaded column-wise for queries over many rows
+    StudentTable table;
+    if (table.importText(filename)) {
+        std::cout << "Students aged 21-22: " << table.countAgeBetween(21, 22)
+                  << ", average age: " << table.averageAge() << std::endl;
+        for (StudentTable::Row row : table.filterAgeBetween(21, 22)) {
+            std::cout << "  " << table.name(row) << " (" << table.id(row) << ")" << std::endl;
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include <iostream>
 #include <vector>
-#include <fstream>
 #include <algorithm>
 #include <string>
-#include <sstream>
+#include <string_view>
+
+#include "../week3/async_io.h"
+#include "serialize.h"
 
 struct Contact {
     std::string name;
@@ -11,6 +13,13 @@ struct Contact {
     std::string email;
 };
 
+template <>
+struct refl::Describe<Contact> {
+    static constexpr auto fields = std::make_tuple(refl::field("name", &Contact::name),
+                                                   refl::field("phone", &Contact::phone),
+                                                   refl::field("email", &Contact::email));
+};
+
 class ContactManager {
 public:
     void addContact(const Contact& contact) {
@@ -36,22 +45,39 @@ public:
         }
     }
 
+    // One write per full buffer instead of a flush per line. Fields with
+    // commas, quotes or line breaks are quoted (refl::csv).
     void saveToFile(const std::string& filename) const {
-        std::ofstream file(filename);
+        aio::FileWriter file(filename);
+        std::string record;
         for (const auto& contact : contacts) {
-            file << contact.name << "," << contact.phone << "," << contact.email << std::endl;
+            record.clear();
+            refl::csv::encode(contact, record);
+            file.write(record);
         }
     }
 
+    // Parses each line in place while the next chunk is being read. A line
+    // needs all three fields; fields after the third are ignored. A quoted
+    // line break continues the record on the next line.
     void loadFromFile(const std::string& filename) {
-        std::ifstream file(filename);
-        std::string line;
+        aio::LineReader file(filename);
+        std::string_view line;
+        std::string joined;
         contacts.clear();
-        while (std::getline(file, line)) {
-            std::istringstream iss(line);
-            std::string name, phone, email;
-            if (std::getline(iss, name, ',') && std::getline(iss, phone, ',') && std::getline(iss, email, ',')) {
-                contacts.push_back({name, phone, email});
+        while (file.next(line)) {
+            std::string_view record = line;
+            if (std::count(line.begin(), line.end(), '"') % 2 != 0) {
+                joined.assign(line.data(), line.size());
+                while (std::count(joined.begin(), joined.end(), '"') % 2 != 0 && file.next(line)) {
+                    joined += '\n';
+                    joined.append(line.data(), line.size());
+                }
+                record = joined;
+            }
+            Contact contact;
+            if (refl::csv::decode(record, contact)) {
+                contacts.push_back(std::move(contact));
             }
         }
     }
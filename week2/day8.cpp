@@ -1,28 +1,43 @@
+#include <algorithm>
+#include <functional>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <map>
 #include <string>
+#include <string_view>
+
+#include "../week3/async_io.h"
+#include "../week3/trace.h"
 
 int main() {
-    std::ifstream file("textfile.txt");
-    if (!file.is_open()) {
+    trace::Session session("day8.trace.json");
+    // The next chunk is read while this one is counted.
+    aio::LineReader file("textfile.txt");
+    if (!file) {
         std::cerr << "Unable to open file" << std::endl;
         return 1;
     }
 
-    std::map<std::string, int> wordCount;
-    std::string line, word;
+    std::map<std::string, int, std::less<>> wordCount;
+    std::string_view line;
 
-    while (std::getline(file, line)) {
-        std::istringstream stream(line);
-        while (stream >> word) {
-            ++wordCount[word];
+    {
+        TRACE_SCOPE("count words");
+        const char* space = " \t\n\v\f\r";
+        while (file.next(line)) {
+            for (size_t begin = line.find_first_not_of(space); begin != std::string_view::npos;) {
+                size_t end = std::min(line.find_first_of(space, begin), line.size());
+                std::string_view word = line.substr(begin, end - begin);
+                auto it = wordCount.find(word);
+                if (it == wordCount.end()) {
+                    it = wordCount.emplace(std::string(word), 0).first;
+                }
+                ++it->second;
+                begin = line.find_first_not_of(space, end);
+            }
         }
     }
 
-    file.close();
-
+    TRACE_SCOPE("print counts");
     for (const auto& pair : wordCount) {
         std::cout << pair.first << ": " << pair.second << std::endl;
     }
@@ -4,11 +4,11 @@
 #include <cctype>
 #include <string>
 
-// Function to convert a string to uppercase
-std::string to_upper(const std::string& str) {
-    std::string result;
-    std::transform(str.begin(), str.end(), std::back_inserter(result), ::toupper);
-    return result;
+#include "string_pipeline.h"
+
+// Function to convert a string to uppercase, in place (ASCII letters only)
+void to_upper(std::string& str) {
+    strpipe::toUpperAscii(str);
 }
 
 int main() {
@@ -20,10 +20,8 @@ int main() {
         return a.size() < b.size();
     });
 
-    // Transform each element to uppercase
-    std::transform(vec.begin(), vec.end(), vec.begin(), [](std::string& str) {
-        return to_upper(str);
-    });
+    // Transform each element to uppercase, in place
+    std::for_each(vec.begin(), vec.end(), to_upper);
 
     // Print the sorted and transformed vector
     for (const auto& str : vec) {
@@ -31,4 +29,4 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,713 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Serializers generated from a compile-time list of fields.
+//
+//   template <>
+//   struct refl::Describe<Contact> {
+//       static constexpr auto fields = std::make_tuple(refl::field("name", &Contact::name),
+//                                                      refl::field("phone", &Contact::phone));
+//   };
+//
+//   std::string out;
+//   refl::csv::encode(contact, out);       // John,123-456\n
+//   refl::json::encode(contact, out);      // {"name":"John","phone":"123-456"}
+//   refl::binary::encode(contact, out);    // little-endian, strings length-prefixed
+//   refl::lines::encode(contact, out);     // one field per line (day13's format)
+//
+//   std::string_view in = text;
+//   while (refl::csv::decode(in, contact)) ...   // consumes one record
+//
+// Each encoder and decoder folds over the field tuple with std::apply. The
+// calls are resolved at compile time and the member pointers are
+// constants, so the result is the hand-written field-by-field code: no
+// virtual calls, no per-field switch, no streams. Numbers go through
+// std::to_chars/from_chars, which ignore the locale and never allocate.
+//
+// Field types: std::string, bool, and the integer and floating-point types.
+// Decoders return false on malformed or truncated input. The record is
+// then partly assigned and `in` is left where parsing stopped.
+namespace refl {
+
+template <typename T, typename M>
+struct Field {
+    std::string_view name;
+    M T::*member;
+};
+
+template <typename T, typename M>
+constexpr Field<T, M> field(std::string_view name, M T::*member) {
+    return Field<T, M>{name, member};
+}
+
+// Specialize with `static constexpr auto fields = std::make_tuple(field(...), ...);`.
+template <typename T>
+struct Describe;
+
+// f(field) for every field of T, in order, unrolled.
+template <typename T, typename F>
+constexpr void forEachField(F&& f) {
+    std::apply([&](const auto&... fields) { (f(fields), ...); }, Describe<T>::fields);
+}
+
+// Like forEachField, but stops at the first f that returns false.
+template <typename T, typename F>
+constexpr bool allFields(F&& f) {
+    return std::apply([&](const auto&... fields) { return (f(fields) && ...); }, Describe<T>::fields);
+}
+
+template <typename T>
+constexpr size_t fieldCount() {
+    return std::tuple_size_v<std::decay_t<decltype(Describe<T>::fields)>>;
+}
+
+namespace detail {
+
+template <typename M>
+constexpr bool isNumber = std::is_arithmetic_v<M> && !std::is_same_v<M, bool>;
+
+template <typename M>
+void appendNumber(std::string& out, M value) {
+    char text[32];
+    auto r = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, static_cast<size_t>(r.ptr - text));
+}
+
+// Parses a number at the front of in and consumes it.
+template <typename M>
+bool parseNumber(std::string_view& in, M& value) {
+    const char* begin = in.data();
+    if (!in.empty() && in.front() == '+') {
+        ++begin;  // from_chars takes no '+'
+    }
+    auto r = std::from_chars(begin, in.data() + in.size(), value);
+    if (r.ec != std::errc()) {
+        return false;
+    }
+    in.remove_prefix(static_cast<size_t>(r.ptr - in.data()));
+    return true;
+}
+
+// A whole token as a value of type M.
+template <typename M>
+bool parseScalar(std::string_view token, M& value) {
+    if constexpr (std::is_same_v<M, std::string>) {
+        value.assign(token.data(), token.size());
+        return true;
+    } else if constexpr (std::is_same_v<M, bool>) {
+        if (token == "true" || token == "1") {
+            value = true;
+        } else if (token == "false" || token == "0") {
+            value = false;
+        } else {
+            return false;
+        }
+        return true;
+    } else {
+        static_assert(isNumber<M>, "unsupported field type");
+        return parseNumber(token, value) && token.empty();
+    }
+}
+
+template <typename M>
+void appendScalar(std::string& out, const M& value) {
+    if constexpr (std::is_same_v<M, std::string>) {
+        out += value;
+    } else if constexpr (std::is_same_v<M, bool>) {
+        out += value ? "true" : "false";
+    } else {
+        static_assert(isNumber<M>, "unsupported field type");
+        appendNumber(out, value);
+    }
+}
+
+// A set of bytes, for scans where find_first_of's per-byte search of the
+// set would dominate.
+struct ByteSet {
+    bool has[256] = {};
+
+    constexpr explicit ByteSet(std::string_view bytes) {
+        for (char c : bytes) {
+            has[static_cast<unsigned char>(c)] = true;
+        }
+    }
+
+    // The first byte of s in the set, or npos.
+    size_t find(std::string_view s) const {
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (has[static_cast<unsigned char>(s[i])]) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+};
+
+inline std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+}  // namespace detail
+
+// Fixed-width little-endian numbers and bools, and strings as a 32-bit
+// length followed by the bytes. No separators, no names.
+namespace binary {
+
+namespace detail {
+
+template <typename M>
+void put(std::string& out, M value) {
+    char bytes[sizeof(M)];
+    std::memcpy(bytes, &value, sizeof(M));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(bytes, bytes + sizeof(M));
+#endif
+    out.append(bytes, sizeof(M));
+}
+
+template <typename M>
+bool get(std::string_view& in, M& value) {
+    if (in.size() < sizeof(M)) {
+        return false;
+    }
+    char bytes[sizeof(M)];
+    std::memcpy(bytes, in.data(), sizeof(M));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(bytes, bytes + sizeof(M));
+#endif
+    std::memcpy(&value, bytes, sizeof(M));
+    in.remove_prefix(sizeof(M));
+    return true;
+}
+
+}  // namespace detail
+
+template <typename T>
+void encode(const T& value, std::string& out) {
+    forEachField<T>([&](const auto& f) {
+        const auto& v = value.*f.member;
+        using M = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<M, std::string>) {
+            detail::put(out, static_cast<uint32_t>(v.size()));
+            out += v;
+        } else if constexpr (std::is_same_v<M, bool>) {
+            out += static_cast<char>(v ? 1 : 0);
+        } else {
+            static_assert(refl::detail::isNumber<M>, "unsupported field type");
+            detail::put(out, v);
+        }
+    });
+}
+
+template <typename T>
+bool decode(std::string_view& in, T& value) {
+    return allFields<T>([&](const auto& f) {
+        auto& v = value.*f.member;
+        using M = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<M, std::string>) {
+            uint32_t size;
+            if (!detail::get(in, size) || in.size() < size) {
+                return false;
+            }
+            v.assign(in.data(), size);
+            in.remove_prefix(size);
+            return true;
+        } else if constexpr (std::is_same_v<M, bool>) {
+            if (in.empty()) {
+                return false;
+            }
+            v = in.front() != 0;
+            in.remove_prefix(1);
+            return true;
+        } else {
+            return detail::get(in, v);
+        }
+    });
+}
+
+}  // namespace binary
+
+// One field per line, in order, unquoted (day13's students.txt). Strings
+// must not contain '\n'.
+namespace lines {
+
+template <typename T>
+void encode(const T& value, std::string& out) {
+    forEachField<T>([&](const auto& f) {
+        detail::appendScalar(out, value.*f.member);
+        out += '\n';
+    });
+}
+
+// next(line) supplies the lines, e.g. from aio::LineReader::next.
+// Numbers may have blanks around them, as `ifs >> age` allowed.
+template <typename T, typename NextLine>
+bool decodeFrom(NextLine&& next, T& value) {
+    return allFields<T>([&](const auto& f) {
+        std::string_view line;
+        if (!next(line)) {
+            return false;
+        }
+        auto& v = value.*f.member;
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
+            return detail::parseScalar(line, v);
+        } else {
+            return detail::parseScalar(detail::trim(line), v);
+        }
+    });
+}
+
+template <typename T>
+bool decode(std::string_view& in, T& value) {
+    return decodeFrom(
+        [&](std::string_view& line) {
+            if (in.empty()) {
+                return false;
+            }
+            size_t nl = in.find('\n');
+            line = in.substr(0, nl);
+            in.remove_prefix(nl == std::string_view::npos ? in.size() : nl + 1);
+            return true;
+        },
+        value);
+}
+
+}  // namespace lines
+
+// RFC 4180: comma-separated, one record per line. A field with a comma,
+// quote or line break goes in quotes, with quotes doubled.
+namespace csv {
+
+namespace detail {
+
+inline constexpr refl::detail::ByteSet kSpecial(",\"\r\n");
+inline constexpr refl::detail::ByteSet kFieldEnd(",\n");
+
+inline void appendQuoted(std::string& out, std::string_view s) {
+    if (kSpecial.find(s) == std::string_view::npos) {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (size_t quote; (quote = s.find('"')) != std::string_view::npos; s.remove_prefix(quote + 1)) {
+        out.append(s.data(), quote + 1);
+        out += '"';
+    }
+    out += s;
+    out += '"';
+}
+
+// The next field, unquoted; scratch holds it if it had doubled quotes.
+inline bool nextField(std::string_view& in, std::string_view& field, std::string& scratch) {
+    if (in.empty() || in.front() != '"') {
+        size_t end = kFieldEnd.find(in);
+        field = in.substr(0, end);
+        if (!field.empty() && field.back() == '\r') {
+            field.remove_suffix(1);
+        }
+        in.remove_prefix(end == std::string_view::npos ? in.size() : end);
+        return true;
+    }
+    in.remove_prefix(1);
+    scratch.clear();
+    for (;;) {
+        size_t quote = in.find('"');
+        if (quote == std::string_view::npos) {
+            return false;  // unterminated
+        }
+        if (quote + 1 < in.size() && in[quote + 1] == '"') {
+            scratch.append(in.data(), quote + 1);
+            in.remove_prefix(quote + 2);
+            continue;
+        }
+        if (scratch.empty()) {
+            field = in.substr(0, quote);
+        } else {
+            scratch.append(in.data(), quote);
+            field = scratch;
+        }
+        in.remove_prefix(quote + 1);
+        return true;
+    }
+}
+
+}  // namespace detail
+
+// The field names as a header line.
+template <typename T>
+void header(std::string& out) {
+    bool first = true;
+    forEachField<T>([&](const auto& f) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        detail::appendQuoted(out, f.name);
+    });
+    out += '\n';
+}
+
+template <typename T>
+void encode(const T& value, std::string& out) {
+    bool first = true;
+    forEachField<T>([&](const auto& f) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        const auto& v = value.*f.member;
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
+            detail::appendQuoted(out, v);
+        } else {
+            refl::detail::appendScalar(out, v);
+        }
+    });
+    out += '\n';
+}
+
+// Consumes one record (through its line break). Fields past the last
+// member are skipped; a record with too few fields fails.
+template <typename T>
+bool decode(std::string_view& in, T& value) {
+    if (in.empty()) {
+        return false;
+    }
+    std::string scratch;
+    bool first = true;
+    bool ok = allFields<T>([&](const auto& f) {
+        if (!first) {
+            if (in.empty() || in.front() != ',') {
+                return false;
+            }
+            in.remove_prefix(1);
+        }
+        first = false;
+        std::string_view field;
+        if (!detail::nextField(in, field, scratch)) {
+            return false;
+        }
+        auto& v = value.*f.member;
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
+            return refl::detail::parseScalar(field, v);
+        } else {
+            return refl::detail::parseScalar(refl::detail::trim(field), v);
+        }
+    });
+    while (ok && !in.empty() && in.front() == ',') {
+        in.remove_prefix(1);
+        std::string_view extra;
+        ok = detail::nextField(in, extra, scratch);
+    }
+    if (ok && !in.empty() && in.front() == '\r') {
+        in.remove_prefix(1);
+    }
+    if (ok && !in.empty()) {
+        ok = in.front() == '\n';
+        in.remove_prefix(ok ? 1 : 0);
+    }
+    return ok;
+}
+
+}  // namespace csv
+
+// One object per record, fields in declaration order, no whitespace.
+// The decoder takes keys in any order, skips unknown keys and blanks,
+// and leaves missing fields unchanged. JSON has no infinities or NaN:
+// those are written as null, which reads back as NaN. Unknown values
+// nested more than kMaxNesting deep are rejected rather than recursed into.
+namespace json {
+
+constexpr size_t kMaxNesting = 1000;
+
+namespace detail {
+
+inline void appendEscaped(std::string& out, std::string_view s) {
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(s.data() + run, i - run);
+        run = i + 1;
+        out += '\\';
+        switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '\n': out += 'n'; break;
+            case '\r': out += 'r'; break;
+            case '\t': out += 't'; break;
+            case '\b': out += 'b'; break;
+            case '\f': out += 'f'; break;
+            default:
+                out += "u00";
+                out += kHex[c >> 4];
+                out += kHex[c & 15];
+        }
+    }
+    out.append(s.data() + run, s.size() - run);
+    out += '"';
+}
+
+inline constexpr refl::detail::ByteSet kStringEnd("\"\\");
+inline constexpr refl::detail::ByteSet kTokenEnd(",}] \t\r\n");
+
+inline void skipBlanks(std::string_view& in) {
+    while (!in.empty() && (in.front() == ' ' || in.front() == '\t' || in.front() == '\n' || in.front() == '\r')) {
+        in.remove_prefix(1);
+    }
+}
+
+inline bool take(std::string_view& in, char c) {
+    skipBlanks(in);
+    if (in.empty() || in.front() != c) {
+        return false;
+    }
+    in.remove_prefix(1);
+    return true;
+}
+
+inline void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+inline bool hex4(std::string_view& in, uint32_t& cp) {
+    if (in.size() < 4) {
+        return false;
+    }
+    auto r = std::from_chars(in.data(), in.data() + 4, cp, 16);
+    if (r.ec != std::errc() || r.ptr != in.data() + 4) {
+        return false;
+    }
+    in.remove_prefix(4);
+    return true;
+}
+
+// A string token, unescaped. Without escapes it is a view into in;
+// otherwise it is built in scratch.
+inline bool parseString(std::string_view& in, std::string_view& s, std::string& scratch) {
+    if (!take(in, '"')) {
+        return false;
+    }
+    size_t end = kStringEnd.find(in);
+    if (end != std::string_view::npos && in[end] == '"') {
+        s = in.substr(0, end);
+        in.remove_prefix(end + 1);
+        return true;
+    }
+    scratch.clear();
+    for (;;) {
+        end = kStringEnd.find(in);
+        if (end == std::string_view::npos) {
+            return false;
+        }
+        scratch.append(in.data(), end);
+        char c = in[end];
+        in.remove_prefix(end + 1);
+        if (c == '"') {
+            s = scratch;
+            return true;
+        }
+        if (in.empty()) {
+            return false;
+        }
+        char e = in.front();
+        in.remove_prefix(1);
+        switch (e) {
+            case '"': case '\\': case '/': scratch += e; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!hex4(in, cp)) {
+                    return false;
+                }
+                if (cp >= 0xD800 && cp < 0xDC00) {  // high surrogate: a low one must follow
+                    uint32_t low;
+                    if (in.size() < 2 || in[0] != '\\' || in[1] != 'u') {
+                        return false;
+                    }
+                    in.remove_prefix(2);
+                    if (!hex4(in, low) || low < 0xDC00 || low >= 0xE000) {
+                        return false;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(scratch, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+}
+
+// Skips any value, nested ones included.
+inline bool skipValue(std::string_view& in, std::string& scratch, size_t depth = 0) {
+    skipBlanks(in);
+    if (in.empty()) {
+        return false;
+    }
+    std::string_view s;
+    if (in.front() == '"') {
+        return parseString(in, s, scratch);
+    }
+    if (in.front() == '{' || in.front() == '[') {
+        if (depth == kMaxNesting) {
+            return false;
+        }
+        char close = in.front() == '{' ? '}' : ']';
+        in.remove_prefix(1);
+        if (take(in, close)) {
+            return true;
+        }
+        do {
+            if (close == '}' && (!parseString(in, s, scratch) || !take(in, ':'))) {
+                return false;
+            }
+            if (!skipValue(in, scratch, depth + 1)) {
+                return false;
+            }
+        } while (take(in, ','));
+        return take(in, close);
+    }
+    size_t end = kTokenEnd.find(in);
+    if (end == 0) {
+        return false;
+    }
+    in.remove_prefix(end == std::string_view::npos ? in.size() : end);
+    return true;
+}
+
+template <typename M>
+bool parseValue(std::string_view& in, M& v, std::string& scratch) {
+    skipBlanks(in);
+    if constexpr (std::is_same_v<M, std::string>) {
+        std::string_view s;
+        if (!parseString(in, s, scratch)) {
+            return false;
+        }
+        v.assign(s.data(), s.size());
+        return true;
+    } else if constexpr (std::is_same_v<M, bool>) {
+        if (in.substr(0, 4) == "true") {
+            v = true;
+            in.remove_prefix(4);
+        } else if (in.substr(0, 5) == "false") {
+            v = false;
+            in.remove_prefix(5);
+        } else {
+            return false;
+        }
+        return true;
+    } else {
+        static_assert(refl::detail::isNumber<M>, "unsupported field type");
+        if constexpr (std::is_floating_point_v<M>) {
+            if (in.substr(0, 4) == "null") {
+                v = std::numeric_limits<M>::quiet_NaN();
+                in.remove_prefix(4);
+                return true;
+            }
+        }
+        return refl::detail::parseNumber(in, v);
+    }
+}
+
+}  // namespace detail
+
+template <typename T>
+void encode(const T& value, std::string& out) {
+    char sep = '{';
+    forEachField<T>([&](const auto& f) {
+        out += sep;
+        sep = ',';
+        out += '"';
+        out += f.name;  // names are plain identifiers
+        out += "\":";
+        const auto& v = value.*f.member;
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
+            detail::appendEscaped(out, v);
+        } else if constexpr (std::is_floating_point_v<std::decay_t<decltype(v)>>) {
+            if (std::isfinite(v)) {
+                refl::detail::appendScalar(out, v);
+            } else {
+                out += "null";
+            }
+        } else {
+            refl::detail::appendScalar(out, v);
+        }
+    });
+    if (sep == '{') {
+        out += '{';
+    }
+    out += '}';
+}
+
+// Consumes one object.
+template <typename T>
+bool decode(std::string_view& in, T& value) {
+    std::string scratch, keyScratch;
+    if (!detail::take(in, '{')) {
+        return false;
+    }
+    if (detail::take(in, '}')) {
+        return true;
+    }
+    do {
+        std::string_view key;
+        if (!detail::parseString(in, key, keyScratch) || !detail::take(in, ':')) {
+            return false;
+        }
+        bool matched = false, ok = true;
+        forEachField<T>([&](const auto& f) {
+            if (!matched && key == f.name) {
+                matched = true;
+                ok = detail::parseValue(in, value.*f.member, scratch);
+            }
+        });
+        if (!ok || (!matched && !detail::skipValue(in, scratch))) {
+            return false;
+        }
+    } while (detail::take(in, ','));
+    return detail::take(in, '}');
+}
+
+}  // namespace json
+
+}  // namespace refl
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRPIPE_HAVE_X86 1
+#else
+#define STRPIPE_HAVE_X86 0
+#endif
+
+// Bulk string processing for day9's sort + transform.
+//
+//   auto pipeline = strpipe::sortBy(strpipe::ByLength{}) | strpipe::toUpper();
+//   pipeline.run(words);          // in place, no allocation per string
+//   pipeline.into(words, out);    // into out, reusing out's string buffers
+//
+// Nothing runs until run()/into(). Consecutive element-wise stages are fused
+// into a single pass, and element-wise stages that cannot change a sort key
+// (case mapping never changes a length) are hoisted in front of the sort so
+// that the same pass also extracts the keys.
+namespace strpipe {
+
+// ---------------------------------------------------------------------------
+// ASCII case mapping. Bytes outside 'a'..'z' / 'A'..'Z' (including UTF-8
+// continuation bytes) are left alone, which matches ::toupper in the "C" locale.
+
+namespace detail {
+
+// 8 bytes at a time: the high bit of each byte in `mask` marks a letter in [lo, hi].
+inline std::uint64_t swarCaseFlip(std::uint64_t x, unsigned char lo, unsigned char hi) {
+    constexpr std::uint64_t ones = 0x0101010101010101ULL;
+    constexpr std::uint64_t highBits = 0x8080808080808080ULL;
+    std::uint64_t low7 = x & ~highBits;
+    std::uint64_t geLo = low7 + (0x80 - lo) * ones;
+    std::uint64_t gtHi = low7 + (0x80 - hi - 1) * ones;
+    std::uint64_t mask = geLo & ~gtHi & ~x & highBits;
+    return x ^ (mask >> 2); // 0x80 >> 2 == 0x20, the case bit
+}
+
+inline std::size_t swarCaseMap(char* p, std::size_t n, unsigned char lo, unsigned char hi) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t x;
+        std::memcpy(&x, p + i, 8);
+        x = swarCaseFlip(x, lo, hi);
+        std::memcpy(p + i, &x, 8);
+    }
+    return i;
+}
+
+inline void scalarCaseMap(char* p, std::size_t i, std::size_t n, unsigned char lo, unsigned char hi) {
+    for (; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        if (c >= lo && c <= hi) {
+            p[i] = static_cast<char>(c ^ 0x20);
+        }
+    }
+}
+
+#if STRPIPE_HAVE_X86
+// 32 bytes per step. Signed compares keep bytes >= 0x80 out of the range.
+__attribute__((target("avx2")))
+inline std::size_t avx2CaseMap(char* p, std::size_t n, unsigned char lo, unsigned char hi) {
+    const __m256i below = _mm256_set1_epi8(static_cast<char>(lo - 1));
+    const __m256i above = _mm256_set1_epi8(static_cast<char>(hi + 1));
+    const __m256i flip = _mm256_set1_epi8(0x20);
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i in = _mm256_and_si256(_mm256_cmpgt_epi8(v, below), _mm256_cmpgt_epi8(above, v));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_xor_si256(v, _mm256_and_si256(in, flip)));
+    }
+    return i;
+}
+
+// SSE2 is part of the x86-64 baseline: 16 bytes per step, no dispatch needed.
+inline std::size_t sse2CaseMap(char* p, std::size_t n, unsigned char lo, unsigned char hi) {
+    const __m128i below = _mm_set1_epi8(static_cast<char>(lo - 1));
+    const __m128i above = _mm_set1_epi8(static_cast<char>(hi + 1));
+    const __m128i flip = _mm_set1_epi8(0x20);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i in = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmpgt_epi8(above, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(v, _mm_and_si128(in, flip)));
+    }
+    return i;
+}
+
+inline bool cpuHasAvx2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+#endif
+
+inline void caseMap(char* p, std::size_t n, unsigned char lo, unsigned char hi) {
+    std::size_t i = 0;
+#if STRPIPE_HAVE_X86
+    if (n >= 32 && cpuHasAvx2()) {
+        i = avx2CaseMap(p, n, lo, hi);
+    } else if (n >= 16) {
+        i = sse2CaseMap(p, n, lo, hi);
+    }
+#endif
+    // Short strings (the common case) go straight to 8-byte SWAR steps.
+    i += swarCaseMap(p + i, n - i, lo, hi);
+    scalarCaseMap(p, i, n, lo, hi);
+}
+
+} // namespace detail
+
+inline void toUpperAscii(char* p, std::size_t n) { detail::caseMap(p, n, 'a', 'z'); }
+inline void toLowerAscii(char* p, std::size_t n) { detail::caseMap(p, n, 'A', 'Z'); }
+inline void toUpperAscii(std::string& s) { toUpperAscii(s.data(), s.size()); }
+inline void toLowerAscii(std::string& s) { toLowerAscii(s.data(), s.size()); }
+
+// ---------------------------------------------------------------------------
+// Stages
+
+// Element-wise, in-place stage. PreservesLength lets the pipeline move it
+// across a sort by length.
+template <typename F, bool PreservesLength = false>
+struct Transform {
+    static constexpr bool is_sort = false;
+    static constexpr bool preserves_length = PreservesLength;
+    F f;
+    void operator()(std::string& s) const { f(s); }
+};
+
+struct UpperFn {
+    void operator()(std::string& s) const { toUpperAscii(s); }
+};
+struct LowerFn {
+    void operator()(std::string& s) const { toLowerAscii(s); }
+};
+
+// Sort key: the string's length (day9's lambda).
+struct ByLength {
+    static constexpr bool is_length = true;
+    std::size_t operator()(const std::string& s) const { return s.size(); }
+};
+
+// Sorts ascending by Key(s). Integral keys with a small range use a counting
+// sort (O(n), stable); anything else sorts precomputed (key, index) pairs.
+template <typename Key>
+struct SortBy {
+    static constexpr bool is_sort = true;
+    using key_type = Key;
+    Key key;
+};
+
+template <typename Key, typename = void>
+struct key_is_length : std::false_type {};
+template <typename Key>
+struct key_is_length<Key, std::enable_if_t<Key::is_length>> : std::true_type {};
+
+template <typename F>
+Transform<F> transform(F f) { return Transform<F>{std::move(f)}; }
+inline Transform<UpperFn, true> toUpper() { return {}; }
+inline Transform<LowerFn, true> toLower() { return {}; }
+template <typename Key>
+SortBy<Key> sortBy(Key key) { return SortBy<Key>{std::move(key)}; }
+
+// ---------------------------------------------------------------------------
+// Pipeline
+
+template <typename... Stages>
+class Pipeline {
+public:
+    static constexpr std::size_t N = sizeof...(Stages);
+
+    explicit Pipeline(std::tuple<Stages...> stages) : stages_(std::move(stages)) {}
+
+    template <typename Stage>
+    Pipeline<Stages..., Stage> operator|(Stage next) const {
+        return Pipeline<Stages..., Stage>(std::tuple_cat(stages_, std::make_tuple(std::move(next))));
+    }
+
+    // Applies every stage to v in place.
+    void run(std::vector<std::string>& v) const { runFrom<0>(v); }
+
+    // Writes the result to out. out's existing strings are overwritten in
+    // place, so a buffer reused across batches stops allocating once its
+    // strings are long enough.
+    void into(const std::vector<std::string>& in, std::vector<std::string>& out) const {
+        out.resize(in.size());
+        for (std::size_t i = 0; i < in.size(); ++i) {
+            out[i].assign(in[i]);
+        }
+        run(out);
+    }
+
+private:
+    template <std::size_t I>
+    using StageAt = std::tuple_element_t<I, std::tuple<Stages...>>;
+
+    template <std::size_t I>
+    static constexpr bool isSort() {
+        if constexpr (I < N) {
+            return StageAt<I>::is_sort;
+        } else {
+            return false;
+        }
+    }
+
+    // First index >= I that is not an element-wise stage.
+    template <std::size_t I>
+    static constexpr std::size_t endOfTransforms() {
+        if constexpr (isSort<I>() || I == N) {
+            return I;
+        } else {
+            return endOfTransforms<I + 1>();
+        }
+    }
+
+    // Can stages [I, J) be applied before sort stage S without changing its order?
+    template <std::size_t S, std::size_t I, std::size_t J>
+    static constexpr bool commuteWithSort() {
+        if constexpr (I == J) {
+            return true;
+        } else {
+            return key_is_length<typename StageAt<S>::key_type>::value && StageAt<I>::preserves_length &&
+                   commuteWithSort<S, I + 1, J>();
+        }
+    }
+
+    template <std::size_t I, std::size_t J>
+    void applyTransforms(std::string& s) const {
+        if constexpr (I < J) {
+            std::get<I>(stages_)(s);
+            applyTransforms<I + 1, J>(s);
+        }
+    }
+
+    template <std::size_t I>
+    void runFrom(std::vector<std::string>& v) const {
+        if constexpr (I < N) {
+            constexpr std::size_t J = endOfTransforms<I>();
+            if constexpr (J == N) {
+                // Trailing element-wise stages: one fused pass.
+                for (auto& s : v) {
+                    applyTransforms<I, J>(s);
+                }
+            } else {
+                // [I, J) element-wise, J is a sort, [J + 1, K) element-wise after it.
+                constexpr std::size_t K = endOfTransforms<J + 1>();
+                constexpr bool hoist = commuteWithSort<J, J + 1, K>();
+                sortFused<I, J, hoist ? K : J + 1>(v);
+                runFrom<hoist ? K : J + 1>(v);
+            }
+        }
+    }
+
+    // Applies element-wise stages [I, J) and [J + 1, K) while extracting the
+    // keys of sort stage J, then sorts.
+    template <std::size_t I, std::size_t J, std::size_t K>
+    void sortFused(std::vector<std::string>& v) const {
+        const auto& key = std::get<J>(stages_).key;
+        using KeyType = std::decay_t<decltype(key(v[0]))>;
+        std::vector<KeyType> keys(v.size());
+        for (std::size_t i = 0; i < v.size(); ++i) {
+            applyTransforms<I, J>(v[i]);
+            applyTransforms<J + 1, K>(v[i]);
+            keys[i] = key(v[i]);
+        }
+        if constexpr (std::is_integral<KeyType>::value) {
+            if (!v.empty()) {
+                auto [lo, hi] = std::minmax_element(keys.begin(), keys.end());
+                auto range = static_cast<std::uint64_t>(*hi) - static_cast<std::uint64_t>(*lo);
+                if (range < (std::uint64_t(1) << 16) && range < v.size()) {
+                    countingSort(v, keys, *lo, static_cast<std::size_t>(range) + 1);
+                    return;
+                }
+            }
+        }
+        indexSort(v, keys);
+    }
+
+    // Stable counting sort: bucket offsets from prefix sums, then one pass that
+    // moves each string into its bucket. Every bucket is written sequentially,
+    // so the scatter streams through memory instead of chasing cycles.
+    template <typename KeyType>
+    static void countingSort(std::vector<std::string>& v, const std::vector<KeyType>& keys, KeyType lo,
+                             std::size_t buckets) {
+        std::vector<std::size_t> start(buckets + 1, 0);
+        for (KeyType k : keys) {
+            ++start[static_cast<std::size_t>(k - lo) + 1];
+        }
+        std::partial_sum(start.begin(), start.end(), start.begin());
+        std::vector<std::string> sorted(v.size());
+        for (std::size_t i = 0; i < v.size(); ++i) {
+            sorted[start[static_cast<std::size_t>(keys[i] - lo)]++] = std::move(v[i]);
+        }
+        v.swap(sorted);
+    }
+
+    template <typename KeyType>
+    static void indexSort(std::vector<std::string>& v, const std::vector<KeyType>& keys) {
+        std::vector<std::size_t> order(v.size());
+        std::iota(order.begin(), order.end(), std::size_t(0));
+        std::stable_sort(order.begin(), order.end(),
+                         [&keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+        std::vector<std::size_t> dest(v.size());
+        for (std::size_t pos = 0; pos < order.size(); ++pos) {
+            dest[order[pos]] = pos;
+        }
+        permute(v, dest);
+    }
+
+    // Moves v[i] to v[dest[i]] for all i. Consumes dest.
+    static void permute(std::vector<std::string>& v, std::vector<std::size_t>& dest) {
+        constexpr std::size_t done = std::numeric_limits<std::size_t>::max();
+        for (std::size_t i = 0; i < v.size(); ++i) {
+            if (dest[i] == done || dest[i] == i) {
+                continue;
+            }
+            std::string carried = std::move(v[i]);
+            std::size_t at = i;
+            while (dest[at] != i) {
+                std::size_t next = dest[at];
+                std::swap(carried, v[next]);
+                dest[at] = done;
+                at = next;
+            }
+            v[i] = std::move(carried);
+            dest[at] = done;
+        }
+    }
+
+    std::tuple<Stages...> stages_;
+};
+
+template <typename Stage>
+Pipeline<Stage> pipeline(Stage stage) {
+    return Pipeline<Stage>(std::make_tuple(std::move(stage)));
+}
+
+// stage | stage starts a pipeline.
+template <typename A, typename B, typename = decltype(A::is_sort), typename = decltype(B::is_sort)>
+Pipeline<A, B> operator|(A a, B b) {
+    return Pipeline<A, B>(std::make_tuple(std::move(a), std::move(b)));
+}
+
+} // namespace strpipe
@@ -0,0 +1,152 @@
+// day9's sort-by-length + uppercase: original code vs strpipe pipeline.
+// Build: g++ -std=c++17 -O2 string_pipeline_bench.cpp -o string_pipeline_bench
+// Usage: ./string_pipeline_bench [strings]   (default 10M; 100M needs ~8 GB of RAM)
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "string_pipeline.h"
+
+// The original day9 code path.
+std::string to_upper_day9(const std::string& str) {
+    std::string result;
+    std::transform(str.begin(), str.end(), std::back_inserter(result), ::toupper);
+    return result;
+}
+
+void day9Original(std::vector<std::string>& vec) {
+    std::sort(vec.begin(), vec.end(), [](const std::string& a, const std::string& b) {
+        return a.size() < b.size();
+    });
+    std::transform(vec.begin(), vec.end(), vec.begin(), [](std::string& str) {
+        return to_upper_day9(str);
+    });
+}
+
+std::vector<std::string> makeWords(std::size_t n) {
+    std::mt19937 rng(2024);
+    const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -_";
+    std::vector<std::string> words(n);
+    for (auto& w : words) {
+        w.resize(3 + rng() % 13); // 3..15 bytes: short-string optimized
+        for (auto& c : w) {
+            c = letters[rng() % (sizeof(letters) - 1)];
+        }
+    }
+    return words;
+}
+
+bool checkCaseMapping() {
+    std::mt19937 rng(7);
+    for (std::size_t n = 0; n < 200; ++n) {
+        std::string s(n, '\0');
+        for (auto& c : s) {
+            c = static_cast<char>(rng() % 256);
+        }
+        std::string upper = s, lower = s;
+        strpipe::toUpperAscii(upper);
+        strpipe::toLowerAscii(lower);
+        for (std::size_t i = 0; i < n; ++i) {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (upper[i] != static_cast<char>(std::toupper(c)) || lower[i] != static_cast<char>(std::tolower(c))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool checkPipeline() {
+    auto words = makeWords(100000);
+    auto expected = words;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const std::string& a, const std::string& b) { return a.size() < b.size(); });
+    for (auto& w : expected) {
+        w = to_upper_day9(w);
+    }
+
+    auto pipeline = strpipe::sortBy(strpipe::ByLength{}) | strpipe::toUpper();
+    auto inPlace = words;
+    pipeline.run(inPlace);
+    std::vector<std::string> out;
+    pipeline.into(words, out);
+
+    // Non-integral key and a transform that cannot be hoisted across the sort.
+    auto generic = strpipe::sortBy([](const std::string& s) { return static_cast<double>(s.size()); }) |
+                   strpipe::transform([](std::string& s) { strpipe::toUpperAscii(s); });
+    auto genericOut = words;
+    generic.run(genericOut);
+    return inPlace == expected && out == expected && genericOut == expected;
+}
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t n = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    if (!checkCaseMapping() || !checkPipeline()) {
+        std::cerr << "strpipe results differ from ::toupper / day9" << std::endl;
+        return 1;
+    }
+    std::cout << "Results match ::toupper and the day9 code path." << std::endl;
+
+    // Raw case-mapping throughput on one long buffer.
+    {
+        std::string text(256 << 20, 'a');
+        std::mt19937 rng(1);
+        for (auto& c : text) {
+            c = static_cast<char>('A' + rng() % 58);
+        }
+        double scalar = timeMs([&] {
+            std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+        });
+        double simd = timeMs([&] { strpipe::toUpperAscii(text); });
+        double mb = static_cast<double>(text.size()) / (1 << 20);
+        std::cout << "\nUppercase of one " << text.size() / (1 << 20) << " MB buffer:" << std::endl;
+        std::cout << std::fixed << std::setprecision(2) << "  ::toupper loop  " << mb / scalar << " GB/s" << std::endl;
+        std::cout << "  toUpperAscii    " << mb / simd << " GB/s" << std::endl;
+    }
+
+    std::cout << "\n" << n << " short strings, sort by length + uppercase (ms):" << std::endl;
+    auto words = makeWords(n);
+    auto pipeline = strpipe::sortBy(strpipe::ByLength{}) | strpipe::toUpper();
+
+    auto work = words;
+    double original = timeMs([&] { day9Original(work); });
+
+    work = words;
+    double inPlace = timeMs([&] {
+        std::sort(work.begin(), work.end(),
+                  [](const std::string& a, const std::string& b) { return a.size() < b.size(); });
+        for (auto& w : work) {
+            strpipe::toUpperAscii(w);
+        }
+    });
+
+    work = words;
+    double fused = timeMs([&] { pipeline.run(work); });
+
+    std::vector<std::string> out;
+    pipeline.into(words, out); // first call sizes out's buffers
+    double into = timeMs([&] { pipeline.into(words, out); });
+
+    std::cout << std::setprecision(1);
+    std::cout << "  day9 (sort + back_inserter copy)  " << std::setw(9) << original << std::endl;
+    std::cout << "  std::sort + in-place ASCII        " << std::setw(9) << inPlace << std::endl;
+    std::cout << "  pipeline.run (fused, in place)    " << std::setw(9) << fused << "   "
+              << original / fused << "x" << std::endl;
+    std::cout << "  pipeline.into (reused buffers)    " << std::setw(9) << into << "   "
+              << original / into << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Column-oriented storage for day13's Student records.
+//
+// A std::vector<Student> interleaves two std::string objects with each age,
+// so a scan over ages pulls 72 bytes per row through the cache to use 4.
+// StudentTable keeps each field in its own column: ages in a plain int
+// array, names dictionary-encoded (names repeat, so each row stores a 4-byte
+// code), ids packed end to end in one character arena. Age scans then read
+// 4 bytes per row and run 4 (SSE2) or 8 (AVX2) rows per instruction.
+
+namespace student_detail {
+
+template <typename T, std::size_t Bytes>
+using Vec [[gnu::vector_size(Bytes)]] = T;
+
+template <typename V, typename T>
+[[gnu::always_inline]] inline void load(V& v, const T* p) {
+    std::memcpy(&v, p, sizeof(v));
+}
+
+// Variable-length strings packed into one buffer; string i is
+// chars[offsets[i], offsets[i + 1]).
+class StringArena {
+public:
+    StringArena() : offsets_(1, 0) {}
+
+    void reserve(std::size_t strings, std::size_t chars) {
+        offsets_.reserve(strings + 1);
+        chars_.reserve(chars);
+    }
+
+    std::uint32_t append(std::string_view s) {
+        if (chars_.size() + s.size() > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("StringArena is limited to 4 GB of characters");
+        }
+        chars_.insert(chars_.end(), s.begin(), s.end());
+        offsets_.push_back(static_cast<std::uint32_t>(chars_.size()));
+        return static_cast<std::uint32_t>(offsets_.size() - 2);
+    }
+
+    std::string_view operator[](std::size_t i) const {
+        return std::string_view(chars_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+    }
+
+    std::size_t size() const { return offsets_.size() - 1; }
+    std::size_t bytes() const { return chars_.capacity() + offsets_.capacity() * sizeof(std::uint32_t); }
+
+private:
+    std::vector<char> chars_;
+    std::vector<std::uint32_t> offsets_;
+};
+
+// Distinct strings in an arena plus a code per row.
+class DictionaryColumn {
+public:
+    void reserve(std::size_t rows) { codes_.reserve(rows); }
+
+    void append(std::string_view s) {
+        auto it = lookup_.find(std::string(s));
+        if (it == lookup_.end()) {
+            it = lookup_.emplace(std::string(s), values_.append(s)).first;
+        }
+        codes_.push_back(it->second);
+    }
+
+    std::string_view operator[](std::size_t row) const { return values_[codes_[row]]; }
+
+    // Code of s, or -1 when no row has that value.
+    std::int64_t find(std::string_view s) const {
+        auto it = lookup_.find(std::string(s));
+        return it == lookup_.end() ? -1 : it->second;
+    }
+
+    const std::vector<std::uint32_t>& codes() const { return codes_; }
+    std::size_t distinct() const { return values_.size(); }
+    std::size_t bytes() const { return codes_.capacity() * sizeof(std::uint32_t) + values_.bytes(); }
+
+private:
+    std::vector<std::uint32_t> codes_;
+    StringArena values_;
+    std::unordered_map<std::string, std::uint32_t> lookup_;
+};
+
+// lo <= x <= hi as one unsigned compare: x - lo wraps below zero.
+template <std::size_t Bytes>
+[[gnu::always_inline]] inline void scanRangeBody(const int* a, std::size_t n, int lo, int hi, std::size_t& count,
+                                                 std::int64_t& sum) {
+    using V = Vec<int, Bytes>;
+    using U = Vec<unsigned, Bytes>;
+    using Half = Vec<int, Bytes / 2>;
+    using Wide = Vec<std::int64_t, Bytes>;
+    constexpr std::size_t W = Bytes / sizeof(int);
+    const unsigned base = static_cast<unsigned>(lo);
+    const unsigned span = static_cast<unsigned>(hi) - base;
+    V counts{};
+    // Ages are summed in 64-bit lanes, one accumulator per half of the
+    // input vector, so no age value can overflow the sum.
+    Wide sumsLow{}, sumsHigh{};
+    V x;
+    Half low, high;
+    std::size_t i = 0;
+    for (; i + W <= n; i += W) {
+        load(x, a + i);
+        V in = reinterpret_cast<V>((reinterpret_cast<U>(x) - base) <= span); // -1 or 0 per lane
+        counts -= in;
+        V kept = x & in;
+        std::memcpy(&low, &kept, sizeof(low));
+        std::memcpy(&high, reinterpret_cast<const char*>(&kept) + sizeof(low), sizeof(high));
+        sumsLow += __builtin_convertvector(low, Wide);
+        sumsHigh += __builtin_convertvector(high, Wide);
+    }
+    sumsLow += sumsHigh;
+    for (std::size_t l = 0; l < W; ++l) {
+        count += static_cast<unsigned>(counts[l]);
+    }
+    for (std::size_t l = 0; l < W / 2; ++l) {
+        sum += sumsLow[l];
+    }
+    for (; i < n; ++i) {
+        bool in = static_cast<unsigned>(a[i]) - base <= span;
+        count += in;
+        sum += in ? a[i] : 0;
+    }
+}
+
+// Appends the indices of rows in range to out, which must have room for
+// every match plus W. Each lane is written unconditionally and the cursor
+// advances by the lane's mask bit, so there is no branch to mispredict.
+template <std::size_t Bytes>
+[[gnu::always_inline]] inline std::size_t selectRangeBody(const int* a, std::size_t n, int lo, int hi,
+                                                          std::uint32_t* out) {
+    using V = Vec<int, Bytes>;
+    using U = Vec<unsigned, Bytes>;
+    constexpr std::size_t W = Bytes / sizeof(int);
+    const unsigned base = static_cast<unsigned>(lo);
+    const unsigned span = static_cast<unsigned>(hi) - base;
+    std::size_t k = 0;
+    V x;
+    std::size_t i = 0;
+    for (; i + W <= n; i += W) {
+        load(x, a + i);
+        V in = reinterpret_cast<V>((reinterpret_cast<U>(x) - base) <= span);
+        for (std::size_t l = 0; l < W; ++l) {
+            out[k] = static_cast<std::uint32_t>(i + l);
+            k += in[l] & 1;
+        }
+    }
+    for (; i < n; ++i) {
+        out[k] = static_cast<std::uint32_t>(i);
+        k += static_cast<unsigned>(a[i]) - base <= span;
+    }
+    return k;
+}
+
+template <std::size_t Bytes>
+[[gnu::always_inline]] inline std::size_t countEqualBody(const std::uint32_t* a, std::size_t n, std::uint32_t value) {
+    using U = Vec<std::uint32_t, Bytes>;
+    using V = Vec<int, Bytes>;
+    constexpr std::size_t W = Bytes / sizeof(std::uint32_t);
+    V counts{};
+    U x;
+    std::size_t i = 0;
+    for (; i + W <= n; i += W) {
+        load(x, a + i);
+        counts -= (x == value);
+    }
+    std::size_t count = 0;
+    for (std::size_t l = 0; l < W; ++l) {
+        count += static_cast<unsigned>(counts[l]);
+    }
+    for (; i < n; ++i) {
+        count += a[i] == value;
+    }
+    return count;
+}
+
+inline void scanRangeDefault(const int* a, std::size_t n, int lo, int hi, std::size_t& count, std::int64_t& sum) {
+    scanRangeBody<16>(a, n, lo, hi, count, sum);
+}
+
+inline std::size_t selectRangeDefault(const int* a, std::size_t n, int lo, int hi, std::uint32_t* out) {
+    return selectRangeBody<16>(a, n, lo, hi, out);
+}
+
+inline std::size_t countEqualDefault(const std::uint32_t* a, std::size_t n, std::uint32_t value) {
+    return countEqualBody<16>(a, n, value);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) inline void scanRangeAvx2(const int* a, std::size_t n, int lo, int hi,
+                                                          std::size_t& count, std::int64_t& sum) {
+    scanRangeBody<32>(a, n, lo, hi, count, sum);
+}
+
+__attribute__((target("avx2"))) inline std::size_t selectRangeAvx2(const int* a, std::size_t n, int lo, int hi,
+                                                                   std::uint32_t* out) {
+    return selectRangeBody<32>(a, n, lo, hi, out);
+}
+
+__attribute__((target("avx2"))) inline std::size_t countEqualAvx2(const std::uint32_t* a, std::size_t n,
+                                                                  std::uint32_t value) {
+    return countEqualBody<32>(a, n, value);
+}
+
+inline bool cpuHasAvx2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+#endif
+
+inline void scanRange(const int* a, std::size_t n, int lo, int hi, std::size_t& count, std::int64_t& sum) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (cpuHasAvx2()) {
+        return scanRangeAvx2(a, n, lo, hi, count, sum);
+    }
+#endif
+    scanRangeDefault(a, n, lo, hi, count, sum);
+}
+
+inline std::size_t selectRange(const int* a, std::size_t n, int lo, int hi, std::uint32_t* out) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (cpuHasAvx2()) {
+        return selectRangeAvx2(a, n, lo, hi, out);
+    }
+#endif
+    return selectRangeDefault(a, n, lo, hi, out);
+}
+
+inline std::size_t countEqual(const std::uint32_t* a, std::size_t n, std::uint32_t value) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (cpuHasAvx2()) {
+        return countEqualAvx2(a, n, value);
+    }
+#endif
+    return countEqualDefault(a, n, value);
+}
+
+} // namespace student_detail
+
+class StudentTable {
+public:
+    using Row = std::uint32_t;
+
+    void reserve(std::size_t rows) {
+        ages_.reserve(rows);
+        names_.reserve(rows);
+        ids_.reserve(rows, rows * 8);
+    }
+
+    void append(std::string_view name, int age, std::string_view id) {
+        if (ages_.size() == std::numeric_limits<Row>::max()) {
+            throw std::length_error("StudentTable is limited to 2^32 - 1 rows");
+        }
+        ages_.push_back(age);
+        names_.append(name);
+        ids_.append(id);
+    }
+
+    std::size_t size() const { return ages_.size(); }
+    std::string_view name(Row row) const { return names_[row]; }
+    int age(Row row) const { return ages_[row]; }
+    std::string_view id(Row row) const { return ids_[row]; }
+
+    const std::vector<int>& ages() const { return ages_; }
+    std::size_t distinctNames() const { return names_.distinct(); }
+
+    // Bytes held by all columns, for comparison with the row layout.
+    std::size_t bytes() const {
+        return ages_.capacity() * sizeof(int) + names_.bytes() + ids_.bytes();
+    }
+
+    // Rows with lo <= age <= hi.
+    std::size_t countAgeBetween(int lo, int hi) const {
+        std::size_t count = 0;
+        std::int64_t sum = 0;
+        scanAges(lo, hi, count, sum);
+        return count;
+    }
+
+    // Mean age of the rows with lo <= age <= hi (0 when there are none).
+    double averageAgeBetween(int lo, int hi) const {
+        std::size_t count = 0;
+        std::int64_t sum = 0;
+        scanAges(lo, hi, count, sum);
+        return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+    }
+
+    double averageAge() const {
+        return averageAgeBetween(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    }
+
+    // Row numbers with lo <= age <= hi, ascending. Counts first so the
+    // result is allocated once at its final size.
+    std::vector<Row> filterAgeBetween(int lo, int hi) const {
+        if (lo > hi) {
+            return {};
+        }
+        constexpr std::size_t kSlack = 8; // selectRangeBody writes up to one vector past the end
+        std::vector<Row> rows(countAgeBetween(lo, hi) + kSlack);
+        std::size_t found = student_detail::selectRange(ages_.data(), ages_.size(), lo, hi, rows.data());
+        rows.resize(found);
+        return rows;
+    }
+
+    // Rows whose name is exactly name; compares 4-byte codes, not strings.
+    std::size_t countName(std::string_view name) const {
+        std::int64_t code = names_.find(name);
+        if (code < 0) {
+            return 0;
+        }
+        const auto& codes = names_.codes();
+        return student_detail::countEqual(codes.data(), codes.size(), static_cast<std::uint32_t>(code));
+    }
+
+    // Appends every record of a file in day13's text format (name, age and id
+    // on three lines). The file is read in one go and parsed in place instead
+    // of through three stream extractions per record.
+    bool importText(const std::string& filename) {
+        std::ifstream ifs(filename, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "Error opening file for reading: " << filename << std::endl;
+            return false;
+        }
+        ifs.seekg(0, std::ios::end);
+        std::string text(static_cast<std::size_t>(ifs.tellg()), '\0');
+        ifs.seekg(0, std::ios::beg);
+        ifs.read(&text[0], static_cast<std::streamsize>(text.size()));
+        const char* p = text.data();
+        const char* end = p + text.size();
+        reserve(size() + static_cast<std::size_t>(std::count(p, end, '\n')) / 3);
+        while (p < end) {
+            std::string_view name = nextLine(p, end);
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            int age = 0;
+            auto parsed = std::from_chars(p, end, age);
+            if (parsed.ec != std::errc()) {
+                std::cerr << "Invalid age in " << filename << " after \"" << name << "\"" << std::endl;
+                return false;
+            }
+            p = parsed.ptr;
+            nextLine(p, end); // rest of the age line
+            std::string_view id = nextLine(p, end);
+            append(name, age, id);
+        }
+        return true;
+    }
+
+    bool exportText(const std::string& filename) const {
+        std::ofstream ofs(filename, std::ios::binary);
+        if (!ofs) {
+            std::cerr << "Error opening file for writing: " << filename << std::endl;
+            return false;
+        }
+        std::string buffer;
+        for (Row row = 0; row < size(); ++row) {
+            buffer.append(name(row)).push_back('\n');
+            buffer.append(std::to_string(age(row))).push_back('\n');
+            buffer.append(id(row)).push_back('\n');
+            if (buffer.size() >= (1 << 20)) {
+                ofs.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        ofs.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return static_cast<bool>(ofs);
+    }
+
+private:
+    void scanAges(int lo, int hi, std::size_t& count, std::int64_t& sum) const {
+        if (lo <= hi) {
+            student_detail::scanRange(ages_.data(), ages_.size(), lo, hi, count, sum);
+        }
+    }
+
+    static std::string_view nextLine(const char*& p, const char* end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (!eol) {
+            eol = end;
+        }
+        std::string_view line(p, static_cast<std::size_t>(eol - p));
+        p = eol == end ? end : eol + 1;
+        return line;
+    }
+
+    std::vector<int> ages_;
+    student_detail::DictionaryColumn names_;
+    student_detail::StringArena ids_;
+};
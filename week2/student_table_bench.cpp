@@ -0,0 +1,243 @@
+// Student scans: std::vector<Student> (day13 layout) vs columnar StudentTable.
+// Build: g++ -std=c++17 -O2 student_table_bench.cpp -o student_table_bench
+// Usage: ./student_table_bench [rows]   (default 10M; the row layout is skipped above 20M,
+//                                        100M columnar rows need ~2.5 GB)
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "student_table.h"
+
+// day13's record and text format.
+struct Student {
+    std::string name;
+    int age;
+    std::string id;
+};
+
+std::vector<Student> loadStudentsDay13(const std::string& filename) {
+    std::vector<Student> students;
+    std::ifstream ifs(filename);
+    while (ifs.peek() != EOF) {
+        Student student;
+        std::getline(ifs, student.name);
+        ifs >> student.age;
+        ifs.ignore();
+        std::getline(ifs, student.id);
+        students.push_back(student);
+    }
+    return students;
+}
+
+const char* const kNames[] = {"Alice", "Bob", "Charlie", "Diana", "Ethan", "Fiona", "George", "Hannah",
+                              "Isaac", "Julia", "Kevin", "Laura", "Michael", "Natalie", "Oscar", "Penelope"};
+
+template <typename Emit>
+void generate(std::size_t n, Emit emit) {
+    std::mt19937 rng(13);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::string id = "S" + std::to_string(10000000 + i);
+        emit(kNames[rng() % 16], static_cast<int>(16 + rng() % 50), id);
+    }
+}
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool check() {
+    std::vector<Student> rows;
+    StudentTable table;
+    generate(100003, [&](const char* name, int age, const std::string& id) {
+        rows.push_back({name, age, id});
+        table.append(name, age, id);
+    });
+
+    const int ranges[][2] = {{18, 25}, {16, 65}, {40, 40}, {70, 80}, {30, 20}, {-5, 17}};
+    for (const auto& r : ranges) {
+        std::vector<StudentTable::Row> expected;
+        long long sum = 0;
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].age >= r[0] && rows[i].age <= r[1]) {
+                expected.push_back(static_cast<StudentTable::Row>(i));
+                sum += rows[i].age;
+            }
+        }
+        double avg = expected.empty() ? 0.0 : static_cast<double>(sum) / static_cast<double>(expected.size());
+        if (table.countAgeBetween(r[0], r[1]) != expected.size() || table.filterAgeBetween(r[0], r[1]) != expected ||
+            table.averageAgeBetween(r[0], r[1]) != avg) {
+            std::cerr << "age range [" << r[0] << ", " << r[1] << "] differs" << std::endl;
+            return false;
+        }
+    }
+    for (const char* name : {"Alice", "Penelope", "Nobody"}) {
+        auto expected = std::count_if(rows.begin(), rows.end(), [&](const Student& s) { return s.name == name; });
+        if (table.countName(name) != static_cast<std::size_t>(expected)) {
+            return false;
+        }
+    }
+    if (table.distinctNames() != 16 || table.name(7) != rows[7].name || table.id(99999) != rows[99999].id) {
+        return false;
+    }
+
+    // Extreme ages and an empty table.
+    StudentTable edge;
+    if (edge.averageAge() != 0.0 || !edge.filterAgeBetween(0, 100).empty()) {
+        return false;
+    }
+    edge.append("min", std::numeric_limits<int>::min(), "a");
+    edge.append("max", std::numeric_limits<int>::max(), "b");
+    if (edge.countAgeBetween(std::numeric_limits<int>::min(), std::numeric_limits<int>::max()) != 2 ||
+        edge.averageAge() != -0.5) {
+        return false;
+    }
+
+    // Round trip through day13's text format.
+    const std::string file = "student_table_check.txt";
+    if (!table.exportText(file)) {
+        return false;
+    }
+    auto loaded = loadStudentsDay13(file);
+    StudentTable imported;
+    bool ok = imported.importText(file) && imported.size() == rows.size() && loaded.size() == rows.size();
+    for (std::size_t i = 0; ok && i < rows.size(); ++i) {
+        auto row = static_cast<StudentTable::Row>(i);
+        ok = loaded[i].name == rows[i].name && loaded[i].age == rows[i].age && loaded[i].id == rows[i].id &&
+             imported.name(row) == rows[i].name && imported.age(row) == rows[i].age && imported.id(row) == rows[i].id;
+    }
+    std::remove(file.c_str());
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t n = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    if (!check()) {
+        std::cerr << "StudentTable results differ from the row layout" << std::endl;
+        return 1;
+    }
+    std::cout << "Results match the std::vector<Student> scans." << std::endl;
+
+    StudentTable table;
+    table.reserve(n);
+    std::vector<Student> rows;
+    bool withRows = n <= 20000000;
+    if (withRows) {
+        rows.reserve(n);
+    }
+    generate(n, [&](const char* name, int age, const std::string& id) {
+        if (withRows) {
+            rows.push_back({name, age, id});
+        }
+        table.append(name, age, id);
+    });
+
+    std::cout << "\n" << n << " rows, ms per query" << std::endl;
+    std::cout << "  memory: columns " << table.bytes() / (1 << 20) << " MB";
+    if (withRows) {
+        std::cout << ", vector<Student> " << rows.capacity() * sizeof(Student) / (1 << 20)
+                  << " MB + heap strings";
+    }
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(28) << "query" << std::right << std::setw(14) << "vector<Student>"
+              << std::setw(14) << "column loop" << std::setw(12) << "SIMD" << std::endl;
+
+    std::size_t sink = 0;
+    const std::vector<int>& ages = table.ages();
+    auto report = [&](const char* query, double aos, double column, double simd) {
+        std::cout << std::left << std::setw(28) << query << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << aos << std::setw(14) << column << std::setw(12) << simd << std::endl;
+    };
+
+    double aos = withRows ? timeMs([&] {
+        sink += std::count_if(rows.begin(), rows.end(), [](const Student& s) { return s.age >= 18 && s.age <= 25; });
+    }) : 0.0;
+    double column = timeMs([&] {
+        std::size_t count = 0;
+        for (int age : ages) {
+            count += age >= 18 && age <= 25;
+        }
+        sink += count;
+    });
+    double simd = timeMs([&] { sink += table.countAgeBetween(18, 25); });
+    report("count 18 <= age <= 25", aos, column, simd);
+
+    aos = withRows ? timeMs([&] {
+        long long sum = 0;
+        for (const Student& s : rows) {
+            sum += s.age;
+        }
+        sink += static_cast<std::size_t>(sum);
+    }) : 0.0;
+    column = timeMs([&] {
+        long long sum = 0;
+        for (int age : ages) {
+            sum += age;
+        }
+        sink += static_cast<std::size_t>(sum);
+    });
+    simd = timeMs([&] { sink += static_cast<std::size_t>(table.averageAge()); });
+    report("average age", aos, column, simd);
+
+    aos = withRows ? timeMs([&] {
+        std::vector<StudentTable::Row> selected;
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].age >= 30 && rows[i].age <= 45) {
+                selected.push_back(static_cast<StudentTable::Row>(i));
+            }
+        }
+        sink += selected.size();
+    }) : 0.0;
+    column = timeMs([&] {
+        std::vector<StudentTable::Row> selected;
+        for (std::size_t i = 0; i < ages.size(); ++i) {
+            if (ages[i] >= 30 && ages[i] <= 45) {
+                selected.push_back(static_cast<StudentTable::Row>(i));
+            }
+        }
+        sink += selected.size();
+    });
+    simd = timeMs([&] { sink += table.filterAgeBetween(30, 45).size(); });
+    report("filter 30 <= age <= 45", aos, column, simd);
+
+    aos = withRows ? timeMs([&] {
+        sink += std::count_if(rows.begin(), rows.end(), [](const Student& s) { return s.name == "Hannah"; });
+    }) : 0.0;
+    column = timeMs([&] {
+        std::size_t count = 0;
+        for (StudentTable::Row r = 0; r < table.size(); ++r) {
+            count += table.name(r) == "Hannah";
+        }
+        sink += count;
+    });
+    simd = timeMs([&] { sink += table.countName("Hannah"); });
+    report("count name == \"Hannah\"", aos, column, simd);
+
+    // Bulk import against day13's stream-per-field loader.
+    std::size_t importRows = std::min<std::size_t>(n, 2000000);
+    StudentTable slice;
+    for (StudentTable::Row r = 0; r < importRows; ++r) {
+        slice.append(table.name(r), table.age(r), table.id(r));
+    }
+    const std::string file = "student_table_bench.txt";
+    slice.exportText(file);
+    double day13 = timeMs([&] { sink += loadStudentsDay13(file).size(); });
+    double bulk = timeMs([&] {
+        StudentTable imported;
+        imported.importText(file);
+        sink += imported.size();
+    });
+    std::remove(file.c_str());
+    std::cout << "\nImport " << importRows << " rows from text: day13 loader " << day13 << " ms, importText "
+              << bulk << " ms (" << day13 / bulk << "x)" << std::endl;
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,281 @@
+// Memory-bound tasks on a ThreadPool with and without worker placement:
+// each task sums one chunk of a large array, which a task of the same
+// configuration wrote first (so, with node queues, on the node that reads
+// it). "same CPU" and "same node" count the sums that ran where their
+// chunk was written. On a one-node machine the placed rows only show what
+// pinning to cores costs or saves.
+// Build: g++ -std=c++17 -O2 affinity_bench.cpp -o affinity_bench -pthread
+// Usage: ./affinity_bench [MiB] [passes] [threads]   (default 256 MiB, 10 passes, one thread per CPU)
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "cpu_topology.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+template <typename T>
+bool ready(std::future<T>& f) {
+    return f.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+}
+
+bool checkTopology() {
+    using V = std::vector<int>;
+    if (CpuTopology::parseCpuList("0-3,8,10-11\n") != V{0, 1, 2, 3, 8, 10, 11} ||
+        CpuTopology::parseCpuList("") != V{} || CpuTopology::parseCpuList("5,x,3-1,2") != V{2, 5}) {
+        return bench::fail("parseCpuList misreads the kernel's list format");
+    }
+    CpuTopology t = CpuTopology::detect();
+    std::vector<int> allowed = CpuTopology::allowedCpus();
+    if (t.nodes.empty() || t.cpuCount() != allowed.size()) {
+        return bench::fail("detect() must cover exactly the allowed CPUs");
+    }
+    for (int cpu : allowed) {
+        if (t.nodeOf(cpu) < 0) {
+            return bench::fail("CPU " + std::to_string(cpu) + " is in no node");
+        }
+    }
+    return true;
+}
+
+bool checkPinning() {
+    CpuTopology t = CpuTopology::detect();
+    ThreadPoolOptions options;
+    options.affinity = WorkerAffinity::Core;
+    ThreadPool pool(options);
+    std::vector<std::future<bool>> results;
+    for (size_t i = 0; i < 4 * t.cpuCount(); ++i) {
+        results.push_back(pool.enqueue([&t] {
+            std::vector<int> mine = CpuTopology::allowedCpus();
+            return mine.size() == 1 && t.nodeOf(mine[0]) == ThreadPool::currentNode();
+        }));
+    }
+    for (std::future<bool>& r : results) {
+        if (!r.get()) {
+            return bench::fail("a Core-pinned worker may run on other CPUs, or reports the wrong node");
+        }
+    }
+    if (ThreadPool::currentNode() != -1) {
+        return bench::fail("currentNode() outside a pool must be -1");
+    }
+    return true;
+}
+
+// Two nodes that share the real CPUs, one worker each.
+bool checkNodeQueues() {
+    ThreadPoolOptions options;
+    options.threads = 2;
+    options.nodeQueues = true;
+    std::vector<int> cpus = CpuTopology::allowedCpus();
+    options.topology.nodes = {{0, cpus}, {1, cpus}};
+    ThreadPool pool(options);
+
+    // A task for a node whose only worker is busy is stolen by the other.
+    std::promise<void> gate;
+    std::shared_future<void> open = gate.get_future().share();
+    std::promise<int> started;
+    std::future<int> blockedNode = started.get_future();
+    pool.post([&started, open] {
+        started.set_value(ThreadPool::currentNode());
+        open.wait();
+    }, TaskOptions{TaskPriority::Normal, {}, 0});
+    if (!ready(blockedNode)) {
+        return bench::fail("the blocking task never started");
+    }
+    int busy = blockedNode.get();
+    ScheduledTask<int> probe = pool.submit(TaskOptions{TaskPriority::Normal, {}, busy}, [] {
+        return ThreadPool::currentNode();
+    });
+    if (!ready(probe.future)) {
+        gate.set_value();
+        return bench::fail("a task queued behind a busy node was not stolen by the idle one");
+    }
+    if (probe.future.get() != 1 - busy) {
+        gate.set_value();
+        return bench::fail("the stolen task ran on the wrong node");
+    }
+
+    // Cancellation finds tasks in either node's queue.
+    std::promise<void> second;
+    std::future<void> bothBusy = second.get_future();
+    pool.post([&second, open] {
+        second.set_value();
+        open.wait();
+    });
+    if (!ready(bothBusy)) {
+        gate.set_value();
+        return bench::fail("the second blocking task never started");
+    }
+    ScheduledTask<int> a = pool.submit(TaskOptions{TaskPriority::Normal, {}, 0}, [] { return 0; });
+    ScheduledTask<int> b = pool.submit(TaskOptions{TaskPriority::Normal, {}, 1}, [] { return 1; });
+    bool cancelled = pool.cancel(b.id) && pool.cancel(a.id) && !pool.cancel(a.id);
+    gate.set_value();
+    if (!cancelled) {
+        return bench::fail("cancel() must find a queued task on any node, once");
+    }
+    try {
+        a.future.get();
+        return bench::fail("a cancelled task's future must throw");
+    } catch (const std::future_error&) {
+    }
+
+    // Everything submitted from outside and from the workers runs.
+    std::vector<std::promise<int>> promises(2000);
+    for (int i = 0; i < 2000; ++i) {
+        pool.post([&pool, &promises, i] {
+            if (i % 2 == 0) {
+                pool.post([&promises, i] { promises[i].set_value(i); });
+            } else {
+                promises[i].set_value(i);
+            }
+        }, TaskOptions{TaskPriority::Normal, {}, i % 3 - 1});
+    }
+    for (int i = 0; i < 2000; ++i) {
+        std::future<int> result = promises[i].get_future();
+        if (!ready(result) || result.get() != i) {
+            return bench::fail("task " + std::to_string(i) + " was lost between the node queues");
+        }
+    }
+    ThreadPoolStats s = pool.stats();
+    if (s.cancelled != 2 || s.submitted != 5 + 3000 || s.queueDepth != 0) {
+        return bench::fail("node queue counters are wrong: " + std::to_string(s.submitted) + " submitted, " +
+                           std::to_string(s.cancelled) + " cancelled");
+    }
+    return true;
+}
+
+struct Result {
+    double fillMs;
+    double gbPerSecond;  // summing, best pass
+    double sameCpu;      // fraction of sums on the CPU that wrote the chunk
+    double sameNode;
+};
+
+struct Chunk {
+    std::unique_ptr<uint64_t[]> data;
+    int node;      // where it should live; -1 for anywhere
+    int writtenOn = -1;
+};
+
+// Each chunk is summed by one task per pass; with placement, on its node.
+Result measure(ThreadPool& pool, const CpuTopology& topology, size_t chunkWords, size_t chunks, int passes,
+               bool fillInTasks, bool placed) {
+    std::vector<Chunk> data(chunks);
+    for (size_t c = 0; c < chunks; ++c) {
+        data[c].data.reset(new uint64_t[chunkWords]);  // not touched yet: no pages behind it
+        data[c].node = placed ? topology.nodes[c % topology.nodes.size()].id : -1;
+    }
+    auto fill = [chunkWords](Chunk& chunk) {
+        for (size_t i = 0; i < chunkWords; ++i) {
+            chunk.data[i] = i * 0x9E3779B97F4A7C15u;
+        }
+        chunk.writtenOn = currentCpu();
+    };
+
+    Result r{};
+    auto start = Clock::now();
+    std::vector<std::future<void>> filled;
+    for (Chunk& chunk : data) {
+        if (fillInTasks) {
+            filled.push_back(pool.submit(TaskOptions{TaskPriority::Normal, {}, chunk.node}, fill, std::ref(chunk)).future);
+        } else {
+            fill(chunk);
+        }
+    }
+    for (std::future<void>& f : filled) {
+        f.get();
+    }
+    r.fillMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    size_t sameCpu = 0, sameNode = 0, sums = 0;
+    double best = 1e30;
+    for (int pass = 0; pass < passes; ++pass) {
+        std::vector<std::future<std::pair<uint64_t, int>>> results;
+        start = Clock::now();
+        for (Chunk& chunk : data) {
+            results.push_back(pool.submit(TaskOptions{TaskPriority::Normal, {}, chunk.node}, [&chunk, chunkWords] {
+                const uint64_t* p = chunk.data.get();
+                uint64_t a = 0, b = 0, c = 0, d = 0;
+                for (size_t i = 0; i + 4 <= chunkWords; i += 4) {
+                    a += p[i];
+                    b += p[i + 1];
+                    c += p[i + 2];
+                    d += p[i + 3];
+                }
+                return std::make_pair(a + b + c + d, currentCpu());
+            }).future);
+        }
+        for (size_t c = 0; c < chunks; ++c) {
+            std::pair<uint64_t, int> sum = results[c].get();
+            sameCpu += sum.second == data[c].writtenOn;
+            sameNode += topology.nodeOf(sum.second) == topology.nodeOf(data[c].writtenOn);
+            ++sums;
+        }
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    r.gbPerSecond = static_cast<double>(chunkWords * chunks * sizeof(uint64_t)) / best / 1e9;
+    r.sameCpu = static_cast<double>(sameCpu) / static_cast<double>(sums);
+    r.sameNode = static_cast<double>(sameNode) / static_cast<double>(sums);
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    size_t mib = argc > 1 ? std::stoul(argv[1]) : 256;
+    int passes = argc > 2 ? std::stoi(argv[2]) : 10;
+    CpuTopology topology = CpuTopology::detect();
+    size_t threads = argc > 3 ? std::stoul(argv[3]) : topology.cpuCount();
+
+    if (!checkTopology() || !checkPinning() || !checkNodeQueues()) {
+        return 1;
+    }
+    std::cout << "Topology, pinning, stealing and cross-node cancel checks pass." << std::endl;
+
+    std::cout << "\n" << topology.nodes.size() << " NUMA node(s):";
+    for (const CpuTopology::Node& node : topology.nodes) {
+        std::cout << "  node " << node.id << " has " << node.cpus.size() << " CPU(s)";
+    }
+    if (topology.nodes.size() == 1) {
+        std::cout << "\n(one node: every placement reads local memory; only cache reuse can differ)";
+    }
+
+    const size_t chunkWords = 512 * 1024;  // 4 MiB
+    size_t chunks = std::max<size_t>(1, mib * 1024 * 1024 / (chunkWords * sizeof(uint64_t)));
+    std::cout << "\n" << chunks << " chunks of 4 MiB, " << threads << " workers, best of " << passes << " passes\n"
+              << std::setw(28) << "" << std::setw(10) << "fill ms" << std::setw(10) << "GB/s" << std::setw(12)
+              << "same CPU" << std::setw(12) << "same node" << std::endl;
+    std::cout << std::fixed;
+    auto row = [&](const char* name, ThreadPoolOptions options, bool fillInTasks) {
+        options.threads = threads;
+        bool placed = options.nodeQueues;
+        options.topology = topology;
+        ThreadPool pool(options);
+        Result r = measure(pool, topology, chunkWords, chunks, passes, fillInTasks, placed);
+        std::cout << std::setw(28) << name << std::setprecision(1) << std::setw(10) << r.fillMs
+                  << std::setprecision(2) << std::setw(10) << r.gbPerSecond << std::setprecision(0) << std::setw(11)
+                  << 100 * r.sameCpu << "%" << std::setw(11) << 100 * r.sameNode << "%" << std::endl;
+    };
+    ThreadPoolOptions unpinned;
+    ThreadPoolOptions cores;
+    cores.affinity = WorkerAffinity::Core;
+    ThreadPoolOptions nodes;
+    nodes.affinity = WorkerAffinity::Node;
+    nodes.nodeQueues = true;
+    ThreadPoolOptions coreNodes = cores;
+    coreNodes.nodeQueues = true;
+    row("unpinned, filled by main", unpinned, false);
+    row("unpinned", unpinned, true);
+    row("pinned to cores", cores, true);
+    row("node queues", nodes, true);
+    row("node queues, pinned cores", coreNodes, true);
+    return 0;
+}
@@ -0,0 +1,806 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define AIO_HAVE_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "thread_pool.h"
+
+// Asynchronous file I/O for the loaders and savers.
+//
+//   aio::LineReader in("students.txt");          // reads ahead while you parse
+//   for (std::string_view line; in.next(line);) ...
+//
+//   aio::FileWriter out("students.txt");         // writes behind while you format
+//   out << name << '\n' << age << '\n';
+//
+// Reads and writes go through an IoQueue with one of three backends:
+//   Uring    io_uring through the raw system calls (no liburing). The
+//            buffers are registered once, so the kernel does not pin and
+//            unpin them on every operation. Submission and the wait share
+//            one io_uring_enter().
+//   Threads  pread/pwrite on a ThreadPool, for kernels without io_uring
+//            or where it is disabled (seccomp, io_uring_disabled).
+//   Sync     pread/pwrite in the caller; nothing overlaps.
+// Auto picks Uring and falls back to Threads.
+//
+// Options::depth is the queue depth: the number of chunk buffers, which is
+// also how many chunks can be in flight. The default, 2, is double
+// buffering: the next chunk is read while the caller parses this one, and
+// a full buffer is written while the caller fills the other. Reads of a
+// file whose pages are not cached overlap with parsing. When the pages
+// are cached, the gain is just the copies done on another core.
+namespace aio {
+
+enum class Backend { Auto, Uring, Threads, Sync };
+
+struct Options {
+    Backend backend = Backend::Auto;
+    size_t chunk = 256 * 1024;  // bytes per read or write
+    unsigned depth = 2;         // buffers, and operations in flight
+    bool registerBuffers = true;
+};
+
+// Reads and writes at explicit offsets, completed in any order. A
+// completion carries the caller's tag and the byte count or -errno. The
+// caller keeps at most depth() operations in flight.
+class IoQueue {
+public:
+    struct Completion {
+        uint64_t tag;
+        int64_t result;
+    };
+
+    explicit IoQueue(unsigned depth) : depth_(depth) {}
+    virtual ~IoQueue() = default;
+
+    IoQueue(const IoQueue&) = delete;
+    IoQueue& operator=(const IoQueue&) = delete;
+
+    unsigned depth() const { return depth_; }
+    virtual const char* name() const = 0;
+
+    // Lets read() and write() name these buffers by index instead of -1.
+    // Returns false where that buys nothing or the kernel refused (e.g.
+    // RLIMIT_MEMLOCK); indexes are then ignored.
+    virtual bool registerBuffers(const iovec*, unsigned) { return false; }
+
+    // Queue an operation. The queue may hold it until submit(), wait() or
+    // poll().
+    virtual void read(int fd, void* data, size_t size, uint64_t offset, int buffer, uint64_t tag) = 0;
+    virtual void write(int fd, const void* data, size_t size, uint64_t offset, int buffer, uint64_t tag) = 0;
+    virtual void submit() {}
+
+    // The next completion: wait() blocks for it, poll() does not.
+    virtual Completion wait() = 0;
+    virtual bool poll(Completion& out) = 0;
+
+private:
+    unsigned depth_;
+};
+
+inline int64_t preadFull(int fd, void* data, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, static_cast<char*>(data) + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<int64_t>(done);
+}
+
+inline int64_t pwriteFull(int fd, const void* data, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pwrite(fd, static_cast<const char*>(data) + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -errno;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<int64_t>(done);
+}
+
+class SyncQueue : public IoQueue {
+public:
+    explicit SyncQueue(unsigned depth) : IoQueue(depth) {}
+
+    const char* name() const override { return "sync"; }
+
+    void read(int fd, void* data, size_t size, uint64_t offset, int, uint64_t tag) override {
+        done_.push_back(Completion{tag, preadFull(fd, data, size, offset)});
+    }
+    void write(int fd, const void* data, size_t size, uint64_t offset, int, uint64_t tag) override {
+        done_.push_back(Completion{tag, pwriteFull(fd, data, size, offset)});
+    }
+
+    Completion wait() override {
+        if (done_.empty()) {
+            throw std::logic_error("aio::SyncQueue::wait with nothing in flight");
+        }
+        Completion c = done_.front();
+        done_.pop_front();
+        return c;
+    }
+    bool poll(Completion& out) override {
+        if (done_.empty()) {
+            return false;
+        }
+        out = wait();
+        return true;
+    }
+
+private:
+    std::deque<Completion> done_;
+};
+
+class ThreadQueue : public IoQueue {
+public:
+    explicit ThreadQueue(unsigned depth) : IoQueue(depth), pool_(depth) {}
+
+    const char* name() const override { return "threads"; }
+
+    void read(int fd, void* data, size_t size, uint64_t offset, int, uint64_t tag) override {
+        pool_.post([this, fd, data, size, offset, tag] { complete(tag, preadFull(fd, data, size, offset)); });
+    }
+    void write(int fd, const void* data, size_t size, uint64_t offset, int, uint64_t tag) override {
+        pool_.post([this, fd, data, size, offset, tag] { complete(tag, pwriteFull(fd, data, size, offset)); });
+    }
+
+    Completion wait() override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return !done_.empty(); });
+        Completion c = done_.front();
+        done_.pop_front();
+        return c;
+    }
+    bool poll(Completion& out) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_.empty()) {
+            return false;
+        }
+        out = done_.front();
+        done_.pop_front();
+        return true;
+    }
+
+private:
+    void complete(uint64_t tag, int64_t result) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back(Completion{tag, result});
+        }
+        ready_.notify_one();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Completion> done_;
+    ThreadPool pool_;  // last: its destructor finishes the tasks that use the rest
+};
+
+#if defined(AIO_HAVE_URING)
+// The three shared mappings of an io_uring instance: the submission ring
+// (indexes into the SQE array), the SQE array, and the completion ring.
+// The kernel moves the SQ head and the CQ tail; we move the other two.
+class Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params p{};
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+        }
+        sqBytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqBytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sqBytes_ = cqBytes_ = std::max(sqBytes_, cqBytes_);
+        }
+        sqesBytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        sq_ = map(sqBytes_, IORING_OFF_SQ_RING);
+        cq_ = single ? sq_ : map(cqBytes_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqesBytes_, IORING_OFF_SQES));
+        if (sq_ == MAP_FAILED || cq_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+            int err = errno;
+            release();
+            throw std::system_error(err, std::generic_category(), "io_uring mmap");
+        }
+        char* sq = static_cast<char*>(sq_);
+        char* cq = static_cast<char*>(cq_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        entries_ = p.sq_entries;
+        features_ = p.features;
+        // SQE i always sits in ring slot i, so the index array is set once.
+        unsigned* array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        for (unsigned i = 0; i < entries_; ++i) {
+            array[i] = i;
+        }
+        tail_ = *sqTail_;
+    }
+
+    ~Ring() { release(); }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    // A zeroed entry to fill in, or nullptr if every entry awaits the
+    // kernel.
+    io_uring_sqe* next() {
+        if (tail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == entries_) {
+            return nullptr;
+        }
+        io_uring_sqe* sqe = &sqes_[tail_ & sqMask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        ++tail_;
+        return sqe;
+    }
+
+    // Hands the new entries to the kernel and waits for minComplete
+    // completions, in one system call.
+    void enter(unsigned minComplete) {
+        __atomic_store_n(sqTail_, tail_, __ATOMIC_RELEASE);
+        for (;;) {
+            unsigned pending = tail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+            if (pending == 0 && minComplete == 0) {
+                return;
+            }
+            long r = ::syscall(__NR_io_uring_enter, fd_, pending, minComplete,
+                               minComplete > 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (r >= 0) {
+                return;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+            if (minComplete > 0 && ready()) {
+                return;
+            }
+        }
+    }
+
+    bool unsubmitted() const { return tail_ != __atomic_load_n(sqTail_, __ATOMIC_RELAXED); }
+
+    bool ready() const { return *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE); }
+
+    bool pop(io_uring_cqe& out) {
+        unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        out = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    unsigned features() const { return features_; }
+
+    bool registerBuffers(const iovec* buffers, unsigned n) {
+        return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, n) == 0;
+    }
+
+private:
+    void* map(size_t bytes, off_t offset) {
+        return ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    }
+
+    void release() {
+        if (sqes_ != nullptr && sqes_ != MAP_FAILED) {
+            ::munmap(sqes_, sqesBytes_);
+        }
+        if (cq_ != nullptr && cq_ != MAP_FAILED && cq_ != sq_) {
+            ::munmap(cq_, cqBytes_);
+        }
+        if (sq_ != nullptr && sq_ != MAP_FAILED) {
+            ::munmap(sq_, sqBytes_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    int fd_ = -1;
+    void* sq_ = nullptr;
+    void* cq_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqBytes_ = 0, cqBytes_ = 0, sqesBytes_ = 0;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned sqMask_ = 0, cqMask_ = 0, entries_ = 0, features_ = 0;
+    unsigned tail_ = 0;  // ours, published to *sqTail_ by enter()
+};
+
+class UringQueue : public IoQueue {
+public:
+    explicit UringQueue(unsigned depth) : IoQueue(depth), ring_(depth) {
+        // IORING_OP_READ and _WRITE came with this feature bit (Linux 5.6).
+        if ((ring_.features() & IORING_FEAT_RW_CUR_POS) == 0) {
+            throw std::system_error(ENOSYS, std::generic_category(), "io_uring without IORING_OP_READ");
+        }
+    }
+
+    const char* name() const override { return registered_ ? "io_uring+reg" : "io_uring"; }
+
+    bool registerBuffers(const iovec* buffers, unsigned n) override {
+        registered_ = ring_.registerBuffers(buffers, n);
+        return registered_;
+    }
+
+    void read(int fd, void* data, size_t size, uint64_t offset, int buffer, uint64_t tag) override {
+        prepare(registered_ && buffer >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, data, size, offset, buffer,
+                tag);
+    }
+    void write(int fd, const void* data, size_t size, uint64_t offset, int buffer, uint64_t tag) override {
+        prepare(registered_ && buffer >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, data, size, offset,
+                buffer, tag);
+    }
+
+    void submit() override {
+        if (ring_.unsubmitted()) {
+            ring_.enter(0);
+        }
+    }
+
+    Completion wait() override {
+        Completion c;
+        while (!poll(c)) {
+            ring_.enter(1);
+        }
+        return c;
+    }
+
+    bool poll(Completion& out) override {
+        submit();
+        io_uring_cqe cqe;
+        if (!ring_.pop(cqe)) {
+            return false;
+        }
+        out = Completion{cqe.user_data, cqe.res};
+        return true;
+    }
+
+private:
+    void prepare(uint8_t op, int fd, const void* data, size_t size, uint64_t offset, int buffer, uint64_t tag) {
+        io_uring_sqe* sqe = ring_.next();
+        if (sqe == nullptr) {
+            throw std::logic_error("aio::UringQueue: more than depth() operations in flight");
+        }
+        sqe->opcode = op;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(size);
+        sqe->off = offset;
+        sqe->user_data = tag;
+        if (op == IORING_OP_READ_FIXED || op == IORING_OP_WRITE_FIXED) {
+            sqe->buf_index = static_cast<uint16_t>(buffer);
+        }
+    }
+
+    Ring ring_;
+    bool registered_ = false;
+};
+#endif
+
+// Auto tries io_uring and falls back to threads. Uring throws
+// std::system_error where io_uring is unavailable.
+inline std::unique_ptr<IoQueue> makeQueue(Backend backend, unsigned depth) {
+    depth = std::max(1u, depth);
+    if (backend == Backend::Sync) {
+        return std::make_unique<SyncQueue>(depth);
+    }
+    if (backend == Backend::Uring || backend == Backend::Auto) {
+#if defined(AIO_HAVE_URING)
+        try {
+            return std::make_unique<UringQueue>(depth);
+        } catch (const std::system_error&) {
+            if (backend == Backend::Uring) {
+                throw;
+            }
+        }
+#else
+        if (backend == Backend::Uring) {
+            throw std::system_error(ENOSYS, std::generic_category(), "io_uring");
+        }
+#endif
+    }
+    return std::make_unique<ThreadQueue>(depth);
+}
+
+// depth page-aligned buffers of chunk bytes, registered with the queue.
+class Buffers {
+public:
+    // None, for a file that did not open.
+    Buffers() : chunk_(1) {}
+
+    Buffers(IoQueue& queue, const Options& options) : chunk_(std::max<size_t>(1, options.chunk)) {
+        size_t bytes = (chunk_ + 4095) / 4096 * 4096;
+        std::vector<iovec> iov;
+        for (unsigned i = 0; i < queue.depth(); ++i) {
+            void* p = std::aligned_alloc(4096, bytes);
+            if (p == nullptr) {
+                throw std::bad_alloc();
+            }
+            data_.emplace_back(static_cast<char*>(p));
+            iov.push_back(iovec{p, chunk_});
+        }
+        if (options.registerBuffers) {
+            queue.registerBuffers(iov.data(), static_cast<unsigned>(iov.size()));
+        }
+    }
+
+    char* operator[](size_t i) const { return data_[i].get(); }
+    size_t chunk() const { return chunk_; }
+
+private:
+    struct Free {
+        void operator()(char* p) const { std::free(p); }
+    };
+    size_t chunk_;
+    std::vector<std::unique_ptr<char, Free>> data_;
+};
+
+// A file in chunks, in order, with depth - 1 chunks read ahead.
+class FileReader {
+public:
+    explicit FileReader(const std::string& path, const Options& options = {})
+        : fd_(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+          error_(fd_ < 0 ? errno : 0),
+          queue_(fd_ >= 0 ? makeQueue(options.backend, options.depth) : nullptr),
+          buffers_(queue_ ? Buffers(*queue_, options) : Buffers()),
+          results_(queue_ ? queue_->depth() : 0, kIdle) {
+        struct stat st;
+        if (fd_ < 0) {
+            return;
+        }
+        if (::fstat(fd_, &st) != 0) {
+            error_ = errno;
+            return;
+        }
+        size_ = static_cast<uint64_t>(st.st_size);
+        chunks_ = (size_ + buffers_.chunk() - 1) / buffers_.chunk();
+        for (uint64_t c = 0; c < std::min<uint64_t>(chunks_, queue_->depth()); ++c) {
+            issue(c);
+        }
+    }
+
+    ~FileReader() {
+        // The reads in flight still own their buffers.
+        for (auto n = std::count(results_.begin(), results_.end(), kPending); n > 0; --n) {
+            drainOne();
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    explicit operator bool() const { return fd_ >= 0 && error_ == 0; }
+    int error() const { return error_; }
+    uint64_t size() const { return size_; }
+    // "none" if the file did not open.
+    const char* backend() const { return queue_ ? queue_->name() : "none"; }
+
+    // The next chunk; false at the end or on an error. The chunk stays
+    // valid until the next call, which hands its buffer back for the
+    // chunk depth places further on.
+    bool next(std::string_view& chunk) {
+        if (!*this) {
+            return false;
+        }
+        if (consumed_ > 0 && consumed_ - 1 + queue_->depth() < chunks_) {
+            issue(consumed_ - 1 + queue_->depth());
+        }
+        if (consumed_ == chunks_) {
+            return false;
+        }
+        size_t slot = consumed_ % queue_->depth();
+        while (results_[slot] == kPending) {
+            drainOne();
+        }
+        int64_t got = results_[slot];
+        results_[slot] = kIdle;
+        if (got < 0) {
+            error_ = static_cast<int>(-got);
+            return false;
+        }
+        uint64_t offset = consumed_ * buffers_.chunk();
+        size_t expected = static_cast<size_t>(std::min<uint64_t>(buffers_.chunk(), size_ - offset));
+        if (static_cast<size_t>(got) < expected) {
+            // Short read: finish it here (or the file shrank under us).
+            int64_t rest = preadFull(fd_, buffers_[slot] + got, expected - static_cast<size_t>(got),
+                                     offset + static_cast<uint64_t>(got));
+            if (rest < 0) {
+                error_ = static_cast<int>(-rest);
+                return false;
+            }
+            got += rest;
+            if (static_cast<size_t>(got) < expected) {
+                chunks_ = consumed_ + 1;
+            }
+        }
+        ++consumed_;
+        chunk = std::string_view(buffers_[slot], static_cast<size_t>(got));
+        return true;
+    }
+
+private:
+    static constexpr int64_t kIdle = INT64_MIN;
+    static constexpr int64_t kPending = INT64_MIN + 1;
+
+    void issue(uint64_t c) {
+        size_t slot = c % queue_->depth();
+        uint64_t offset = c * buffers_.chunk();
+        size_t size = static_cast<size_t>(std::min<uint64_t>(buffers_.chunk(), size_ - offset));
+        results_[slot] = kPending;
+        queue_->read(fd_, buffers_[slot], size, offset, static_cast<int>(slot), slot);
+    }
+
+    void drainOne() {
+        IoQueue::Completion c = queue_->wait();
+        results_[c.tag] = c.result;
+    }
+
+    int fd_;
+    int error_;  // open()'s errno is read before anything else runs
+    uint64_t size_ = 0;
+    uint64_t chunks_ = 0;
+    uint64_t consumed_ = 0;
+    std::unique_ptr<IoQueue> queue_;
+    Buffers buffers_;
+    std::vector<int64_t> results_;  // per slot: bytes read, -errno, kIdle or kPending
+};
+
+// Lines of a file, as std::getline would return them (without the '\n';
+// a last line without one still counts).
+class LineReader {
+public:
+    explicit LineReader(const std::string& path, const Options& options = {}) : file_(path, options) {}
+
+    explicit operator bool() const { return static_cast<bool>(file_); }
+    const FileReader& file() const { return file_; }
+
+    // The next line; valid until the next call.
+    bool next(std::string_view& line) {
+        carry_.clear();
+        for (;;) {
+            size_t nl = chunk_.find('\n');
+            if (nl != std::string_view::npos) {
+                if (carry_.empty()) {
+                    line = chunk_.substr(0, nl);
+                } else {
+                    carry_.append(chunk_.data(), nl);
+                    line = carry_;
+                }
+                chunk_.remove_prefix(nl + 1);
+                return true;
+            }
+            // The line goes on in the next chunk, whose read reuses this
+            // buffer: keep what we have.
+            carry_.append(chunk_.data(), chunk_.size());
+            chunk_ = {};
+            if (!file_.next(chunk_)) {
+                line = carry_;
+                return !carry_.empty();
+            }
+        }
+    }
+
+private:
+    FileReader file_;
+    std::string_view chunk_;
+    std::string carry_;
+};
+
+// Appends to a file through depth buffers: a full buffer is written in the
+// background while the caller fills the next one. In kTruncate mode writes
+// carry explicit offsets, so completions may come in any order; only one
+// writer per file. kAppend opens with O_APPEND, so the kernel puts each
+// write at the end of the file and other processes or writers appending to
+// it interleave instead of overwriting; there one write is in flight at a
+// time, so the buffers still land in order.
+class FileWriter {
+public:
+    enum Mode { kTruncate, kAppend };
+
+    explicit FileWriter(const std::string& path, Mode mode = kTruncate, const Options& options = {})
+        : fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (mode == kTruncate ? O_TRUNC : O_APPEND), 0644)),
+          error_(fd_ < 0 ? errno : 0),
+          append_(mode == kAppend),
+          queue_(fd_ >= 0 ? makeQueue(options.backend, options.depth) : nullptr),
+          buffers_(queue_ ? Buffers(*queue_, options) : Buffers()),
+          busy_(queue_ ? queue_->depth() : 0, false),
+          sizes_(queue_ ? queue_->depth() : 0, 0),
+          offsets_(queue_ ? queue_->depth() : 0, 0) {
+        struct stat st;
+        if (fd_ < 0) {
+            return;
+        }
+        if (::fstat(fd_, &st) != 0) {
+            error_ = errno;
+            return;
+        }
+        offset_ = static_cast<uint64_t>(st.st_size);
+    }
+
+    ~FileWriter() { close(); }
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    explicit operator bool() const { return fd_ >= 0 && error_ == 0; }
+    int error() const { return error_; }
+    // "none" if the file did not open.
+    const char* backend() const { return queue_ ? queue_->name() : "none"; }
+
+    void write(std::string_view s) {
+        if (fd_ < 0) {
+            return;
+        }
+        bool issued = false;
+        while (!s.empty()) {
+            size_t n = std::min(s.size(), buffers_.chunk() - fill_);
+            std::memcpy(buffers_[active_] + fill_, s.data(), n);
+            fill_ += n;
+            s.remove_prefix(n);
+            if (fill_ == buffers_.chunk()) {
+                issue();
+                issued = true;
+            }
+        }
+        if (issued) {
+            queue_->submit();
+        }
+    }
+
+    FileWriter& operator<<(std::string_view s) {
+        write(s);
+        return *this;
+    }
+    FileWriter& operator<<(char c) {
+        write(std::string_view(&c, 1));
+        return *this;
+    }
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, char>>>
+    FileWriter& operator<<(T value) {
+        char text[24];
+        auto r = std::to_chars(text, text + sizeof(text), value);
+        write(std::string_view(text, static_cast<size_t>(r.ptr - text)));
+        return *this;
+    }
+
+    // Starts writing what is buffered if no write is in flight, without
+    // waiting. A logger calls this after every line: each line reaches the
+    // kernel promptly, and lines logged during a write go out together in
+    // the next one.
+    void writeBehind() {
+        IoQueue::Completion c;
+        while (inFlight_ > 0 && queue_->poll(c)) {
+            finish(c);
+        }
+        if (fill_ > 0 && inFlight_ == 0 && fd_ >= 0) {
+            issue();
+            queue_->submit();
+        }
+    }
+
+    // Waits until everything written so far is in the file (the page
+    // cache; this is not fsync).
+    void flush() {
+        if (!queue_) {
+            return;
+        }
+        if (fill_ > 0 && fd_ >= 0) {
+            issue();
+        }
+        queue_->submit();
+        while (inFlight_ > 0) {
+            finish(queue_->wait());
+        }
+    }
+
+    void close() {
+        flush();
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    // Queues the active buffer and moves to the next, waiting for it if
+    // its last write is still in flight. O_APPEND ignores the offset, so in
+    // kAppend mode the previous write has to finish first.
+    void issue() {
+        if (append_) {
+            while (inFlight_ > 0) {
+                finish(queue_->wait());
+            }
+        }
+        busy_[active_] = true;
+        sizes_[active_] = fill_;
+        offsets_[active_] = offset_;
+        queue_->write(fd_, buffers_[active_], fill_, offset_, static_cast<int>(active_), active_);
+        ++inFlight_;
+        offset_ += fill_;
+        fill_ = 0;
+        active_ = (active_ + 1) % queue_->depth();
+        while (busy_[active_]) {
+            finish(queue_->wait());
+        }
+    }
+
+    void finish(const IoQueue::Completion& c) {
+        size_t slot = static_cast<size_t>(c.tag);
+        int64_t got = c.result;
+        if (got >= 0 && static_cast<size_t>(got) < sizes_[slot]) {
+            int64_t rest = pwriteFull(fd_, buffers_[slot] + got, sizes_[slot] - static_cast<size_t>(got),
+                                      offsets_[slot] + static_cast<uint64_t>(got));
+            got = rest < 0 ? rest : got + rest;
+        }
+        if (got < 0 && error_ == 0) {
+            error_ = static_cast<int>(-got);
+        }
+        busy_[slot] = false;
+        --inFlight_;
+    }
+
+    int fd_;
+    int error_;  // open()'s errno is read before anything else runs
+    bool append_;
+    uint64_t offset_ = 0;  // where the next buffer goes (ignored with O_APPEND)
+    std::unique_ptr<IoQueue> queue_;
+    Buffers buffers_;
+    size_t active_ = 0;
+    size_t fill_ = 0;
+    unsigned inFlight_ = 0;
+    std::vector<bool> busy_;
+    std::vector<size_t> sizes_;
+    std::vector<uint64_t> offsets_;
+};
+
+}  // namespace aio
@@ -0,0 +1,549 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_io.h"
+
+// Disk-backed B+tree from int keys to strings, for key sets that do not
+// fit in a std::map.
+//
+//   bptree::Builder build("index.bpt");
+//   for (const auto& [key, value] : sorted)       // keys strictly increasing
+//       build.add(key, value);
+//   build.finish();
+//
+//   bptree::Tree tree("index.bpt");
+//   std::optional<std::string> v = tree.find(42);
+//   tree.scan(100, 200, [](int key, std::string_view value) { ... });
+//
+// The file is a run of 4 KiB pages: a header, the leaves in key order, then
+// each internal level up to the root. The tree is bulk loaded from sorted
+// input in that order, in one sequential pass through an aio::FileWriter,
+// with every page packed full, and is read-only afterwards. A leaf holds
+// (key, offset, length) slots growing from the front and the values
+// growing from the back; an internal page holds up to 510 separator keys
+// and 511 child page numbers. A lookup reads one page per level, four for
+// a hundred million short values.
+//
+// Pages are read through a buffer pool of Options::cachePages pages with
+// LRU eviction (0: no limit):
+//   mmap   the file is mapped and a page is a pointer into the mapping;
+//          the pool only decides which pages stay resident.
+//   pread  pages are copied into the pool's own frames.
+// With Options::dropEvicted an evicted page also leaves the OS page cache
+// (madvise and posix_fadvise), so cachePages is the memory actually used,
+// and a tree larger than that behaves as one larger than RAM: every miss
+// is a read from the device.
+//
+// Pages are stored in the host's byte order. A Tree is not thread-safe:
+// find() and scan() update the pool. Page ids, counts and value offsets are
+// checked as pages are read, so a damaged or truncated file makes find()
+// and scan() throw std::runtime_error rather than read out of bounds.
+namespace bptree {
+
+constexpr size_t kPageSize = 4096;
+constexpr size_t kMaxValue = 1000;  // so a leaf always holds at least four entries
+
+namespace detail {
+
+constexpr char kMagic[8] = {'C', 'P', 'P', '3', '0', 'B', 'P', 'T'};
+constexpr uint32_t kVersion = 1;
+constexpr uint16_t kLeaf = 1;
+constexpr uint16_t kInternal = 2;
+constexpr uint32_t kMaxHeight = 16;  // 511^15 leaves; anything taller is damage
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t root;  // 0 for an empty tree
+    uint32_t height;  // levels, leaves included
+    uint64_t keys;
+    uint32_t pages;
+};
+
+struct PageHeader {
+    uint16_t type;
+    uint16_t count;  // slots in a leaf, separators in an internal page
+    uint32_t next;   // the following leaf, 0 after the last
+};
+
+struct Slot {
+    int32_t key;
+    uint16_t offset;
+    uint16_t length;
+};
+
+// Separator keys of an internal page, then its children at a fixed offset.
+constexpr size_t kFanout = (kPageSize - sizeof(PageHeader) - sizeof(uint32_t)) / (sizeof(int32_t) + sizeof(uint32_t));
+constexpr size_t kChildrenAt = sizeof(PageHeader) + kFanout * sizeof(int32_t);
+
+template <class T>
+T load(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+template <class T>
+void store(char* p, const T& value) {
+    std::memcpy(p, &value, sizeof(T));
+}
+
+inline PageHeader headerOf(const char* page) { return load<PageHeader>(page); }
+inline int32_t separator(const char* page, size_t i) { return load<int32_t>(page + sizeof(PageHeader) + i * 4); }
+inline uint32_t child(const char* page, size_t i) { return load<uint32_t>(page + kChildrenAt + i * 4); }
+inline Slot slot(const char* page, size_t i) { return load<Slot>(page + sizeof(PageHeader) + i * sizeof(Slot)); }
+
+constexpr size_t kMaxSlots = (kPageSize - sizeof(PageHeader)) / sizeof(Slot);
+
+}  // namespace detail
+
+// Writes a tree from keys in strictly increasing order. finish() must be
+// called for the file to be readable.
+class Builder {
+public:
+    explicit Builder(const std::string& path) : path_(path), out_(path) {
+        if (!out_) {
+            throw std::system_error(out_.error(), std::generic_category(), "bptree: cannot create " + path);
+        }
+        char header[kPageSize] = {};
+        out_.write(std::string_view(header, kPageSize));  // filled in by finish()
+        startLeaf();
+    }
+
+    Builder(const Builder&) = delete;
+    Builder& operator=(const Builder&) = delete;
+
+    void add(int key, std::string_view value) {
+        if (keys_ != 0 && key <= last_) {
+            throw std::invalid_argument("bptree::Builder: keys must be strictly increasing");
+        }
+        if (value.size() > kMaxValue) {
+            throw std::length_error("bptree::Builder: value of " + std::to_string(value.size()) + " bytes");
+        }
+        if (slotsEnd_ + sizeof(detail::Slot) + value.size() > valuesBegin_) {
+            writeLeaf(pages_ + 1);
+            startLeaf();
+        }
+        if (count_ == 0) {
+            level_.emplace_back(key, pages_);
+        }
+        valuesBegin_ -= value.size();
+        std::memcpy(leaf_ + valuesBegin_, value.data(), value.size());
+        detail::store(leaf_ + slotsEnd_, detail::Slot{key, static_cast<uint16_t>(valuesBegin_),
+                                                      static_cast<uint16_t>(value.size())});
+        slotsEnd_ += sizeof(detail::Slot);
+        ++count_;
+        ++keys_;
+        last_ = key;
+    }
+
+    void finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        uint32_t height = 0;
+        if (count_ > 0) {
+            writeLeaf(0);
+            height = 1;
+        }
+        // Each level up holds the first key and page of every page below.
+        while (level_.size() > 1) {
+            std::vector<std::pair<int32_t, uint32_t>> below;
+            below.swap(level_);
+            for (size_t first = 0; first < below.size(); first += detail::kFanout + 1) {
+                size_t n = std::min(detail::kFanout + 1, below.size() - first);
+                char page[kPageSize] = {};
+                detail::store(page, detail::PageHeader{detail::kInternal, static_cast<uint16_t>(n - 1), 0});
+                for (size_t i = 0; i < n; ++i) {
+                    if (i > 0) {
+                        detail::store(page + sizeof(detail::PageHeader) + (i - 1) * 4, below[first + i].first);
+                    }
+                    detail::store(page + detail::kChildrenAt + i * 4, below[first + i].second);
+                }
+                level_.emplace_back(below[first].first, pages_);
+                writePage(page);
+            }
+            ++height;
+        }
+        out_.close();
+        if (out_.error() != 0) {
+            throw std::system_error(out_.error(), std::generic_category(), "bptree: cannot write " + path_);
+        }
+
+        detail::FileHeader header{};
+        std::memcpy(header.magic, detail::kMagic, sizeof(header.magic));
+        header.version = detail::kVersion;
+        header.pageSize = kPageSize;
+        header.root = level_.empty() ? 0 : level_.front().second;
+        header.height = height;
+        header.keys = keys_;
+        header.pages = pages_;
+        char page[kPageSize] = {};
+        detail::store(page, header);
+        int fd = ::open(path_.c_str(), O_WRONLY | O_CLOEXEC);
+        int64_t written = fd < 0 ? -errno : aio::pwriteFull(fd, page, kPageSize, 0);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (written != static_cast<int64_t>(kPageSize)) {
+            throw std::system_error(written < 0 ? static_cast<int>(-written) : EIO, std::generic_category(),
+                                    "bptree: cannot write the header of " + path_);
+        }
+    }
+
+private:
+    void startLeaf() {
+        std::memset(leaf_, 0, kPageSize);
+        count_ = 0;
+        slotsEnd_ = sizeof(detail::PageHeader);
+        valuesBegin_ = kPageSize;
+    }
+
+    void writeLeaf(uint32_t next) {
+        detail::store(leaf_, detail::PageHeader{detail::kLeaf, count_, next});
+        writePage(leaf_);
+    }
+
+    void writePage(const char* page) {
+        out_.write(std::string_view(page, kPageSize));
+        ++pages_;
+    }
+
+    std::string path_;
+    aio::FileWriter out_;
+    char leaf_[kPageSize];
+    uint16_t count_ = 0;
+    size_t slotsEnd_ = 0;
+    size_t valuesBegin_ = 0;
+    uint32_t pages_ = 1;  // the header is page 0
+    uint64_t keys_ = 0;
+    int last_ = 0;
+    bool finished_ = false;
+    std::vector<std::pair<int32_t, uint32_t>> level_;  // first key and page of each page on the level
+};
+
+struct Options {
+    bool mmap = true;
+    size_t cachePages = 0;     // buffer pool size; 0 keeps every page
+    bool dropEvicted = false;  // evicted pages leave the OS page cache too
+};
+
+struct PoolStats {
+    uint64_t reads = 0;   // page accesses
+    uint64_t misses = 0;  // accesses that loaded the page; 0 for mmap without a limit, where the OS decides
+    size_t resident = 0;  // pages held
+};
+
+class Tree {
+public:
+    explicit Tree(const std::string& path, const Options& options = {})
+        : options_(options), fd_(::open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "bptree: cannot open " + path);
+        }
+        char page[kPageSize];
+        struct stat st;
+        if (aio::preadFull(fd_, page, kPageSize, 0) != static_cast<int64_t>(kPageSize) || ::fstat(fd_, &st) != 0 ||
+            std::memcmp(page, detail::kMagic, sizeof(detail::kMagic)) != 0 ||
+            (header_ = detail::load<detail::FileHeader>(page)).version != detail::kVersion ||
+            header_.pageSize != kPageSize || static_cast<uint64_t>(st.st_size) < uint64_t(header_.pages) * kPageSize ||
+            header_.root >= header_.pages || header_.height > detail::kMaxHeight ||
+            (header_.root != 0 && header_.height == 0)) {
+            ::close(fd_);
+            throw std::runtime_error("bptree: " + path + " is not a B+tree file");
+        }
+
+        size_t capacity = options_.cachePages == 0 ? header_.pages : std::min<size_t>(options_.cachePages, header_.pages);
+        if (options_.mmap) {
+            bytes_ = uint64_t(header_.pages) * kPageSize;
+            void* base = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd_, 0);
+            if (base == MAP_FAILED) {
+                int err = errno;
+                ::close(fd_);
+                throw std::system_error(err, std::generic_category(), "bptree: cannot map " + path);
+            }
+            base_ = static_cast<char*>(base);
+            if (options_.cachePages == 0) {
+                return;  // the OS manages residency; no pool needed
+            }
+        } else {
+            frames_.reset(static_cast<char*>(std::aligned_alloc(kPageSize, capacity * kPageSize)));
+            if (!frames_) {
+                ::close(fd_);
+                throw std::bad_alloc();
+            }
+        }
+        // A bounded pool reads pages at random; readahead would only fill
+        // memory the pool does not count.
+        if (options_.cachePages != 0) {
+            ::posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM);
+            if (base_) {
+                ::madvise(base_, bytes_, MADV_RANDOM);
+            }
+        }
+        frameOf_.assign(header_.pages, kNone);
+        lru_.resize(capacity + 1);
+        lru_[kHead].prev = lru_[kHead].next = kHead;
+    }
+
+    ~Tree() {
+        if (base_) {
+            ::munmap(base_, bytes_);
+        }
+        ::close(fd_);
+    }
+
+    Tree(const Tree&) = delete;
+    Tree& operator=(const Tree&) = delete;
+
+    uint64_t size() const { return header_.keys; }
+    uint32_t height() const { return header_.height; }
+    uint32_t pages() const { return header_.pages; }
+
+    std::optional<std::string> find(int key) const {
+        if (header_.root == 0) {
+            return std::nullopt;
+        }
+        uint32_t id = leafFor(key);
+        const char* leaf = node(id, detail::kLeaf);
+        size_t i = lowerBound(leaf, key);
+        if (i == detail::headerOf(leaf).count || detail::slot(leaf, i).key != key) {
+            return std::nullopt;
+        }
+        detail::Slot s = valueSlot(leaf, i, id);
+        return std::string(leaf + s.offset, s.length);
+    }
+
+    // Calls f(key, value) for every key in [from, to] in order and returns
+    // how many there were. value points into a page: it is valid during the
+    // call only, and f must not use the tree.
+    template <class F>
+    size_t scan(int from, int to, F&& f) const {
+        if (header_.root == 0 || from > to) {
+            return 0;
+        }
+        size_t n = 0;
+        uint32_t id = leafFor(from);
+        const char* leaf = node(id, detail::kLeaf);
+        for (size_t i = lowerBound(leaf, from);;) {
+            detail::PageHeader h = detail::headerOf(leaf);
+            for (; i < h.count; ++i) {
+                detail::Slot s = valueSlot(leaf, i, id);
+                if (s.key > to) {
+                    return n;
+                }
+                f(static_cast<int>(s.key), std::string_view(leaf + s.offset, s.length));
+                ++n;
+            }
+            if (h.next == 0) {
+                return n;
+            }
+            if (h.next <= id) {
+                corrupt(id);  // leaves are written in order; this would loop
+            }
+            id = h.next;
+            leaf = node(id, detail::kLeaf);
+            i = 0;
+        }
+    }
+
+    PoolStats poolStats() const {
+        PoolStats s = stats_;
+        s.resident = resident_;
+        return s;
+    }
+
+    // Empties the pool and, with dropEvicted or a pool-less mapping, drops
+    // the file from the OS page cache, so the next reads go to the device.
+    void dropCache() const {
+        if (!lru_.empty()) {
+            for (uint32_t f = 1; f <= resident_; ++f) {
+                release(f);
+            }
+            resident_ = 0;
+            lru_[kHead].prev = lru_[kHead].next = kHead;
+        }
+        if (base_) {
+            ::madvise(base_, bytes_, MADV_DONTNEED);
+        }
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr uint32_t kHead = 0;  // LRU list sentinel; frames are 1..capacity
+
+    struct Frame {
+        uint32_t page = kNone;
+        uint32_t prev = kHead, next = kHead;
+    };
+
+    uint32_t leafFor(int key) const {
+        uint32_t id = header_.root;
+        for (uint32_t level = 1; level < header_.height; ++level) {
+            const char* p = node(id, detail::kInternal);
+            size_t lo = 0, hi = detail::headerOf(p).count;  // upper bound among the separators
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (key < detail::separator(p, mid)) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            id = detail::child(p, lo);
+        }
+        return id;
+    }
+
+    static size_t lowerBound(const char* leaf, int key) {
+        size_t lo = 0, hi = detail::headerOf(leaf).count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (detail::slot(leaf, mid).key < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    [[noreturn]] static void corrupt(uint32_t id) {
+        throw std::runtime_error("bptree: page " + std::to_string(id) + " is damaged");
+    }
+
+    // Page id as a leaf or an internal page, with its id, type and count
+    // checked against the file.
+    const char* node(uint32_t id, uint16_t type) const {
+        if (id == 0 || id >= header_.pages) {
+            corrupt(id);
+        }
+        const char* p = page(id);
+        detail::PageHeader h = detail::headerOf(p);
+        if (h.type != type || h.count > (type == detail::kLeaf ? detail::kMaxSlots : detail::kFanout)) {
+            corrupt(id);
+        }
+        return p;
+    }
+
+    // Slot i of leaf id, whose value must lie within the page.
+    static detail::Slot valueSlot(const char* leaf, size_t i, uint32_t id) {
+        detail::Slot s = detail::slot(leaf, i);
+        if (size_t(s.offset) + s.length > kPageSize) {
+            corrupt(id);
+        }
+        return s;
+    }
+
+    // The page's bytes, valid until the next call. id is in range.
+    const char* page(uint32_t id) const {
+        ++stats_.reads;
+        if (lru_.empty()) {
+            return base_ + uint64_t(id) * kPageSize;
+        }
+        uint32_t f = frameOf_[id];
+        if (f != kNone) {
+            unlink(f);
+            pushFront(f);
+            return data(f);
+        }
+        ++stats_.misses;
+        if (resident_ + 1 < lru_.size()) {
+            f = static_cast<uint32_t>(++resident_);
+        } else {
+            f = lru_[kHead].prev;
+            release(f);
+        }
+        lru_[f].page = id;
+        frameOf_[id] = f;
+        pushFront(f);
+        if (!base_) {
+            int64_t got = aio::preadFull(fd_, data(f), kPageSize, uint64_t(id) * kPageSize);
+            if (got != static_cast<int64_t>(kPageSize)) {
+                frameOf_[id] = kNone;
+                lru_[f].page = kNone;
+                unlink(f);
+                pushBack(f);  // reused first
+                throw std::system_error(got < 0 ? static_cast<int>(-got) : EIO, std::generic_category(),
+                                        "bptree: page read");
+            }
+        }
+        return data(f);
+    }
+
+    char* data(uint32_t f) const {
+        return base_ ? base_ + uint64_t(lru_[f].page) * kPageSize : frames_.get() + uint64_t(f - 1) * kPageSize;
+    }
+
+    void unlink(uint32_t f) const {
+        lru_[lru_[f].prev].next = lru_[f].next;
+        lru_[lru_[f].next].prev = lru_[f].prev;
+    }
+
+    void pushFront(uint32_t f) const {
+        lru_[f].prev = kHead;
+        lru_[f].next = lru_[kHead].next;
+        lru_[lru_[kHead].next].prev = f;
+        lru_[kHead].next = f;
+    }
+
+    void pushBack(uint32_t f) const {
+        lru_[f].next = kHead;
+        lru_[f].prev = lru_[kHead].prev;
+        lru_[lru_[kHead].prev].next = f;
+        lru_[kHead].prev = f;
+    }
+
+    // Unlinks frame f and forgets its page, for reuse.
+    void release(uint32_t f) const {
+        uint32_t id = lru_[f].page;
+        unlink(f);
+        if (id == kNone) {
+            return;
+        }
+        if (options_.dropEvicted) {
+            if (base_) {
+                ::madvise(base_ + uint64_t(id) * kPageSize, kPageSize, MADV_DONTNEED);
+            }
+            ::posix_fadvise(fd_, static_cast<off_t>(uint64_t(id) * kPageSize), kPageSize, POSIX_FADV_DONTNEED);
+        }
+        frameOf_[id] = kNone;
+        lru_[f].page = kNone;
+    }
+
+    struct FreeDeleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+
+    Options options_;
+    int fd_;
+    detail::FileHeader header_{};
+    char* base_ = nullptr;  // the mapping, with Options::mmap
+    uint64_t bytes_ = 0;
+    std::unique_ptr<char[], FreeDeleter> frames_;  // page buffers, without it
+    mutable std::vector<uint32_t> frameOf_;        // page -> frame, or kNone
+    mutable std::vector<Frame> lru_;               // [0] is the list head, most recent first
+    mutable size_t resident_ = 0;
+    mutable PoolStats stats_;
+};
+
+}  // namespace bptree
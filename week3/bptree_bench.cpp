@@ -0,0 +1,293 @@
+// Point and range lookups in the disk-backed B+tree (bptree.h) against
+// day20's std::map, with the file in the page cache and with a memory
+// budget of a tenth of the file. The second case stands in for a data set
+// ten times larger than RAM: the buffer pool holds a tenth of the pages
+// and evicted pages are dropped from the page cache as well, so each miss
+// reads the device, as it would if the pages had never fit.
+// Build: g++ -std=c++17 -O2 bptree_bench.cpp -o bptree_bench -pthread
+// Usage: ./bptree_bench [keys] [dir] [--filter=pread] [--samples=n] [--min-time=ms] [--json]
+//        (default 4000000 keys in the temp directory)
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "bptree.h"
+
+using Clock = std::chrono::steady_clock;
+
+std::string valueOf(int key) {
+    return "value-" + std::to_string(key);
+}
+
+void build(const std::string& path, const std::map<int, std::string>& map) {
+    bptree::Builder b(path);
+    for (const auto& [key, value] : map) {
+        b.add(key, value);
+    }
+    b.finish();
+}
+
+// Every key, some absent ones and random ranges, against the std::map the
+// tree was built from, under each way of reading pages.
+bool checkTree(const std::string& path) {
+    std::mt19937 rng(3);
+    std::map<int, std::string> map;
+    for (int i = 0; i < 60000; ++i) {
+        int key = static_cast<int>(rng() % 2000000) - 1000000;
+        map[key] = std::string(rng() % 3 == 0 ? rng() % 200 : rng() % 12, static_cast<char>('a' + key % 26)) +
+                   std::to_string(key);
+    }
+    build(path, map);
+    bptree::Options options[4];
+    options[1].cachePages = 3;
+    options[1].dropEvicted = true;
+    options[2].mmap = false;
+    options[3].mmap = false;
+    options[3].cachePages = 2;
+    for (const bptree::Options& o : options) {
+        bptree::Tree tree(path, o);
+        if (tree.size() != map.size() || tree.height() < 3) {
+            return bench::fail("tree holds " + std::to_string(tree.size()) + " keys in " +
+                               std::to_string(tree.height()) + " levels");
+        }
+        for (const auto& [key, value] : map) {
+            if (tree.find(key) != value) {
+                return bench::fail("key " + std::to_string(key) + " lost");
+            }
+        }
+        for (int i = 0; i < 20000; ++i) {
+            int key = static_cast<int>(rng() % 2200000) - 1100000;
+            if (tree.find(key).has_value() != (map.count(key) == 1)) {
+                return bench::fail("find(" + std::to_string(key) + ") disagrees with the map");
+            }
+        }
+        for (int i = 0; i < 300; ++i) {
+            int from = static_cast<int>(rng() % 2200000) - 1100000;
+            int to = from + static_cast<int>(rng() % (i % 10 == 0 ? 400000 : 2000));
+            std::vector<std::pair<int, std::string>> got, expected(map.lower_bound(from), map.upper_bound(to));
+            size_t n = tree.scan(from, to, [&got](int key, std::string_view value) {
+                got.emplace_back(key, std::string(value));
+            });
+            if (got != expected || n != got.size()) {
+                return bench::fail("scan(" + std::to_string(from) + ", " + std::to_string(to) + ") returned " +
+                                   std::to_string(got.size()) + " entries, expected " +
+                                   std::to_string(expected.size()));
+            }
+        }
+        if (o.cachePages != 0 && tree.poolStats().resident > o.cachePages) {
+            return bench::fail("the buffer pool outgrew its budget");
+        }
+        tree.dropCache();
+        if (tree.find(map.begin()->first) != map.begin()->second) {
+            return bench::fail("find after dropCache()");
+        }
+    }
+
+    // Damaged files: a bad page id, count or value offset read from the
+    // file throws instead of reading past the pages.
+    std::string good;
+    {
+        std::ifstream in(path, std::ios::binary);
+        good.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint32_t root = bptree::detail::load<bptree::detail::FileHeader>(good.data()).root;
+    uint32_t pageCount = bptree::detail::load<bptree::detail::FileHeader>(good.data()).pages;
+    const size_t leaf = bptree::kPageSize;  // the first leaf is page 1
+    struct Damage {
+        const char* what;
+        size_t at;
+        uint32_t value;
+    };
+    const Damage damages[] = {
+        {"a child past the end", root * bptree::kPageSize + bptree::detail::kChildrenAt, 0xffffff},
+        {"a child pointing at the header", root * bptree::kPageSize + bptree::detail::kChildrenAt, 0},
+        {"a leaf count past the page", leaf, bptree::detail::kLeaf | 60000u << 16},
+        {"a leaf that is not a leaf", leaf, bptree::detail::kInternal | 1u << 16},
+        {"a value past the page", leaf + sizeof(bptree::detail::PageHeader) + 4, 4000u | 1000u << 16},
+        {"a leaf chain that loops", leaf + 4, 1},
+        {"a root past the end", offsetof(bptree::detail::FileHeader, root), pageCount},
+    };
+    for (const Damage& d : damages) {
+        std::string bad = good;
+        std::memcpy(&bad[d.at], &d.value, sizeof(d.value));
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bad;
+        for (const bptree::Options& o : options) {
+            try {
+                bptree::Tree tree(path, o);
+                tree.find(map.begin()->first);
+                tree.scan(INT32_MIN, INT32_MAX, [](int, std::string_view) {});
+                return bench::fail(std::string(d.what) + " went unnoticed");
+            } catch (const std::runtime_error&) {
+            }
+        }
+    }
+
+    // Edge cases: nothing, one key, bad input.
+    build(path, {});
+    if (bptree::Tree(path).find(0) || bptree::Tree(path).scan(-10, 10, [](int, std::string_view) {}) != 0) {
+        return bench::fail("an empty tree found something");
+    }
+    build(path, {{7, "seven"}});
+    if (bptree::Tree(path).find(7) != "seven" || bptree::Tree(path).find(8)) {
+        return bench::fail("a one-key tree");
+    }
+    bool threw = false;
+    try {
+        bptree::Builder b(path);
+        b.add(2, "x");
+        b.add(1, "y");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    try {
+        bptree::Builder b(path);
+        b.add(1, std::string(bptree::kMaxValue + 1, 'x'));
+        threw = false;
+    } catch (const std::length_error&) {
+    }
+    try {
+        bptree::Tree unfinished(path);
+        threw = false;
+    } catch (const std::runtime_error&) {
+    }
+    return threw || bench::fail("unsorted keys, an oversized value or an unfinished file went unnoticed");
+}
+
+struct Row {
+    std::string name;
+    double pointNs;
+    double rangeUs;
+    double missesPerLookup;
+    double residentMiB;
+};
+
+// Point lookups at random keys (a third exist) and 100-key range scans,
+// each call one iteration of the runner. ops counts the calls, for the
+// miss rate.
+template <typename Find, typename Scan>
+Row measure(bench::Runner& runner, const std::string& name, int maxKey, Find find, Scan scan, size_t& ops) {
+    std::mt19937 rng(11);
+    size_t found = 0, scanned = 0;
+    runner.run(name + ", point", [&] {
+        found += find(static_cast<int>(rng() % static_cast<unsigned>(maxKey))).has_value();
+        ++ops;
+    });
+    runner.run(name + ", range", [&] {
+        int from = static_cast<int>(rng() % static_cast<unsigned>(maxKey));
+        scanned += scan(from, from + 299);
+        ++ops;
+    });
+    const bench::Result* point = runner.result(name + ", point");
+    const bench::Result* range = runner.result(name + ", range");
+    if ((point && found == 0) || (range && scanned == 0)) {
+        std::abort();
+    }
+    return Row{name, point ? point->medianNs : 0, range ? range->medianNs / 1000 : 0, 0, 0};
+}
+
+int main(int argc, char* argv[]) {
+    bench::Runner runner(argc, argv);
+    const std::vector<std::string>& args = runner.args();
+    int keys = args.size() > 0 ? std::stoi(args[0]) : 4000000;
+    std::filesystem::path dir =
+        args.size() > 1 ? std::filesystem::path(args[1]) : std::filesystem::temp_directory_path();
+    std::string path = (dir / ("bptree_bench." + std::to_string(::getpid()) + ".bpt")).string();
+
+    if (!checkTree(path)) {
+        std::filesystem::remove(path);
+        return 1;
+    }
+    std::cout << "B+tree lookups, scans, buffer pool eviction and bulk-load checks pass." << std::endl;
+
+    // Keys 0, 3, 6, ...: two random keys in three are absent.
+    int maxKey = keys * 3;
+    auto start = Clock::now();
+    {
+        bptree::Builder b(path);
+        for (int key = 0; key < maxKey; key += 3) {
+            b.add(key, valueOf(key));
+        }
+        b.finish();
+    }
+    double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    uint64_t fileBytes = std::filesystem::file_size(path);
+
+    std::map<int, std::string> map;
+    for (int key = 0; key < maxKey; key += 3) {
+        map.emplace_hint(map.end(), key, valueOf(key));
+    }
+
+    size_t pages = bptree::Tree(path).pages();
+    std::cout << "\n" << keys << " keys, " << fileBytes / (1024 * 1024) << " MiB file of " << pages << " pages, "
+              << bptree::Tree(path).height() << " levels, bulk loaded in " << std::fixed << std::setprecision(0)
+              << buildMs << " ms\n"
+              << "point lookups at random keys and 100-key range scans\n"
+              << std::endl;
+
+    std::vector<Row> rows;
+    size_t mapOps = 0;
+    rows.push_back(measure(runner, "std::map", maxKey, [&map](int key) {
+        auto it = map.find(key);
+        return it != map.end() ? std::optional<std::string>(it->second) : std::nullopt;
+    }, [&map](int from, int to) {
+        size_t n = 0;
+        for (auto it = map.lower_bound(from); it != map.end() && it->first <= to; ++it) {
+            n += it->second.size() != 0;
+        }
+        return n;
+    }, mapOps));
+
+    // Cold rows start with the file out of the page cache; warm ones read
+    // it all first, into the page cache and the pool.
+    auto row = [&](const char* name, bptree::Options options, bool cold) {
+        bptree::Tree tree(path, options);
+        if (cold) {
+            tree.dropCache();
+        } else {
+            tree.scan(0, maxKey, [](int, std::string_view) {});
+        }
+        bptree::PoolStats before = tree.poolStats();
+        size_t ops = 0;
+        Row r = measure(runner, name, maxKey, [&tree](int key) { return tree.find(key); },
+                        [&tree](int from, int to) { return tree.scan(from, to, [](int, std::string_view) {}); }, ops);
+        bptree::PoolStats after = tree.poolStats();
+        r.missesPerLookup = ops ? static_cast<double>(after.misses - before.misses) / static_cast<double>(ops) : 0;
+        r.residentMiB = static_cast<double>(after.resident * bptree::kPageSize) / (1024 * 1024);
+        rows.push_back(r);
+    };
+    bptree::Options mmapCached;
+    bptree::Options preadCached;
+    preadCached.mmap = false;
+    bptree::Options mmapTenth;
+    mmapTenth.cachePages = pages / 10;
+    mmapTenth.dropEvicted = true;
+    bptree::Options preadTenth = mmapTenth;
+    preadTenth.mmap = false;
+    row("mmap, page cache", mmapCached, false);
+    row("pread pool, page cache", preadCached, false);
+    row("mmap, 1/10 memory", mmapTenth, true);
+    row("pread pool, 1/10 memory", preadTenth, true);
+    std::filesystem::remove(path);
+
+    std::cout << "\n" << std::setw(30) << "" << std::setw(12) << "point ns" << std::setw(12) << "range us"
+              << std::setw(14) << "misses/op" << std::setw(14) << "resident MiB" << std::endl;
+    for (const Row& r : rows) {
+        std::cout << std::setw(30) << r.name << std::setprecision(0) << std::setw(12) << r.pointNs
+                  << std::setprecision(1) << std::setw(12) << r.rangeUs << std::setprecision(2) << std::setw(14)
+                  << r.missesPerLookup << std::setprecision(1) << std::setw(14) << r.residentMiB << std::endl;
+    }
+    return runner.finish();
+}
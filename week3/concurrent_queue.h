@@ -0,0 +1,439 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Bounded lock-free queues.
+//
+//   MpmcQueue<Job> q(1024);     // any number of producers and consumers
+//   q.push(job);                // blocks while full
+//   q.pop(job);                 // blocks while empty
+//   if (q.tryPush(job)) ...     // never block
+//   size_t n = q.tryPopBatch(jobs, 32);
+//
+// MpmcQueue is Dmitry Vyukov's ring: every cell has a sequence number that
+// says whether it is free or full in the current lap. Producers contend
+// only on the tail and consumers only on the head, with one CAS per
+// operation or per batch. SpscQueue is the single-producer,
+// single-consumer ring. It needs no CAS, just one release store per
+// operation or batch.
+//
+// Capacities are rounded up to a power of two. Blocking calls spin
+// briefly, then sleep on a futex. The non-blocking calls never sleep, but
+// they still wake sleepers, so the two kinds can be mixed freely.
+//
+// TripleBuffer, at the end, is the queue of length one that overwrites:
+// it hands the latest value from one thread to another.
+namespace queue_detail {
+
+constexpr size_t kCacheLine = 64;
+constexpr int kSpins = 64;
+
+inline size_t roundUpCapacity(size_t n) {
+    size_t c = 2;
+    while (c < n) {
+        c <<= 1;
+    }
+    return c;
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    word.wait(expected, std::memory_order_acquire);
+#endif
+}
+
+inline void futexWakeAll(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+    word.notify_all();
+#endif
+}
+
+// Lock-free sleep and wake for one condition ("not empty", "not full").
+// The low bit of the state says that someone may be asleep; the rest is an
+// epoch that every wake-up advances. A waiter sets the bit, re-checks its
+// condition, then sleeps while the state is unchanged. notifyAll() makes a
+// system call only when the bit is set, and clears it, so a burst of
+// pushes wakes the sleepers once.
+class EventCount {
+public:
+    uint32_t prepareWait() {
+        uint32_t key = state_.fetch_or(1, std::memory_order_seq_cst) | 1;
+        // Pairs with notifyAll(): either the waiter's re-check sees the new
+        // item, or the notifier sees the bit.
+#if !defined(__SANITIZE_THREAD__)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+        return key;
+    }
+
+    void wait(uint32_t key) { futexWait(state_, key); }
+
+    void notifyAll() {
+#if defined(__SANITIZE_THREAD__)
+        // TSan does not model fences. An RMW gives the same guarantee, but
+        // it would make every notifier write the shared line.
+        uint32_t state = state_.fetch_or(0, std::memory_order_seq_cst);
+#else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t state = state_.load(std::memory_order_relaxed);
+#endif
+        // +1 clears the bit and advances the epoch. If the CAS fails,
+        // another notifier has already done both.
+        if ((state & 1) != 0 && state_.compare_exchange_strong(state, state + 1, std::memory_order_relaxed)) {
+            futexWakeAll(state_);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> state_{0};
+};
+
+// Retries attempt() (which returns a bool or a count) until it succeeds.
+// It spins first, then sleeps on event between attempts. On a single CPU
+// the other side cannot run while we spin, so it sleeps right away.
+template <typename Attempt>
+auto blockOn(EventCount& event, Attempt attempt) {
+    static const int spins = std::thread::hardware_concurrency() > 1 ? kSpins : 0;
+    for (int i = 0; i < spins; ++i) {
+        if (auto r = attempt()) {
+            return r;
+        }
+        cpuRelax();
+    }
+    for (;;) {
+        uint32_t key = event.prepareWait();
+        if (auto r = attempt()) {
+            return r;
+        }
+        event.wait(key);
+        if (auto r = attempt()) {
+            return r;
+        }
+    }
+}
+
+template <typename T>
+struct Slot {
+    T* get() { return std::launder(reinterpret_cast<T*>(bytes)); }
+    alignas(T) unsigned char bytes[sizeof(T)];
+};
+
+}  // namespace queue_detail
+
+template <typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity)
+        : mask_(queue_detail::roundUpCapacity(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcQueue() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (size_t pos = head_.load(std::memory_order_relaxed); pos != tail; ++pos) {
+            cells_[pos & mask_].slot.get()->~T();
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Elements in the queue at some recent moment.
+    size_t sizeApprox() const {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    // Leaves value untouched and returns false if the queue is full.
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t pos;
+        if (claim(tail_, 0, 1, pos) == 0) {
+            return false;
+        }
+        Cell& cell = cells_[pos & mask_];
+        new (cell.slot.bytes) T(std::forward<U>(value));
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        notEmpty_.notifyAll();
+        return true;
+    }
+
+    bool tryPop(T& out) { return tryPopBatch(&out, 1) == 1; }
+
+    // Moves up to n items from items[0..] into the queue, in order, and
+    // returns how many were taken. A batch costs a single CAS.
+    size_t tryPushBatch(T* items, size_t n) {
+        size_t pos;
+        size_t k = claim(tail_, 0, n, pos);
+        for (size_t i = 0; i < k; ++i) {
+            Cell& cell = cells_[(pos + i) & mask_];
+            new (cell.slot.bytes) T(std::move(items[i]));
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        if (k > 0) {
+            notEmpty_.notifyAll();
+        }
+        return k;
+    }
+
+    // Moves up to n items into out[0..] and returns how many.
+    size_t tryPopBatch(T* out, size_t n) {
+        size_t pos;
+        size_t k = claim(head_, 1, n, pos);
+        for (size_t i = 0; i < k; ++i) {
+            Cell& cell = cells_[(pos + i) & mask_];
+            T* item = cell.slot.get();
+            out[i] = std::move(*item);
+            item->~T();
+            cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        if (k > 0) {
+            notFull_.notifyAll();
+        }
+        return k;
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        queue_detail::blockOn(notFull_, [&] { return tryPush(std::forward<U>(value)); });
+    }
+
+    void pop(T& out) {
+        queue_detail::blockOn(notEmpty_, [&] { return tryPop(out); });
+    }
+
+    // Pushes all n items, blocking while the queue is full.
+    void pushBatch(T* items, size_t n) {
+        for (size_t done = 0; done < n;) {
+            done += queue_detail::blockOn(notFull_, [&] { return tryPushBatch(items + done, n - done); });
+        }
+    }
+
+    // Blocks until at least one item is available, then pops up to n.
+    size_t popBatch(T* out, size_t n) {
+        return queue_detail::blockOn(notEmpty_, [&] { return tryPopBatch(out, n); });
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        queue_detail::Slot<T> slot;
+    };
+
+    // Claims up to n consecutive cells from position on. A cell can be
+    // claimed when its sequence is its position + ready: 0 for producers
+    // (free) and 1 for consumers (full). Returns the count, 0 if the queue
+    // is full (empty for consumers), and the first position in first.
+    size_t claim(std::atomic<size_t>& position, size_t ready, size_t n, size_t& first) {
+        size_t pos = position.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t k = 0;
+            while (k < n && cells_[(pos + k) & mask_].sequence.load(std::memory_order_acquire) == pos + k + ready) {
+                ++k;
+            }
+            if (k > 0) {
+                if (position.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                    first = pos;
+                    return k;
+                }
+                continue;  // pos now holds the current position
+            }
+            size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+            if (static_cast<std::ptrdiff_t>(seq - (pos + ready)) < 0) {
+                return 0;  // the cell is a lap behind
+            }
+            pos = position.load(std::memory_order_relaxed);  // someone else took pos
+        }
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(queue_detail::kCacheLine) std::atomic<size_t> tail_{0};
+    alignas(queue_detail::kCacheLine) std::atomic<size_t> head_{0};
+    alignas(queue_detail::kCacheLine) queue_detail::EventCount notEmpty_;
+    queue_detail::EventCount notFull_;
+};
+
+// Exactly one thread may push and one (other) thread may pop.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : mask_(queue_detail::roundUpCapacity(capacity) - 1), slots_(new queue_detail::Slot<T>[mask_ + 1]) {}
+
+    ~SpscQueue() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (size_t pos = head_.load(std::memory_order_relaxed); pos != tail; ++pos) {
+            slots_[pos & mask_].get()->~T();
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    size_t sizeApprox() const {
+        return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+    }
+
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ > mask_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ > mask_) {
+                return false;
+            }
+        }
+        new (slots_[tail & mask_].bytes) T(std::forward<U>(value));
+        tail_.store(tail + 1, std::memory_order_release);
+        notEmpty_.notifyAll();
+        return true;
+    }
+
+    bool tryPop(T& out) { return tryPopBatch(&out, 1) == 1; }
+
+    size_t tryPushBatch(T* items, size_t n) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t room = mask_ + 1 - (tail - headCache_);
+        if (room < n) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            room = mask_ + 1 - (tail - headCache_);
+        }
+        size_t k = room < n ? room : n;
+        for (size_t i = 0; i < k; ++i) {
+            new (slots_[(tail + i) & mask_].bytes) T(std::move(items[i]));
+        }
+        if (k > 0) {
+            tail_.store(tail + k, std::memory_order_release);
+            notEmpty_.notifyAll();
+        }
+        return k;
+    }
+
+    size_t tryPopBatch(T* out, size_t n) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t ready = tailCache_ - head;
+        if (ready < n) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            ready = tailCache_ - head;
+        }
+        size_t k = ready < n ? ready : n;
+        for (size_t i = 0; i < k; ++i) {
+            T* item = slots_[(head + i) & mask_].get();
+            out[i] = std::move(*item);
+            item->~T();
+        }
+        if (k > 0) {
+            head_.store(head + k, std::memory_order_release);
+            notFull_.notifyAll();
+        }
+        return k;
+    }
+
+    template <typename U>
+    void push(U&& value) {
+        queue_detail::blockOn(notFull_, [&] { return tryPush(std::forward<U>(value)); });
+    }
+
+    void pop(T& out) {
+        queue_detail::blockOn(notEmpty_, [&] { return tryPop(out); });
+    }
+
+    void pushBatch(T* items, size_t n) {
+        for (size_t done = 0; done < n;) {
+            done += queue_detail::blockOn(notFull_, [&] { return tryPushBatch(items + done, n - done); });
+        }
+    }
+
+    size_t popBatch(T* out, size_t n) {
+        return queue_detail::blockOn(notEmpty_, [&] { return tryPopBatch(out, n); });
+    }
+
+private:
+    const size_t mask_;
+    std::unique_ptr<queue_detail::Slot<T>[]> slots_;
+    // Each side caches the other side's index and rereads it only when
+    // the cached value says full (or empty). The event a side notifies
+    // shares its line: it is written only by a sleeper on the other side.
+    alignas(queue_detail::kCacheLine) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+    queue_detail::EventCount notEmpty_;
+    alignas(queue_detail::kCacheLine) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+    queue_detail::EventCount notFull_;
+};
+
+// The latest value from one writer to one reader, lock-free. Three slots:
+// the writer fills its own and swaps it into the middle; the reader swaps
+// the middle for its own when a new value is there. Values the reader
+// never got to are dropped, so a slow reader sees the newest one, not a
+// backlog (a renderer behind a simulation, for example).
+//
+//   buffer.writeSlot() = state;       // writer
+//   buffer.publish();
+//   buffer.wait();                    // reader: blocks for a new value
+//   use(buffer.readSlot());
+template <typename T>
+class TripleBuffer {
+public:
+    T& writeSlot() { return slots_[write_]; }
+
+    void publish() {
+        write_ = static_cast<uint8_t>(middle_.exchange(static_cast<uint8_t>(write_ | kFresh), std::memory_order_acq_rel) & kIndex);
+        published_.notifyAll();
+    }
+
+    // Takes the newest value, if there is one the reader has not seen.
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) {
+            return false;
+        }
+        read_ = static_cast<uint8_t>(middle_.exchange(read_, std::memory_order_acq_rel) & kIndex);
+        return true;
+    }
+
+    void wait() {
+        queue_detail::blockOn(published_, [this] { return update(); });
+    }
+
+    const T& readSlot() const { return slots_[read_]; }
+
+private:
+    static constexpr uint8_t kIndex = 3;
+    static constexpr uint8_t kFresh = 4;
+
+    T slots_[3] = {};
+    alignas(queue_detail::kCacheLine) uint8_t write_ = 0;
+    alignas(queue_detail::kCacheLine) uint8_t read_ = 2;
+    alignas(queue_detail::kCacheLine) std::atomic<uint8_t> middle_{1};
+    queue_detail::EventCount published_;
+};
@@ -0,0 +1,393 @@
+#pragma once
+
+// Coroutines on top of ThreadPool (C++20).
+//
+//   coro::task<long> leaf(ThreadPool& pool, int i) {
+//       co_await coro::schedule_on(pool);           // continue on a worker
+//       co_return work(i);
+//   }
+//   coro::task<long> request(ThreadPool& pool) {
+//       std::vector<coro::task<long>> parts;
+//       for (int i = 0; i < 8; ++i) parts.push_back(leaf(pool, i));
+//       std::vector<long> results = co_await coro::when_all(std::move(parts));
+//       ...
+//   }
+//   long total = coro::sync_wait(request(pool));    // only outside the pool
+//
+// task<T> is lazy: it starts when awaited and resumes its awaiter when it
+// finishes. Both hand-offs use symmetric transfer (await_suspend returns
+// the next handle), so a long chain of tasks that complete synchronously
+// runs in constant stack space. Nothing blocks a worker: a suspended
+// coroutine holds no thread, and whoever completes the last dependency
+// resumes it.
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace coro {
+
+template <typename T = void>
+class task;
+
+namespace detail {
+
+// Resumes whatever awaits the finished coroutine, or returns to the
+// caller of resume() if nothing does.
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+        return h.promise().continuation;
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr exception;
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    task<T> get_return_object() noexcept;
+    template <typename U>
+    void return_value(U&& v) {
+        value.emplace(std::forward<U>(v));
+    }
+    T result() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+
+    std::optional<T> value;
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+    void result() const {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+}  // namespace detail
+
+template <typename T>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    task() = default;
+    explicit task(Handle h) : h_(h) {}
+    task(task&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (h_) {
+                h_.destroy();
+            }
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    ~task() {
+        if (h_) {
+            h_.destroy();
+        }
+    }
+
+    // Starts the task and suspends the awaiter until it finishes.
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Handle h;
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                h.promise().continuation = awaiting;
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return Awaiter{h_};
+    }
+
+private:
+    Handle h_;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> Promise<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline task<void> Promise<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// An eagerly started coroutine that destroys itself when it finishes,
+// then transfers to the handle it was given with ResumeAfter (if any).
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        auto final_suspend() const noexcept {
+            struct Final {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                    std::coroutine_handle<> next = h.promise().next;
+                    h.destroy();
+                    return next;
+                }
+                void await_resume() const noexcept {}
+            };
+            return Final{};
+        }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+
+        std::coroutine_handle<> next = std::noop_coroutine();
+    };
+};
+
+// co_await ResumeAfter{h} in a Detached coroutine: transfer to h once the
+// coroutine has finished. Never actually suspends.
+struct ResumeAfter {
+    std::coroutine_handle<> next;
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<Detached::promise_type> h) const noexcept {
+        h.promise().next = next;
+        return false;
+    }
+    void await_resume() const noexcept {}
+};
+
+template <typename T>
+using Stored = std::conditional_t<std::is_void_v<T>, char, std::optional<T>>;
+
+template <typename T>
+struct AllState {
+    explicit AllState(std::size_t n) : pending(n + 1), results(n) {}
+
+    // Returns the awaiting coroutine for the last of n children plus the
+    // launcher, otherwise a no-op handle.
+    std::coroutine_handle<> arrive() noexcept {
+        return pending.fetch_sub(1, std::memory_order_acq_rel) == 1 ? parent : std::noop_coroutine();
+    }
+
+    std::atomic<std::size_t> pending;
+    std::vector<Stored<T>> results;
+    std::coroutine_handle<> parent;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+template <typename T>
+Detached runAllChild(task<T> child, std::shared_ptr<AllState<T>> state, std::size_t i) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(child);
+        } else {
+            state->results[i].emplace(co_await std::move(child));
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state->errorMutex);
+        if (!state->error) {
+            state->error = std::current_exception();
+        }
+    }
+    co_await ResumeAfter{state->arrive()};
+}
+
+// The awaiters below only borrow the state: the awaiting coroutine keeps
+// the owning shared_ptr (GCC 12 mishandles non-trivial members of
+// temporary awaiters that live across a suspension).
+template <typename T>
+struct StartAll {
+    const std::shared_ptr<AllState<T>>* state;
+    std::vector<task<T>>* children;
+
+    bool await_ready() const noexcept { return children->empty(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> parent) {
+        (*state)->parent = parent;
+        for (std::size_t i = 0; i < children->size(); ++i) {
+            runAllChild(std::move((*children)[i]), *state, i);
+        }
+        std::coroutine_handle<> next = (*state)->arrive();
+        // When every child finished inline, the launcher is last: resume
+        // the parent right away instead of returning to our caller.
+        return next;
+    }
+    void await_resume() const noexcept {}
+};
+
+template <typename T>
+struct AnyState {
+    std::atomic<bool> decided{false};
+    std::atomic<int> handshake{0};  // the winner and the launcher both arrive
+    std::size_t index = 0;
+    Stored<T> result;
+    std::exception_ptr error;
+    std::coroutine_handle<> parent;
+
+    std::coroutine_handle<> arrive() noexcept {
+        return handshake.fetch_add(1, std::memory_order_acq_rel) == 1 ? parent : std::noop_coroutine();
+    }
+};
+
+template <typename T>
+Detached runAnyChild(task<T> child, std::shared_ptr<AnyState<T>> state, std::size_t i) {
+    std::exception_ptr error;
+    Stored<T> result{};
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(child);
+        } else {
+            result.emplace(co_await std::move(child));
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    if (state->decided.exchange(true, std::memory_order_acq_rel)) {
+        co_return;  // lost the race; the result is dropped
+    }
+    state->index = i;
+    state->result = std::move(result);
+    state->error = error;
+    co_await ResumeAfter{state->arrive()};
+}
+
+template <typename T>
+struct StartAny {
+    const std::shared_ptr<AnyState<T>>* state;
+    std::vector<task<T>>* children;
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> parent) {
+        (*state)->parent = parent;
+        for (std::size_t i = 0; i < children->size(); ++i) {
+            runAnyChild(std::move((*children)[i]), *state, i);
+        }
+        return (*state)->arrive();
+    }
+    void await_resume() const noexcept {}
+};
+
+}  // namespace detail
+
+// Continues the awaiting coroutine on one of pool's workers.
+inline auto schedule_on(ThreadPool& pool, const TaskOptions& options = {}) {
+    struct Awaiter {
+        ThreadPool& pool;
+        TaskOptions options;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            pool.post([h] { h.resume(); }, options);
+        }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{pool, options};
+}
+
+// Runs all children concurrently (each continues wherever it schedules
+// itself) and returns their results in order. Rethrows the first
+// exception after every child has finished.
+template <typename T>
+task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> when_all(std::vector<task<T>> children) {
+    auto state = std::make_shared<detail::AllState<T>>(children.size());
+    co_await detail::StartAll<T>{&state, &children};
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+    if constexpr (!std::is_void_v<T>) {
+        std::vector<T> results;
+        results.reserve(state->results.size());
+        for (auto& r : state->results) {
+            results.push_back(std::move(*r));
+        }
+        co_return results;
+    }
+}
+
+template <typename T>
+struct AnyResult {
+    std::size_t index;
+    T value;
+};
+
+// Returns the first child to finish (its index and result, or rethrows
+// its exception). The others keep running; their results are dropped.
+template <typename T>
+task<std::conditional_t<std::is_void_v<T>, std::size_t, AnyResult<T>>> when_any(std::vector<task<T>> children) {
+    if (children.empty()) {
+        throw std::invalid_argument("when_any of no tasks");
+    }
+    auto state = std::make_shared<detail::AnyState<T>>();
+    co_await detail::StartAny<T>{&state, &children};
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+    if constexpr (std::is_void_v<T>) {
+        co_return state->index;
+    } else {
+        co_return AnyResult<T>{state->index, std::move(*state->result)};
+    }
+}
+
+// Blocks the calling thread until t finishes. Never call it on a worker
+// of the pool t needs.
+template <typename T>
+T sync_wait(task<T> t) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    detail::Stored<T> result{};
+    std::exception_ptr error;
+
+    [](task<T> t, std::mutex& mutex, std::condition_variable& cv, bool& done, detail::Stored<T>& result,
+       std::exception_ptr& error) -> detail::Detached {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(t);
+            } else {
+                result.emplace(co_await std::move(t));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_one();
+    }(std::move(t), mutex, cv, done, result, error);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return done; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if constexpr (!std::is_void_v<T>) {
+        return std::move(*result);
+    }
+}
+
+}  // namespace coro
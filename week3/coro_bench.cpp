@@ -0,0 +1,233 @@
+// Fan-out/fan-in requests: coroutines (coro.h) against std::future.
+// Build: g++ -std=c++20 -O2 coro_bench.cpp -o coro_bench -pthread
+// Usage: ./coro_bench [requests] [fan-out]   (default 2000 requests of 16 leaves)
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coro.h"
+#include "thread_pool.h"
+
+// One leaf of a request: a few microseconds of arithmetic.
+long leafWork(long request, long leaf) {
+    uint64_t x = static_cast<uint64_t>(request * 131 + leaf);
+    for (int i = 0; i < 2000; ++i) {
+        x = x * 6364136223846793005u + 1442695040888963407u;
+    }
+    return static_cast<long>(x >> 40);
+}
+
+// The second stage of a request, run after the fan-in.
+long combine(long request, long sum) { return sum ^ (request << 3); }
+
+coro::task<long> leaf(ThreadPool& pool, long request, long i) {
+    co_await coro::schedule_on(pool);
+    co_return leafWork(request, i);
+}
+
+coro::task<long> request(ThreadPool& pool, long r, int fanOut) {
+    std::vector<coro::task<long>> leaves;
+    leaves.reserve(static_cast<size_t>(fanOut));
+    for (int i = 0; i < fanOut; ++i) {
+        leaves.push_back(leaf(pool, r, i));
+    }
+    std::vector<long> parts = co_await coro::when_all(std::move(leaves));
+    long sum = 0;
+    for (long p : parts) {
+        sum += p;
+    }
+    co_await coro::schedule_on(pool);
+    co_return combine(r, sum);
+}
+
+std::vector<long> runCoroutines(ThreadPool& pool, int requests, int fanOut) {
+    std::vector<coro::task<long>> all;
+    for (int r = 0; r < requests; ++r) {
+        all.push_back(request(pool, r, fanOut));
+    }
+    return coro::sync_wait(coro::when_all(std::move(all)));
+}
+
+// Futures, with the fan-in done by the calling thread: every leaf is
+// enqueued up front, then each request's leaves are waited for in order.
+std::vector<long> runFuturesCaller(ThreadPool& pool, int requests, int fanOut) {
+    std::vector<std::vector<std::future<long>>> leaves(static_cast<size_t>(requests));
+    for (int r = 0; r < requests; ++r) {
+        for (int i = 0; i < fanOut; ++i) {
+            leaves[static_cast<size_t>(r)].push_back(pool.enqueue(leafWork, r, i));
+        }
+    }
+    std::vector<std::future<long>> stage2;
+    for (int r = 0; r < requests; ++r) {
+        long sum = 0;
+        for (auto& f : leaves[static_cast<size_t>(r)]) {
+            sum += f.get();
+        }
+        stage2.push_back(pool.enqueue(combine, r, sum));
+    }
+    std::vector<long> results;
+    for (auto& f : stage2) {
+        results.push_back(f.get());
+    }
+    return results;
+}
+
+// Futures, with each request a task that blocks in get(). The blocked
+// requests need threads of their own (a second pool), or the leaves they
+// wait for could never run.
+std::vector<long> runFuturesBlocking(ThreadPool& leafPool, ThreadPool& requestPool, int requests, int fanOut) {
+    std::vector<std::future<long>> all;
+    for (int r = 0; r < requests; ++r) {
+        all.push_back(requestPool.enqueue([&leafPool, r, fanOut] {
+            std::vector<std::future<long>> leaves;
+            for (int i = 0; i < fanOut; ++i) {
+                leaves.push_back(leafPool.enqueue(leafWork, r, i));
+            }
+            long sum = 0;
+            for (auto& f : leaves) {
+                sum += f.get();
+            }
+            return combine(r, sum);
+        }));
+    }
+    std::vector<long> results;
+    for (auto& f : all) {
+        results.push_back(f.get());
+    }
+    return results;
+}
+
+coro::task<long> ready(long v) { co_return v; }
+
+coro::task<long> sumOfReady(long n) {
+    long sum = 0;
+    for (long i = 0; i < n; ++i) {
+        sum += co_await ready(i);
+    }
+    co_return sum;
+}
+
+coro::task<long> depth(long n) {
+    if (n == 0) {
+        co_return 0;
+    }
+    co_return 1 + co_await depth(n - 1);
+}
+
+coro::task<int> sleepy(ThreadPool& pool, int ms) {
+    co_await coro::schedule_on(pool);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    co_return ms;
+}
+
+coro::task<void> failing(ThreadPool& pool, bool fail) {
+    co_await coro::schedule_on(pool);
+    if (fail) {
+        throw std::runtime_error("leaf failed");
+    }
+}
+
+// GCC emits symmetric transfer as a tail call, which the sanitizers
+// disable; their builds only get a shallow chain.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+const long kChain = 2000;
+#else
+const long kChain = 2000000;
+#endif
+
+bool check() {
+    // Synchronous completions and deep recursion must not grow the stack;
+    // without symmetric transfer both overflow an 8 MB stack.
+    if (coro::sync_wait(sumOfReady(kChain)) != kChain * (kChain - 1) / 2 ||
+        coro::sync_wait(depth(kChain / 10)) != kChain / 10) {
+        std::cerr << "synchronous chains give wrong results" << std::endl;
+        return false;
+    }
+
+    // A single worker suffices: nothing blocks it while a request waits.
+    ThreadPool one(1);
+    std::vector<long> expected = {combine(7, [] {
+        long s = 0;
+        for (int i = 0; i < 5; ++i) {
+            s += leafWork(7, i);
+        }
+        return s;
+    }())};
+    if (coro::sync_wait(request(one, 7, 5)) != expected[0]) {
+        std::cerr << "request on a one-worker pool is wrong" << std::endl;
+        return false;
+    }
+
+    ThreadPool pool(4);
+    std::vector<coro::task<int>> racers;
+    racers.push_back(sleepy(pool, 60));
+    racers.push_back(sleepy(pool, 1));
+    racers.push_back(sleepy(pool, 30));
+    auto first = coro::sync_wait(coro::when_any(std::move(racers)));
+    if (first.index != 1 || first.value != 1) {
+        std::cerr << "when_any picked task " << first.index << std::endl;
+        return false;
+    }
+
+    std::vector<coro::task<void>> voids;
+    for (int i = 0; i < 8; ++i) {
+        voids.push_back(failing(pool, i == 5));
+    }
+    try {
+        coro::sync_wait(coro::when_all(std::move(voids)));
+        std::cerr << "when_all lost an exception" << std::endl;
+        return false;
+    } catch (const std::runtime_error&) {
+    }
+    std::vector<coro::task<void>> fine;
+    fine.push_back(failing(pool, false));
+    coro::sync_wait(coro::when_all(std::move(fine)));
+    coro::sync_wait(coro::when_all(std::vector<coro::task<void>>{}));
+    return true;
+}
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int requests = argc > 1 ? std::stoi(argv[1]) : 2000;
+    int fanOut = argc > 2 ? std::stoi(argv[2]) : 16;
+    if (!check()) {
+        return 1;
+    }
+    std::cout << "Symmetric transfer, when_all, when_any and exception checks pass." << std::endl;
+
+    const size_t threads = 4;
+    ThreadPool pool(threads);
+    ThreadPool requestPool(threads);
+    std::vector<long> coroutines, caller, blocking;
+    double best[3] = {1e300, 1e300, 1e300};
+    for (int run = 0; run < 3; ++run) {
+        best[0] = std::min(best[0], timeMs([&] { coroutines = runCoroutines(pool, requests, fanOut); }));
+        best[1] = std::min(best[1], timeMs([&] { caller = runFuturesCaller(pool, requests, fanOut); }));
+        best[2] = std::min(best[2], timeMs([&] { blocking = runFuturesBlocking(pool, requestPool, requests, fanOut); }));
+    }
+    if (coroutines != caller || coroutines != blocking) {
+        std::cerr << "the three versions disagree" << std::endl;
+        return 1;
+    }
+
+    std::cout << "\n" << requests << " requests x " << fanOut << " leaves on " << threads
+              << " workers, best of 3\n" << std::fixed << std::setprecision(1)
+              << "  coroutines (when_all, no blocking)       " << std::setw(9) << best[0] << " ms\n"
+              << "  futures, fan-in on the calling thread     " << std::setw(9) << best[1] << " ms\n"
+              << "  futures, request tasks block in get()     " << std::setw(9) << best[2] << " ms  (+"
+              << threads << " threads)" << std::endl;
+    return 0;
+}
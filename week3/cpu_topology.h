@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+// The CPUs this process may run on, grouped by NUMA node.
+//
+//   CpuTopology t = CpuTopology::detect();
+//   for (const CpuTopology::Node& node : t.nodes) ...   // node.id, node.cpus
+//
+// detect() reads /sys/devices/system/node/node<N>/cpulist and keeps only
+// the CPUs in the process's affinity mask, which is where a cpuset
+// (taskset, docker --cpuset-cpus, systemd AllowedCPUs) shows up. Nodes
+// left without CPUs are dropped. Without NUMA information (a kernel
+// without CONFIG_NUMA, sysfs not mounted, not Linux) all allowed CPUs form
+// node 0, so a single-node machine and an unknown one look the same.
+struct CpuTopology {
+    struct Node {
+        int id;
+        std::vector<int> cpus;  // ascending
+    };
+
+    std::vector<Node> nodes;  // ascending id
+
+    static CpuTopology detect();
+
+    // Parses the kernel's list format, "0-3,8,10-11". Malformed ranges are
+    // skipped.
+    static std::vector<int> parseCpuList(std::string_view list);
+
+    // CPUs in the calling thread's affinity mask.
+    static std::vector<int> allowedCpus();
+
+    size_t cpuCount() const {
+        size_t n = 0;
+        for (const Node& node : nodes) {
+            n += node.cpus.size();
+        }
+        return n;
+    }
+
+    // Node id of cpu, or -1 if it is not in the topology.
+    int nodeOf(int cpu) const {
+        for (const Node& node : nodes) {
+            if (std::binary_search(node.cpus.begin(), node.cpus.end(), cpu)) {
+                return node.id;
+            }
+        }
+        return -1;
+    }
+};
+
+// Restricts the calling thread to cpus. Returns false, leaving the thread
+// where it was, if the set is empty or the kernel refuses it (CPUs offline
+// or outside the cpuset).
+inline bool pinThisThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+// CPU the calling thread is running on, or -1 where that is unknown.
+inline int currentCpu() {
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+inline std::vector<int> CpuTopology::parseCpuList(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string range(list.substr(0, comma));
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        char* end = nullptr;
+        long first = std::strtol(range.c_str(), &end, 10);
+        if (end == range.c_str() || first < 0) {
+            continue;
+        }
+        long last = first;
+        if (*end == '-') {
+            const char* from = end + 1;
+            last = std::strtol(from, &end, 10);
+            if (end == from || last < first) {
+                continue;
+            }
+        }
+        if (*end != '\0' && *end != '\n') {
+            continue;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+inline std::vector<int> CpuTopology::allowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+inline CpuTopology CpuTopology::detect() {
+    CpuTopology t;
+    std::vector<int> allowed = allowedCpus();
+#ifdef __linux__
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        while (dirent* entry = readdir(dir)) {
+            std::string_view name = entry->d_name;
+            if (name.size() <= 4 || name.substr(0, 4) != "node" ||
+                name.find_first_not_of("0123456789", 4) != std::string_view::npos) {
+                continue;
+            }
+            std::ifstream in("/sys/devices/system/node/" + std::string(name) + "/cpulist");
+            std::string list;
+            if (!std::getline(in, list)) {
+                continue;
+            }
+            Node node{std::atoi(entry->d_name + 4), {}};
+            for (int cpu : parseCpuList(list)) {
+                if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            if (!node.cpus.empty()) {
+                t.nodes.push_back(std::move(node));
+            }
+        }
+        closedir(dir);
+    }
+#endif
+    std::sort(t.nodes.begin(), t.nodes.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+    if (t.nodes.empty()) {
+        t.nodes.push_back(Node{0, std::move(allowed)});
+        return t;
+    }
+    // Allowed CPUs that no node lists (hot-added, or a partial sysfs) go to
+    // the first node rather than never being used.
+    for (int cpu : allowed) {
+        if (t.nodeOf(cpu) < 0) {
+            t.nodes.front().cpus.push_back(cpu);
+        }
+    }
+    std::sort(t.nodes.front().cpus.begin(), t.nodes.front().cpus.end());
+    return t;
+}
@@ -1,11 +1,32 @@
 #include <iostream>
 #include <vector>
+#include <list>
 #include <numeric>
+#include <iterator>
+#include <type_traits>
+
+#include "reduce.h"
+
+// Element type of any container. decltype(*container.begin()) alone would be
+// a reference (const int& for const vector<int>), so it has to be decayed.
+template <typename Container>
+using ValueTypeOf = std::decay_t<decltype(*std::begin(std::declval<const Container&>()))>;
+
+template <typename Container, typename = void>
+struct is_contiguous : std::false_type {};
+
+template <typename Container>
+struct is_contiguous<Container, std::void_t<decltype(std::data(std::declval<const Container&>()))>>
+    : std::true_type {};
 
 template <typename Container>
-auto sum(const Container& container) -> decltype(*container.begin()) {
-    using ValueType = decltype(*container.begin());
-    return std::accumulate(container.begin(), container.end(), ValueType{});
+auto sum(const Container& container) -> ValueTypeOf<Container> {
+    using ValueType = ValueTypeOf<Container>;
+    if constexpr (is_contiguous<Container>::value && std::is_arithmetic<ValueType>::value) {
+        return reduce::sum(container);
+    } else {
+        return std::accumulate(container.begin(), container.end(), ValueType{});
+    }
 }
 
 int main() {
@@ -15,5 +36,15 @@ int main() {
     std::vector<double> vec_d = {1.1, 2.2, 3.3, 4.4, 5.5};
     std::cout << "Sum of vector<double> elements: " << sum(vec_d) << std::endl;
 
+    std::list<int> lst = {10, 20, 30};
+    std::cout << "Sum of list elements: " << sum(lst) << std::endl;
+
+    std::cout << "Min / max of vector: " << *reduce::min(vec) << " / " << *reduce::max(vec) << std::endl;
+    std::cout << "Dot product of vector with itself: " << reduce::dot(vec, vec) << std::endl;
+
+    reduce::Options kahan;
+    kahan.summation = reduce::Summation::Kahan;
+    std::cout << "Kahan sum of vector<double> elements: " << reduce::sum(vec_d, kahan) << std::endl;
+
     return 0;
-}
\ No newline at end of file
+}
@@ -1,8 +1,11 @@
+#include <filesystem>
 #include <iostream>
 #include <map>
 #include <optional>
 #include <string>
 
+#include "bptree.h"
+
 // Function that may fail and return an optional value
 std::optional<std::string> findValue(const std::map<int, std::string>& myMap, int key) {
     auto it = myMap.find(key);
@@ -13,6 +16,12 @@ std::optional<std::string> findValue(const std::map<int, std::string>& myMap, in
     }
 }
 
+// The same lookup on a disk-backed B+tree, for key sets that do not fit
+// in memory
+std::optional<std::string> findValue(const bptree::Tree& index, int key) {
+    return index.find(key);
+}
+
 int main() {
     std::map<int, std::string> myMap = {
         {1, "one"},
@@ -35,5 +44,26 @@ int main() {
         std::cout << "Value not found for key: " << keyToFind << std::endl;
     }
 
+    // The same map bulk loaded into a B+tree file, queried the same way
+    std::string path = (std::filesystem::temp_directory_path() / "day20.bpt").string();
+    {
+        bptree::Builder build(path);
+        for (const auto& [key, value] : myMap) {
+            build.add(key, value);
+        }
+        build.finish();
+    }
+    {
+        bptree::Tree index(path);
+        for (int key : {keyToFind, 4}) {
+            std::optional<std::string> onDisk = findValue(index, key);
+            std::cout << "On disk, key " << key << ": " << onDisk.value_or("not found") << std::endl;
+        }
+        index.scan(2, 3, [](int key, std::string_view value) {
+            std::cout << "Range [2, 3]: " << key << " -> " << value << std::endl;
+        });
+    }
+    std::filesystem::remove(path);
+
     return 0;
 }
\ No newline at end of file
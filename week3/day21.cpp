@@ -1,85 +1,36 @@
 #include <iostream>
 #include <vector>
-#include <queue>
-#include <thread>
-#include <functional>
-#include <future>
-#include <mutex>
-#include <condition_variable>
 
-class ThreadPool {
-public:
-    ThreadPool(size_t threads);
-    ~ThreadPool();
-
-    template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>;
-
-private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
-};
-
-ThreadPool::ThreadPool(size_t threads) : stop(false) {
-    for(size_t i = 0; i < threads; ++i) {
-        workers.emplace_back([this] {
-            for(;;) {
-                std::function<void()> task;
-
-                {
-                    std::unique_lock<std::mutex> lock(this->queue_mutex);
-                    this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-                    if(this->stop && this->tasks.empty())
-                        return;
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
-                }
-
-                task();
-            }
-        });
-    }
-}
-
-ThreadPool::~ThreadPool() {
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        stop = true;
-    }
-    condition.notify_all();
-    for(std::thread &worker: workers)
-        worker.join();
-}
-
-template<class F, class... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type> {
-    using return_type = typename std::result_of<F(Args...)>::type;
-
-    auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
-
-        tasks.emplace([task]() { (*task)(); });
-    }
-    condition.notify_one();
-    return res;
-}
+#include "thread_pool.h"
+#include "trace.h"
 
 int main() {
+    // Build with -DCPP30_TRACE to get per-task queue wait and run time.
+    trace::Session session("day21.trace.json");
     ThreadPool pool(4);
 
     auto result = pool.enqueue([](int answer) { return answer; }, 42);
 
     std::cout << "Result: " << result.get() << std::endl;
 
+    // More tasks than workers, so some of them wait in the queue.
+    std::vector<std::future<long long>> sums;
+    for (int t = 0; t < 16; ++t) {
+        sums.push_back(pool.enqueue([](int n) {
+            TRACE_SCOPE("sum");
+            long long sum = 0;
+            for (int i = 0; i < n; ++i) {
+                sum += i;
+            }
+            return sum;
+        }, 1000000 * (t + 1)));
+    }
+    long long total = 0;
+    for (auto& sum : sums) {
+        total += sum.get();
+    }
+    std::cout << "Sum of 16 tasks: " << total << std::endl;
+    std::cout << "Pool: " << pool.stats();
+
     return 0;
-}
\ No newline at end of file
+}
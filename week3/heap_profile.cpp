@@ -0,0 +1,707 @@
+// The allocator hooks, call-site tables and report writer behind
+// heap_profile.h. Linked in by cpp30_add_program(... HEAP_PROFILE).
+#include "heap_profile.h"
+
+#include <ostream>
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+
+namespace heapprof {
+
+bool available() { return false; }
+void start(size_t) {}
+void stop() {}
+bool running() { return false; }
+void reset() {}
+Stats stats() { return {}; }
+std::vector<Site> snapshot() { return {}; }
+void writeFolded(std::ostream&, Metric) {}
+
+}  // namespace heapprof
+
+#else
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cxxabi.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <unordered_map>
+#include <elf.h>
+#include <link.h>
+#include <unistd.h>
+#include <unwind.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+
+// Everything that runs between the program's call and the stack walk goes
+// in its own section, so the walk can drop those frames by address
+// whatever was inlined.
+#define HEAPPROF_TEXT __attribute__((section("heapprof_text"), noinline))
+extern "C" char __start_heapprof_text[];
+extern "C" char __stop_heapprof_text[];
+
+namespace heapprof {
+
+namespace {
+
+constexpr int kMaxDepth = 32;
+constexpr size_t kSites = 4096;  // distinct stacks; one more slot collects the rest
+constexpr int kSiteProbes = 64;
+constexpr size_t kBucketSlots = 8;  // 128 bytes: a free probes two cache lines
+constexpr size_t kBuckets = (size_t(1) << 20) / kBucketSlots;
+constexpr int kWeightBits = 40;
+
+struct SiteSlot {
+    std::atomic<uint64_t> hash{0};
+    std::atomic<bool> ready{false};
+    int depth = 0;
+    uintptr_t frames[kMaxDepth] = {};
+    std::atomic<uint64_t> allocatedBytes{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<int64_t> liveBytes{0};
+    std::atomic<int64_t> liveSamples{0};
+};
+
+// A sampled pointer and its site and weight (site << kWeightBits | bytes).
+struct LiveSlot {
+    std::atomic<uintptr_t> key{0};
+    std::atomic<uint64_t> value{0};
+};
+
+struct alignas(128) Bucket {
+    LiveSlot slots[kBucketSlots];
+};
+
+// Constant-initialized: malloc runs before any constructor.
+SiteSlot g_sites[kSites + 1];
+Bucket g_live[kBuckets];
+// Pointers in each bucket. A free reads this (128 KB, mostly cached)
+// instead of the bucket (16 MB, mostly not).
+std::atomic<uint8_t> g_occupied[kBuckets];
+
+std::atomic<bool> g_running{false};
+std::atomic<int64_t> g_sampleBytes{static_cast<int64_t>(kDefaultSampleBytes)};
+std::atomic<uint64_t> g_epoch{0};  // bumped by start(), so threads redraw their countdown
+std::atomic<int64_t> g_liveEntries{0};
+std::atomic<uint64_t> g_samples{0};
+std::atomic<uint64_t> g_dropped{0};
+std::atomic<size_t> g_siteCount{0};
+
+struct ThreadState {
+    int64_t untilSample;  // bytes left before the next sample
+    uint64_t rng;
+    uint64_t epoch;
+    bool busy;  // inside the profiler: its own allocations are not sampled
+};
+
+thread_local ThreadState t_state = {0, 0, 0, false};
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    return x ^ (x >> 33);
+}
+
+// Exponential with mean rate, at least 1.
+int64_t nextInterval(ThreadState& t, int64_t rate) {
+    t.rng ^= t.rng << 13;
+    t.rng ^= t.rng >> 7;
+    t.rng ^= t.rng << 17;
+    double u = static_cast<double>((t.rng >> 11) + 1) * 0x1.0p-53;  // (0, 1]
+    return static_cast<int64_t>(-std::log(u) * static_cast<double>(rate)) + 1;
+}
+
+_Unwind_Reason_Code walkStep(_Unwind_Context* context, void* arg) {
+    auto* walk = static_cast<std::pair<uintptr_t*, int>*>(arg);
+    uintptr_t ip = _Unwind_GetIP(context);
+    if (ip == 0) {
+        return _URC_END_OF_STACK;
+    }
+    if (walk->second == 0 && ip >= reinterpret_cast<uintptr_t>(__start_heapprof_text) &&
+        ip < reinterpret_cast<uintptr_t>(__stop_heapprof_text)) {
+        return _URC_NO_REASON;
+    }
+    walk->first[walk->second++] = ip;
+    return walk->second == kMaxDepth ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+HEAPPROF_TEXT int captureStack(uintptr_t* frames) {
+    std::pair<uintptr_t*, int> walk{frames, 0};
+    _Unwind_Backtrace(walkStep, &walk);
+    return walk.second;
+}
+
+SiteSlot& findSite(const uintptr_t* frames, int depth) {
+    uint64_t h = static_cast<uint64_t>(depth);
+    for (int i = 0; i < depth; ++i) {
+        h = mix(h ^ frames[i]);
+    }
+    h |= 1;  // 0 marks a free slot
+    for (int i = 0; i < kSiteProbes; ++i) {
+        SiteSlot& s = g_sites[(h + static_cast<uint64_t>(i)) & (kSites - 1)];
+        uint64_t seen = s.hash.load(std::memory_order_acquire);
+        if (seen == 0 && s.hash.compare_exchange_strong(seen, h, std::memory_order_acq_rel)) {
+            s.depth = depth;
+            std::copy(frames, frames + depth, s.frames);
+            s.ready.store(true, std::memory_order_release);
+            g_siteCount.fetch_add(1, std::memory_order_relaxed);
+            return s;
+        }
+        if (seen == h) {
+            return s;
+        }
+    }
+    return g_sites[kSites];
+}
+
+size_t bucketOf(const void* p) {
+    return mix(reinterpret_cast<uintptr_t>(p)) % kBuckets;
+}
+
+void remember(void* p, SiteSlot& site, uint64_t weight) {
+    g_samples.fetch_add(1, std::memory_order_relaxed);
+    site.allocatedBytes.fetch_add(weight, std::memory_order_relaxed);
+    site.samples.fetch_add(1, std::memory_order_relaxed);
+    weight = std::min(weight, (uint64_t(1) << kWeightBits) - 1);
+    uint64_t value = static_cast<uint64_t>(&site - g_sites) << kWeightBits | weight;
+    size_t b = bucketOf(p);
+    for (LiveSlot& slot : g_live[b].slots) {
+        uintptr_t empty = 0;
+        if (slot.key.load(std::memory_order_relaxed) == 0 &&
+            slot.key.compare_exchange_strong(empty, reinterpret_cast<uintptr_t>(p), std::memory_order_acq_rel)) {
+            slot.value.store(value, std::memory_order_release);
+            g_occupied[b].fetch_add(1, std::memory_order_relaxed);
+            site.liveBytes.fetch_add(static_cast<int64_t>(weight), std::memory_order_relaxed);
+            site.liveSamples.fetch_add(1, std::memory_order_relaxed);
+            g_liveEntries.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void forget(void* p) {
+    size_t b = bucketOf(p);
+    if (g_occupied[b].load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    for (LiveSlot& slot : g_live[b].slots) {
+        if (slot.key.load(std::memory_order_acquire) == reinterpret_cast<uintptr_t>(p)) {
+            uint64_t value = slot.value.load(std::memory_order_acquire);
+            slot.value.store(0, std::memory_order_relaxed);
+            slot.key.store(0, std::memory_order_release);
+            g_occupied[b].fetch_sub(1, std::memory_order_relaxed);
+            SiteSlot& site = g_sites[value >> kWeightBits];
+            site.liveBytes.fetch_sub(static_cast<int64_t>(value & ((uint64_t(1) << kWeightBits) - 1)),
+                                     std::memory_order_relaxed);
+            site.liveSamples.fetch_sub(1, std::memory_order_relaxed);
+            g_liveEntries.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+HEAPPROF_TEXT void sample(void* p, size_t size) {
+    ThreadState& t = t_state;
+    if (t.busy) {
+        return;
+    }
+    t.busy = true;
+    int64_t rate = g_sampleBytes.load(std::memory_order_relaxed);
+    uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+    uint64_t weight = size;
+    if (rate > 1) {
+        if (t.epoch != epoch) {  // first allocation since start(): only draw the countdown
+            t.epoch = epoch;
+            if (t.rng == 0) {
+                t.rng = mix(reinterpret_cast<uintptr_t>(&t) ^ static_cast<uint64_t>(std::time(nullptr))) | 1;
+            }
+            t.untilSample = nextInterval(t, rate);
+            t.busy = false;
+            return;
+        }
+        t.untilSample = nextInterval(t, rate);
+        // An allocation of s bytes is sampled with probability
+        // 1 - exp(-s/rate); dividing by it makes the estimate unbiased.
+        double s = static_cast<double>(std::max<size_t>(size, 1));
+        weight = static_cast<uint64_t>(s / -std::expm1(-s / static_cast<double>(rate)) + 0.5);
+    } else {
+        t.untilSample = 0;
+    }
+    uintptr_t frames[kMaxDepth];
+    int depth = captureStack(frames);
+    remember(p, findSite(frames, depth), weight);
+    t.busy = false;
+}
+
+inline void onAllocation(void* p, size_t size) {
+    if (g_running.load(std::memory_order_relaxed) && p != nullptr) {
+        ThreadState& t = t_state;
+        t.untilSample -= static_cast<int64_t>(size);
+        if (t.untilSample <= 0) {
+            sample(p, size);
+        }
+    }
+}
+
+inline void onFree(void* p) {
+    if (p != nullptr && g_liveEntries.load(std::memory_order_relaxed) > 0) {
+        forget(p);
+    }
+}
+
+// Function symbols of the loaded ELF files, read on first use.
+class Symbolizer {
+public:
+    Symbolizer() {
+        dl_iterate_phdr(
+            [](dl_phdr_info* info, size_t, void* self) {
+                Module m;
+                m.path = info->dlpi_name && info->dlpi_name[0] ? info->dlpi_name : executable();
+                m.base = info->dlpi_addr;
+                m.low = UINTPTR_MAX;
+                for (int i = 0; i < info->dlpi_phnum; ++i) {
+                    const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+                    if (ph.p_type == PT_LOAD) {
+                        m.low = std::min<uintptr_t>(m.low, m.base + ph.p_vaddr);
+                        m.high = std::max<uintptr_t>(m.high, m.base + ph.p_vaddr + ph.p_memsz);
+                    }
+                }
+                static_cast<Symbolizer*>(self)->modules_.push_back(std::move(m));
+                return 0;
+            },
+            this);
+    }
+
+    // The call as file+0xoffset, for addr2line -e file.
+    std::string location(uintptr_t ip) {
+        uintptr_t at = ip - 1;
+        for (const Module& m : modules_) {
+            if (at >= m.low && at < m.high) {
+                char offset[32];
+                std::snprintf(offset, sizeof(offset), "+0x%zx", static_cast<size_t>(at - m.base));
+                return m.path + offset;
+            }
+        }
+        return {};
+    }
+
+    const std::string& name(uintptr_t ip) {
+        auto cached = names_.find(ip);
+        if (cached != names_.end()) {
+            return cached->second;
+        }
+        std::string& name = names_[ip];
+        uintptr_t at = ip - 1;  // a return address; the call is before it
+        for (Module& m : modules_) {
+            if (at < m.low || at >= m.high) {
+                continue;
+            }
+            if (!m.loaded) {
+                load(m);
+            }
+            auto it = std::upper_bound(m.symbols.begin(), m.symbols.end(), at,
+                                       [](uintptr_t a, const Symbol& s) { return a < s.start; });
+            if (it != m.symbols.begin() && at < std::prev(it)->end) {
+                name = demangle(std::prev(it)->name);
+            } else {
+                char offset[32];
+                std::snprintf(offset, sizeof(offset), "+0x%zx", static_cast<size_t>(at - m.base));
+                name = m.path.substr(m.path.rfind('/') + 1) + offset;
+            }
+            return name;
+        }
+        char address[32];
+        std::snprintf(address, sizeof(address), "0x%zx", static_cast<size_t>(at));
+        return name = address;
+    }
+
+private:
+    struct Symbol {
+        uintptr_t start;
+        uintptr_t end;
+        std::string name;
+    };
+    struct Module {
+        std::string path;
+        uintptr_t base = 0;
+        uintptr_t low = 0;
+        uintptr_t high = 0;
+        bool loaded = false;
+        std::vector<Symbol> symbols;
+    };
+
+    static std::string executable() {
+        char path[4096];
+        ssize_t n = readlink("/proc/self/exe", path, sizeof(path));
+        if (n <= 0 || static_cast<size_t>(n) == sizeof(path)) {
+            return "/proc/self/exe";
+        }
+        return std::string(path, static_cast<size_t>(n));
+    }
+
+    static std::string demangle(const std::string& name) {
+        int status = 0;
+        char* text = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+        std::string result = status == 0 && text ? text : name;
+        std::free(text);
+        std::replace(result.begin(), result.end(), ';', ':');  // ';' separates frames
+        return result;
+    }
+
+    // .symtab if the file has one (static functions too), else .dynsym.
+    static void load(Module& m) {
+        m.loaded = true;
+        std::ifstream in(m.path, std::ios::binary);
+        std::string elf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (elf.size() < sizeof(ElfW(Ehdr)) || std::memcmp(elf.data(), ELFMAG, SELFMAG) != 0) {
+            return;
+        }
+        auto at = [&elf](size_t offset) { return elf.data() + offset; };
+        const auto* header = reinterpret_cast<const ElfW(Ehdr)*>(at(0));
+        if (header->e_shoff + size_t(header->e_shnum) * sizeof(ElfW(Shdr)) > elf.size()) {
+            return;
+        }
+        const auto* sections = reinterpret_cast<const ElfW(Shdr)*>(at(header->e_shoff));
+        const ElfW(Shdr)* table = nullptr;
+        for (int i = 0; i < header->e_shnum; ++i) {
+            if (sections[i].sh_type == SHT_SYMTAB || (sections[i].sh_type == SHT_DYNSYM && !table)) {
+                table = &sections[i];
+            }
+        }
+        if (!table || table->sh_link >= header->e_shnum) {
+            return;
+        }
+        const ElfW(Shdr)& strings = sections[table->sh_link];
+        if (table->sh_offset + table->sh_size > elf.size() || strings.sh_offset + strings.sh_size > elf.size()) {
+            return;
+        }
+        const auto* symbols = reinterpret_cast<const ElfW(Sym)*>(at(table->sh_offset));
+        for (size_t i = 0; i < table->sh_size / sizeof(ElfW(Sym)); ++i) {
+            const ElfW(Sym)& s = symbols[i];
+            int type = ELF64_ST_TYPE(s.st_info);
+            if ((type != STT_FUNC && type != STT_GNU_IFUNC) || s.st_value == 0 || s.st_name >= strings.sh_size) {
+                continue;
+            }
+            uintptr_t start = m.base + s.st_value;
+            m.symbols.push_back({start, start + std::max<uintptr_t>(s.st_size, 1), at(strings.sh_offset + s.st_name)});
+        }
+        std::sort(m.symbols.begin(), m.symbols.end(),
+                  [](const Symbol& a, const Symbol& b) { return a.start < b.start; });
+    }
+
+    std::vector<Module> modules_;
+    std::unordered_map<uintptr_t, std::string> names_;
+};
+
+// Keeps the calling thread's own allocations out of the profile.
+struct Busy {
+    Busy() : was(t_state.busy) { t_state.busy = true; }
+    ~Busy() { t_state.busy = was; }
+    bool was;
+};
+
+const char* reportPrefix = nullptr;  // from the environment, which outlives the exit handlers
+
+void writeReport() {
+    stop();
+    Busy busy;
+    Stats s = stats();
+    std::vector<Site> sites = snapshot();
+    uint64_t allocated = 0, live = 0;
+    for (const Site& site : sites) {
+        allocated += site.allocatedBytes;
+        live += site.liveBytes;
+    }
+    std::ofstream allocFile(std::string(reportPrefix) + ".alloc.folded");
+    writeFolded(allocFile, Metric::Allocated);
+    std::ofstream liveFile(std::string(reportPrefix) + ".live.folded");
+    writeFolded(liveFile, Metric::Live);
+    int64_t rate = g_sampleBytes.load();
+    std::cerr << "heap profile: " << s.samples << " samples ("
+              << (rate > 1 ? "1 per " + std::to_string(rate) + " bytes" : std::string("every allocation")) << ") at "
+              << s.sites << " call sites, ~" << allocated << " bytes allocated, ~" << live << " live at exit";
+    if (s.dropped != 0) {
+        std::cerr << ", " << s.dropped << " untracked";
+    }
+    std::cerr << "; wrote " << reportPrefix << ".alloc.folded and " << reportPrefix << ".live.folded" << std::endl;
+    std::sort(sites.begin(), sites.end(),
+              [](const Site& a, const Site& b) { return a.allocatedBytes > b.allocatedBytes; });
+    for (size_t i = 0; i < std::min<size_t>(sites.size(), 5); ++i) {
+        const Site& site = sites[i];
+        std::cerr << "  " << site.allocatedBytes << " bytes in "
+                  << (site.frames.empty() ? std::string("[no stack]") : site.frames.back());
+        if (!site.location.empty()) {
+            std::cerr << " at " << site.location;
+        }
+        std::cerr << std::endl;
+    }
+}
+
+__attribute__((constructor)) void startFromEnvironment() {
+    const char* prefix = std::getenv("CPP30_HEAP_PROFILE");
+    if (!prefix || !*prefix) {
+        return;
+    }
+    reportPrefix = prefix;
+    const char* rate = std::getenv("CPP30_HEAP_SAMPLE");
+    std::atexit(writeReport);
+    start(rate ? std::strtoull(rate, nullptr, 10) : kDefaultSampleBytes);
+}
+
+}  // namespace
+
+bool available() { return true; }
+
+void start(size_t sampleBytes) {
+    g_sampleBytes.store(static_cast<int64_t>(std::max<size_t>(sampleBytes, 1)), std::memory_order_relaxed);
+    g_epoch.fetch_add(1, std::memory_order_relaxed);
+    g_running.store(true, std::memory_order_release);
+}
+
+void stop() { g_running.store(false, std::memory_order_release); }
+
+bool running() { return g_running.load(std::memory_order_acquire); }
+
+void reset() {
+    for (SiteSlot& s : g_sites) {
+        s.ready.store(false, std::memory_order_relaxed);
+        s.hash.store(0, std::memory_order_relaxed);
+        s.depth = 0;
+        s.allocatedBytes.store(0, std::memory_order_relaxed);
+        s.samples.store(0, std::memory_order_relaxed);
+        s.liveBytes.store(0, std::memory_order_relaxed);
+        s.liveSamples.store(0, std::memory_order_relaxed);
+    }
+    if (g_liveEntries.exchange(0, std::memory_order_relaxed) != 0) {
+        for (size_t b = 0; b < kBuckets; ++b) {
+            for (LiveSlot& slot : g_live[b].slots) {
+                slot.key.store(0, std::memory_order_relaxed);
+            }
+            g_occupied[b].store(0, std::memory_order_relaxed);
+        }
+    }
+    g_samples.store(0, std::memory_order_relaxed);
+    g_dropped.store(0, std::memory_order_relaxed);
+    g_siteCount.store(0, std::memory_order_relaxed);
+}
+
+Stats stats() {
+    Stats s;
+    s.samples = g_samples.load(std::memory_order_relaxed);
+    s.dropped = g_dropped.load(std::memory_order_relaxed);
+    s.sites = g_siteCount.load(std::memory_order_relaxed);
+    return s;
+}
+
+std::vector<Site> snapshot() {
+    Busy busy;
+    Symbolizer symbols;
+    std::vector<Site> sites;
+    for (size_t i = 0; i <= kSites; ++i) {
+        const SiteSlot& slot = g_sites[i];
+        if (slot.samples.load(std::memory_order_relaxed) == 0 ||
+            (i < kSites && !slot.ready.load(std::memory_order_acquire))) {
+            continue;
+        }
+        Site site;
+        for (int f = slot.depth - 1; f >= 0; --f) {
+            site.frames.push_back(symbols.name(slot.frames[f]));
+        }
+        if (i == kSites) {
+            site.frames.push_back("[stacks past the site table]");
+        } else if (slot.depth > 0) {
+            site.location = symbols.location(slot.frames[0]);
+        }
+        site.allocatedBytes = slot.allocatedBytes.load(std::memory_order_relaxed);
+        site.samples = slot.samples.load(std::memory_order_relaxed);
+        site.liveBytes = static_cast<uint64_t>(std::max<int64_t>(slot.liveBytes.load(std::memory_order_relaxed), 0));
+        site.liveSamples =
+            static_cast<uint64_t>(std::max<int64_t>(slot.liveSamples.load(std::memory_order_relaxed), 0));
+        sites.push_back(std::move(site));
+    }
+    return sites;
+}
+
+void writeFolded(std::ostream& out, Metric metric) {
+    Busy busy;
+    // Sites differing only in return addresses inside the same functions
+    // fold into one line.
+    std::map<std::string, uint64_t> stacks;
+    for (const Site& site : snapshot()) {
+        uint64_t bytes = metric == Metric::Allocated ? site.allocatedBytes : site.liveBytes;
+        if (bytes == 0) {
+            continue;
+        }
+        std::string stack;
+        for (const std::string& frame : site.frames) {
+            stack += stack.empty() ? "" : ";";
+            stack += frame;
+        }
+        stacks[stack.empty() ? "[no stack]" : stack] += bytes;
+    }
+    for (const auto& [stack, bytes] : stacks) {
+        out << stack << ' ' << bytes << '\n';
+    }
+}
+
+}  // namespace heapprof
+
+// The hooks. Each forwards to glibc, then tells the profiler.
+extern "C" {
+
+HEAPPROF_TEXT void* malloc(size_t size) noexcept {
+    void* p = __libc_malloc(size);
+    heapprof::onAllocation(p, size);
+    return p;
+}
+
+HEAPPROF_TEXT void* calloc(size_t count, size_t size) noexcept {
+    void* p = __libc_calloc(count, size);
+    heapprof::onAllocation(p, count * size);
+    return p;
+}
+
+// The old block is forgotten first: once glibc has it back, another
+// thread may be handed the same address.
+HEAPPROF_TEXT void* realloc(void* old, size_t size) noexcept {
+    heapprof::onFree(old);
+    void* p = __libc_realloc(old, size);
+    heapprof::onAllocation(p, size);
+    return p;
+}
+
+HEAPPROF_TEXT void* reallocarray(void* old, size_t count, size_t size) noexcept {
+    size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    heapprof::onFree(old);
+    void* p = __libc_realloc(old, bytes);
+    heapprof::onAllocation(p, bytes);
+    return p;
+}
+
+HEAPPROF_TEXT void free(void* p) noexcept {
+    heapprof::onFree(p);
+    __libc_free(p);
+}
+
+HEAPPROF_TEXT void* memalign(size_t alignment, size_t size) noexcept {
+    void* p = __libc_memalign(alignment, size);
+    heapprof::onAllocation(p, size);
+    return p;
+}
+
+HEAPPROF_TEXT void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    void* p = __libc_memalign(alignment, size);
+    heapprof::onAllocation(p, size);
+    return p;
+}
+
+HEAPPROF_TEXT int posix_memalign(void** out, size_t alignment, size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* p = __libc_memalign(alignment, size);
+    if (p == nullptr) {
+        return ENOMEM;
+    }
+    heapprof::onAllocation(p, size);
+    *out = p;
+    return 0;
+}
+
+}  // extern "C"
+
+namespace {
+
+HEAPPROF_TEXT void* allocateOrThrow(size_t size, size_t alignment) {
+    size = std::max<size_t>(size, 1);
+    for (;;) {
+        void* p = alignment <= alignof(std::max_align_t) ? __libc_malloc(size) : __libc_memalign(alignment, size);
+        if (p != nullptr) {
+            heapprof::onAllocation(p, size);
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+HEAPPROF_TEXT void* allocateOrNull(size_t size, size_t alignment) noexcept {
+    try {
+        return allocateOrThrow(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+HEAPPROF_TEXT void release(void* p) noexcept {
+    heapprof::onFree(p);
+    __libc_free(p);
+}
+
+}  // namespace
+
+// Weak, so a program's own operator new (bench.h's counting one) wins and
+// reaches the profiler through malloc instead.
+#define HEAPPROF_WEAK __attribute__((weak))
+
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new(size_t size) { return allocateOrThrow(size, 0); }
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new[](size_t size) { return allocateOrThrow(size, 0); }
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new(size_t size, std::align_val_t a) {
+    return allocateOrThrow(size, static_cast<size_t>(a));
+}
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new[](size_t size, std::align_val_t a) {
+    return allocateOrThrow(size, static_cast<size_t>(a));
+}
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocateOrNull(size, 0);
+}
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocateOrNull(size, 0);
+}
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new(size_t size, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return allocateOrNull(size, static_cast<size_t>(a));
+}
+HEAPPROF_TEXT HEAPPROF_WEAK void* operator new[](size_t size, std::align_val_t a, const std::nothrow_t&) noexcept {
+    return allocateOrNull(size, static_cast<size_t>(a));
+}
+
+HEAPPROF_WEAK void operator delete(void* p) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete[](void* p) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete(void* p, size_t) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete[](void* p, size_t) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete[](void* p, size_t, std::align_val_t) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+HEAPPROF_WEAK void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+
+#endif
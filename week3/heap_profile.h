@@ -0,0 +1,88 @@
+#pragma once
+
+// Sampling heap profiler: which call stacks allocate, and what they still
+// hold.
+//
+// Linked into a program by cpp30_add_program(... HEAP_PROFILE), or into
+// every program by cmake -DCPP30_HEAP_PROFILE=ON. It stays idle until
+// started, from the environment:
+//
+//   CPP30_HEAP_PROFILE=day8 ./day8     # writes day8.alloc.folded and day8.live.folded at exit
+//   CPP30_HEAP_SAMPLE=1 ...            # mean bytes between samples; 1 records every allocation
+//   flamegraph.pl day8.alloc.folded > day8.svg
+//
+// or from code:
+//
+//   heapprof::start(64 * 1024);
+//   ...
+//   heapprof::stop();
+//   heapprof::writeFolded(out, heapprof::Metric::Live);
+//
+// heap_profile.cpp replaces malloc, calloc, realloc, free, the aligned
+// allocators and every operator new and delete, and forwards them to
+// glibc. An allocation costs one relaxed load while the profiler is idle.
+// While it runs, each thread counts down the bytes to its next sample,
+// drawn from an exponential distribution so the samples form a Poisson
+// process over allocated bytes (as in tcmalloc). Only a sampled allocation
+// walks its stack. The stack is stored once per distinct call site, in a
+// fixed open-addressed table claimed with a CAS. Each sample adds its
+// unbiased byte estimate to the site's atomic counters, and the sampled
+// pointer goes into a second fixed table, so that its free can subtract it
+// again. Frees probe that table only while it holds something. Nothing
+// takes a lock and nothing allocates, and full tables count drops instead
+// of growing. Symbols are read from the ELF files only when a report is
+// written.
+//
+// Under AddressSanitizer or ThreadSanitizer, which replace the allocator
+// themselves, the hooks are compiled out and available() is false.
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace heapprof {
+
+constexpr size_t kDefaultSampleBytes = 512 * 1024;
+
+enum class Metric {
+    Allocated,  // every byte allocated while running
+    Live,       // allocated and not yet freed
+};
+
+// One call site. Byte counts are estimates unless every allocation is
+// sampled.
+struct Site {
+    std::vector<std::string> frames;  // outermost caller first
+    std::string location;             // the innermost call as file+0xoffset, for addr2line
+    uint64_t allocatedBytes = 0;
+    uint64_t liveBytes = 0;
+    uint64_t samples = 0;
+    uint64_t liveSamples = 0;
+};
+
+struct Stats {
+    uint64_t samples = 0;
+    uint64_t dropped = 0;  // samples with no room to track their free
+    size_t sites = 0;
+};
+
+bool available();
+
+// Samples one allocation per sampleBytes allocated, on average; 1 or less
+// samples all of them.
+void start(size_t sampleBytes = kDefaultSampleBytes);
+void stop();
+bool running();
+
+// Forgets every site and sample. Only while stopped.
+void reset();
+
+Stats stats();
+std::vector<Site> snapshot();
+
+// One line per stack, "outer;inner;leaf bytes", for flamegraph.pl,
+// speedscope or inferno.
+void writeFolded(std::ostream& out, Metric metric);
+
+}  // namespace heapprof
@@ -0,0 +1,302 @@
+// Cost of the heap profiler (heap_profile.h) at several sampling rates, on
+// malloc/free pairs and on building day8's std::map<std::string, int> word
+// counts. "libc" calls glibc's allocator directly, past the hooks. "idle"
+// has the hooks linked in but the profiler stopped, which is what every
+// program built with -DCPP30_HEAP_PROFILE=ON pays.
+// Build: g++ -std=c++17 -O2 heap_profile_bench.cpp heap_profile.cpp -o heap_profile_bench -pthread
+// Usage: ./heap_profile_bench [operations]   (default 2000000)
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "heap_profile.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void __libc_free(void* p);
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Bytes recorded at the sites whose stacks pass through function.
+struct Totals {
+    uint64_t allocated = 0;
+    uint64_t live = 0;
+};
+
+Totals sitesThrough(const std::string& function) {
+    Totals t;
+    for (const heapprof::Site& site : heapprof::snapshot()) {
+        for (const std::string& frame : site.frames) {
+            if (frame.find(function) != std::string::npos) {
+                t.allocated += site.allocatedBytes;
+                t.live += site.liveBytes;
+                break;
+            }
+        }
+    }
+    return t;
+}
+
+char* g_blocks[100];
+
+__attribute__((noinline)) void newArrays() {
+    for (char*& b : g_blocks) {
+        b = new char[1000];
+    }
+}
+
+__attribute__((noinline)) void* cAllocations(void** aligned) {
+    void* p = std::malloc(300);
+    void* q = std::calloc(10, 30);
+    p = std::realloc(p, 5000);
+    if (posix_memalign(aligned, 64, 128) != 0) {
+        std::abort();
+    }
+    asm volatile("" : : "r"(q) : "memory");  // or GCC drops the unused calloc/free pair
+    std::free(q);
+    return p;
+}
+
+struct alignas(256) Page {
+    char bytes[512];
+};
+
+__attribute__((noinline)) Page* alignedNew() {
+    Page* page = new Page;
+    asm volatile("" : : "r"(page) : "memory");  // not a tail call, so this frame stays on the stack
+    return page;
+}
+
+__attribute__((noinline)) uint64_t threadWork(unsigned seed) {
+    uint64_t total = 0;
+    void* held[64];
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        size_t size = 1 + (seed >> 16) % 512;
+        held[i % 64] = std::malloc(size);
+        total += size;
+        if (i % 64 == 63) {
+            for (void* p : held) {
+                std::free(p);
+            }
+        }
+    }
+    for (int i = 0; i < 20000 % 64; ++i) {
+        std::free(held[i]);
+    }
+    return total;
+}
+
+__attribute__((noinline)) uint64_t sampledWork() {
+    uint64_t total = 0;
+    std::vector<void*> held;
+    for (size_t i = 0; i < 50000; ++i) {
+        size_t size = 64 + (i * 2654435761u) % 4033;
+        held.push_back(std::malloc(size));
+        total += size;
+    }
+    for (void* p : held) {
+        std::free(p);
+    }
+    return total;
+}
+
+__attribute__((noinline)) void afterStop() {
+    char* p = new char[4096];
+    asm volatile("" : : "r"(p) : "memory");  // or GCC drops the new/delete pair
+    delete[] p;
+}
+
+bool check() {
+    // Every allocation sampled: the sites hold exact byte counts.
+    heapprof::reset();
+    heapprof::start(1);
+    newArrays();
+    void* aligned = nullptr;
+    void* c = cAllocations(&aligned);
+    Page* page = alignedNew();
+    heapprof::stop();
+    Totals arrays = sitesThrough("newArrays");
+    Totals cs = sitesThrough("cAllocations");
+    Totals pages = sitesThrough("alignedNew");
+    if (arrays.allocated != 100000 || arrays.live != 100000) {
+        return bench::fail("new[]: " + std::to_string(arrays.allocated) + " bytes allocated, " +
+                           std::to_string(arrays.live) + " live; expected 100000 and 100000");
+    }
+    if (cs.allocated != 300 + 300 + 5000 + 128 || cs.live != 5000 + 128) {
+        return bench::fail("malloc/calloc/realloc/posix_memalign: " + std::to_string(cs.allocated) + " allocated, " +
+                           std::to_string(cs.live) + " live; expected 5728 and 5128");
+    }
+    if (pages.allocated != sizeof(Page) || reinterpret_cast<uintptr_t>(page) % alignof(Page) != 0) {
+        return bench::fail("aligned operator new was not recorded");
+    }
+    for (char*& b : g_blocks) {
+        delete[] b;
+    }
+    std::free(c);
+    std::free(aligned);
+    delete page;
+    if (sitesThrough("newArrays").live != 0 || sitesThrough("cAllocations").live != 0 ||
+        sitesThrough("alignedNew").live != 0) {
+        return bench::fail("frees after stop() must still be subtracted");
+    }
+
+    std::ostringstream folded;
+    heapprof::writeFolded(folded, heapprof::Metric::Allocated);
+    bool found = false;
+    std::istringstream lines(folded.str());
+    for (std::string line; std::getline(lines, line);) {
+        size_t space = line.rfind(' ');
+        if (space == std::string::npos || space == 0 || space + 1 == line.size() ||
+            line.find_first_not_of("0123456789", space + 1) != std::string::npos) {
+            return bench::fail("not a folded stack line: " + line);
+        }
+        found = found || (line.find("newArrays") != std::string::npos && line.find("main") < line.find("newArrays"));
+    }
+    if (!found) {
+        return bench::fail("no folded stack runs from main to newArrays:\n" + folded.str());
+    }
+
+    heapprof::start(1);
+    afterStop();  // recorded: the profiler is running
+    heapprof::stop();
+    afterStop();
+    if (sitesThrough("afterStop").allocated != 4096) {
+        return bench::fail("allocations while stopped must not be recorded");
+    }
+
+    // Threads allocating and freeing at once: nothing lost, nothing left.
+    heapprof::reset();
+    heapprof::start(1);
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> expected(4);
+    for (unsigned t = 0; t < 4; ++t) {
+        threads.emplace_back([t, &expected] { expected[t] = threadWork(t + 1); });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    heapprof::stop();
+    Totals threaded = sitesThrough("threadWork");
+    uint64_t sum = expected[0] + expected[1] + expected[2] + expected[3];
+    if (threaded.allocated != sum || threaded.live != 0 || heapprof::stats().dropped != 0) {
+        return bench::fail("4 threads: " + std::to_string(threaded.allocated) + " bytes recorded, " +
+                           std::to_string(threaded.live) + " live; expected " + std::to_string(sum) + " and 0");
+    }
+
+    // Sampled: the estimate is unbiased, and frees cancel it exactly.
+    heapprof::reset();
+    heapprof::start(16 * 1024);
+    uint64_t actual = sampledWork();
+    heapprof::stop();
+    Totals sampled = sitesThrough("sampledWork");
+    double error = static_cast<double>(sampled.allocated) / static_cast<double>(actual) - 1;
+    if (std::abs(error) > 0.1 || sampled.live != 0) {
+        return bench::fail("1 sample per 16 KiB estimated " + std::to_string(sampled.allocated) + " bytes of " +
+                           std::to_string(actual) + ", " + std::to_string(sampled.live) + " live");
+    }
+    std::cout << "Sampling 1 per 16 KiB: " << heapprof::stats().samples << " samples estimate " << actual / 1000
+              << " KB allocated within " << std::setprecision(2) << std::abs(error) * 100 << "%." << std::endl;
+    heapprof::reset();
+    return true;
+}
+
+// ns per malloc/free pair, 64 blocks in flight, sizes 16..2063.
+template <typename Alloc, typename Free>
+double churn(size_t operations, Alloc alloc, Free release) {
+    void* held[64] = {};
+    uint32_t seed = 7;
+    auto start = Clock::now();
+    for (size_t i = 0; i < operations; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        void*& slot = held[i & 63];
+        release(slot);
+        slot = alloc(16 + (seed >> 21));
+    }
+    for (void*& slot : held) {
+        release(slot);
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(operations);
+}
+
+// day8's word count: a map node and often a heap string per new word.
+double wordCount(const std::vector<std::string>& words) {
+    auto start = Clock::now();
+    std::map<std::string, int> counts;
+    for (const std::string& w : words) {
+        ++counts[w];
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (counts.size() > words.size()) {
+        std::abort();
+    }
+    return ms;
+}
+
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    if (!heapprof::available()) {
+        std::cout << "The heap profiler is compiled out under sanitizers; nothing to measure." << std::endl;
+        return 0;
+    }
+    if (!check()) {
+        return 1;
+    }
+    std::cout << "Call-site attribution, live accounting, threads and folded output checks pass." << std::endl;
+
+    std::vector<std::string> words;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < operations / 4; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        uint32_t id = (seed >> 8) % (operations / 16 + 1);
+        words.push_back((id % 3 == 0 ? "a-rather-long-word-" : "w") + std::to_string(id));
+    }
+
+    std::cout << "\n" << operations << " malloc/free pairs, " << words.size()
+              << " words into a std::map; best of 3\n"
+              << std::setw(22) << "" << std::setw(14) << "ns/pair" << std::setw(12) << "map ms" << std::setw(12)
+              << "samples" << std::endl;
+    std::cout << std::fixed;
+    auto row = [&](const char* name, size_t rate, bool libc) {
+        double ns = 1e9, ms = 1e9;
+        heapprof::reset();
+        if (rate != 0) {
+            heapprof::start(rate);
+        }
+        for (int rep = 0; rep < 3; ++rep) {
+            if (libc) {
+                ns = std::min(ns, churn(operations, __libc_malloc, __libc_free));
+            } else {
+                ns = std::min(ns, churn(operations, std::malloc, std::free));
+                ms = std::min(ms, wordCount(words));
+            }
+        }
+        heapprof::stop();
+        std::cout << std::setw(22) << name << std::setprecision(1) << std::setw(14) << ns << std::setw(12);
+        if (libc) {
+            std::cout << "-";
+        } else {
+            std::cout << std::setprecision(2) << ms;
+        }
+        std::cout << std::setw(12) << heapprof::stats().samples << std::endl;
+    };
+    row("libc", 0, true);
+    row("idle", 0, false);
+    row("1 per 512 KiB", 512 * 1024, false);
+    row("1 per 64 KiB", 64 * 1024, false);
+    row("1 per 4 KiB", 4 * 1024, false);
+    row("every allocation", 1, false);
+    heapprof::reset();
+    return 0;
+}
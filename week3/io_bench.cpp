@@ -0,0 +1,317 @@
+// Loading and saving day13's student records: std::ifstream/ofstream
+// against aio::LineReader/FileWriter (async_io.h) on each backend. Cold
+// runs first drop the file from the page cache (fdatasync, then
+// POSIX_FADV_DONTNEED), so its reads go to the disk. Warm runs read it
+// from memory. "load" builds the vector<Student> and is bound by its
+// allocations. "scan" only counts lines, so the I/O shows.
+// Build: g++ -std=c++17 -O2 io_bench.cpp -o io_bench -pthread
+// Usage: ./io_bench [megabytes]   (default 32)
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "async_io.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Student {
+    std::string name;
+    int age;
+    std::string id;
+};
+
+// day13's loadStudents.
+std::vector<Student> loadIfstream(const std::string& path) {
+    std::vector<Student> students;
+    std::ifstream ifs(path);
+    while (ifs.peek() != EOF) {
+        Student s;
+        std::getline(ifs, s.name);
+        ifs >> s.age;
+        ifs.ignore();
+        std::getline(ifs, s.id);
+        students.push_back(s);
+    }
+    return students;
+}
+
+std::vector<Student> loadAio(const std::string& path, const aio::Options& options) {
+    std::vector<Student> students;
+    aio::LineReader in(path, options);
+    std::string_view name, age, id;
+    while (in.next(name)) {
+        Student s{std::string(name), 0, {}};
+        in.next(age);
+        size_t digits = age.find_first_not_of(" \t");
+        std::from_chars(age.data() + std::min(digits, age.size()), age.data() + age.size(), s.age);
+        in.next(id);
+        s.id = std::string(id);
+        students.push_back(std::move(s));
+    }
+    return students;
+}
+
+// A parse light enough for the reads to matter: lines and their bytes.
+uint64_t scanIfstream(const std::string& path) {
+    std::ifstream ifs(path);
+    uint64_t sum = 0;
+    for (std::string line; std::getline(ifs, line);) {
+        sum += line.size() + 1;
+    }
+    return sum;
+}
+
+uint64_t scanAio(const std::string& path, const aio::Options& options) {
+    aio::LineReader in(path, options);
+    uint64_t sum = 0;
+    for (std::string_view line; in.next(line);) {
+        sum += line.size() + 1;
+    }
+    return sum;
+}
+
+void saveOfstream(const std::vector<Student>& students, const std::string& path) {
+    std::ofstream ofs(path);
+    for (const Student& s : students) {
+        ofs << s.name << '\n' << s.age << '\n' << s.id << '\n';
+    }
+}
+
+void saveAio(const std::vector<Student>& students, const std::string& path, const aio::Options& options) {
+    aio::FileWriter out(path, aio::FileWriter::kTruncate, options);
+    for (const Student& s : students) {
+        out << s.name << '\n' << s.age << '\n' << s.id << '\n';
+    }
+}
+
+void dropCache(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+std::string slurp(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream all;
+    all << in.rdbuf();
+    return all.str();
+}
+
+void spit(const std::string& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+bool checkBackend(const std::string& path, aio::Backend backend, unsigned depth, size_t chunk) {
+    aio::Options options;
+    options.backend = backend;
+    options.depth = depth;
+    options.chunk = chunk;
+    std::string where = std::string(" (depth ") + std::to_string(depth) + ", chunk " + std::to_string(chunk) + ")";
+
+    std::string longLine(3 * chunk + 5, 'x');
+    const std::vector<std::string> texts = {"",          "a",         "a\n",        "\n\n",
+                                            "ab\ncd",    "one\n\nthree\n", longLine, "s\n" + longLine + "\nt",
+                                            std::string(chunk, '\n'), std::string(2 * chunk + 1, 'y') + "\n"};
+    for (const std::string& text : texts) {
+        spit(path, text);
+        aio::FileReader reader(path, options);
+        std::string got;
+        for (std::string_view chunkView; reader.next(chunkView);) {
+            got.append(chunkView.data(), chunkView.size());
+        }
+        if (!reader || got != text) {
+            std::cerr << reader.backend() << " FileReader returned the wrong bytes" << where << std::endl;
+            return false;
+        }
+        std::vector<std::string> expected, lines;
+        std::istringstream ss(text);
+        for (std::string line; std::getline(ss, line);) {
+            expected.push_back(line);
+        }
+        aio::LineReader lr(path, options);
+        for (std::string_view line; lr.next(line);) {
+            lines.emplace_back(line);
+        }
+        if (lines != expected) {
+            std::cerr << lr.file().backend() << " LineReader differs from std::getline" << where << std::endl;
+            return false;
+        }
+    }
+
+    // Pieces of every size, then an append that must land after them.
+    std::mt19937 rng(static_cast<unsigned>(depth * 131 + chunk));
+    std::string text;
+    {
+        aio::FileWriter out(path, aio::FileWriter::kTruncate, options);
+        for (int i = 0; i < 400; ++i) {
+            std::string piece(rng() % (2 * chunk + 3), static_cast<char>('a' + i % 26));
+            out.write(piece);
+            text += piece;
+            if (i % 7 == 0) {
+                out.writeBehind();
+            }
+        }
+        out << 12345 << ' ' << -7 << '\n';
+        text += "12345 -7\n";
+    }
+    {
+        aio::FileWriter out(path, aio::FileWriter::kAppend, options);
+        out << "appended\n";
+        text += "appended\n";
+    }
+    if (slurp(path) != text) {
+        std::cerr << "FileWriter wrote the wrong bytes" << where << std::endl;
+        return false;
+    }
+
+    // Two appenders on one file (as two processes logging to log.txt would
+    // be): nothing is overwritten and each writer's bytes stay in order.
+    // Writes interleave at buffer boundaries, so lines longer than a chunk
+    // may be split, as with two ofstreams in ios::app mode.
+    std::string firstText, secondText;
+    {
+        aio::FileWriter first(path, aio::FileWriter::kAppend, options);
+        aio::FileWriter second(path, aio::FileWriter::kAppend, options);
+        for (int i = 0; i < 100; ++i) {
+            std::string upper(chunk + 1, static_cast<char>('A' + i % 26));
+            std::string lower(chunk + 1, static_cast<char>('a' + i % 26));
+            first << upper;
+            first.writeBehind();
+            second << lower;
+            second.writeBehind();
+            firstText += upper;
+            secondText += lower;
+        }
+    }
+    std::string appended = slurp(path);
+    if (appended.size() != text.size() + firstText.size() + secondText.size() ||
+        appended.compare(0, text.size(), text) != 0) {
+        std::cerr << "kAppend writers overwrote each other" << where << std::endl;
+        return false;
+    }
+    std::string gotFirst, gotSecond;
+    for (size_t i = text.size(); i < appended.size(); ++i) {
+        (appended[i] >= 'A' && appended[i] <= 'Z' ? gotFirst : gotSecond) += appended[i];
+    }
+    if (gotFirst != firstText || gotSecond != secondText) {
+        std::cerr << "kAppend reordered a writer's bytes" << where << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool check(const std::string& dir) {
+    std::string path = dir + "/io_bench.check";
+    for (aio::Backend backend : {aio::Backend::Sync, aio::Backend::Threads, aio::Backend::Auto}) {
+        for (unsigned depth : {1u, 2u, 3u}) {
+            for (size_t chunk : {size_t(7), size_t(4096)}) {
+                if (!checkBackend(path, backend, depth, chunk)) {
+                    return false;
+                }
+            }
+        }
+    }
+    ::unlink(path.c_str());
+    aio::FileReader missing(dir + "/no such file");
+    std::string_view chunk;
+    aio::FileWriter nowhere(dir + "/no such dir/file");
+    nowhere << "dropped\n";
+    nowhere.flush();
+    if (missing || missing.error() != ENOENT || missing.next(chunk) || nowhere || nowhere.error() != ENOENT) {
+        std::cerr << "a missing file must fail with ENOENT" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    double megabytes = argc > 1 ? std::stod(argv[1]) : 32;
+    if (!check(".")) {
+        return 1;
+    }
+    std::cout << "FileReader, LineReader and FileWriter checks pass on sync, threads and "
+              << aio::makeQueue(aio::Backend::Auto, 1)->name() << "." << std::endl;
+
+    std::vector<Student> students;
+    size_t bytes = 0;
+    std::mt19937 rng(42);
+    while (bytes < megabytes * 1e6) {
+        Student s{"Student " + std::to_string(students.size()), 18 + static_cast<int>(rng() % 10),
+                  "S" + std::to_string(1000000 + students.size())};
+        bytes += s.name.size() + s.id.size() + 5;
+        students.push_back(std::move(s));
+    }
+    const std::string path = "io_bench.students.txt";
+    double mb = static_cast<double>(bytes) / 1e6;
+
+    struct Way {
+        const char* name;
+        aio::Backend backend;
+        unsigned depth;
+        bool registered;
+    };
+    const Way ways[] = {
+        {"sync, depth 1", aio::Backend::Sync, 1, false},         {"threads, depth 2", aio::Backend::Threads, 2, false},
+        {"io_uring, depth 2", aio::Backend::Uring, 2, false},    {"io_uring+reg, depth 2", aio::Backend::Uring, 2, true},
+        {"io_uring+reg, depth 4", aio::Backend::Uring, 4, true},
+    };
+    auto optionsFor = [](const Way& w) {
+        aio::Options o;
+        o.backend = w.backend;
+        o.depth = w.depth;
+        o.registerBuffers = w.registered;
+        return o;
+    };
+    auto timed = [](auto f) {
+        auto start = Clock::now();
+        f();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    std::cout << "\n" << students.size() << " students, " << std::fixed << std::setprecision(1) << mb
+              << " MB; MB/s, best of 3\n"
+              << std::setw(24) << "" << std::setw(10) << "save" << std::setw(12) << "load cold" << std::setw(12)
+              << "load warm" << std::setw(12) << "scan cold" << std::setw(12) << "scan warm" << std::endl;
+    auto row = [&](const char* name, auto save, auto load, auto scan) {
+        double s = 1e9, cold = 1e9, warm = 1e9, scanCold = 1e9, scanWarm = 1e9;
+        bool ok = true;
+        for (int rep = 0; rep < 3; ++rep) {
+            s = std::min(s, timed(save));
+            dropCache(path);
+            cold = std::min(cold, timed([&] { ok = ok && load().size() == students.size(); }));
+            warm = std::min(warm, timed([&] { ok = ok && load().size() == students.size(); }));
+            dropCache(path);
+            scanCold = std::min(scanCold, timed([&] { ok = ok && scan() == bytes; }));
+            scanWarm = std::min(scanWarm, timed([&] { ok = ok && scan() == bytes; }));
+        }
+        if (!ok) {
+            std::cerr << name << " did not read the whole file" << std::endl;
+        }
+        std::cout << std::setw(24) << name << std::setw(10) << mb / s << std::setw(12) << mb / cold << std::setw(12)
+                  << mb / warm << std::setw(12) << mb / scanCold << std::setw(12) << mb / scanWarm << std::endl;
+    };
+    row("ifstream/ofstream", [&] { saveOfstream(students, path); }, [&] { return loadIfstream(path); },
+        [&] { return scanIfstream(path); });
+    for (const Way& w : ways) {
+        aio::Options o = optionsFor(w);
+        row(w.name, [&] { saveAio(students, path, o); }, [&] { return loadAio(path, o); },
+            [&] { return scanAio(path, o); });
+    }
+    ::unlink(path.c_str());
+    return 0;
+}
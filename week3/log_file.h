@@ -0,0 +1,223 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "async_io.h"
+#include "lz.h"
+#include "trace.h"
+
+// Log sink shared by any number of threads: plain text, or lz frames
+// compressed off the callers' threads.
+//
+//   LogFile::Options options = LogFile::Options::fromEnvironment();
+//   LogFile log(LogFile::pathFor("log.txt", options), options);
+//   log.writeLine("Drawing Circle");
+//
+// Plain: each write goes into an aio::FileWriter under the mutex and is
+// handed to the kernel at once (writeBehind), so a line reaches the file
+// promptly and lines logged during a write share the next one.
+//
+// Compressed: a write only appends to a block in memory. A background
+// thread takes the block once it holds blockSize bytes, or maxDelay after
+// its first line, compresses it into one lz frame (lz.h) while callers
+// fill the next block, and writes the frame behind. The file is a
+// sequence of frames; `lzcat log.txt.lz` prints the text. If the thread
+// falls maxBuffered bytes behind, writers wait for it rather than let the
+// buffer grow without bound. A crash loses at most the last maxDelay of
+// lines, which were never written.
+struct LogFileOptions {
+    bool compress = false;
+    size_t blockSize = 64 * 1024;
+    std::chrono::milliseconds maxDelay{50};
+    size_t maxBuffered = 16 * 1024 * 1024;
+    aio::Options io;
+
+    // compress is set by CPP30_LOG_COMPRESS (anything but empty or "0").
+    static LogFileOptions fromEnvironment() {
+        LogFileOptions options;
+        const char* value = std::getenv("CPP30_LOG_COMPRESS");
+        options.compress = value && *value && std::string_view(value) != "0";
+        return options;
+    }
+};
+
+class LogFile {
+public:
+    using Options = LogFileOptions;
+
+    struct Stats {
+        uint64_t rawBytes = 0;     // written by callers
+        uint64_t storedBytes = 0;  // written to the file so far
+        uint64_t frames = 0;
+        double compressSeconds = 0;
+    };
+
+    // Where a log named path goes with these options: path.lz if compressed.
+    static std::string pathFor(const std::string& path, const Options& options) {
+        return options.compress ? path + ".lz" : path;
+    }
+
+    // Appends to path.
+    explicit LogFile(const std::string& path, const Options& options = Options())
+        : options_(options), file_(path, aio::FileWriter::kAppend, options.io) {
+        if (options_.compress && file_) {
+            thread_ = std::thread([this] { run(); });
+        }
+    }
+
+    // Writes everything still buffered.
+    ~LogFile() {
+        if (thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+    }
+
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+
+    explicit operator bool() const { return static_cast<bool>(file_); }
+    bool compressed() const { return options_.compress; }
+
+    void write(std::string_view s) { append(s, {}); }
+
+    // s and a newline, as one write.
+    void writeLine(std::string_view s) { append(s, "\n"); }
+
+    LogFile& operator<<(std::string_view s) {
+        write(s);
+        return *this;
+    }
+
+    // Waits until everything written so far is in the file (the page
+    // cache; this is not fsync).
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) {
+            file_.flush();
+            return;
+        }
+        uint64_t target = appended_;
+        flushRequested_ = true;
+        wake_.notify_one();
+        drained_.wait(lock, [&] { return flushed_ >= target; });
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats s = stats_;
+        s.rawBytes = appended_;
+        if (!thread_.joinable()) {
+            s.storedBytes = appended_;
+        }
+        return s;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void append(std::string_view s, std::string_view tail) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool compressing = thread_.joinable();
+        if (compressing && pending_.size() >= options_.maxBuffered) {
+            drained_.wait(lock, [this] { return pending_.size() < options_.maxBuffered; });
+        }
+        // The lock hold time: in a trace, a caller's zone (e.g. "Logger::log")
+        // minus this one is the time spent waiting for the mutex, or for the
+        // compressor to catch up.
+        TRACE_SCOPE("LogFile::append locked");
+        if (!compressing) {
+            file_.write(s);
+            file_.write(tail);
+            file_.writeBehind();
+            appended_ += s.size() + tail.size();
+            return;
+        }
+        size_t before = pending_.size();
+        if (before == 0) {
+            pendingSince_ = Clock::now();
+        }
+        pending_.append(s);
+        pending_.append(tail);
+        appended_ += s.size() + tail.size();
+        // The thread sleeps until a deadline, so it only needs to hear of
+        // the first line of a block and of the block filling up.
+        if (before == 0 || (before < options_.blockSize && pending_.size() >= options_.blockSize)) {
+            wake_.notify_one();
+        }
+    }
+
+    void run() {
+        std::string block;
+        std::string frames;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            auto ready = [this] {
+                return stop_ || flushRequested_ || pending_.size() >= options_.blockSize;
+            };
+            if (pending_.empty()) {
+                wake_.wait(lock, [this] { return stop_ || flushRequested_ || !pending_.empty(); });
+            } else {
+                wake_.wait_until(lock, pendingSince_ + options_.maxDelay, ready);
+            }
+            if (pending_.empty() && !flushRequested_) {
+                if (stop_) {
+                    break;
+                }
+                continue;
+            }
+            block.swap(pending_);  // callers go on filling the other buffer
+            pending_.clear();
+            uint64_t upto = appended_;
+            bool flush = flushRequested_;
+            flushRequested_ = false;
+            drained_.notify_all();
+            lock.unlock();
+
+            auto start = Clock::now();
+            frames.clear();
+            for (size_t at = 0; at < block.size(); at += options_.blockSize) {
+                lz::appendFrame(std::string_view(block).substr(at, options_.blockSize), frames);
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            file_.write(frames);
+            if (flush) {
+                file_.flush();
+            } else {
+                file_.writeBehind();
+            }
+
+            lock.lock();
+            stats_.storedBytes += frames.size();
+            stats_.frames += (block.size() + options_.blockSize - 1) / options_.blockSize;
+            stats_.compressSeconds += seconds;
+            flushed_ = upto;
+            drained_.notify_all();
+        }
+    }
+
+    Options options_;
+    aio::FileWriter file_;  // under mutex_ when plain, the thread's when compressed
+    std::mutex mutex_;
+    std::condition_variable wake_;     // the thread: work to do
+    std::condition_variable drained_;  // writers: room in the buffer, or a flush done
+    std::string pending_;
+    Clock::time_point pendingSince_;
+    uint64_t appended_ = 0;
+    uint64_t flushed_ = 0;
+    bool flushRequested_ = false;
+    bool stop_ = false;
+    Stats stats_;
+    std::thread thread_;
+};
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Fast LZ77 block compression and a framed file format for logs.
+//
+//   std::string out;
+//   lz::appendFrame(text, out);                        // one self-contained frame
+//   ...
+//   lz::FrameHeader h;
+//   if (lz::parseFrameHeader(p, h)) lz::decodeFrame(h, p + lz::kFrameHeader, raw);
+//
+// The block format is LZ4's: a sequence is a token byte (literal count in
+// the high nibble, match length minus 4 in the low one, 15 meaning "more
+// bytes follow, 255 each"), the literals, and a 16-bit offset back into
+// the output. The last sequence has literals only. The compressor is a
+// greedy single-probe matcher: 4 bytes are hashed into a 16 KiB table of
+// positions, a hit is extended backwards and forwards eight bytes at a
+// time, and after 64 misses in a row it probes every second byte, then
+// every third, and so on, so incompressible input is skipped quickly.
+// Log lines repeat their timestamps, levels and messages within a few
+// hundred bytes, which is what a 64 KiB window catches. Both directions
+// copy whole words and may overshoot into space written next, which
+// maxCompressedSize leaves room for.
+//
+// A frame is a 16-byte header (magic, raw size, stored size with the top
+// bit set for a block stored uncompressed, checksum of the raw bytes)
+// followed by the block. Frames share nothing, so a file of them can be
+// appended to and a damaged frame loses only itself.
+namespace lz {
+
+constexpr uint32_t kFrameMagic = 0x315A4C43;  // "CLZ1"
+constexpr size_t kFrameHeader = 16;
+constexpr uint32_t kStored = 0x80000000u;
+constexpr size_t kMaxBlock = 64 * 1024 * 1024;  // larger raw sizes are taken for corruption
+
+// Worst case for n bytes (all literals), plus slack for word copies.
+constexpr size_t maxCompressedSize(size_t n) {
+    return n + n / 255 + 32;
+}
+
+namespace detail {
+
+constexpr unsigned kHashLog = 12;
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5;   // the block always ends in literals
+constexpr size_t kMatchSearchEnd = 12;  // no match starts this close to the end
+constexpr size_t kMaxOffset = 65535;
+constexpr unsigned kSkipTrigger = 6;
+
+inline uint32_t load32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t load64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline void store32(char* p, uint32_t v) {
+    std::memcpy(p, &v, 4);
+}
+
+inline uint32_t hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - kHashLog);
+}
+
+// Bytes equal at a and b, reading no further than limit on b's side.
+inline size_t matchLength(const char* a, const char* b, const char* limit) {
+    const char* start = b;
+    while (b + 8 <= limit) {
+        uint64_t diff = load64(a) ^ load64(b);
+        if (diff != 0) {
+            return static_cast<size_t>(b - start) + static_cast<size_t>(__builtin_ctzll(diff) / 8);
+        }
+        a += 8;
+        b += 8;
+    }
+    while (b < limit && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return static_cast<size_t>(b - start);
+}
+
+inline char* writeLength(char* op, size_t n) {
+    for (; n >= 255; n -= 255) {
+        *op++ = static_cast<char>(255);
+    }
+    *op++ = static_cast<char>(n);
+    return op;
+}
+
+inline char* writeSequence(char* op, const char* literals, size_t literalCount, size_t offset, size_t matchLength) {
+    char* token = op++;
+    unsigned high = literalCount >= 15 ? 15 : static_cast<unsigned>(literalCount);
+    if (literalCount >= 15) {
+        op = writeLength(op, literalCount - 15);
+    }
+    unsigned low = 0;
+    if (matchLength == 0) {
+        std::memcpy(op, literals, literalCount);
+        op += literalCount;
+    } else {
+        // Literals before a match end at least kMatchSearchEnd bytes before
+        // the input does, and dst has slack, so whole words may be copied.
+        for (size_t i = 0; i < literalCount; i += 8) {
+            std::memcpy(op + i, literals + i, 8);
+        }
+        op += literalCount;
+        *op++ = static_cast<char>(offset & 0xff);
+        *op++ = static_cast<char>(offset >> 8);
+        size_t extra = matchLength - kMinMatch;
+        low = extra >= 15 ? 15 : static_cast<unsigned>(extra);
+        if (extra >= 15) {
+            op = writeLength(op, extra - 15);
+        }
+    }
+    *token = static_cast<char>((high << 4) | low);
+    return op;
+}
+
+inline bool readLength(const char*& ip, const char* end, size_t& n) {
+    for (;;) {
+        if (ip == end) {
+            return false;
+        }
+        unsigned char b = static_cast<unsigned char>(*ip++);
+        n += b;
+        if (b != 255) {
+            return true;
+        }
+    }
+}
+
+// Writes the sequences of src that end in a match at op and returns where
+// the final literals begin. The search hashes the next position while it
+// compares the current one, LZ4's way, so the two overlap.
+inline const char* compressMatches(const char* src, size_t n, char*& op, unsigned acceleration) {
+    const char* anchor = src;
+    if (n < kMatchSearchEnd + 1) {
+        return anchor;
+    }
+    uint32_t table[1u << kHashLog] = {};
+    const char* ip = src + 1;
+    const char* searchEnd = src + n - kMatchSearchEnd;
+    const char* matchEnd = src + n - kLastLiterals;
+    uint32_t h = hash(load32(ip));
+    for (;;) {
+        const char* match;
+        const char* next = ip;
+        unsigned misses = acceleration << kSkipTrigger;
+        do {
+            ip = next;
+            next += misses++ >> kSkipTrigger;
+            if (next > searchEnd) {
+                return anchor;
+            }
+            match = src + table[h];
+            table[h] = static_cast<uint32_t>(ip - src);
+            h = hash(load32(next));
+        } while (static_cast<size_t>(ip - match) > kMaxOffset || load32(match) != load32(ip));
+        while (ip > anchor && match > src && ip[-1] == match[-1]) {
+            --ip;
+            --match;
+        }
+        for (;;) {
+            size_t length = kMinMatch + matchLength(match + kMinMatch, ip + kMinMatch, matchEnd);
+            op = writeSequence(op, anchor, static_cast<size_t>(ip - anchor), static_cast<size_t>(ip - match), length);
+            ip += length;
+            anchor = ip;
+            if (ip > searchEnd) {
+                return anchor;
+            }
+            table[hash(load32(ip - 2))] = static_cast<uint32_t>(ip - 2 - src);
+            // Fields of a log line often match again straight away.
+            uint32_t at = hash(load32(ip));
+            match = src + table[at];
+            table[at] = static_cast<uint32_t>(ip - src);
+            if (static_cast<size_t>(ip - match) > kMaxOffset || load32(match) != load32(ip)) {
+                break;
+            }
+        }
+        h = hash(load32(++ip));
+    }
+}
+
+}  // namespace detail
+
+// Compresses src[0, n) into dst, which holds maxCompressedSize(n) bytes,
+// and returns the compressed size. A higher acceleration probes fewer
+// positions between matches: faster, and a worse ratio.
+inline size_t compress(const char* src, size_t n, char* dst, unsigned acceleration = 1) {
+    char* op = dst;
+    const char* anchor = detail::compressMatches(src, n, op, acceleration);
+    op = detail::writeSequence(op, anchor, static_cast<size_t>(src + n - anchor), 0, 0);
+    return static_cast<size_t>(op - dst);
+}
+
+// Decompresses a block into exactly rawSize bytes at dst. False if the
+// block is malformed or does not produce rawSize bytes; it never reads or
+// writes out of bounds either way.
+inline bool decompress(const char* src, size_t n, char* dst, size_t rawSize) {
+    using namespace detail;
+    const char* ip = src;
+    const char* iend = src + n;
+    char* op = dst;
+    char* oend = dst + rawSize;
+    while (ip < iend) {
+        unsigned token = static_cast<unsigned char>(*ip++);
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(ip, iend, literals)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(iend - ip) || literals > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        if (static_cast<size_t>(iend - ip) >= literals + 16 && static_cast<size_t>(oend - op) >= literals + 16) {
+            for (size_t i = 0; i < literals; i += 16) {
+                std::memcpy(op + i, ip + i, 16);
+            }
+        } else {
+            std::memcpy(op, ip, literals);
+        }
+        op += literals;
+        ip += literals;
+        if (ip == iend) {
+            break;  // the last sequence has no match
+        }
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = static_cast<unsigned char>(ip[0]) | static_cast<size_t>(static_cast<unsigned char>(ip[1])) << 8;
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(ip, iend, length)) {
+            return false;
+        }
+        length += kMinMatch;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst) || length > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        const char* match = op - offset;
+        if (offset >= 16 && static_cast<size_t>(oend - op) >= length + 16) {
+            char* end = op + length;
+            for (char* p = op; p < end; p += 16, match += 16) {
+                std::memcpy(p, match, 16);
+            }
+            op = end;
+        } else if (offset >= 8 && static_cast<size_t>(oend - op) >= length + 8) {
+            // Eight bytes at a time, overshooting into space written later.
+            char* end = op + length;
+            for (char* p = op; p < end; p += 8, match += 8) {
+                std::memcpy(p, match, 8);
+            }
+            op = end;
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                op[i] = match[i];  // overlapping: repeats the last offset bytes
+            }
+            op += length;
+        }
+    }
+    return op == oend;
+}
+
+// 32-bit hash of a block, for the frame checksum.
+inline uint32_t checksum(const char* p, size_t n) {
+    uint64_t h = 0x9E3779B97F4A7C15u ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        h = (h ^ detail::load64(p + i)) * 0xFF51AFD7ED558CCDu;
+        h ^= h >> 32;
+    }
+    for (; i < n; ++i) {
+        h = (h ^ static_cast<unsigned char>(p[i])) * 0xC4CEB9FE1A85EC53u;
+    }
+    h ^= h >> 29;
+    return static_cast<uint32_t>(h);
+}
+
+struct FrameHeader {
+    uint32_t rawSize = 0;
+    uint32_t storedSize = 0;  // bytes of block after the header
+    bool compressed = true;
+    uint32_t checksum = 0;
+};
+
+// Appends raw as one frame, stored uncompressed if compression does not
+// shrink it.
+inline void appendFrame(std::string_view raw, std::string& out, unsigned acceleration = 1) {
+    size_t at = out.size();
+    out.resize(at + kFrameHeader + maxCompressedSize(raw.size()));
+    char* header = &out[at];
+    size_t stored = compress(raw.data(), raw.size(), header + kFrameHeader, acceleration);
+    uint32_t flags = 0;
+    if (stored >= raw.size()) {
+        std::memcpy(header + kFrameHeader, raw.data(), raw.size());
+        stored = raw.size();
+        flags = kStored;
+    }
+    detail::store32(header, kFrameMagic);
+    detail::store32(header + 4, static_cast<uint32_t>(raw.size()));
+    detail::store32(header + 8, static_cast<uint32_t>(stored) | flags);
+    detail::store32(header + 12, checksum(raw.data(), raw.size()));
+    out.resize(at + kFrameHeader + stored);
+}
+
+// Reads kFrameHeader bytes at p. False if they are not a frame header.
+inline bool parseFrameHeader(const char* p, FrameHeader& h) {
+    if (detail::load32(p) != kFrameMagic) {
+        return false;
+    }
+    h.rawSize = detail::load32(p + 4);
+    uint32_t stored = detail::load32(p + 8);
+    h.compressed = (stored & kStored) == 0;
+    h.storedSize = stored & ~kStored;
+    h.checksum = detail::load32(p + 12);
+    return h.rawSize <= kMaxBlock && h.storedSize <= maxCompressedSize(h.rawSize) &&
+           (h.compressed || h.storedSize == h.rawSize);
+}
+
+// Decodes a frame's block (h.storedSize bytes at block) into out, which
+// holds h.rawSize bytes, and verifies the checksum.
+inline bool decodeFrame(const FrameHeader& h, const char* block, char* out) {
+    if (h.compressed) {
+        if (!decompress(block, h.storedSize, out, h.rawSize)) {
+            return false;
+        }
+    } else {
+        std::memcpy(out, block, h.rawSize);
+    }
+    return checksum(out, h.rawSize) == h.checksum;
+}
+
+}  // namespace lz
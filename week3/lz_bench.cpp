@@ -0,0 +1,411 @@
+// Compression ratio and speed of the lz block codec (lz.h) on log text, and
+// what LogFile's compressed mode (log_file.h) costs the threads that log.
+// The log text is generated in day18's shape with the timestamp, level,
+// thread and fields a production log line carries; pass a file to measure
+// that instead.
+// Build: g++ -std=c++17 -O2 lz_bench.cpp -o lz_bench -pthread
+// Usage: ./lz_bench [MiB] [lines] [file] [--filter=KiB] [--samples=n] [--min-time=ms] [--json]
+//        (default 64 MiB of generated log text, 1000000 distinct logged lines)
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "log_file.h"
+#include "lz.h"
+
+// Lines like a service's log: a timestamp that advances, a level, a
+// worker, one of a few dozen messages and some numbers.
+std::string logText(size_t bytes, uint32_t seed) {
+    static const char* const levels[] = {"INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR"};
+    static const char* const messages[] = {
+        "Drawing Circle", "Drawing Square", "Log entry from writer 1", "Log entry from writer 2",
+        "request served", "cache miss, reading page", "connection accepted from 10.0.3.17",
+        "retrying write after EAGAIN", "timer fired late", "queue depth above threshold",
+        "checkpoint written", "student record updated", "contact saved", "lookup finished"};
+    std::mt19937 rng(seed);
+    std::string text;
+    text.reserve(bytes + 256);
+    uint64_t micros = 1760796207000000;
+    char line[256];
+    while (text.size() < bytes) {
+        micros += rng() % 900;
+        uint64_t seconds = micros / 1000000;
+        int n = std::snprintf(line, sizeof(line),
+                              "2026-10-18 %02u:%02u:%02u.%06u %s [worker-%u] %s id=%u latency_us=%u bytes=%u\n",
+                              static_cast<unsigned>(seconds / 3600 % 24), static_cast<unsigned>(seconds / 60 % 60),
+                              static_cast<unsigned>(seconds % 60), static_cast<unsigned>(micros % 1000000),
+                              levels[rng() % std::size(levels)], static_cast<unsigned>(rng() % 8),
+                              messages[rng() % std::size(messages)], static_cast<unsigned>(rng() % 100000),
+                              static_cast<unsigned>(rng() % 2000), static_cast<unsigned>(rng() % 65536));
+        text.append(line, static_cast<size_t>(n));
+    }
+    text.resize(bytes);
+    return text;
+}
+
+bool roundTrip(const std::string& raw, const std::string& what) {
+    std::vector<char> packed(lz::maxCompressedSize(raw.size()));
+    size_t n = lz::compress(raw.data(), raw.size(), packed.data());
+    if (n > packed.size()) {
+        return bench::fail(what + ": compressed past maxCompressedSize");
+    }
+    std::string back(raw.size(), '\0');
+    if (!lz::decompress(packed.data(), n, back.data(), back.size()) || back != raw) {
+        return bench::fail(what + ": round trip of " + std::to_string(raw.size()) + " bytes");
+    }
+    std::string frame;
+    lz::appendFrame(raw, frame);
+    lz::FrameHeader h;
+    back.assign(raw.size(), '\0');
+    if (!lz::parseFrameHeader(frame.data(), h) || frame.size() != lz::kFrameHeader + h.storedSize ||
+        !lz::decodeFrame(h, frame.data() + lz::kFrameHeader, back.data()) || back != raw) {
+        return bench::fail(what + ": frame round trip of " + std::to_string(raw.size()) + " bytes");
+    }
+    return true;
+}
+
+// Raw text of a file of frames; false if any frame is bad.
+bool readFrames(const std::string& path, std::string& text, size_t& frames) {
+    std::ifstream in(path, std::ios::binary);
+    std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    text.clear();
+    frames = 0;
+    for (size_t at = 0; at < file.size(); ++frames) {
+        lz::FrameHeader h;
+        if (file.size() - at < lz::kFrameHeader || !lz::parseFrameHeader(file.data() + at, h) ||
+            file.size() - at - lz::kFrameHeader < h.storedSize) {
+            return false;
+        }
+        size_t old = text.size();
+        text.resize(old + h.rawSize);
+        if (!lz::decodeFrame(h, file.data() + at + lz::kFrameHeader, &text[old])) {
+            return false;
+        }
+        at += lz::kFrameHeader + h.storedSize;
+    }
+    return true;
+}
+
+bool checkCodec() {
+    std::mt19937 rng(5);
+    auto random = [&rng](size_t n) {
+        std::string s(n, '\0');
+        for (char& c : s) {
+            c = static_cast<char>(rng());
+        }
+        return s;
+    };
+    for (size_t n = 0; n < 40; ++n) {
+        if (!roundTrip(random(n), "random") || !roundTrip(std::string(n, 'x'), "one byte repeated")) {
+            return false;
+        }
+    }
+    if (!roundTrip(std::string(300000, 'x'), "a long run") || !roundTrip(random(300000), "incompressible") ||
+        !roundTrip(logText(1 << 20, 1), "log text")) {
+        return false;
+    }
+    // Literal runs and matches of every length around the 15 and 15 + 255
+    // boundaries of the length encoding, at offsets from 1 (overlapping)
+    // up to the 64 KiB window and past it.
+    for (int i = 0; i < 3000; ++i) {
+        std::string s = random(rng() % 64);
+        while (s.size() < 1000 + rng() % 100000) {
+            size_t length = rng() % 3 == 0 ? 250 + rng() % 40 : rng() % 40;
+            if (rng() % 2 == 0 || s.empty()) {
+                s += random(length);
+            } else {
+                size_t offset = 1 + (rng() % 4 == 0 ? rng() % 70000 : rng() % 20);
+                offset = std::min(offset, s.size());
+                for (size_t k = 0; k < length; ++k) {
+                    s.push_back(s[s.size() - offset]);
+                }
+            }
+        }
+        if (!roundTrip(s, "mixed input " + std::to_string(i))) {
+            return false;
+        }
+    }
+
+    // Damaged blocks and frames are rejected without reading or writing
+    // out of bounds (the asan build checks the latter).
+    std::string raw = logText(200000, 2);
+    std::string frame;
+    lz::appendFrame(raw, frame);
+    lz::FrameHeader h;
+    lz::parseFrameHeader(frame.data(), h);
+    const char* block = frame.data() + lz::kFrameHeader;
+    std::string out(raw.size(), '\0');
+    for (size_t cut = 0; cut < h.storedSize; cut += cut < 300 ? 1 : 997) {
+        std::vector<char> truncated(block, block + cut);  // exactly cut bytes, so asan sees overreads
+        if (lz::decompress(truncated.data(), cut, out.data(), out.size())) {
+            return bench::fail("a block cut to " + std::to_string(cut) + " bytes decoded");
+        }
+    }
+    for (int i = 0; i < 3000; ++i) {
+        std::string damaged = frame;
+        size_t at = lz::kFrameHeader + rng() % h.storedSize;
+        damaged[at] = static_cast<char>(damaged[at] ^ (1 + rng() % 255));
+        // A changed offset can point at the same text elsewhere: that
+        // frame still decodes to the original, which is fine.
+        if (lz::decodeFrame(h, damaged.data() + lz::kFrameHeader, out.data()) && out != raw) {
+            return bench::fail("a frame damaged at byte " + std::to_string(at) + " decoded to other text");
+        }
+    }
+    std::vector<char> small(100);
+    if (lz::decompress(block, h.storedSize, small.data(), small.size())) {
+        return bench::fail("a block decoded into too small a buffer");
+    }
+    std::string header = frame.substr(0, lz::kFrameHeader);
+    header[0] = 'x';
+    if (lz::parseFrameHeader(header.data(), h)) {
+        return bench::fail("a header without the magic parsed");
+    }
+    return true;
+}
+
+bool checkLogFile(const std::string& path) {
+    // Four threads logging at once into small blocks: every line arrives,
+    // in each thread's order, across many frames.
+    std::filesystem::remove(path);
+    LogFile::Options options;
+    options.compress = true;
+    options.blockSize = 4096;
+    LogFile::Stats stats;
+    {
+        LogFile log(path, options);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < 20000; ++i) {
+                    log.writeLine("thread " + std::to_string(t) + " line " + std::to_string(i));
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        log.flush();
+        stats = log.stats();
+    }
+    std::string text;
+    size_t frames;
+    if (!readFrames(path, text, frames)) {
+        return bench::fail("LogFile wrote a bad frame");
+    }
+    if (frames < 10 || stats.frames == 0 || stats.storedBytes >= stats.rawBytes || stats.rawBytes != text.size()) {
+        return bench::fail("LogFile wrote " + std::to_string(frames) + " frames, " + std::to_string(text.size()) +
+                           " bytes");
+    }
+    int next[4] = {};
+    for (size_t at = 0; at < text.size();) {
+        size_t nl = text.find('\n', at);
+        int t, i;
+        if (nl == std::string::npos || std::sscanf(text.c_str() + at, "thread %d line %d", &t, &i) != 2 || t < 0 ||
+            t > 3 || i != next[t]++) {
+            return bench::fail("LogFile lost or reordered lines near byte " + std::to_string(at));
+        }
+        at = nl + 1;
+    }
+    if (std::count(next, next + 4, 20000) != 4) {
+        return bench::fail("LogFile lost lines");
+    }
+
+    // A lone line is written once maxDelay has passed, without a flush,
+    // and a second log appends frames after the first's.
+    options.maxDelay = std::chrono::milliseconds(20);
+    LogFile log(path, options);
+    log.writeLine("late line");
+    size_t size = std::filesystem::file_size(path);
+    for (int i = 0; i < 200 && std::filesystem::file_size(path) == size; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (!readFrames(path, text, frames) || text.size() < 9 || text.substr(text.size() - 10) != "late line\n") {
+        return bench::fail("a line was not written after maxDelay");
+    }
+
+    // Plain mode writes the text as is.
+    std::string plain = path + ".txt";
+    std::filesystem::remove(plain);
+    {
+        LogFile raw(plain);
+        raw.writeLine("Drawing Circle");
+        raw << "Drawing " << "Square\n";
+    }
+    std::ifstream in(plain);
+    std::string got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::filesystem::remove(plain);
+    return got == "Drawing Circle\nDrawing Square\n" || bench::fail("plain LogFile wrote \"" + got + "\"");
+}
+
+struct Speed {
+    std::string name;
+    double ratio;
+    double compressMBs;    // 0 when --filter skipped the pass
+    double decompressMBs;
+};
+
+// One pass over text in blocks is one iteration of the runner; the
+// speeds come from its medians.
+Speed measure(bench::Runner& runner, const std::string& name, const std::string& text, size_t blockSize,
+              unsigned acceleration = 1) {
+    std::vector<std::vector<char>> packed;
+    std::vector<size_t> sizes;
+    for (size_t at = 0; at < text.size(); at += blockSize) {
+        packed.emplace_back(lz::maxCompressedSize(blockSize));
+    }
+    size_t stored = 0;
+    auto compressAll = [&] {
+        stored = 0;
+        sizes.clear();
+        for (size_t at = 0, i = 0; at < text.size(); at += blockSize, ++i) {
+            size_t n = std::min(blockSize, text.size() - at);
+            sizes.push_back(lz::compress(text.data() + at, n, packed[i].data(), acceleration));
+            stored += sizes.back();
+        }
+    };
+    compressAll();
+    runner.run(name + ", compress", compressAll);
+
+    std::string out(text.size(), '\0');
+    runner.run(name + ", decompress", [&] {
+        for (size_t at = 0, i = 0; at < text.size(); at += blockSize, ++i) {
+            size_t n = std::min(blockSize, text.size() - at);
+            if (!lz::decompress(packed[i].data(), sizes[i], &out[at], n)) {
+                std::abort();
+            }
+        }
+    });
+    if (runner.result(name + ", decompress") && out != text) {
+        std::abort();
+    }
+    double mb = static_cast<double>(text.size()) / 1e6;
+    auto speed = [&](const char* pass) {
+        const bench::Result* r = runner.result(name + pass);
+        return r && r->medianNs > 0 ? mb / (r->medianNs / 1e9) : 0.0;
+    };
+    return Speed{name, static_cast<double>(text.size()) / static_cast<double>(stored), speed(", compress"),
+                 speed(", decompress")};
+}
+
+int main(int argc, char* argv[]) {
+    bench::Runner runner(argc, argv);
+    const std::vector<std::string>& args = runner.args();
+    size_t mib = args.size() > 0 ? std::stoul(args[0]) : 64;
+    size_t lines = args.size() > 1 ? std::stoul(args[1]) : 1000000;
+    std::string path =
+        (std::filesystem::temp_directory_path() / ("lz_bench." + std::to_string(::getpid()) + ".lz")).string();
+
+    if (!checkCodec() || !checkLogFile(path)) {
+        std::filesystem::remove(path);
+        return 1;
+    }
+    std::filesystem::remove(path);
+    std::cout << "lz round trips, damaged-input rejection and LogFile framing checks pass." << std::endl;
+
+    std::string text;
+    std::string source = "generated log text";
+    if (args.size() > 2) {
+        std::ifstream in(args[2], std::ios::binary);
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        source = args[2];
+    } else {
+        text = logText(mib * 1024 * 1024, 7);
+    }
+    std::cout << "\n" << source << ", " << text.size() / 1024 << " KiB, one core; one iteration is a pass over it\n"
+              << std::endl;
+    std::vector<Speed> speeds;
+    for (size_t block : {16 * 1024, 64 * 1024, 256 * 1024}) {
+        speeds.push_back(measure(runner, std::to_string(block / 1024) + " KiB blocks", text, block));
+    }
+    for (unsigned acceleration : {2, 4}) {
+        std::string name = "64 KiB, accel " + std::to_string(acceleration);
+        speeds.push_back(measure(runner, name, text, 64 * 1024, acceleration));
+    }
+    std::mt19937 rng(9);
+    std::string noise(std::min<size_t>(text.size(), 16 << 20), '\0');
+    for (char& c : noise) {
+        c = static_cast<char>(rng());
+    }
+    speeds.push_back(measure(runner, "random bytes, 64 KiB", noise, 64 * 1024));
+
+    // The caller's side: lines through LogFile, plain and compressed, one
+    // writeLine per iteration. The background thread's compression time is
+    // reported beside it; the caller only pays for it when the thread
+    // falls behind and applies backpressure.
+    std::vector<std::string> logLines;
+    for (size_t at = 0; at < text.size() && logLines.size() < lines;) {
+        size_t nl = text.find('\n', at);
+        if (nl == std::string::npos) {
+            break;
+        }
+        logLines.emplace_back(text, at, nl - at);
+        at = nl + 1;
+    }
+    struct Logged {
+        const char* name;
+        double ns;
+        double fileRatio;
+        double backgroundNs;
+    };
+    std::vector<Logged> logged;
+    for (bool compress : {false, true}) {
+        std::string name = std::string("LogFile writeLine, ") + (compress ? "compressed" : "plain");
+        if (logLines.empty() || !runner.selected(name)) {
+            continue;
+        }
+        std::filesystem::remove(path);
+        LogFile::Options options;
+        options.compress = compress;
+        size_t written = 0;
+        uint64_t bytes = 0;
+        LogFile::Stats stats;
+        {
+            LogFile log(path, options);
+            runner.run(name, [&] {
+                const std::string& line = logLines[written++ % logLines.size()];
+                log.writeLine(line);
+                bytes += line.size() + 1;
+            });
+            log.flush();
+            stats = log.stats();
+        }
+        logged.push_back(Logged{compress ? "compressed" : "plain", runner.result(name)->medianNs,
+                                static_cast<double>(std::filesystem::file_size(path)) / static_cast<double>(bytes),
+                                stats.compressSeconds * 1e9 / static_cast<double>(written)});
+    }
+    std::filesystem::remove(path);
+
+    std::cout << "\n" << std::setw(26) << "" << std::setw(10) << "ratio" << std::setw(16) << "compress MB/s"
+              << std::setw(18) << "decompress MB/s" << std::endl;
+    for (const Speed& s : speeds) {
+        if (s.compressMBs == 0 && s.decompressMBs == 0) {
+            continue;
+        }
+        std::cout << std::setw(26) << s.name << std::fixed << std::setprecision(2) << std::setw(10) << s.ratio
+                  << std::setprecision(0) << std::setw(16) << s.compressMBs << std::setw(18) << s.decompressMBs
+                  << std::endl;
+    }
+    if (!logged.empty()) {
+        std::cout << "\n" << logLines.size() << " distinct lines through LogFile\n"
+                  << std::setw(26) << "" << std::setw(12) << "ns/line" << std::setw(14) << "file/logged"
+                  << std::setw(20) << "thread ns/line" << std::endl;
+        for (const Logged& l : logged) {
+            std::cout << std::setw(26) << l.name << std::setprecision(0) << std::setw(12) << l.ns
+                      << std::setprecision(2) << std::setw(14) << l.fileRatio << std::setprecision(0)
+                      << std::setw(20) << l.backgroundNs << std::endl;
+        }
+    }
+    return runner.finish();
+}
@@ -0,0 +1,119 @@
+// Prints logs written as lz frames (log_file.h with compression, e.g.
+// CPP30_LOG_COMPRESS=1 ./day18), or checks them with -t.
+// Build: g++ -std=c++17 -O2 lzcat.cpp -o lzcat -pthread
+// Usage: ./lzcat [-t] [file...]   (standard input if no file or "-")
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "lz.h"
+
+// Reads up to n bytes; fewer only at end of file. -errno on error.
+ssize_t readFull(int fd, char* p, size_t n) {
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = ::read(fd, p + got, n - got);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0) {
+            return -errno;
+        }
+        if (r == 0) {
+            break;
+        }
+        got += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(got);
+}
+
+bool writeFull(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w < 0) {
+            return false;
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// Decodes every frame of fd to standard output (or nowhere, when testing).
+bool cat(int fd, const std::string& name, bool testOnly) {
+    std::vector<char> block, raw;
+    char header[lz::kFrameHeader];
+    uint64_t offset = 0;
+    for (;;) {
+        ssize_t got = readFull(fd, header, sizeof(header));
+        if (got == 0) {
+            return true;
+        }
+        if (got < 0) {
+            std::cerr << "lzcat: " << name << ": " << std::strerror(static_cast<int>(-got)) << std::endl;
+            return false;
+        }
+        lz::FrameHeader h;
+        if (static_cast<size_t>(got) < sizeof(header) || !lz::parseFrameHeader(header, h)) {
+            std::cerr << "lzcat: " << name << ": no frame at offset " << offset << std::endl;
+            return false;
+        }
+        block.resize(h.storedSize);
+        raw.resize(h.rawSize);
+        if (readFull(fd, block.data(), block.size()) != static_cast<ssize_t>(block.size())) {
+            std::cerr << "lzcat: " << name << ": frame at offset " << offset << " is cut short" << std::endl;
+            return false;
+        }
+        if (!lz::decodeFrame(h, block.data(), raw.data())) {
+            std::cerr << "lzcat: " << name << ": frame at offset " << offset << " is corrupt" << std::endl;
+            return false;
+        }
+        if (!testOnly && !writeFull(STDOUT_FILENO, raw.data(), raw.size())) {
+            std::cerr << "lzcat: write: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        offset += sizeof(header) + h.storedSize;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool testOnly = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-t") {
+            testOnly = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "usage: lzcat [-t] [file...]" << std::endl;
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        files.push_back("-");
+    }
+    bool ok = true;
+    for (const std::string& file : files) {
+        if (file == "-") {
+            ok = cat(STDIN_FILENO, "(standard input)", testOnly) && ok;
+            continue;
+        }
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "lzcat: " << file << ": " << std::strerror(errno) << std::endl;
+            ok = false;
+            continue;
+        }
+        ok = cat(fd, file, testOnly) && ok;
+        ::close(fd);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,359 @@
+// Bounded queues: MpmcQueue and SpscQueue (concurrent_queue.h) against a
+// mutex + condition_variable queue, from 1 to N producers and consumers.
+// Build: g++ -std=c++17 -O2 queue_bench.cpp -o queue_bench -pthread
+// Usage: ./queue_bench [items] [max threads]   (default 400000 items, 4 threads)
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_queue.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+// The queue inside ThreadPool, bounded, with the same interface.
+template <typename T>
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity) : capacity_(capacity) {}
+
+    void push(T value) { pushBatch(&value, 1); }
+    void pop(T& out) { popBatch(&out, 1); }
+
+    void pushBatch(T* items, size_t n) {
+        for (size_t done = 0; done < n;) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notFull_.wait(lock, [this] { return items_.size() < capacity_; });
+            for (; done < n && items_.size() < capacity_; ++done) {
+                items_.push_back(std::move(items[done]));
+            }
+            lock.unlock();
+            notEmpty_.notify_all();
+        }
+    }
+
+    size_t popBatch(T* out, size_t n) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty(); });
+        size_t k = std::min(n, items_.size());
+        for (size_t i = 0; i < k; ++i) {
+            out[i] = std::move(items_.front());
+            items_.pop_front();
+        }
+        lock.unlock();
+        notFull_.notify_all();
+        return k;
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_, notFull_;
+};
+
+struct Counted {
+    static inline std::atomic<int> live{0};
+    Counted() { ++live; }
+    Counted(const Counted&) { ++live; }
+    Counted& operator=(const Counted&) = default;
+    ~Counted() { --live; }
+};
+
+bool checkSingleThreaded() {
+    MpmcQueue<std::unique_ptr<int>> q(5);
+    SpscQueue<std::unique_ptr<int>> s(3);
+    if (q.capacity() != 8 || s.capacity() != 4) {
+        std::cerr << "capacity is not rounded up to a power of two" << std::endl;
+        return false;
+    }
+    for (int i = 0; i < 8; ++i) {
+        if (!q.tryPush(std::make_unique<int>(i))) {
+            return false;
+        }
+    }
+    auto extra = std::make_unique<int>(99);
+    if (q.tryPush(std::move(extra)) || !extra || q.sizeApprox() != 8) {
+        std::cerr << "push into a full queue must fail and keep the value" << std::endl;
+        return false;
+    }
+    std::unique_ptr<int> out[8];
+    if (q.tryPopBatch(out, 3) != 3 || *out[0] != 0 || *out[2] != 2) {
+        return false;
+    }
+    // The ring wraps: three free cells, five requested.
+    std::unique_ptr<int> more[5];
+    for (int i = 0; i < 5; ++i) {
+        more[i] = std::make_unique<int>(8 + i);
+    }
+    if (q.tryPushBatch(more, 5) != 3 || !more[3] || more[2]) {
+        std::cerr << "batch push into a nearly full queue is wrong" << std::endl;
+        return false;
+    }
+    for (int expected = 3; expected < 11; ++expected) {
+        std::unique_ptr<int> v;
+        if (!q.tryPop(v) || *v != expected) {
+            std::cerr << "MpmcQueue is not FIFO" << std::endl;
+            return false;
+        }
+    }
+    std::unique_ptr<int> v;
+    if (q.tryPop(v) || q.tryPopBatch(out, 8) != 0) {
+        return false;
+    }
+
+    for (int lap = 0; lap < 3; ++lap) {
+        for (int i = 0; i < 4; ++i) {
+            s.push(std::make_unique<int>(lap * 4 + i));
+        }
+        if (s.tryPush(std::make_unique<int>(-1)) || s.tryPopBatch(out, 8) != 4 || *out[3] != lap * 4 + 3) {
+            std::cerr << "SpscQueue lap " << lap << " is wrong" << std::endl;
+            return false;
+        }
+    }
+
+    // Items left in a queue are destroyed with it.
+    {
+        MpmcQueue<Counted> mq(4);
+        SpscQueue<Counted> sq(4);
+        for (int i = 0; i < 3; ++i) {
+            mq.push(Counted());
+            sq.push(Counted());
+        }
+        Counted c;
+        mq.pop(c);
+        sq.pop(c);
+    }
+    if (Counted::live != 0) {
+        std::cerr << Counted::live << " items leaked" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Every producer pushes its own increasing values through the queue;
+// consumers must see each value exactly once and each producer's values in
+// order. Mixes single and batch calls, blocking and non-blocking.
+template <typename Queue>
+bool checkConcurrent(Queue& q, int producers, int consumers, uint64_t perProducer) {
+    const uint64_t kStop = ~uint64_t(0);
+    std::vector<std::thread> threads;
+    std::vector<std::vector<uint64_t>> seen(static_cast<size_t>(consumers));
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, p, perProducer] {
+            uint64_t base = uint64_t(p) << 32;
+            uint64_t batch[7];
+            for (uint64_t i = 0; i < perProducer;) {
+                if (i % 3 == 0) {
+                    size_t n = static_cast<size_t>(std::min<uint64_t>(7, perProducer - i));
+                    for (size_t k = 0; k < n; ++k) {
+                        batch[k] = base + i + k;
+                    }
+                    q.pushBatch(batch, n);
+                    i += n;
+                } else if (q.tryPush(base + i)) {
+                    ++i;
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&q, &seen, c, kStop] {
+            uint64_t batch[5];
+            for (;;) {
+                size_t n = q.popBatch(batch, c % 2 == 0 ? 5 : 1);
+                for (size_t k = 0; k < n; ++k) {
+                    if (batch[k] == kStop) {
+                        // Hand any other stop markers in the batch back.
+                        for (size_t j = k + 1; j < n; ++j) {
+                            q.push(batch[j]);
+                        }
+                        return;
+                    }
+                    seen[static_cast<size_t>(c)].push_back(batch[k]);
+                }
+            }
+        });
+    }
+    for (int p = 0; p < producers; ++p) {
+        threads[static_cast<size_t>(p)].join();
+    }
+    for (int c = 0; c < consumers; ++c) {
+        q.push(kStop);
+    }
+    for (size_t t = static_cast<size_t>(producers); t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (const auto& values : seen) {
+        std::vector<uint64_t> last(static_cast<size_t>(producers), 0);
+        std::vector<bool> any(static_cast<size_t>(producers), false);
+        for (uint64_t v : values) {
+            size_t p = static_cast<size_t>(v >> 32);
+            if (any[p] && (v & 0xffffffff) <= last[p]) {
+                std::cerr << "a consumer saw producer " << p << " out of order" << std::endl;
+                return false;
+            }
+            any[p] = true;
+            last[p] = v & 0xffffffff;
+        }
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    std::sort(all.begin(), all.end());
+    bool ok = all.size() == uint64_t(producers) * perProducer;
+    for (size_t i = 0; ok && i < all.size(); ++i) {
+        ok = all[i] == (uint64_t(i / perProducer) << 32) + i % perProducer;
+    }
+    if (!ok) {
+        std::cerr << producers << "x" << consumers << ": values lost or duplicated" << std::endl;
+    }
+    return ok;
+}
+
+bool check(int maxThreads) {
+    if (!checkSingleThreaded()) {
+        return false;
+    }
+    for (int p = 1; p <= maxThreads; p *= 2) {
+        for (int c = 1; c <= maxThreads; c *= 2) {
+            MpmcQueue<uint64_t> q(p == c ? 2 : 64);  // tiny queues stress full/empty
+            if (!checkConcurrent(q, p, c, 5000)) {
+                return false;
+            }
+        }
+    }
+    SpscQueue<uint64_t> s(2), t(64);
+    return checkConcurrent(s, 1, 1, 20000) && checkConcurrent(t, 1, 1, 20000);
+}
+
+// Moves items from producers to consumers in batches of the given size;
+// returns millions of items per second.
+template <typename Queue>
+double throughput(int producers, int consumers, uint64_t items, size_t batch) {
+    Queue q(1024);
+    const uint64_t kStop = 0;
+    uint64_t perProducer = items / static_cast<uint64_t>(producers);
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, perProducer, batch] {
+            std::vector<uint64_t> buffer(batch);
+            for (uint64_t i = 0; i < perProducer; i += batch) {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(batch, perProducer - i));
+                for (size_t k = 0; k < n; ++k) {
+                    buffer[k] = i + k + 1;
+                }
+                q.pushBatch(buffer.data(), n);
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&q, &total, batch, kStop] {
+            std::vector<uint64_t> buffer(batch);
+            uint64_t sum = 0;
+            for (;;) {
+                size_t n = q.popBatch(buffer.data(), batch);
+                for (size_t k = 0; k < n; ++k) {
+                    if (buffer[k] == kStop) {
+                        for (size_t j = k + 1; j < n; ++j) {
+                            q.push(buffer[j]);
+                        }
+                        total += sum;
+                        return;
+                    }
+                    sum += buffer[k];
+                }
+            }
+        });
+    }
+    for (int p = 0; p < producers; ++p) {
+        threads[static_cast<size_t>(p)].join();
+    }
+    for (int c = 0; c < consumers; ++c) {
+        q.push(kStop);
+    }
+    for (size_t t = static_cast<size_t>(producers); t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (total != uint64_t(producers) * perProducer * (perProducer + 1) / 2) {
+        std::cerr << "throughput run lost items" << std::endl;
+        std::exit(1);
+    }
+    return static_cast<double>(uint64_t(producers) * perProducer) / seconds / 1e6;
+}
+
+// One-way hand-off latency: a ping-pong through two queues, halved.
+template <typename Queue>
+LatencyHistogram pingPong(int rounds) {
+    Queue there(64), back(64);
+    std::thread echo([&] {
+        for (int i = 0; i < rounds; ++i) {
+            uint64_t v;
+            there.pop(v);
+            back.push(v);
+        }
+    });
+    LatencyHistogram h;
+    for (int i = 0; i < rounds; ++i) {
+        auto sent = Clock::now();
+        there.push(uint64_t(i));
+        uint64_t v;
+        back.pop(v);
+        h.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent).count()) / 2);
+    }
+    echo.join();
+    return h;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t items = argc > 1 ? std::stoull(argv[1]) : 400000;
+    int maxThreads = argc > 2 ? std::max(1, std::stoi(argv[2])) : 4;
+    if (!check(maxThreads)) {
+        return 1;
+    }
+    std::cout << "FIFO, wrap-around, batch, blocking and " << maxThreads << "x" << maxThreads
+              << " producer/consumer checks pass." << std::endl;
+
+    std::cout << "\n" << items << " items through a 1024-slot queue, million items per second\n"
+              << std::setw(10) << "producers" << std::setw(10) << "consumers" << std::setw(10) << "mutex"
+              << std::setw(10) << "mpmc" << std::setw(12) << "mutex x32" << std::setw(12) << "mpmc x32"
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int p = 1; p <= maxThreads; p *= 2) {
+        for (int c = 1; c <= maxThreads; c *= 2) {
+            std::cout << std::setw(10) << p << std::setw(10) << c << std::setw(10)
+                      << throughput<MutexQueue<uint64_t>>(p, c, items, 1) << std::setw(10)
+                      << throughput<MpmcQueue<uint64_t>>(p, c, items, 1) << std::setw(12)
+                      << throughput<MutexQueue<uint64_t>>(p, c, items, 32) << std::setw(12)
+                      << throughput<MpmcQueue<uint64_t>>(p, c, items, 32) << std::endl;
+        }
+    }
+    std::cout << std::setw(20) << "spsc 1x1" << std::setw(10) << "" << std::setw(10)
+              << throughput<SpscQueue<uint64_t>>(1, 1, items, 1) << std::setw(12) << "" << std::setw(12)
+              << throughput<SpscQueue<uint64_t>>(1, 1, items, 32) << std::endl;
+
+    const int rounds = static_cast<int>(std::min<uint64_t>(items / 20, 20000));
+    std::cout << "\nOne-way hand-off latency, ping-pong of " << rounds << " rounds, us\n"
+              << std::setw(10) << "queue" << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10)
+              << "max" << std::endl;
+    auto row = [](const char* name, const LatencyHistogram& h) {
+        std::cout << std::setw(10) << name << std::setw(10) << h.percentile(0.5) / 1000.0 << std::setw(10)
+                  << h.percentile(0.99) / 1000.0 << std::setw(10) << h.max / 1000.0 << std::endl;
+    };
+    row("mutex", pingPong<MutexQueue<uint64_t>>(rounds));
+    row("mpmc", pingPong<MpmcQueue<uint64_t>>(rounds));
+    row("spsc", pingPong<SpscQueue<uint64_t>>(rounds));
+    return 0;
+}
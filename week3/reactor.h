@@ -0,0 +1,897 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "timer_wheel.h"
+
+// Reactor network library on Linux epoll, after muduo: one EventLoop per
+// thread, non-blocking TCP connections with growable buffers, and a timer
+// wheel per loop.
+//
+//   net::EventLoopThread base;                        // accepts
+//   net::TcpServer server(base.loop(), net::InetAddress("127.0.0.1", 0), 4);
+//   net::LengthHeaderCodec codec([&](const net::TcpConnectionPtr& conn, std::string_view msg) {
+//       pool.post([conn, req = std::string(msg)] {    // compute off the IO thread
+//           net::LengthHeaderCodec::send(conn, handle(req));
+//       });
+//   });
+//   server.setMessageCallback(codec.callback());
+//   server.start();
+//
+// Every object lives on one loop and is used only from that loop's thread.
+// The exceptions are EventLoop::runInLoop/queueInLoop/quit, the timer
+// calls, and TcpConnection::send/shutdown/forceClose, which any thread may
+// call. Sockets are level-triggered. A connection is destroyed only from
+// the loop's pending-functor phase, so a channel never dangles while a
+// batch of events is dispatched.
+namespace net {
+
+inline std::system_error sysError(const char* what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+// Bytes between the read and write index are readable. Space freed at the
+// front is reused before the vector grows.
+class Buffer {
+public:
+    static constexpr size_t kInitialSize = 1024;
+
+    size_t readableBytes() const { return write_ - read_; }
+    const char* peek() const { return data_.data() + read_; }
+
+    void retrieve(size_t n) {
+        if (n < readableBytes()) {
+            read_ += n;
+        } else {
+            retrieveAll();
+        }
+    }
+    void retrieveAll() { read_ = write_ = 0; }
+
+    std::string retrieveAsString(size_t n) {
+        std::string s(peek(), n);
+        retrieve(n);
+        return s;
+    }
+
+    void append(const void* data, size_t n) {
+        ensureWritable(n);
+        std::memcpy(data_.data() + write_, data, n);
+        write_ += n;
+    }
+    void append(std::string_view s) { append(s.data(), s.size()); }
+
+    void appendUint32(uint32_t v) {
+        v = htonl(v);
+        append(&v, sizeof v);
+    }
+    uint32_t peekUint32() const {
+        uint32_t v;
+        std::memcpy(&v, peek(), sizeof v);
+        return ntohl(v);
+    }
+
+    // Reads whatever the socket has with one readv() into the free space
+    // plus a 64 KB stack buffer, so idle connections keep small buffers.
+    // Returns readv()'s result.
+    ssize_t readFd(int fd) {
+        char extra[65536];
+        size_t writable = data_.size() - write_;
+        iovec vec[2] = {{data_.data() + write_, writable}, {extra, sizeof extra}};
+        ssize_t n = ::readv(fd, vec, writable < sizeof extra ? 2 : 1);
+        if (n <= 0) {
+            return n;
+        }
+        if (static_cast<size_t>(n) <= writable) {
+            write_ += static_cast<size_t>(n);
+        } else {
+            write_ = data_.size();
+            append(extra, static_cast<size_t>(n) - writable);
+        }
+        return n;
+    }
+
+    size_t capacity() const { return data_.size(); }
+
+private:
+    void ensureWritable(size_t n) {
+        if (data_.size() - write_ >= n) {
+            return;
+        }
+        size_t readable = readableBytes();
+        if (data_.size() < readable + n) {
+            data_.resize(std::max(data_.size() * 2, readable + n));
+        }
+        std::memmove(data_.data(), data_.data() + read_, readable);
+        read_ = 0;
+        write_ = readable;
+    }
+
+    std::vector<char> data_ = std::vector<char>(kInitialSize);
+    size_t read_ = 0;
+    size_t write_ = 0;
+};
+
+struct InetAddress {
+    InetAddress(const char* ip, uint16_t port) {
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+            throw std::invalid_argument(std::string("bad IPv4 address: ") + ip);
+        }
+    }
+    explicit InetAddress(const sockaddr_in& a) : addr(a) {}
+
+    uint16_t port() const { return ntohs(addr.sin_port); }
+
+    sockaddr_in addr{};
+};
+
+class EventLoop;
+
+// One fd's interest set and callbacks. Owned by whoever owns the fd.
+class Channel {
+public:
+    using Callback = std::function<void()>;
+
+    Channel(EventLoop* loop, int fd) : loop_(loop), fd_(fd) {}
+
+    int fd() const { return fd_; }
+    void setReadCallback(Callback cb) { read_ = std::move(cb); }
+    void setWriteCallback(Callback cb) { write_ = std::move(cb); }
+    void setCloseCallback(Callback cb) { close_ = std::move(cb); }
+    void setErrorCallback(Callback cb) { error_ = std::move(cb); }
+
+    void enableReading() { setEvents(events_ | EPOLLIN | EPOLLPRI); }
+    void enableWriting() { setEvents(events_ | EPOLLOUT); }
+    void disableWriting() { setEvents(events_ & ~uint32_t(EPOLLOUT)); }
+    void disableAll() { setEvents(0); }
+    bool isWriting() const { return (events_ & EPOLLOUT) != 0; }
+    void remove();
+
+    // Keeps owner alive while a callback runs, and skips events that
+    // arrive after it is gone.
+    void tie(const std::shared_ptr<void>& owner) {
+        tie_ = owner;
+        tied_ = true;
+    }
+
+    void handleEvent(uint32_t revents) {
+        std::shared_ptr<void> guard;
+        if (tied_ && !(guard = tie_.lock())) {
+            return;
+        }
+        if ((revents & EPOLLHUP) && !(revents & EPOLLIN) && close_) {
+            close_();
+        }
+        if ((revents & EPOLLERR) && error_) {
+            error_();
+        }
+        if ((revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) && read_) {
+            read_();
+        }
+        if ((revents & EPOLLOUT) && write_) {
+            write_();
+        }
+    }
+
+private:
+    friend class EventLoop;
+    void setEvents(uint32_t events);
+
+    EventLoop* loop_;
+    int fd_;
+    uint32_t events_ = 0;
+    bool added_ = false;  // registered with epoll
+    std::weak_ptr<void> tie_;
+    bool tied_ = false;
+    Callback read_, write_, close_, error_;
+};
+
+// Construct it on the thread that will call loop().
+class EventLoop {
+public:
+    using Functor = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+
+    // Timer resolution.
+    static constexpr std::chrono::milliseconds kTick{10};
+
+    EventLoop()
+        : threadId_(std::this_thread::get_id()),
+          epollFd_(::epoll_create1(EPOLL_CLOEXEC)),
+          wakeFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          wakeChannel_(this, wakeFd_),
+          start_(Clock::now()),
+          pollTime_(start_) {
+        if (epollFd_ < 0 || wakeFd_ < 0) {
+            throw sysError("EventLoop");
+        }
+        wakeChannel_.setReadCallback([this] {
+            uint64_t n;
+            while (::read(wakeFd_, &n, sizeof n) > 0) {
+            }
+        });
+        wakeChannel_.enableReading();
+    }
+
+    ~EventLoop() {
+        wakeChannel_.disableAll();
+        wakeChannel_.remove();
+        std::lock_guard<std::mutex> lock(mutex_);  // no wakeup() in flight
+        ::close(wakeFd_);
+        ::close(epollFd_);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Runs until quit(); the functors queued by then still run.
+    void loop() {
+        std::vector<epoll_event> events(64);
+        while (!quit_.load(std::memory_order_acquire)) {
+            int n = ::epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), pollTimeoutMs());
+            pollTime_ = Clock::now();
+            if (n < 0 && errno != EINTR) {
+                throw sysError("epoll_wait");
+            }
+            for (int i = 0; i < n; ++i) {
+                static_cast<Channel*>(events[static_cast<size_t>(i)].data.ptr)->handleEvent(events[static_cast<size_t>(i)].events);
+            }
+            if (n == static_cast<int>(events.size())) {
+                events.resize(events.size() * 2);
+            }
+            expireTimers();
+            runPending();
+        }
+        runPending();
+    }
+
+    void quit() {
+        quit_.store(true, std::memory_order_release);
+        if (!isInLoopThread()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup();
+        }
+    }
+
+    bool isInLoopThread() const { return threadId_ == std::this_thread::get_id(); }
+
+    // When epoll_wait last returned; cheaper than reading the clock.
+    Clock::time_point pollTime() const { return pollTime_; }
+
+    void runInLoop(Functor f) {
+        if (isInLoopThread()) {
+            f();
+        } else {
+            queueInLoop(std::move(f));
+        }
+    }
+
+    void queueInLoop(Functor f) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool first = pending_.empty();
+        pending_.push_back(std::move(f));
+        // Another thread only wakes the loop for the first functor; the loop
+        // thread itself only while it runs functors (during event handling
+        // the pending phase is still to come).
+        if (isInLoopThread() ? callingPending_ : first) {
+            wakeup();
+        }
+    }
+
+    // Runs f on the loop and waits for it. Never call it from the loop of
+    // another thread that f waits for.
+    void runInLoopAndWait(const Functor& f) {
+        if (isInLoopThread()) {
+            f();
+            return;
+        }
+        std::promise<void> done;
+        queueInLoop([&] {
+            f();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    TimerId runAfter(Clock::duration delay, Functor f) { return addTimer(delay, Clock::duration::zero(), std::move(f)); }
+    TimerId runEvery(Clock::duration period, Functor f) { return addTimer(period, period, std::move(f)); }
+
+    void cancel(TimerId id) {
+        runInLoop([this, id] {
+            auto it = timers_.find(id);
+            if (it != timers_.end()) {
+                wheel_.cancel(it->second);
+                timers_.erase(it);
+            }
+        });
+    }
+
+    size_t pendingTimers() const { return timers_.size(); }
+
+private:
+    friend class Channel;
+
+    struct Timer {
+        TimerId id = 0;
+        uint64_t periodTicks = 0;  // 0 for one-shot
+        Functor f;
+    };
+
+    struct Due {
+        TimerId id;
+        bool oneShot;
+        Functor f;
+    };
+
+    void update(Channel* ch, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.ptr = ch;
+        int op = ch->added_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (::epoll_ctl(epollFd_, op, ch->fd_, &ev) < 0) {
+            throw sysError("epoll_ctl");
+        }
+        ch->added_ = true;
+    }
+
+    void remove(Channel* ch) {
+        if (ch->added_) {
+            ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, ch->fd_, nullptr);
+            ch->added_ = false;
+        }
+    }
+
+    // Called with mutex_ held: once the loop has quit, the destructor may
+    // close wakeFd_ as soon as it gets the mutex.
+    void wakeup() {
+        uint64_t one = 1;
+        ssize_t n = ::write(wakeFd_, &one, sizeof one);
+        static_cast<void>(n);
+    }
+
+    void runPending() {
+        std::vector<Functor> functors;
+        callingPending_ = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            functors.swap(pending_);
+        }
+        for (Functor& f : functors) {
+            f();
+        }
+        callingPending_ = false;
+    }
+
+    // Timers live in a TimerWheel counting kTick ticks since start_, so
+    // adding and cancelling are O(1), and epoll_wait sleeps until the
+    // wheel's next expiry rather than waking every tick. timers_ maps the
+    // ids handed out, which exist before the timer reaches the loop, to
+    // the wheel's.
+    uint64_t nowTick() const { return static_cast<uint64_t>((Clock::now() - start_) / kTick); }
+
+    // The first expiry is the caller's now() plus delay, rounded up to a
+    // tick, so a timer never fires early.
+    TimerId addTimer(Clock::duration delay, Clock::duration period, Functor f) {
+        TimerId id = nextTimerId_.fetch_add(1, std::memory_order_relaxed);
+        auto ticks = [](Clock::duration d) {
+            return static_cast<uint64_t>((d + kTick - Clock::duration(1)) / kTick);
+        };
+        uint64_t due = ticks(Clock::now() - start_ + std::max(delay, Clock::duration::zero()));
+        uint64_t periodTicks = period == Clock::duration::zero() ? 0 : std::max<uint64_t>(1, ticks(period));
+        runInLoop([this, id, due, periodTicks, f = std::move(f)]() mutable {
+            timers_.emplace(id, wheel_.insert(due, Timer{id, periodTicks, std::move(f)}));
+        });
+        return id;
+    }
+
+    int pollTimeoutMs() const {
+        uint64_t next = wheel_.nextExpiry();
+        if (next == TimerWheel<Timer>::kNever) {
+            return -1;
+        }
+        auto at = start_ + kTick * static_cast<Clock::rep>(next);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(at - Clock::now()).count();
+        return static_cast<int>(std::max<decltype(ms)>(0, ms) + 1);
+    }
+
+    // The wheel's fire callback may not add or cancel timers, so the due
+    // ones are collected first and run after. One that an earlier callback
+    // cancels is no longer in timers_ and is skipped.
+    void expireTimers() {
+        wheel_.advance(nowTick(), [this](TimerWheel<Timer>::Id, Timer& t) -> uint64_t {
+            if (t.periodTicks == 0) {
+                due_.push_back(Due{t.id, true, std::move(t.f)});
+                return 0;
+            }
+            due_.push_back(Due{t.id, false, t.f});
+            return wheel_.now() + t.periodTicks;
+        });
+        for (Due& d : due_) {
+            auto it = timers_.find(d.id);
+            if (it == timers_.end()) {
+                continue;
+            }
+            if (d.oneShot) {
+                timers_.erase(it);
+            }
+            d.f();  // may add or cancel timers, this one included
+        }
+        due_.clear();
+    }
+
+    const std::thread::id threadId_;
+    const int epollFd_;
+    const int wakeFd_;
+    Channel wakeChannel_;
+    std::atomic<bool> quit_{false};
+    bool callingPending_ = false;
+    std::mutex mutex_;
+    std::vector<Functor> pending_;
+
+    const Clock::time_point start_;
+    Clock::time_point pollTime_;
+    TimerWheel<Timer> wheel_;
+    std::unordered_map<TimerId, TimerWheel<Timer>::Id> timers_;
+    std::vector<Due> due_;  // expireTimers()'s, kept for its capacity
+    std::atomic<TimerId> nextTimerId_{1};
+};
+
+inline void Channel::setEvents(uint32_t events) {
+    events_ = events;
+    loop_->update(this, events);
+}
+
+inline void Channel::remove() { loop_->remove(this); }
+
+// A thread running its own EventLoop until destroyed.
+class EventLoopThread {
+public:
+    EventLoopThread() {
+        thread_ = std::thread([this] {
+            EventLoop loop;
+            ready_.set_value(&loop);
+            loop.loop();
+        });
+        loop_ = ready_.get_future().get();
+    }
+
+    ~EventLoopThread() {
+        loop_->quit();
+        thread_.join();
+    }
+
+    EventLoop* loop() const { return loop_; }
+
+private:
+    std::promise<EventLoop*> ready_;
+    std::thread thread_;
+    EventLoop* loop_;
+};
+
+class TcpConnection;
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+
+// Owns a connected non-blocking socket on one loop.
+class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
+public:
+    using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
+    using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer&)>;
+
+    TcpConnection(EventLoop* loop, int fd, uint64_t id) : loop_(loop), fd_(fd), id_(id), channel_(loop, fd) {
+        channel_.setReadCallback([this] { handleRead(); });
+        channel_.setWriteCallback([this] { handleWrite(); });
+        channel_.setCloseCallback([this] { handleClose(); });
+        channel_.setErrorCallback([this] { handleClose(); });
+        int one = 1;
+        ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    }
+
+    ~TcpConnection() { ::close(fd_); }
+
+    TcpConnection(const TcpConnection&) = delete;
+    TcpConnection& operator=(const TcpConnection&) = delete;
+
+    EventLoop* loop() const { return loop_; }
+    uint64_t id() const { return id_; }
+    bool connected() const { return state_.load(std::memory_order_acquire) == State::Connected; }
+    size_t outputBytes() const { return output_.readableBytes(); }
+
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+    // Called on the loop after the peer or an error closed the connection;
+    // the owner drops its reference and queues connectDestroyed().
+    void setCloseCallback(ConnectionCallback cb) { closeCallback_ = std::move(cb); }
+
+    // Closes a connection that has neither received nor written anything
+    // for this long, checked on the loop's timer wheel.
+    void setIdleTimeout(EventLoop::Clock::duration timeout) {
+        idleTimeout_ = timeout;
+    }
+
+    // Writes now if the socket accepts it, and buffers the rest. Safe from
+    // any thread; dropped once the connection is closing.
+    void send(std::string_view data) {
+        if (!connected()) {
+            return;
+        }
+        if (loop_->isInLoopThread()) {
+            sendInLoop(data.data(), data.size());
+        } else {
+            loop_->queueInLoop([self = shared_from_this(), s = std::string(data)] { self->sendInLoop(s.data(), s.size()); });
+        }
+    }
+
+    // Half-closes after the buffered output has been written.
+    void shutdown() {
+        State expected = State::Connected;
+        if (state_.compare_exchange_strong(expected, State::Disconnecting)) {
+            loop_->runInLoop([self = shared_from_this()] { self->shutdownInLoop(); });
+        }
+    }
+
+    void forceClose() {
+        State s = state_.load(std::memory_order_acquire);
+        if (s == State::Connected || s == State::Disconnecting) {
+            loop_->queueInLoop([self = shared_from_this()] { self->handleClose(); });
+        }
+    }
+
+    // On the loop: starts reading and reports the connection.
+    void connectEstablished() {
+        state_.store(State::Connected, std::memory_order_release);
+        lastActive_ = loop_->pollTime();
+        channel_.tie(shared_from_this());
+        channel_.enableReading();
+        if (connectionCallback_) {
+            connectionCallback_(shared_from_this());
+        }
+        if (idleTimeout_ != EventLoop::Clock::duration::zero()) {
+            armIdleTimer(idleTimeout_);
+        }
+    }
+
+    // On the loop: the last call before the owner lets go.
+    void connectDestroyed() {
+        if (state_.exchange(State::Disconnected) != State::Disconnected) {
+            channel_.disableAll();
+            if (connectionCallback_) {
+                connectionCallback_(shared_from_this());
+            }
+        }
+        channel_.remove();
+    }
+
+private:
+    enum class State { Connecting, Connected, Disconnecting, Disconnected };
+
+    void handleRead() {
+        lastActive_ = loop_->pollTime();
+        ssize_t n = input_.readFd(fd_);
+        if (n > 0) {
+            messageCallback_(shared_from_this(), input_);
+        } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            handleClose();
+        }
+    }
+
+    void handleWrite() {
+        if (!channel_.isWriting()) {
+            return;
+        }
+        ssize_t n = ::send(fd_, output_.peek(), output_.readableBytes(), MSG_NOSIGNAL);
+        if (n > 0) {
+            lastActive_ = loop_->pollTime();  // a slow reader is not idle
+            output_.retrieve(static_cast<size_t>(n));
+            if (output_.readableBytes() == 0) {
+                channel_.disableWriting();
+                if (state_.load(std::memory_order_acquire) == State::Disconnecting) {
+                    shutdownInLoop();
+                }
+            }
+        } else if (errno != EAGAIN && errno != EINTR) {
+            handleClose();
+        }
+    }
+
+    void handleClose() {
+        State s = state_.exchange(State::Disconnected);
+        if (s == State::Disconnected) {
+            return;
+        }
+        channel_.disableAll();
+        TcpConnectionPtr self = shared_from_this();
+        if (connectionCallback_) {
+            connectionCallback_(self);
+        }
+        if (closeCallback_) {
+            closeCallback_(self);
+        }
+    }
+
+    void sendInLoop(const char* data, size_t len) {
+        if (state_.load(std::memory_order_acquire) == State::Disconnected) {
+            return;
+        }
+        size_t written = 0;
+        if (!channel_.isWriting() && output_.readableBytes() == 0) {
+            ssize_t n = ::send(fd_, data, len, MSG_NOSIGNAL);
+            if (n >= 0) {
+                written = static_cast<size_t>(n);
+            } else if (errno != EAGAIN && errno != EINTR) {
+                handleClose();
+                return;
+            }
+        }
+        if (written < len) {
+            output_.append(data + written, len - written);
+            if (!channel_.isWriting()) {
+                channel_.enableWriting();
+            }
+        }
+    }
+
+    void shutdownInLoop() {
+        if (!channel_.isWriting()) {
+            ::shutdown(fd_, SHUT_WR);
+        }
+    }
+
+    // Fires at most once per timeout: if the connection was active in the
+    // meantime, the timer is re-armed for the remainder.
+    void armIdleTimer(EventLoop::Clock::duration after) {
+        std::weak_ptr<TcpConnection> weak = shared_from_this();
+        loop_->runAfter(after, [weak] {
+            TcpConnectionPtr self = weak.lock();
+            if (!self || self->state_.load(std::memory_order_acquire) == State::Disconnected) {
+                return;
+            }
+            auto idle = self->loop_->pollTime() - self->lastActive_;
+            if (idle >= self->idleTimeout_) {
+                self->handleClose();
+            } else {
+                self->armIdleTimer(self->idleTimeout_ - idle);
+            }
+        });
+    }
+
+    EventLoop* loop_;
+    const int fd_;
+    const uint64_t id_;
+    Channel channel_;
+    std::atomic<State> state_{State::Connecting};
+    Buffer input_;
+    Buffer output_;
+    EventLoop::Clock::time_point lastActive_;
+    EventLoop::Clock::duration idleTimeout_ = EventLoop::Clock::duration::zero();
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    ConnectionCallback closeCallback_;
+};
+
+// Accepts on baseLoop and spreads connections round-robin over ioThreads
+// loops of its own (0 keeps them on baseLoop). Destroy it while baseLoop
+// still runs, after any work that holds its connections has finished.
+class TcpServer {
+public:
+    TcpServer(EventLoop* baseLoop, const InetAddress& listenAddr, int ioThreads)
+        : baseLoop_(baseLoop),
+          listenFd_(::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)),
+          idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+          acceptChannel_(baseLoop, listenFd_) {
+        int one = 1;
+        sockaddr_in addr = listenAddr.addr;
+        socklen_t len = sizeof addr;
+        if (listenFd_ < 0 || ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one) < 0 ||
+            ::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 ||
+            ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+            throw sysError("TcpServer");
+        }
+        port_ = ntohs(addr.sin_port);
+        for (int i = 0; i < ioThreads; ++i) {
+            ioThreads_.push_back(std::make_unique<EventLoopThread>());
+        }
+        acceptChannel_.setReadCallback([this] { handleAccept(); });
+    }
+
+    ~TcpServer() {
+        baseLoop_->runInLoopAndWait([this] {
+            acceptChannel_.disableAll();
+            acceptChannel_.remove();
+        });
+        std::unordered_map<uint64_t, TcpConnectionPtr> connections;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections.swap(connections_);
+        }
+        auto destroyOn = [&connections](EventLoop* loop) {
+            loop->runInLoopAndWait([&connections, loop] {
+                for (auto& entry : connections) {
+                    if (entry.second->loop() == loop) {
+                        entry.second->connectDestroyed();
+                    }
+                }
+            });
+        };
+        destroyOn(baseLoop_);
+        for (auto& t : ioThreads_) {
+            destroyOn(t->loop());
+        }
+        ioThreads_.clear();
+        ::close(listenFd_);
+        ::close(idleFd_);
+    }
+
+    TcpServer(const TcpServer&) = delete;
+    TcpServer& operator=(const TcpServer&) = delete;
+
+    uint16_t port() const { return port_; }
+    size_t connectionCount() const { return connectionCount_.load(std::memory_order_relaxed); }
+
+    void setConnectionCallback(TcpConnection::ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(TcpConnection::MessageCallback cb) { messageCallback_ = std::move(cb); }
+    void setIdleTimeout(EventLoop::Clock::duration timeout) { idleTimeout_ = timeout; }
+
+    void start() {
+        baseLoop_->runInLoopAndWait([this] {
+            if (::listen(listenFd_, SOMAXCONN) < 0) {
+                throw sysError("listen");
+            }
+            acceptChannel_.enableReading();
+        });
+    }
+
+private:
+    void handleAccept() {
+        for (;;) {
+            int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                newConnection(fd);
+                continue;
+            }
+            if (errno == EMFILE) {
+                // Out of fds: the pending connection would make the level-
+                // triggered listener spin. Borrow the spare fd to accept
+                // and close it.
+                ::close(idleFd_);
+                int victim = ::accept(listenFd_, nullptr, nullptr);
+                if (victim >= 0) {
+                    ::close(victim);
+                }
+                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                continue;
+            }
+            return;  // EAGAIN, or an error for one connection only
+        }
+    }
+
+    void newConnection(int fd) {
+        EventLoop* loop = ioThreads_.empty() ? baseLoop_ : ioThreads_[next_++ % ioThreads_.size()]->loop();
+        auto conn = std::make_shared<TcpConnection>(loop, fd, nextId_++);
+        conn->setConnectionCallback(connectionCallback_);
+        conn->setMessageCallback(messageCallback_);
+        conn->setIdleTimeout(idleTimeout_);
+        conn->setCloseCallback([this](const TcpConnectionPtr& c) { removeConnection(c); });
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections_.emplace(conn->id(), conn);
+        }
+        connectionCount_.fetch_add(1, std::memory_order_relaxed);
+        loop->runInLoop([conn] { conn->connectEstablished(); });
+    }
+
+    // On the connection's loop.
+    void removeConnection(const TcpConnectionPtr& conn) {
+        size_t erased;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            erased = connections_.erase(conn->id());
+        }
+        if (erased) {
+            connectionCount_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        conn->loop()->queueInLoop([conn] { conn->connectDestroyed(); });
+    }
+
+    EventLoop* baseLoop_;
+    const int listenFd_;
+    int idleFd_;
+    uint16_t port_ = 0;
+    Channel acceptChannel_;
+    std::vector<std::unique_ptr<EventLoopThread>> ioThreads_;
+    size_t next_ = 0;
+    uint64_t nextId_ = 1;
+    std::mutex mutex_;  // connections_ changes on the base and IO loops
+    std::unordered_map<uint64_t, TcpConnectionPtr> connections_;
+    std::atomic<size_t> connectionCount_{0};
+    TcpConnection::ConnectionCallback connectionCallback_;
+    TcpConnection::MessageCallback messageCallback_;
+    EventLoop::Clock::duration idleTimeout_ = EventLoop::Clock::duration::zero();
+};
+
+// Blocking connect, then a non-blocking socket for a TcpConnection. Meant
+// for clients and benchmarks; servers never block.
+inline int connectTo(const InetAddress& addr) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&addr.addr), sizeof addr.addr) < 0) {
+        std::system_error e = sysError("connect");
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw e;
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Splits a byte stream into messages framed by a 4-byte big-endian length.
+class LengthHeaderCodec {
+public:
+    using MessageCallback = std::function<void(const TcpConnectionPtr&, std::string_view)>;
+    static constexpr uint32_t kMaxMessage = 1 << 24;
+
+    explicit LengthHeaderCodec(MessageCallback cb) : callback_(std::move(cb)) {}
+
+    // Passes every complete message to the callback. The view is valid
+    // only during the call. A length over kMaxMessage closes the connection.
+    void onMessage(const TcpConnectionPtr& conn, Buffer& buf) const {
+        while (buf.readableBytes() >= sizeof(uint32_t)) {
+            uint32_t len = buf.peekUint32();
+            if (len > kMaxMessage) {
+                conn->forceClose();
+                return;
+            }
+            if (buf.readableBytes() < sizeof(uint32_t) + len) {
+                return;
+            }
+            callback_(conn, std::string_view(buf.peek() + sizeof(uint32_t), len));
+            buf.retrieve(sizeof(uint32_t) + len);
+        }
+    }
+
+    TcpConnection::MessageCallback callback() const {
+        return [this](const TcpConnectionPtr& conn, Buffer& buf) { onMessage(conn, buf); };
+    }
+
+    // Header and payload go out in one send().
+    static void send(const TcpConnectionPtr& conn, std::string_view message) {
+        std::string frame(sizeof(uint32_t) + message.size(), '\0');
+        uint32_t len = htonl(static_cast<uint32_t>(message.size()));
+        std::memcpy(frame.data(), &len, sizeof len);
+        std::memcpy(frame.data() + sizeof len, message.data(), message.size());
+        conn->send(frame);
+    }
+
+private:
+    MessageCallback callback_;
+};
+
+}  // namespace net
@@ -0,0 +1,342 @@
+// Loopback echo server on reactor.h: requests per second and latency with
+// thousands of connections, computing either on the IO loops or on a
+// ThreadPool.
+// Build: g++ -std=c++17 -O2 reactor_bench.cpp -o reactor_bench -pthread
+// Usage: ./reactor_bench [connections] [seconds] [io threads] [work rounds]
+//        (default 10000 connections, 2 s, 2 IO threads, 16 rounds)
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "reactor.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+// The per-request compute: FNV-1a over the payload, rounds times.
+uint64_t digest(std::string_view payload, int rounds) {
+    uint64_t h = 14695981039346656037ull;
+    for (int r = 0; r < rounds; ++r) {
+        for (char c : payload) {
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+// A response is the request with bytes 8..15 replaced by its digest.
+std::string respond(std::string_view request, int rounds) {
+    std::string response(request);
+    if (response.size() >= 16) {
+        uint64_t h = digest(request, rounds);
+        std::memcpy(response.data() + 8, &h, sizeof h);
+    }
+    return response;
+}
+
+template <typename Pred>
+bool waitFor(Pred done, std::chrono::milliseconds limit = std::chrono::milliseconds(5000)) {
+    auto end = Clock::now() + limit;
+    while (!done()) {
+        if (Clock::now() > end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool checkBuffer() {
+    net::Buffer b;
+    std::string big(5000, 'x');
+    b.appendUint32(5000);
+    b.append(big);
+    if (b.readableBytes() != 5004 || b.peekUint32() != 5000 || b.capacity() < 5004) {
+        return false;
+    }
+    b.retrieve(4);
+    if (b.retrieveAsString(5000) != big || b.readableBytes() != 0) {
+        return false;
+    }
+    // Freed space at the front is reused instead of growing.
+    net::Buffer c;
+    c.append(std::string(1000, 'a'));
+    c.retrieve(900);
+    c.append(std::string(900, 'b'));
+    return c.capacity() == net::Buffer::kInitialSize && c.readableBytes() == 1000 && c.peek()[99] == 'a' && c.peek()[100] == 'b';
+}
+
+bool checkTimers() {
+    net::EventLoopThread t;
+    net::EventLoop* loop = t.loop();
+    std::mutex mutex;
+    std::vector<int> fired;
+    auto record = [&](int tag) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired.push_back(tag);
+    };
+    auto start = Clock::now();
+    loop->runAfter(std::chrono::milliseconds(60), [&] { record(3); });
+    loop->runAfter(std::chrono::milliseconds(20), [&] { record(1); });
+    auto cancelled = loop->runAfter(std::chrono::milliseconds(40), [&] { record(-1); });
+    loop->runAfter(std::chrono::milliseconds(40), [&] { record(2); });
+    loop->cancel(cancelled);
+    std::atomic<int> ticks{0};
+    auto every = loop->runEvery(std::chrono::milliseconds(10), [&] { ++ticks; });
+    // Past the first level of the loop's timer wheel: it fires only after
+    // moving down a level, not when its low tick digits come up.
+    std::atomic<bool> late{false};
+    auto far = loop->runAfter(net::EventLoop::kTick * (256 + 3), [&] { late = true; });
+    if (!waitFor([&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            return fired.size() == 3;
+        })) {
+        return false;
+    }
+    auto elapsed = Clock::now() - start;
+    loop->cancel(every);
+    loop->cancel(far);
+    bool ok = fired == std::vector<int>{1, 2, 3} && elapsed >= std::chrono::milliseconds(60) && ticks >= 3 && !late;
+    int afterCancel = ticks;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return ok && ticks == afterCancel;
+}
+
+// A framed echo server with an idle timeout, a large message that overflows
+// the socket buffers, and messages split across reads.
+bool checkServer() {
+    net::EventLoopThread base;
+    net::LengthHeaderCodec codec([](const net::TcpConnectionPtr& conn, std::string_view msg) {
+        net::LengthHeaderCodec::send(conn, msg);
+    });
+    net::TcpServer server(base.loop(), net::InetAddress("127.0.0.1", 0), 2);
+    server.setMessageCallback(codec.callback());
+    server.setIdleTimeout(std::chrono::milliseconds(200));
+    server.start();
+    net::InetAddress addr("127.0.0.1", server.port());
+
+    net::EventLoopThread clientThread;
+    net::EventLoop* loop = clientThread.loop();
+    auto conn = std::make_shared<net::TcpConnection>(loop, net::connectTo(addr), 1);
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    net::LengthHeaderCodec clientCodec([&](const net::TcpConnectionPtr&, std::string_view msg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies.emplace_back(msg);
+    });
+    std::atomic<bool> closed{false};
+    Clock::time_point closedAt;
+    conn->setMessageCallback(clientCodec.callback());
+    conn->setCloseCallback([&](const net::TcpConnectionPtr& c) {
+        closedAt = Clock::now();
+        closed = true;
+        c->loop()->queueInLoop([c] { c->connectDestroyed(); });
+    });
+    loop->runInLoopAndWait([&] { conn->connectEstablished(); });
+
+    std::string big(3 << 20, 'z');
+    for (size_t i = 0; i < big.size(); i += 4096) {
+        big[i] = static_cast<char>('a' + i / 4096 % 26);
+    }
+    net::LengthHeaderCodec::send(conn, "hello");
+    net::LengthHeaderCodec::send(conn, big);
+    // One frame delivered in three pieces.
+    std::string frame = std::string("\0\0\0\x05", 4) + "world";
+    conn->send(frame.substr(0, 2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    conn->send(frame.substr(2, 4));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    conn->send(frame.substr(6));
+    auto lastSend = Clock::now();
+    bool ok = waitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return replies.size() == 3;
+    });
+    ok = ok && replies[0] == "hello" && replies[1] == big && replies[2] == "world";
+    if (!ok) {
+        std::cerr << "echo of framed messages is wrong" << std::endl;
+        return false;
+    }
+    // Now silent: the server closes the connection 200 ms after its last
+    // read or write, which is after our last send.
+    if (!waitFor([&] { return closed.load(); }) || closedAt - lastSend < std::chrono::milliseconds(200) ||
+        !waitFor([&] { return server.connectionCount() == 0; })) {
+        std::cerr << "idle connection was not closed on time" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+struct Result {
+    double requestsPerSecond;
+    LatencyHistogram latency;
+};
+
+// Closed loop: every connection keeps one 64-byte request in flight for
+// the given time. The server computes on its IO loops, or hands each
+// decoded request to pool.
+Result run(size_t connections, double seconds, int ioThreads, int rounds, ThreadPool* pool) {
+    net::EventLoopThread base;
+    net::LengthHeaderCodec serverCodec([rounds, pool](const net::TcpConnectionPtr& conn, std::string_view msg) {
+        if (pool) {
+            pool->post([conn, request = std::string(msg), rounds] {
+                net::LengthHeaderCodec::send(conn, respond(request, rounds));
+            });
+        } else {
+            net::LengthHeaderCodec::send(conn, respond(msg, rounds));
+        }
+    });
+    auto server = std::make_unique<net::TcpServer>(base.loop(), net::InetAddress("127.0.0.1", 0), ioThreads);
+    server->setMessageCallback(serverCodec.callback());
+    server->start();
+    net::InetAddress addr("127.0.0.1", server->port());
+
+    const size_t clientLoops = 2;
+    std::vector<std::unique_ptr<net::EventLoopThread>> clients;
+    for (size_t i = 0; i < clientLoops; ++i) {
+        clients.push_back(std::make_unique<net::EventLoopThread>());
+    }
+    // Per-connection send time and per-loop counters, each touched only by
+    // its loop's thread.
+    std::vector<Clock::time_point> sent(connections);
+    std::vector<LatencyHistogram> latency(clientLoops);
+    std::vector<uint64_t> completed(clientLoops, 0);
+    std::atomic<bool> measuring{false}, stopping{false};
+    std::string request(64, 'r');
+
+    auto sendNext = [&](const net::TcpConnectionPtr& conn) {
+        std::string req = request;
+        uint64_t id = conn->id();
+        std::memcpy(req.data(), &id, sizeof id);
+        sent[id] = Clock::now();
+        net::LengthHeaderCodec::send(conn, req);
+    };
+    net::LengthHeaderCodec clientCodec([&](const net::TcpConnectionPtr& conn, std::string_view msg) {
+        uint64_t id;
+        std::memcpy(&id, msg.data(), sizeof id);
+        if (id != conn->id()) {
+            std::cerr << "response went to the wrong connection" << std::endl;
+            std::exit(1);
+        }
+        if (measuring.load(std::memory_order_relaxed)) {
+            size_t loop = id % clientLoops;
+            latency[loop].add(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent[id]).count()));
+            ++completed[loop];
+        }
+        if (!stopping.load(std::memory_order_relaxed)) {
+            sendNext(conn);
+        }
+    });
+
+    std::vector<net::TcpConnectionPtr> conns;
+    conns.reserve(connections);
+    for (size_t i = 0; i < connections; ++i) {
+        // Keep the accept queue from overflowing (the kernel would drop SYNs
+        // and the client would retry a second later).
+        if (i % 1000 == 0 && !waitFor([&] { return server->connectionCount() + 1000 >= i; })) {
+            std::cerr << "server stopped accepting" << std::endl;
+            std::exit(1);
+        }
+        net::EventLoop* loop = clients[i % clientLoops]->loop();
+        auto conn = std::make_shared<net::TcpConnection>(loop, net::connectTo(addr), i);
+        conn->setMessageCallback(clientCodec.callback());
+        conns.push_back(conn);
+    }
+    waitFor([&] { return server->connectionCount() == connections; });
+    for (auto& c : clients) {
+        net::EventLoop* loop = c->loop();
+        loop->runInLoopAndWait([&, loop] {
+            for (auto& conn : conns) {
+                if (conn->loop() == loop) {
+                    conn->connectEstablished();
+                    sendNext(conn);
+                }
+            }
+        });
+    }
+
+    // Warm up, then measure.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    measuring = true;
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    measuring = false;
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    stopping = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (pool) {
+        waitFor([pool] {
+            ThreadPoolStats s = pool->stats();
+            return s.completed == s.submitted;
+        });
+    }
+
+    Result result{0.0, {}};
+    for (size_t i = 0; i < clientLoops; ++i) {
+        net::EventLoop* loop = clients[i]->loop();
+        loop->runInLoopAndWait([&, loop, i] {
+            for (auto& conn : conns) {
+                if (conn->loop() == loop) {
+                    conn->connectDestroyed();
+                }
+            }
+            result.latency.merge(latency[i]);
+            result.requestsPerSecond += static_cast<double>(completed[i]) / elapsed;
+        });
+    }
+    conns.clear();
+    clients.clear();
+    server.reset();
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    size_t connections = argc > 1 ? std::stoull(argv[1]) : 10000;
+    double seconds = argc > 2 ? std::stod(argv[2]) : 2.0;
+    int ioThreads = argc > 3 ? std::stoi(argv[3]) : 2;
+    int rounds = argc > 4 ? std::stoi(argv[4]) : 16;
+
+    // Each loopback connection takes two descriptors (client and server).
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    size_t maxConnections = limit.rlim_cur > 200 ? (limit.rlim_cur - 100) / 2 : 50;
+    if (connections > maxConnections) {
+        std::cout << "RLIMIT_NOFILE is " << limit.rlim_cur << ": using " << maxConnections << " connections"
+                  << std::endl;
+        connections = maxConnections;
+    }
+
+    if (!checkBuffer() || !checkTimers() || !checkServer()) {
+        std::cerr << "reactor checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Buffer, timer wheel, framing, large write and idle timeout checks pass." << std::endl;
+
+    ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    std::cout << "\n" << connections << " loopback connections, 64-byte requests, " << rounds
+              << " digest rounds, " << ioThreads << " IO threads, " << seconds << " s\n"
+              << std::left << std::setw(22) << "compute on" << std::right << std::setw(12) << "req/s"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::endl;
+    for (ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}) {
+        Result r = run(connections, seconds, ioThreads, rounds, p);
+        auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+        std::cout << std::left << std::setw(22) << (p ? "ThreadPool" : "IO loops") << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(12) << r.requestsPerSecond << std::setprecision(1)
+                  << std::setw(10) << us(r.latency.percentile(0.5)) << std::setw(10)
+                  << us(r.latency.percentile(0.99)) << std::setw(10) << us(r.latency.max) << std::endl;
+    }
+    return 0;
+}
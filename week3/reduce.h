@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Reductions over contiguous ranges: sum, min, max, dot.
+//
+// std::accumulate adds into one variable, so every add waits for the one
+// before it. Here each range is split across several independent vector
+// accumulators (GCC vector extensions: 32-byte vectors compiled for AVX2,
+// 16-byte vectors for the baseline ISA, picked at runtime), and large ranges
+// are split across a ThreadPool.
+namespace reduce {
+
+// How floating-point sums are accumulated.
+//   Fast     - independent accumulators, fastest, ordinary rounding error
+//   Kahan    - compensated summation, error independent of n
+//   Pairwise - pairwise tree over small blocks, O(log n) error growth
+enum class Summation { Fast, Kahan, Pairwise };
+
+struct Options {
+    Summation summation = Summation::Fast;
+    // Ranges shorter than this run on the calling thread.
+    std::size_t parallelThreshold = std::size_t(1) << 22;
+    // Pool used above the threshold; nullptr means a process-wide pool.
+    // Do not run parallel reductions from tasks of that same pool.
+    ThreadPool* pool = nullptr;
+    // Number of chunks to split into; 0 means hardware_concurrency.
+    std::size_t threads = 0;
+    // false forces the plain scalar loop (baseline for benchmarks).
+    bool vectorize = true;
+};
+
+namespace detail {
+
+template <typename T, std::size_t Bytes>
+using Vec [[gnu::vector_size(Bytes)]] = T;
+
+template <typename T, std::size_t Bytes>
+constexpr std::size_t kLanes = Bytes / sizeof(T);
+
+// Blocks summed with the fast kernel before being merged pairwise.
+constexpr std::size_t kPairwiseBlock = 256;
+
+// Vectors travel through out-parameters: returning a 32-byte vector from a
+// function compiled without AVX trips GCC's ABI warning (-Wpsabi), even when
+// it is always inlined into AVX2 code.
+template <typename V, typename T>
+[[gnu::always_inline]] inline void load(V& v, const T* p) {
+    std::memcpy(&v, p, sizeof(v));
+}
+
+// A term of the sum: a[i] for sum(), a[i] * b[i] for dot().
+template <typename T>
+struct SumTerm {
+    const T* a;
+    template <typename V>
+    [[gnu::always_inline]] void vec(V& out, std::size_t i) const { load(out, a + i); }
+    [[gnu::always_inline]] T scalar(std::size_t i) const { return a[i]; }
+};
+
+template <typename T>
+struct DotTerm {
+    const T* a;
+    const T* b;
+    template <typename V>
+    [[gnu::always_inline]] void vec(V& out, std::size_t i) const {
+        V y;
+        load(out, a + i);
+        load(y, b + i);
+        out *= y;
+    }
+    [[gnu::always_inline]] T scalar(std::size_t i) const { return a[i] * b[i]; }
+};
+
+template <typename T, std::size_t Bytes>
+[[gnu::always_inline]] inline T horizontalSum(const Vec<T, Bytes>& v) {
+    T total{};
+    for (std::size_t l = 0; l < kLanes<T, Bytes>; ++l) {
+        total += v[l];
+    }
+    return total;
+}
+
+template <typename T, std::size_t Bytes, typename Term>
+[[gnu::always_inline]] inline T addFast(const Term& term, std::size_t i, std::size_t end) {
+    constexpr std::size_t W = kLanes<T, Bytes>;
+    Vec<T, Bytes> acc0{}, acc1{}, acc2{}, acc3{}, x0, x1, x2, x3;
+    for (; i + 4 * W <= end; i += 4 * W) {
+        term.vec(x0, i);
+        term.vec(x1, i + W);
+        term.vec(x2, i + 2 * W);
+        term.vec(x3, i + 3 * W);
+        acc0 += x0;
+        acc1 += x1;
+        acc2 += x2;
+        acc3 += x3;
+    }
+    for (; i + W <= end; i += W) {
+        term.vec(x0, i);
+        acc0 += x0;
+    }
+    acc0 += acc1;
+    acc2 += acc3;
+    acc0 += acc2;
+    T total = horizontalSum<T, Bytes>(acc0);
+    for (; i < end; ++i) {
+        total += term.scalar(i);
+    }
+    return total;
+}
+
+template <typename T>
+[[gnu::always_inline]] inline void kahanAdd(T& sum, T& carry, const T& x) {
+    T y = x - carry;
+    T t = sum + y;
+    carry = (t - sum) - y;
+    sum = t;
+}
+
+template <typename T, std::size_t Bytes, typename Term>
+[[gnu::always_inline]] inline T addKahan(const Term& term, std::size_t i, std::size_t end) {
+    constexpr std::size_t W = kLanes<T, Bytes>;
+    Vec<T, Bytes> sum0{}, carry0{}, sum1{}, carry1{}, x0, x1;
+    for (; i + 2 * W <= end; i += 2 * W) {
+        term.vec(x0, i);
+        term.vec(x1, i + W);
+        kahanAdd(sum0, carry0, x0);
+        kahanAdd(sum1, carry1, x1);
+    }
+    T sum{}, carry{};
+    for (std::size_t l = 0; l < W; ++l) {
+        kahanAdd(sum, carry, static_cast<T>(sum0[l]));
+        kahanAdd(sum, carry, static_cast<T>(sum1[l]));
+        kahanAdd(sum, carry, static_cast<T>(-carry0[l]));
+        kahanAdd(sum, carry, static_cast<T>(-carry1[l]));
+    }
+    for (; i < end; ++i) {
+        kahanAdd(sum, carry, term.scalar(i));
+    }
+    return sum;
+}
+
+// Pairwise summation without recursion: block sums are pushed like a binary
+// counter, so block b merges with its neighbours once per trailing one bit.
+template <typename T, std::size_t Bytes, typename Term>
+[[gnu::always_inline]] inline T addPairwise(const Term& term, std::size_t i, std::size_t end) {
+    T stack[64];
+    std::size_t top = 0;
+    for (std::size_t block = 1; i < end; ++block, i += kPairwiseBlock) {
+        T s = addFast<T, Bytes>(term, i, std::min(end, i + kPairwiseBlock));
+        for (std::size_t b = block; (b & 1) == 0; b >>= 1) {
+            s = stack[--top] + s;
+        }
+        stack[top++] = s;
+    }
+    T total{};
+    while (top > 0) {
+        total = stack[--top] + total;
+    }
+    return total;
+}
+
+template <typename T, std::size_t Bytes, typename Term>
+[[gnu::always_inline]] inline T addBody(const Term& term, std::size_t begin, std::size_t end, Summation mode) {
+    if constexpr (std::is_floating_point<T>::value) {
+        if (mode == Summation::Kahan) {
+            return addKahan<T, Bytes>(term, begin, end);
+        }
+        if (mode == Summation::Pairwise) {
+            return addPairwise<T, Bytes>(term, begin, end);
+        }
+    }
+    return addFast<T, Bytes>(term, begin, end);
+}
+
+// m = better of (m, x), lane-wise for vectors.
+template <bool IsMin, typename V>
+[[gnu::always_inline]] inline void keepBetter(V& m, const V& x) {
+    if constexpr (IsMin) {
+        m = x < m ? x : m;
+    } else {
+        m = x > m ? x : m;
+    }
+}
+
+template <bool IsMin, std::size_t Bytes, typename T>
+[[gnu::always_inline]] inline T extremeBody(const T* a, std::size_t n) {
+    constexpr std::size_t W = kLanes<T, Bytes>;
+    std::size_t i = 0;
+    T best = a[0];
+    if (n >= 4 * W) {
+        Vec<T, Bytes> m0, m1, m2, m3, x0, x1, x2, x3;
+        load(m0, a);
+        load(m1, a + W);
+        load(m2, a + 2 * W);
+        load(m3, a + 3 * W);
+        for (i = 4 * W; i + 4 * W <= n; i += 4 * W) {
+            load(x0, a + i);
+            load(x1, a + i + W);
+            load(x2, a + i + 2 * W);
+            load(x3, a + i + 3 * W);
+            keepBetter<IsMin>(m0, x0);
+            keepBetter<IsMin>(m1, x1);
+            keepBetter<IsMin>(m2, x2);
+            keepBetter<IsMin>(m3, x3);
+        }
+        keepBetter<IsMin>(m0, m1);
+        keepBetter<IsMin>(m2, m3);
+        keepBetter<IsMin>(m0, m2);
+        for (std::size_t l = 0; l < W; ++l) {
+            keepBetter<IsMin>(best, static_cast<T>(m0[l]));
+        }
+    }
+    for (; i < n; ++i) {
+        keepBetter<IsMin>(best, a[i]);
+    }
+    return best;
+}
+
+// Each kernel exists twice: 16-byte vectors for the baseline ISA and
+// 32-byte vectors for AVX2. The bodies above are always_inline, so each
+// wrapper gets its own code generation.
+template <typename T, typename Term>
+T addDefault(const Term& term, std::size_t begin, std::size_t end, Summation mode) {
+    return addBody<T, 16>(term, begin, end, mode);
+}
+
+template <bool IsMin, typename T>
+T extremeDefault(const T* a, std::size_t n) {
+    return extremeBody<IsMin, 16>(a, n);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <typename T, typename Term>
+__attribute__((target("avx2,fma"))) T addAvx2(const Term& term, std::size_t begin, std::size_t end, Summation mode) {
+    return addBody<T, 32>(term, begin, end, mode);
+}
+
+template <bool IsMin, typename T>
+__attribute__((target("avx2,fma"))) T extremeAvx2(const T* a, std::size_t n) {
+    return extremeBody<IsMin, 32>(a, n);
+}
+
+inline bool cpuHasAvx2() {
+    static const bool has = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return has;
+}
+#endif
+
+template <typename T, typename Term>
+T addRange(const Term& term, std::size_t begin, std::size_t end, const Options& options) {
+    if (!options.vectorize) {
+        // Same loop as std::accumulate: one accumulator, serial dependency chain.
+        T total{};
+        for (std::size_t i = begin; i < end; ++i) {
+            total += term.scalar(i);
+        }
+        return total;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if (cpuHasAvx2()) {
+        return addAvx2<T>(term, begin, end, options.summation);
+    }
+#endif
+    return addDefault<T>(term, begin, end, options.summation);
+}
+
+template <bool IsMin, typename T>
+T extremeRange(const T* a, std::size_t n, const Options& options) {
+    if (!options.vectorize) {
+        T best = a[0];
+        for (std::size_t i = 1; i < n; ++i) {
+            keepBetter<IsMin>(best, a[i]);
+        }
+        return best;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if (cpuHasAvx2()) {
+        return extremeAvx2<IsMin>(a, n);
+    }
+#endif
+    return extremeDefault<IsMin>(a, n);
+}
+
+inline ThreadPool& sharedPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+// Runs chunk(begin, end) over [0, n) on the pool and returns the partial
+// results in order.
+template <typename R, typename Chunk>
+std::vector<R> forChunks(std::size_t n, const Options& options, Chunk chunk) {
+    static const std::size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t threads = options.threads ? options.threads : hardwareThreads;
+    if (threads <= 1) {
+        return {chunk(std::size_t(0), n)};
+    }
+    ThreadPool& pool = options.pool ? *options.pool : sharedPool();
+    // Chunk boundaries on 64-element multiples keep every chunk's vector loads aligned alike.
+    std::size_t step = (n / threads + 63) / 64 * 64;
+    std::vector<std::future<R>> pending;
+    for (std::size_t begin = step; begin < n; begin += step) {
+        std::size_t end = std::min(n, begin + step);
+        pending.push_back(pool.enqueue([&chunk, begin, end] { return chunk(begin, end); }));
+    }
+    std::vector<R> partials;
+    partials.push_back(chunk(std::size_t(0), std::min(n, step)));
+    for (auto& f : pending) {
+        partials.push_back(f.get());
+    }
+    return partials;
+}
+
+template <typename T>
+T combineSums(const std::vector<T>& partials, Summation mode) {
+    T sum{};
+    if constexpr (std::is_floating_point<T>::value) {
+        if (mode != Summation::Fast) {
+            T carry{};
+            for (T p : partials) {
+                kahanAdd(sum, carry, p);
+            }
+            return sum;
+        }
+    }
+    for (T p : partials) {
+        sum += p;
+    }
+    return sum;
+}
+
+template <typename T, typename Term>
+T parallelAdd(const Term& term, std::size_t n, const Options& options) {
+    if (n < options.parallelThreshold) {
+        return addRange<T>(term, 0, n, options);
+    }
+    auto partials = forChunks<T>(n, options, [&](std::size_t begin, std::size_t end) {
+        return addRange<T>(term, begin, end, options);
+    });
+    return combineSums(partials, options.summation);
+}
+
+template <bool IsMin, typename T>
+std::optional<T> parallelExtreme(const T* a, std::size_t n, const Options& options) {
+    if (n == 0) {
+        return std::nullopt;
+    }
+    if (n < options.parallelThreshold) {
+        return extremeRange<IsMin>(a, n, options);
+    }
+    auto partials = forChunks<T>(n, options, [&](std::size_t begin, std::size_t end) {
+        return extremeRange<IsMin>(a + begin, end - begin, options);
+    });
+    return extremeRange<IsMin>(partials.data(), partials.size(), options);
+}
+
+template <typename T>
+constexpr void checkElementType() {
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+                      !std::is_same<T, long double>::value,
+                  "reduce:: works on arithmetic element types (no bool, no long double vectors)");
+}
+
+} // namespace detail
+
+template <typename T>
+T sum(const T* data, std::size_t n, const Options& options = {}) {
+    detail::checkElementType<T>();
+    return detail::parallelAdd<T>(detail::SumTerm<T>{data}, n, options);
+}
+
+template <typename T>
+T dot(const T* a, const T* b, std::size_t n, const Options& options = {}) {
+    detail::checkElementType<T>();
+    return detail::parallelAdd<T>(detail::DotTerm<T>{a, b}, n, options);
+}
+
+// Empty ranges have no minimum: std::nullopt.
+template <typename T>
+std::optional<T> min(const T* data, std::size_t n, const Options& options = {}) {
+    detail::checkElementType<T>();
+    return detail::parallelExtreme<true>(data, n, options);
+}
+
+template <typename T>
+std::optional<T> max(const T* data, std::size_t n, const Options& options = {}) {
+    detail::checkElementType<T>();
+    return detail::parallelExtreme<false>(data, n, options);
+}
+
+// Overloads for contiguous containers (anything with data() and size()).
+template <typename Container>
+using ElementOf = std::decay_t<decltype(*std::data(std::declval<const Container&>()))>;
+
+template <typename Container>
+auto sum(const Container& c, const Options& options = {}) -> ElementOf<Container> {
+    return reduce::sum(std::data(c), std::size(c), options);
+}
+
+template <typename Container>
+auto dot(const Container& a, const Container& b, const Options& options = {}) -> ElementOf<Container> {
+    return reduce::dot(std::data(a), std::data(b), std::min(std::size(a), std::size(b)), options);
+}
+
+template <typename Container>
+auto min(const Container& c, const Options& options = {}) -> std::optional<ElementOf<Container>> {
+    return reduce::min(std::data(c), std::size(c), options);
+}
+
+template <typename Container>
+auto max(const Container& c, const Options& options = {}) -> std::optional<ElementOf<Container>> {
+    return reduce::max(std::data(c), std::size(c), options);
+}
+
+} // namespace reduce
@@ -0,0 +1,144 @@
+// reduce::sum / min / max / dot against std::accumulate and friends.
+// Build: g++ -std=c++17 -O2 reduce_bench.cpp -o reduce_bench -pthread
+// Usage: ./reduce_bench [max elements]   (default 100M; 1G int needs 4 GB of RAM)
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "reduce.h"
+
+volatile double sink;
+
+// Best-of-runs time in microseconds; fewer runs for the big sizes.
+template <typename F>
+double timeIt(std::size_t n, F&& f) {
+    int runs = n <= 1000000 ? 20 : (n <= 100000000 ? 5 : 2);
+    double best = 1e300;
+    for (int r = 0; r < runs; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        sink = static_cast<double>(f());
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    return best;
+}
+
+template <typename T>
+std::vector<T> makeData(std::size_t n) {
+    std::vector<T> data(n);
+    std::mt19937_64 rng(42);
+    for (auto& x : data) {
+        if constexpr (std::is_integral<T>::value) {
+            x = static_cast<T>(rng() % 100);
+        } else {
+            // Mixed magnitudes make rounding error visible.
+            x = static_cast<T>(std::ldexp(static_cast<double>(rng() % 1000000) / 1e6, static_cast<int>(rng() % 20)));
+        }
+    }
+    return data;
+}
+
+bool checkResults() {
+    std::vector<int> ints = makeData<int>(100003);
+    std::vector<double> doubles = makeData<double>(100003);
+    reduce::Options parallel;
+    parallel.parallelThreshold = 1000;
+    parallel.threads = 4;
+
+    long long expectedInt = std::accumulate(ints.begin(), ints.end(), 0LL);
+    long double exact = std::accumulate(doubles.begin(), doubles.end(), 0.0L);
+    auto closeEnough = [&](double got) { return std::abs(static_cast<long double>(got) - exact) < 1e-6L * exact; };
+
+    bool ok = reduce::sum(ints) == expectedInt && reduce::sum(ints, parallel) == expectedInt &&
+              *reduce::min(ints) == *std::min_element(ints.begin(), ints.end()) &&
+              *reduce::max(ints, parallel) == *std::max_element(ints.begin(), ints.end()) &&
+              *reduce::min(doubles) == *std::min_element(doubles.begin(), doubles.end()) &&
+              reduce::dot(ints, ints) == std::inner_product(ints.begin(), ints.end(), ints.begin(), 0) &&
+              closeEnough(reduce::sum(doubles)) && closeEnough(reduce::sum(doubles, parallel)) &&
+              !reduce::min(std::vector<int>{}).has_value();
+    for (auto mode : {reduce::Summation::Kahan, reduce::Summation::Pairwise}) {
+        reduce::Options options;
+        options.summation = mode;
+        ok = ok && closeEnough(reduce::sum(doubles, options));
+    }
+    // Every length up to a few vectors, to cover all tail paths.
+    for (std::size_t n = 1; n < 200 && ok; ++n) {
+        ok = reduce::sum(ints.data(), n) == std::accumulate(ints.begin(), ints.begin() + static_cast<long>(n), 0) &&
+             *reduce::max(ints.data(), n) == *std::max_element(ints.begin(), ints.begin() + static_cast<long>(n));
+    }
+    return ok;
+}
+
+// Relative error of a double sum against a long double reference.
+double relativeError(const std::vector<double>& data, const reduce::Options& options) {
+    long double exact = 0;
+    long double carry = 0;
+    for (double x : data) {
+        long double y = x - carry;
+        long double t = exact + y;
+        carry = (t - exact) - y;
+        exact = t;
+    }
+    double got = options.vectorize ? reduce::sum(data, options) : std::accumulate(data.begin(), data.end(), 0.0);
+    return static_cast<double>(std::abs((static_cast<long double>(got) - exact) / exact));
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t maxN = argc > 1 ? std::stoull(argv[1]) : 100000000;
+    if (!checkResults()) {
+        std::cerr << "reduce:: results do not match the standard algorithms" << std::endl;
+        return 1;
+    }
+    std::cout << "Results match std::accumulate / min_element / inner_product.\n" << std::endl;
+
+    reduce::Options fast;
+    reduce::Options kahan;
+    kahan.summation = reduce::Summation::Kahan;
+    reduce::Options pairwise;
+    pairwise.summation = reduce::Summation::Pairwise;
+    reduce::Options serial;
+    serial.vectorize = false;
+
+    std::cout << std::setw(12) << "n" << " | " << std::setw(10) << "int acc" << std::setw(10) << "int sum"
+              << std::setw(8) << "x" << std::setw(10) << "int max" << " | " << std::setw(10) << "dbl acc"
+              << std::setw(10) << "dbl sum" << std::setw(8) << "x" << std::setw(10) << "kahan" << std::setw(10)
+              << "pairwise" << std::setw(10) << "dot" << "   (us)" << std::endl;
+
+    for (std::size_t n = 1000; n <= maxN; n *= 10) {
+        double intAcc, intSum, intMax;
+        {
+            auto ints = makeData<int>(n);
+            intAcc = timeIt(n, [&] { return std::accumulate(ints.begin(), ints.end(), 0); });
+            intSum = timeIt(n, [&] { return reduce::sum(ints, fast); });
+            intMax = timeIt(n, [&] { return *reduce::max(ints, fast); });
+        }
+        auto doubles = makeData<double>(n);
+        double dblAcc = timeIt(n, [&] { return std::accumulate(doubles.begin(), doubles.end(), 0.0); });
+        double dblSum = timeIt(n, [&] { return reduce::sum(doubles, fast); });
+        double dblKahan = timeIt(n, [&] { return reduce::sum(doubles, kahan); });
+        double dblPairwise = timeIt(n, [&] { return reduce::sum(doubles, pairwise); });
+        double dblDot = timeIt(n, [&] { return reduce::dot(doubles, doubles, fast); });
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(12) << n << " | " << std::setw(10) << intAcc
+                  << std::setw(10) << intSum << std::setw(7) << std::setprecision(1) << intAcc / intSum << "x"
+                  << std::setprecision(1) << std::setw(10) << intMax << " | " << std::setw(10) << dblAcc
+                  << std::setw(10) << dblSum << std::setw(7) << std::setprecision(1) << dblAcc / dblSum << "x"
+                  << std::setprecision(1) << std::setw(10) << dblKahan << std::setw(10) << dblPairwise
+                  << std::setw(10) << dblDot << std::endl;
+    }
+
+    auto doubles = makeData<double>(std::min<std::size_t>(maxN, 10000000));
+    std::cout << "\nRelative error of double sums over " << doubles.size() << " elements:" << std::endl;
+    std::cout << std::scientific << std::setprecision(2);
+    std::cout << "  std::accumulate " << relativeError(doubles, serial) << std::endl;
+    std::cout << "  Fast            " << relativeError(doubles, fast) << std::endl;
+    std::cout << "  Kahan           " << relativeError(doubles, kahan) << std::endl;
+    std::cout << "  Pairwise        " << relativeError(doubles, pairwise) << std::endl;
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Terminal frames for the snake game, three ways, on the same bot game:
+//   day22       system("clear"), then 800 cells through cout with endl;
+//   full frame  every cell in one write(), no diff;
+//   diff        term::Renderer: the changed cells in one write().
+// Output goes to a temporary file, so the numbers are the cost of producing
+// and writing a frame, not the terminal's drawing. Then the logic and the
+// renderer run on two threads joined by a TripleBuffer, as in snake_term.
+// Build: g++ -std=c++17 -O2 render_bench.cpp -o render_bench -pthread
+// Usage: ./render_bench [frames]   (default 5000; day22 runs at most 300)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "concurrent_queue.h"
+#include "snake_sim.h"
+#include "snake_view.h"
+#include "term_render.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Steers toward the food, avoiding walls and the body when it can.
+snake::Direction bot(const snake::Game& g) {
+    int hx = snake::Game::xOf(g.head()), hy = snake::Game::yOf(g.head());
+    int fx = snake::Game::xOf(g.food()), fy = snake::Game::yOf(g.food());
+    snake::Direction order[5] = {fx > hx ? snake::Direction::Right : snake::Direction::Left,
+                                 fy > hy ? snake::Direction::Down : snake::Direction::Up, snake::Direction::Up,
+                                 snake::Direction::Left, snake::Direction::Down};
+    if (fx == hx) {
+        order[0] = order[1];
+    }
+    for (snake::Direction d : order) {
+        int x = hx + (d == snake::Direction::Right) - (d == snake::Direction::Left);
+        int y = hy + (d == snake::Direction::Down) - (d == snake::Direction::Up);
+        if (d != snake::opposite(g.direction()) && !g.blocked(x, y)) {
+            return d;
+        }
+    }
+    return snake::Direction::Right;
+}
+
+// One tick of the bot game, restarting it when it ends.
+void advance(snake::Game& g) {
+    g.turn(bot(g));
+    g.step();
+    if (g.over()) {
+        g.restart();
+    }
+}
+
+// Game::draw of day22, a scan of the body for every cell.
+void day22Draw(const snake::Game& g) {
+    int rc = std::system("clear 2>/dev/null");
+    (void)rc;
+    for (int y = 0; y < snake::Game::kHeight; y++) {
+        for (int x = 0; x < snake::Game::kWidth; x++) {
+            if (snake::Game::cellAt(x, y) == g.food()) {
+                std::cout << "F";
+            } else {
+                bool isBody = false;
+                g.forEachBodyCell([&](snake::Game::Cell c) { isBody = isBody || c == snake::Game::cellAt(x, y); });
+                std::cout << (isBody ? "O" : " ");
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+struct Result {
+    double usPerFrame;
+    double bytesPerFrame;
+};
+
+// Sends stdout (and system()'s children) to fd while f runs, and measures
+// how much it wrote.
+template <typename F>
+Result measure(int fd, int frames, F f) {
+    ftruncate(fd, 0);
+    lseek(fd, 0, SEEK_SET);
+    std::cout.flush();
+    int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    auto start = Clock::now();
+    for (int i = 0; i < frames; ++i) {
+        f();
+    }
+    std::cout.flush();
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    off_t bytes = lseek(fd, 0, SEEK_END);
+    return Result{us / frames, static_cast<double>(bytes) / frames};
+}
+
+bool check(int fd) {
+    // After the first frame only the changed cells may be sent, with as
+    // few cursor moves and colour changes as possible.
+    ftruncate(fd, 0);
+    lseek(fd, 0, SEEK_SET);
+    term::Renderer r(fd, 10, 3);
+    r.back().text(0, 0, "hello");
+    size_t first = r.present();
+    if (r.present() != 0) {
+        std::cerr << "an unchanged frame must write nothing" << std::endl;
+        return false;
+    }
+    r.back().put(7, 2, 'x', term::kRed);
+    size_t second = r.present();
+    r.back().put(8, 2, 'y', term::kRed);
+    r.back().put(4, 1, 'z');
+    r.back().put(0, 1, 'a');
+    size_t third = r.present();
+    std::string sent(first + second + third, '\0');
+    if (pread(fd, &sent[0], sent.size(), 0) != static_cast<ssize_t>(sent.size())) {
+        return false;
+    }
+    std::string expected2 = "\x1b[3;8H\x1b[31mx";
+    // 'a' then the gap to 'z' is reprinted, then a jump to 'y'.
+    std::string expected3 = "\x1b[2;1H\x1b[0ma   z\x1b[3;9H\x1b[31my";
+    if (sent.compare(first, second, expected2) != 0 || sent.compare(first + second, third, expected3) != 0) {
+        std::cerr << "unexpected diff output" << std::endl;
+        return false;
+    }
+
+    // The reader always ends on the writer's last value and never sees one
+    // go backwards.
+    TripleBuffer<uint64_t> buffer;
+    const uint64_t n = 200000;
+    std::thread writer([&] {
+        for (uint64_t i = 1; i <= n; ++i) {
+            buffer.writeSlot() = i;
+            buffer.publish();
+        }
+    });
+    uint64_t last = 0;
+    bool ordered = true;
+    while (last != n) {
+        buffer.wait();
+        ordered = ordered && buffer.readSlot() > last;
+        last = buffer.readSlot();
+    }
+    writer.join();
+    if (!ordered) {
+        std::cerr << "TripleBuffer went backwards" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int frames = argc > 1 ? std::max(1, std::stoi(argv[1])) : 5000;
+    char path[] = "/tmp/render_benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::perror("mkstemp");
+        return 1;
+    }
+    unlink(path);
+    if (!check(fd)) {
+        return 1;
+    }
+    std::cout << "Diff output and TripleBuffer handoff checks pass." << std::endl;
+
+    std::cout << "\n" << snake::kViewWidth << "x" << snake::kViewHeight << " frames, one bot tick per frame\n"
+              << std::setw(12) << "" << std::setw(10) << "frames" << std::setw(14) << "us/frame" << std::setw(14)
+              << "bytes/frame" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    auto row = [](const char* name, int n, Result r) {
+        std::cout << std::setw(12) << name << std::setw(10) << n << std::setw(14) << r.usPerFrame << std::setw(14)
+                  << r.bytesPerFrame << std::endl;
+    };
+
+    int slow = std::min(frames, 300);
+    snake::Game game(1);
+    row("day22", slow, measure(fd, slow, [&] {
+        advance(game);
+        day22Draw(game);
+    }));
+    game = snake::Game(1);
+    term::Renderer full(fd, snake::kViewWidth, snake::kViewHeight);
+    row("full frame", frames, measure(fd, frames, [&] {
+        advance(game);
+        snake::draw(game, full.back());
+        full.invalidate();
+        full.present();
+    }));
+    game = snake::Game(1);
+    term::Renderer diff(fd, snake::kViewWidth, snake::kViewHeight);
+    row("diff", frames, measure(fd, frames, [&] {
+        advance(game);
+        snake::draw(game, diff.back());
+        diff.present();
+    }));
+    const term::Renderer::Stats& s = diff.stats();
+    std::cout << std::setw(12) << "" << "of which present(): " << s.nanos / 1000.0 / static_cast<double>(s.frames)
+              << " us" << std::endl;
+
+    // Logic unthrottled on one thread, the renderer on another: the logic
+    // never waits, and the renderer draws the newest state it finds.
+    TripleBuffer<snake::Game> handoff;
+    std::atomic<bool> stop{false};
+    term::Renderer threaded(fd, snake::kViewWidth, snake::kViewHeight);
+    game = snake::Game(1);
+    auto start = Clock::now();
+    std::thread render([&] {
+        do {
+            handoff.wait();
+            snake::draw(handoff.readSlot(), threaded.back());
+            threaded.present();
+        } while (!stop.load(std::memory_order_acquire));
+    });
+    const int ticks = frames * 20;
+    for (int i = 0; i < ticks; ++i) {
+        advance(game);
+        handoff.writeSlot() = game;
+        if (i == ticks - 1) {
+            stop.store(true, std::memory_order_release);
+        }
+        handoff.publish();
+    }
+    double logicUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    render.join();
+    const term::Renderer::Stats& t = threaded.stats();
+    std::cout << "\nRender thread behind a TripleBuffer: " << ticks << " ticks in " << logicUs / 1000.0 << " ms ("
+              << logicUs * 1000.0 / ticks << " ns/tick), " << t.frames << " frames drawn, "
+              << static_cast<double>(t.bytes) / static_cast<double>(t.frames) << " bytes/frame" << std::endl;
+    return 0;
+}
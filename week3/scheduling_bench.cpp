@@ -0,0 +1,201 @@
+// Interactive-task latency behind a batch backlog: FIFO enqueue() against
+// priority classes and deadlines (ThreadPool::submit).
+// Build: g++ -std=c++17 -O2 scheduling_bench.cpp -o scheduling_bench -pthread
+// Usage: ./scheduling_bench [batch tasks] [interactive tasks]   (default 4000, 200)
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+void spin(std::chrono::microseconds d) {
+    auto end = Clock::now() + d;
+    while (Clock::now() < end) {
+    }
+}
+
+// Runs the tasks submitted by submitAll on a one-worker pool after all of
+// them are queued, and returns the order in which they ran.
+template <typename Submit>
+std::vector<int> runOrder(Submit submitAll) {
+    std::mutex mutex;
+    std::vector<int> order;
+    auto record = [&](int tag) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(tag);
+    };
+    {
+        ThreadPool pool(1);
+        std::promise<void> gate;
+        std::shared_future<void> open = gate.get_future().share();
+        pool.enqueue([open] { open.wait(); });
+        submitAll(pool, record);
+        gate.set_value();
+    }  // the destructor runs the whole queue
+    return order;
+}
+
+bool checkScheduling() {
+    using P = TaskPriority;
+    auto at = [](int ms) { return Clock::now() + std::chrono::milliseconds(ms); };
+
+    // enqueue() alone stays FIFO.
+    std::vector<int> fifo = runOrder([](ThreadPool& pool, auto& record) {
+        for (int i = 0; i < 50; ++i) {
+            pool.enqueue(record, i);
+        }
+    });
+    if (!std::is_sorted(fifo.begin(), fifo.end()) || fifo.size() != 50) {
+        std::cerr << "enqueue() is no longer FIFO" << std::endl;
+        return false;
+    }
+
+    // Classes first, FIFO inside a class; deadlines in EDF order.
+    std::vector<int> classes = runOrder([&](ThreadPool& pool, auto& record) {
+        pool.submit({P::Batch, {}}, record, 5);
+        pool.submit({P::Normal, {}}, record, 3);
+        pool.submit({P::Interactive, {}}, record, 1);
+        pool.submit({P::Batch, {}}, record, 6);
+        pool.submit({P::Interactive, {}}, record, 2);
+        pool.enqueue(record, 4);
+        pool.submit({P::Batch, at(300)}, record, 9);
+        pool.submit({P::Batch, at(-10)}, record, 0);
+        pool.submit({P::Batch, at(100)}, record, 7);
+        pool.submit({P::Batch, at(200)}, record, 8);
+    });
+    // Deadline tasks 7..9 (100-300 ms) come after Normal (20 ms slack) but
+    // before Batch (500 ms slack).
+    if (classes != std::vector<int>{0, 1, 2, 3, 4, 7, 8, 9, 5, 6}) {
+        std::cerr << "priority / deadline order is wrong:";
+        for (int tag : classes) {
+            std::cerr << ' ' << tag;
+        }
+        std::cerr << std::endl;
+        return false;
+    }
+
+    // Aging: after waiting longer than its 500 ms slack, a Batch task runs
+    // before anything submitted since, even Interactive work.
+    std::vector<int> aged = runOrder([](ThreadPool& pool, auto& record) {
+        pool.submit({P::Batch, {}}, record, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(520));
+        pool.enqueue(record, 2);
+        pool.submit({P::Interactive, {}}, record, 0);
+    });
+    if (aged != std::vector<int>{1, 0, 2}) {
+        std::cerr << "Batch task was starved" << std::endl;
+        return false;
+    }
+
+    // Cancellation of queued tasks only.
+    ThreadPool pool(1);
+    std::promise<void> gate;
+    std::shared_future<void> open = gate.get_future().share();
+    auto blocker = pool.submit({}, [open] { open.wait(); });
+    auto victim = pool.submit({P::Batch, {}}, [] { return 1; });
+    auto survivor = pool.submit({P::Batch, {}}, [] { return 2; });
+    while (pool.stats().queueDepth != 2) {
+        std::this_thread::yield();  // until the blocker has started
+    }
+    bool ok = !pool.cancel(blocker.id) && pool.cancel(victim.id) && !pool.cancel(victim.id) &&
+              !pool.cancel(12345);
+    gate.set_value();
+    try {
+        victim.future.get();
+        ok = false;
+    } catch (const std::future_error& e) {
+        ok = ok && e.code() == std::future_errc::broken_promise;
+    }
+    ok = ok && survivor.future.get() == 2 && pool.stats().cancelled == 1;
+    if (!ok) {
+        std::cerr << "cancel() is wrong" << std::endl;
+    }
+    return ok;
+}
+
+struct Latency {
+    double p50, p99, max;
+};
+
+enum class Mode { Fifo, Priority, Deadline };
+
+// A backlog of batch tasks (100 us each) with interactive tasks (10 us)
+// arriving every 2 ms; returns the interactive queue-wait percentiles in
+// microseconds, and the time to drain everything.
+Latency mixed(Mode mode, int batch, int interactive, double& totalMs, uint64_t& misses) {
+    std::vector<double> waits(static_cast<size_t>(interactive));
+    auto start = Clock::now();
+    {
+        ThreadPool pool(4);
+        for (int i = 0; i < batch; ++i) {
+            auto work = [] { spin(std::chrono::microseconds(100)); };
+            if (mode == Mode::Fifo) {
+                pool.enqueue(work);
+            } else {
+                pool.submit({TaskPriority::Batch, {}}, work);
+            }
+        }
+        for (int i = 0; i < interactive; ++i) {
+            auto submitted = Clock::now();
+            auto work = [&waits, i, submitted] {
+                waits[static_cast<size_t>(i)] =
+                    std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+                spin(std::chrono::microseconds(10));
+            };
+            if (mode == Mode::Fifo) {
+                pool.enqueue(work);
+            } else if (mode == Mode::Priority) {
+                pool.submit({TaskPriority::Interactive, {}}, work);
+            } else {
+                pool.submit({TaskPriority::Normal, submitted + std::chrono::milliseconds(5)}, work);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        misses = pool.stats().deadlineMisses;
+    }
+    totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::sort(waits.begin(), waits.end());
+    return {waits[waits.size() / 2], waits[waits.size() * 99 / 100], waits.back()};
+}
+
+int main(int argc, char* argv[]) {
+    int batch = argc > 1 ? std::stoi(argv[1]) : 4000;
+    int interactive = argc > 2 ? std::max(1, std::stoi(argv[2])) : 200;
+    if (!checkScheduling()) {
+        return 1;
+    }
+    std::cout << "FIFO, class, deadline, aging and cancel checks pass." << std::endl;
+
+    std::cout << "\n" << batch << " batch tasks (100 us) + " << interactive
+              << " interactive tasks (10 us, every 2 ms) on 4 workers\n"
+              << std::left << std::setw(26) << "scheduling" << std::right << std::setw(12) << "p50 us"
+              << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::setw(12) << "total ms"
+              << std::setw(10) << "misses" << std::endl;
+    const std::pair<Mode, const char*> modes[] = {
+        {Mode::Fifo, "FIFO enqueue()"},
+        {Mode::Priority, "Interactive vs Batch"},
+        {Mode::Deadline, "5 ms deadline vs Batch"},
+    };
+    for (const auto& [mode, name] : modes) {
+        double totalMs = 0;
+        uint64_t misses = 0;
+        Latency l = mixed(mode, batch, interactive, totalMs, misses);
+        std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << l.p50 << std::setw(12) << l.p99 << std::setw(12) << l.max << std::setw(12)
+                  << totalMs << std::setw(10);
+        if (mode == Mode::Deadline) {
+            std::cout << misses << std::endl;
+        } else {
+            std::cout << "-" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,305 @@
+// The headless snake core (snake_sim.h) against day22's data structures:
+// a vector body with the head at the front, and linear scans for
+// collisions, food and the bot's lookups. Both sides play the same
+// greedy bot with the same seeds.
+// Build: g++ -std=c++17 -O2 snake_bench.cpp -o snake_bench -pthread
+// Usage: ./snake_bench [games] [ticks per game]   (default 4096 games, 1000 ticks)
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "snake_sim.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+using snake::Direction;
+using snake::Step;
+
+struct Point {
+    int x, y;
+    bool operator==(const Point& o) const { return x == o.x && y == o.y; }
+};
+
+// day22's Snake and Food with the core's rules and generator, so both
+// make the same moves and place the same food.
+template <int W, int H>
+class Day22Game {
+public:
+    static constexpr int kCells = W * H;
+
+    explicit Day22Game(uint64_t seed = 0) { reset(seed); }
+
+    void reset(uint64_t seed) {
+        rng_ = snake::Rng(seed);
+        body_.assign(1, Point{W / 2, H / 2});
+        dir_ = Direction::Right;
+        over_ = won_ = false;
+        eaten_ = 0;
+        placeFood();
+    }
+
+    void restart() { reset(rng_.next64()); }
+
+    void turn(Direction d) {
+        if (d != snake::opposite(dir_)) {
+            dir_ = d;
+        }
+    }
+
+    Step step() {
+        if (over_) {
+            return won_ ? Step::Won : Step::Died;
+        }
+        Point next = body_.front();
+        switch (dir_) {
+            case Direction::Up: --next.y; break;
+            case Direction::Down: ++next.y; break;
+            case Direction::Left: --next.x; break;
+            case Direction::Right: ++next.x; break;
+        }
+        bool eat = next == food_;
+        if (next.x < 0 || next.x >= W || next.y < 0 || next.y >= H ||
+            std::find(body_.begin(), body_.end() - (eat ? 0 : 1), next) != body_.end() - (eat ? 0 : 1)) {
+            over_ = true;
+            return Step::Died;
+        }
+        body_.insert(body_.begin(), next);
+        if (!eat) {
+            body_.pop_back();
+            return Step::Moved;
+        }
+        ++eaten_;
+        if (static_cast<int>(body_.size()) == kCells) {
+            over_ = won_ = true;
+            return Step::Won;
+        }
+        placeFood();
+        return Step::Ate;
+    }
+
+    bool blocked(int x, int y) const {
+        return x < 0 || x >= W || y < 0 || y >= H || onBody(Point{x, y});
+    }
+
+    Point head() const { return body_.front(); }
+    Point food() const { return food_; }
+    Direction direction() const { return dir_; }
+    const std::vector<Point>& body() const { return body_; }
+    uint64_t eaten() const { return eaten_; }
+
+private:
+    bool onBody(Point p) const { return std::find(body_.begin(), body_.end(), p) != body_.end(); }
+
+    void placeFood() {
+        for (int i = 0; i < 4; ++i) {
+            int c = static_cast<int>(rng_.below(kCells));
+            if (!onBody(Point{c % W, c / W})) {
+                food_ = Point{c % W, c / W};
+                return;
+            }
+        }
+        uint32_t k = rng_.below(static_cast<uint32_t>(kCells - static_cast<int>(body_.size())));
+        for (int c = 0;; ++c) {
+            if (!onBody(Point{c % W, c / W}) && k-- == 0) {
+                food_ = Point{c % W, c / W};
+                return;
+            }
+        }
+    }
+
+    std::vector<Point> body_;
+    Point food_{0, 0};
+    Direction dir_ = Direction::Right;
+    bool over_ = false;
+    bool won_ = false;
+    uint64_t eaten_ = 0;
+    snake::Rng rng_;
+};
+
+template <int W, int H>
+Point headOf(const snake::BasicGame<W, H>& g) {
+    return Point{g.xOf(g.head()), g.yOf(g.head())};
+}
+template <int W, int H>
+Point foodOf(const snake::BasicGame<W, H>& g) {
+    return Point{g.xOf(g.food()), g.yOf(g.food())};
+}
+template <int W, int H>
+Point headOf(const Day22Game<W, H>& g) {
+    return g.head();
+}
+template <int W, int H>
+Point foodOf(const Day22Game<W, H>& g) {
+    return g.food();
+}
+
+// Heads for the food along whichever axis is off, and takes the first
+// free cell among its preferences: up to four occupancy lookups a tick.
+struct Greedy {
+    template <typename G>
+    Direction operator()(const G& g) const {
+        Point h = headOf(g), f = foodOf(g);
+        Direction order[4];
+        int n = 0;
+        auto add = [&](Direction d) {
+            if (std::find(order, order + n, d) == order + n) {
+                order[n++] = d;
+            }
+        };
+        if (f.x > h.x) add(Direction::Right);
+        if (f.x < h.x) add(Direction::Left);
+        if (f.y < h.y) add(Direction::Up);
+        if (f.y > h.y) add(Direction::Down);
+        add(g.direction());
+        add(Direction::Up);
+        add(Direction::Left);
+        add(Direction::Down);
+        add(Direction::Right);
+        for (Direction d : order) {
+            int x = h.x + (d == Direction::Right) - (d == Direction::Left);
+            int y = h.y + (d == Direction::Down) - (d == Direction::Up);
+            if (d != snake::opposite(g.direction()) && !g.blocked(x, y)) {
+                return d;
+            }
+        }
+        return g.direction();
+    }
+};
+
+// Plays seeds side by side, restarting after each death, and compares
+// every step: result, head, food and the body from head to tail.
+template <int W, int H>
+bool checkAgainstDay22(int seeds, int ticks) {
+    Greedy bot;
+    for (int seed = 0; seed < seeds; ++seed) {
+        snake::BasicGame<W, H> fast(static_cast<uint64_t>(seed));
+        Day22Game<W, H> slow(static_cast<uint64_t>(seed));
+        for (int t = 0; t < ticks; ++t) {
+            fast.turn(bot(fast));
+            slow.turn(bot(slow));
+            Step a = fast.step(), b = slow.step();
+            std::vector<Point> body;
+            fast.forEachBodyCell([&](uint16_t c) { body.push_back(Point{c % W, c / W}); });
+            if (a != b || !(headOf(fast) == slow.head()) || !(foodOf(fast) == slow.food()) ||
+                body != slow.body() || fast.length() != static_cast<int>(body.size())) {
+                std::cerr << W << "x" << H << " seed " << seed << " diverges at tick " << t << std::endl;
+                return false;
+            }
+            if (fast.occupied(fast.food()) && !fast.over()) {
+                std::cerr << "food placed on the snake" << std::endl;
+                return false;
+            }
+            if (a == Step::Died || a == Step::Won) {
+                fast.restart();
+                slow.restart();
+            }
+        }
+    }
+    return true;
+}
+
+bool check() {
+    if (!checkAgainstDay22<40, 20>(100, 3000) || !checkAgainstDay22<6, 5>(300, 500)) {
+        return false;
+    }
+
+    snake::Game wall(1);
+    wall.turn(Direction::Left);  // reversing is ignored
+    if (wall.direction() != Direction::Right) {
+        std::cerr << "a turn back into the body must be ignored" << std::endl;
+        return false;
+    }
+    Step r = Step::Moved;
+    while (r == Step::Moved || r == Step::Ate) {
+        r = wall.step();
+    }
+    if (r != Step::Died || wall.ticks() != 20) {
+        std::cerr << "the snake must die on the right wall after 20 ticks" << std::endl;
+        return false;
+    }
+
+    // A Hamiltonian cycle fills a 4x2 board: the ring wraps on every lap.
+    snake::BasicGame<4, 2> tiny(7);
+    for (int t = 0; t < 1000 && !tiny.over(); ++t) {
+        int x = tiny.xOf(tiny.head()), y = tiny.yOf(tiny.head());
+        tiny.turn(y == 1 ? (x == 3 ? Direction::Up : Direction::Right)
+                         : (x == 0 ? Direction::Down : Direction::Left));
+        tiny.step();
+    }
+    if (!tiny.won() || tiny.length() != 8 || tiny.eaten() != 7) {
+        std::cerr << "the cycle must fill the board" << std::endl;
+        return false;
+    }
+
+    // The same seeds give the same games on any number of workers.
+    std::vector<snake::Game> a, b;
+    for (uint64_t s = 0; s < 64; ++s) {
+        a.emplace_back(s);
+        b.emplace_back(s);
+    }
+    ThreadPool one(1), four(4);
+    snake::RunStats sa = snake::runGames(one, a, 2000, Greedy{}, 1);
+    snake::RunStats sb = snake::runGames(four, b, 2000, Greedy{}, 16);
+    if (sa.episodes != sb.episodes || sa.food != sb.food || sa.ticks != 64 * 2000) {
+        std::cerr << "runGames depends on the number of workers" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].head() != b[i].head() || a[i].food() != b[i].food() || a[i].length() != b[i].length()) {
+            std::cerr << "game " << i << " differs between runs" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename G>
+double run(int threads, int games, uint64_t ticks, snake::RunStats& stats) {
+    std::vector<G> g;
+    for (int s = 0; s < games; ++s) {
+        g.emplace_back(static_cast<uint64_t>(s));
+    }
+    ThreadPool pool(static_cast<size_t>(threads));
+    auto start = Clock::now();
+    stats = snake::runGames(pool, g, ticks, Greedy{}, static_cast<size_t>(threads) * 8);
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int games = argc > 1 ? std::max(1, std::stoi(argv[1])) : 4096;
+    uint64_t ticks = argc > 2 ? std::stoull(argv[2]) : 1000;
+    if (!check()) {
+        return 1;
+    }
+    std::cout << "Step-by-step match with day22's structures, walls, reversal, full board and "
+                 "worker-count determinism checks pass."
+              << std::endl;
+
+    std::cout << "\n" << games << " games x " << ticks << " ticks, greedy bot, "
+              << sizeof(snake::Game) << "-byte games\n"
+              << std::setw(22) << "" << std::setw(10) << "threads" << std::setw(14) << "Mticks/s"
+              << std::setw(10) << "deaths" << std::setw(14) << "food/1k ticks" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    auto row = [&](const char* name, int threads, double seconds, const snake::RunStats& s) {
+        std::cout << std::setw(22) << name << std::setw(10) << threads << std::setw(14)
+                  << s.ticks / seconds / 1e6 << std::setw(10) << s.episodes << std::setw(14)
+                  << 1000.0 * static_cast<double>(s.food) / static_cast<double>(s.ticks) << std::endl;
+    };
+    snake::RunStats stats;
+    double t = run<Day22Game<40, 20>>(1, games, ticks, stats);
+    row("day22 structures", 1, t, stats);
+    int hw = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int threads = 1;; threads = std::min(threads * 2, hw)) {
+        t = run<snake::Game>(threads, games, ticks, stats);
+        row("snake_sim.h", threads, t, stats);
+        if (threads == hw) {
+            break;
+        }
+    }
+    return 0;
+}
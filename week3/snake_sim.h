@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Headless simulation core for the snake game of day22, for bots and
+// training runs.
+//
+//   snake::Game game(seed);
+//   while (!game.over()) {
+//       game.turn(choose(game));      // reversing into the body is ignored
+//       game.step();                  // Moved, Ate, Died or Won
+//   }
+//
+// Unlike day22, nothing here is O(length). The body is a ring buffer (the
+// head moves in O(1)), collisions test a bitset occupancy grid, and food
+// goes to a uniformly random free cell. With a seeded PCG32 in place of
+// rand(), a game is a pure function of its seed and its inputs. A game is
+// ~2 KB with no heap, so runGames() can step thousands of them side by
+// side on a ThreadPool.
+//
+// Rules as in day22: the board has walls, the snake starts with one cell
+// in the middle heading right, and the tail moves out of the way before
+// the head moves in. One change: eating grows the snake by one cell (the
+// tail stays put). day22's grow() also advanced the head a second time.
+namespace snake {
+
+enum class Direction : uint8_t { Up, Down, Left, Right };
+enum class Step : uint8_t { Moved, Ate, Died, Won };
+
+inline Direction opposite(Direction d) {
+    switch (d) {
+        case Direction::Up: return Direction::Down;
+        case Direction::Down: return Direction::Up;
+        case Direction::Left: return Direction::Right;
+        default: return Direction::Left;
+    }
+}
+
+// PCG32 (O'Neill): 8 bytes of state, and the same sequence everywhere for
+// a given seed.
+class Rng {
+public:
+    explicit Rng(uint64_t seed = 0) {
+        next();
+        state_ += seed;
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state_;
+        state_ = old * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t x = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (x >> rot) | (x << ((32 - rot) & 31));
+    }
+
+    uint64_t next64() { return (uint64_t(next()) << 32) | next(); }
+
+    // Uniform in [0, n) for n > 0 (Lemire's multiply-shift, with rejection
+    // of the few biased products).
+    uint32_t below(uint32_t n) {
+        uint64_t m = uint64_t(next()) * n;
+        if (static_cast<uint32_t>(m) < n) {
+            uint32_t threshold = (0u - n) % n;
+            while (static_cast<uint32_t>(m) < threshold) {
+                m = uint64_t(next()) * n;
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+
+private:
+    uint64_t state_ = 0;
+};
+
+template <int W, int H>
+class BasicGame {
+public:
+    static constexpr int kWidth = W;
+    static constexpr int kHeight = H;
+    static constexpr int kCells = W * H;
+    static_assert(W >= 2 && H >= 1 && kCells <= 65535, "cells are 16-bit indices");
+
+    using Cell = uint16_t;
+
+    BasicGame() : BasicGame(0) {}
+    explicit BasicGame(uint64_t seed) { reset(seed); }
+
+    void reset(uint64_t seed) {
+        rng_ = Rng(seed);
+        words_.fill(0);
+        head_ = 0;
+        length_ = 1;
+        body_[0] = cellAt(W / 2, H / 2);
+        set(body_[0]);
+        dir_ = Direction::Right;
+        over_ = won_ = false;
+        ticks_ = eaten_ = 0;
+        placeFood();
+    }
+
+    // A new game, seeded from this one's generator.
+    void restart() { reset(rng_.next64()); }
+
+    // Ignores a turn straight back into the snake, like day22's input().
+    void turn(Direction d) {
+        if (d != opposite(dir_)) {
+            dir_ = d;
+        }
+    }
+
+    Step step() {
+        if (over_) {
+            return won_ ? Step::Won : Step::Died;
+        }
+        int x = xOf(head()), y = yOf(head());
+        switch (dir_) {
+            case Direction::Up: --y; break;
+            case Direction::Down: ++y; break;
+            case Direction::Left: --x; break;
+            case Direction::Right: ++x; break;
+        }
+        ++ticks_;
+        if (x < 0 || x >= W || y < 0 || y >= H) {
+            over_ = true;
+            return Step::Died;
+        }
+        Cell next = cellAt(x, y);
+        bool eat = next == food_;
+        Cell tail = body_[tailIndex()];
+        if (test(next) && (eat || next != tail)) {
+            over_ = true;
+            return Step::Died;
+        }
+        if (!eat) {
+            clear(tail);
+            --length_;
+        }
+        head_ = head_ + 1 == kCells ? 0 : head_ + 1;
+        body_[head_] = next;
+        ++length_;
+        set(next);
+        if (!eat) {
+            return Step::Moved;
+        }
+        ++eaten_;
+        if (length_ == kCells) {
+            over_ = won_ = true;
+            return Step::Won;
+        }
+        placeFood();
+        return Step::Ate;
+    }
+
+    static Cell cellAt(int x, int y) { return static_cast<Cell>(y * W + x); }
+    static int xOf(Cell c) { return c % W; }
+    static int yOf(Cell c) { return c / W; }
+
+    Cell head() const { return body_[head_]; }
+    Cell food() const { return food_; }
+    Direction direction() const { return dir_; }
+    int length() const { return length_; }
+    bool over() const { return over_; }
+    bool won() const { return won_; }
+    uint64_t ticks() const { return ticks_; }
+    uint64_t eaten() const { return eaten_; }
+
+    bool occupied(Cell c) const { return test(c); }
+    // Off the board counts as occupied.
+    bool blocked(int x, int y) const { return x < 0 || x >= W || y < 0 || y >= H || test(cellAt(x, y)); }
+
+    // Calls f(cell) from the head to the tail.
+    template <typename F>
+    void forEachBodyCell(F f) const {
+        int i = head_;
+        for (int n = 0; n < length_; ++n) {
+            f(body_[static_cast<size_t>(i)]);
+            i = i == 0 ? kCells - 1 : i - 1;
+        }
+    }
+
+private:
+    static constexpr size_t kWords = (kCells + 63) / 64;
+
+    int tailIndex() const {
+        int i = head_ - length_ + 1;
+        return i < 0 ? i + kCells : i;
+    }
+
+    bool test(Cell c) const { return (words_[c / 64] >> (c % 64)) & 1; }
+    void set(Cell c) { words_[c / 64] |= uint64_t(1) << (c % 64); }
+    void clear(Cell c) { words_[c / 64] &= ~(uint64_t(1) << (c % 64)); }
+
+    // A uniformly random free cell: a few rejection draws while the board
+    // is mostly free, else the k-th free cell found by popcount, one word
+    // at a time.
+    void placeFood() {
+        for (int i = 0; i < 4; ++i) {
+            Cell c = static_cast<Cell>(rng_.below(kCells));
+            if (!test(c)) {
+                food_ = c;
+                return;
+            }
+        }
+        uint32_t k = rng_.below(static_cast<uint32_t>(kCells - length_));
+        for (size_t w = 0;; ++w) {
+            uint64_t free = ~words_[w];
+            if (w == kWords - 1 && kCells % 64 != 0) {
+                free &= (uint64_t(1) << (kCells % 64)) - 1;
+            }
+            uint32_t n = static_cast<uint32_t>(__builtin_popcountll(free));
+            if (k < n) {
+                for (; k > 0; --k) {
+                    free &= free - 1;  // drop the lowest free cell
+                }
+                food_ = static_cast<Cell>(w * 64 + static_cast<size_t>(__builtin_ctzll(free)));
+                return;
+            }
+            k -= n;
+        }
+    }
+
+    std::array<Cell, kCells> body_;  // ring, head at head_
+    std::array<uint64_t, kWords> words_;
+    int head_ = 0;
+    int length_ = 0;
+    Cell food_ = 0;
+    Direction dir_ = Direction::Right;
+    bool over_ = false;
+    bool won_ = false;
+    uint64_t ticks_ = 0;
+    uint64_t eaten_ = 0;
+    Rng rng_;
+};
+
+// The board of day22.
+using Game = BasicGame<40, 20>;
+
+struct RunStats {
+    uint64_t ticks = 0;
+    uint64_t episodes = 0;  // games finished (and restarted)
+    uint64_t food = 0;
+};
+
+// Advances every game by ticks steps on pool. Before each step,
+// policy(game) returns the direction to turn. A finished game restarts at
+// once, so every game runs all its ticks. Each task steps a contiguous run
+// of games, and each game runs all its ticks before the next one starts,
+// so its state stays in L1. The result is the same for any number of
+// workers.
+template <typename GameT, typename Policy>
+RunStats runGames(ThreadPool& pool, std::vector<GameT>& games, uint64_t ticks, Policy policy, size_t tasks) {
+    tasks = std::max<size_t>(1, std::min(tasks, games.size()));
+    std::vector<std::future<RunStats>> parts;
+    for (size_t t = 0; t < tasks; ++t) {
+        size_t begin = games.size() * t / tasks, end = games.size() * (t + 1) / tasks;
+        parts.push_back(pool.enqueue([&games, ticks, policy, begin, end] {
+            RunStats s;
+            for (size_t g = begin; g < end; ++g) {
+                GameT& game = games[g];
+                uint64_t before = game.eaten();  // eaten before this run
+                for (uint64_t i = 0; i < ticks; ++i) {
+                    game.turn(policy(game));
+                    Step r = game.step();
+                    if (r == Step::Died || r == Step::Won) {
+                        s.food += game.eaten() - before;
+                        before = 0;
+                        ++s.episodes;
+                        game.restart();
+                    }
+                }
+                s.food += game.eaten() - before;
+            }
+            s.ticks = ticks * (end - begin);
+            return s;
+        }));
+    }
+    RunStats total;
+    for (auto& p : parts) {
+        RunStats s = p.get();
+        total.ticks += s.ticks;
+        total.episodes += s.episodes;
+        total.food += s.food;
+    }
+    return total;
+}
+
+}  // namespace snake
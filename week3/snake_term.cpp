@@ -0,0 +1,130 @@
+// day22's snake game for Linux terminals, on snake_sim.h and
+// term_render.h. It keeps day22's three threads but drops the shared
+// mutex:
+//   input   hands the last key to the logic thread in an atomic;
+//   logic   ticks the game and publishes a copy through a TripleBuffer;
+//   render  draws the newest copy and writes the changed cells.
+// A slow terminal costs frames, never ticks. On exit it prints the frame
+// time and bytes per frame.
+// Build: g++ -std=c++17 -O2 snake_term.cpp -o snake_term -pthread
+// Usage: ./snake_term [tick ms] [seed]   (w/a/s/d to steer, q to quit; default 100 ms)
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "concurrent_queue.h"
+#include "snake_sim.h"
+#include "snake_view.h"
+#include "term_render.h"
+
+struct Snapshot {
+    snake::Game game;
+    bool quit = false;
+};
+
+// Raw keys without echo, restored on exit.
+class RawMode {
+public:
+    RawMode() : active_(isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_) == 0) {
+        if (active_) {
+            termios raw = saved_;
+            raw.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO);
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+    }
+    ~RawMode() {
+        if (active_) {
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved_);
+        }
+    }
+
+private:
+    termios saved_{};
+    bool active_;
+};
+
+int main(int argc, char* argv[]) {
+    int tickMs = argc > 1 ? std::stoi(argv[1]) : 100;
+    uint64_t seed = argc > 2 ? std::stoull(argv[2])
+                             : static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+
+    constexpr int kNoKey = -1, kQuit = -2;
+    std::atomic<int> key{kNoKey};
+    std::atomic<bool> done{false};
+    TripleBuffer<Snapshot> frames;
+    term::Renderer::Stats stats;
+    RawMode raw;
+
+    std::thread input([&] {
+        pollfd in{STDIN_FILENO, POLLIN, 0};
+        while (!done.load(std::memory_order_relaxed)) {
+            char ch;
+            if (poll(&in, 1, 50) <= 0 || read(STDIN_FILENO, &ch, 1) != 1) {
+                continue;
+            }
+            switch (ch) {
+                case 'w': key.store(static_cast<int>(snake::Direction::Up)); break;
+                case 's': key.store(static_cast<int>(snake::Direction::Down)); break;
+                case 'a': key.store(static_cast<int>(snake::Direction::Left)); break;
+                case 'd': key.store(static_cast<int>(snake::Direction::Right)); break;
+                case 'q': key.store(kQuit); break;
+            }
+        }
+    });
+
+    std::thread logic([&] {
+        snake::Game game(seed);
+        for (;;) {
+            // The last key of a tick wins.
+            int k = key.exchange(kNoKey);
+            if (k >= 0) {
+                game.turn(static_cast<snake::Direction>(k));
+            }
+            if (k != kQuit) {
+                game.step();
+            }
+            Snapshot& out = frames.writeSlot();
+            out.game = game;
+            out.quit = k == kQuit;
+            frames.publish();
+            if (k == kQuit || game.over()) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(tickMs));
+        }
+    });
+
+    std::thread render([&] {
+        term::Renderer screen(STDOUT_FILENO, snake::kViewWidth, snake::kViewHeight);
+        for (;;) {
+            frames.wait();
+            const Snapshot& s = frames.readSlot();
+            snake::draw(s.game, screen.back());
+            screen.present();
+            if (s.quit || s.game.over()) {
+                break;
+            }
+        }
+        stats = screen.stats();
+    });
+
+    logic.join();
+    render.join();
+    done = true;
+    input.join();
+
+    std::cout << std::fixed << std::setprecision(1) << stats.frames << " frames, "
+              << stats.nanos / 1000.0 / static_cast<double>(stats.frames) << " us and "
+              << static_cast<double>(stats.bytes) / static_cast<double>(stats.frames) << " bytes per frame"
+              << std::endl;
+    return 0;
+}
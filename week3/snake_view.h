@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "snake_sim.h"
+#include "term_render.h"
+
+// How the terminal frontends draw a game: day22's 40x20 board inside a
+// border, with a status line under it.
+namespace snake {
+
+constexpr int kViewWidth = Game::kWidth + 2;
+constexpr int kViewHeight = Game::kHeight + 3;
+
+inline void draw(const Game& game, term::Frame& f) {
+    f.clear();
+    for (int x = 0; x < kViewWidth; ++x) {
+        f.put(x, 0, '#', term::kBlue);
+        f.put(x, Game::kHeight + 1, '#', term::kBlue);
+    }
+    for (int y = 1; y <= Game::kHeight; ++y) {
+        f.put(0, y, '#', term::kBlue);
+        f.put(kViewWidth - 1, y, '#', term::kBlue);
+    }
+    if (!game.over()) {
+        f.put(Game::xOf(game.food()) + 1, Game::yOf(game.food()) + 1, 'F', term::kRed);
+    }
+    game.forEachBodyCell([&](Game::Cell c) { f.put(Game::xOf(c) + 1, Game::yOf(c) + 1, 'O', term::kGreen); });
+    f.put(Game::xOf(game.head()) + 1, Game::yOf(game.head()) + 1, '@', term::kGreen);
+    std::string status = "score " + std::to_string(game.eaten()) + "  length " + std::to_string(game.length());
+    if (game.over()) {
+        status += game.won() ? "  YOU WIN" : "  GAME OVER";
+    }
+    f.text(0, Game::kHeight + 2, status, game.over() ? term::kYellow : term::kDefault);
+}
+
+}  // namespace snake
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Flicker-free terminal frames for Linux (any ANSI/VT100 terminal).
+//
+//   term::Renderer screen(STDOUT_FILENO, 40, 20);
+//   for (;;) {
+//       term::Frame& f = screen.back();
+//       f.clear();
+//       f.put(x, y, 'O', term::kGreen);
+//       screen.present();             // one write() with just the changes
+//   }
+//
+// The renderer keeps two frames: the one on the terminal (front) and the
+// one being drawn (back). present() compares them cell by cell and emits
+// only what changed. A cursor move covers a long jump, and a gap of a few
+// cells is cheaper to reprint than to jump over. A colour escape is sent
+// only when the colour changes. The whole update goes out in a single
+// write(), so the terminal never shows half a frame. A snake tick changes
+// about three cells, which is a few dozen bytes. day22 clears the screen
+// with system("cls") and prints all 800 cells a row at a time.
+namespace term {
+
+enum Color : uint8_t { kDefault = 0, kRed, kGreen, kYellow, kBlue, kMagenta, kCyan, kWhite };
+
+struct Cell {
+    char ch = ' ';
+    uint8_t color = kDefault;
+    bool operator==(const Cell& o) const { return ch == o.ch && color == o.color; }
+    bool operator!=(const Cell& o) const { return !(*this == o); }
+};
+
+class Frame {
+public:
+    Frame(int width, int height, Cell fill = Cell{})
+        : width_(width), height_(height), cells_(static_cast<size_t>(width * height), fill) {}
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    void clear(Cell fill = Cell{}) { cells_.assign(cells_.size(), fill); }
+
+    // Writes outside the frame are dropped.
+    void put(int x, int y, char ch, uint8_t color = kDefault) {
+        if (x >= 0 && x < width_ && y >= 0 && y < height_) {
+            cells_[index(x, y)] = Cell{ch, color};
+        }
+    }
+
+    void text(int x, int y, const std::string& s, uint8_t color = kDefault) {
+        for (char ch : s) {
+            put(x++, y, ch, color);
+        }
+    }
+
+    const Cell& at(int x, int y) const { return cells_[index(x, y)]; }
+    Cell& at(int x, int y) { return cells_[index(x, y)]; }
+
+private:
+    size_t index(int x, int y) const { return static_cast<size_t>(y * width_ + x); }
+
+    int width_;
+    int height_;
+    std::vector<Cell> cells_;
+};
+
+class Renderer {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t nanos = 0;  // in present(), diff and write()
+    };
+
+    // Draws at the top left of the terminal, which it clears on the
+    // first present(). The cursor stays hidden until destruction.
+    Renderer(int fd, int width, int height) : fd_(fd), front_(width, height), back_(width, height) {
+        out_.reserve(static_cast<size_t>(width * height) * 8);
+        invalidate();
+    }
+
+    ~Renderer() {
+        // Below the frame, default colour, cursor back on.
+        out_ = "\x1b[0m\x1b[" + std::to_string(front_.height() + 1) + ";1H\x1b[?25h";
+        flush();
+    }
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    Frame& back() { return back_; }
+
+    // Forgets what is on the terminal: the next present() clears the
+    // screen and draws every cell (after a resize, or another program
+    // wrote to it).
+    void invalidate() {
+        front_.clear(Cell{'\0', kDefault});
+        repaint_ = true;
+    }
+
+    // Sends the difference between back() and the terminal in one
+    // write(), and returns its size in bytes (0 if nothing changed).
+    size_t present() {
+        auto start = std::chrono::steady_clock::now();
+        out_.clear();
+        if (repaint_) {
+            out_ += "\x1b[?25l\x1b[0m\x1b[2J";
+            color_ = kDefault;
+            repaint_ = false;
+        }
+        int cx = -1, cy = -1;  // where the terminal's cursor is, if known
+        for (int y = 0; y < back_.height(); ++y) {
+            for (int x = 0; x < back_.width(); ++x) {
+                const Cell& cell = back_.at(x, y);
+                if (cell == front_.at(x, y)) {
+                    continue;
+                }
+                if (cy == y && x >= cx && x - cx <= kMaxGap) {
+                    // A short run of unchanged cells costs less than a jump.
+                    for (; cx < x; ++cx) {
+                        emit(front_.at(cx, y));
+                    }
+                } else {
+                    moveTo(x, y);
+                }
+                emit(cell);
+                front_.at(x, y) = cell;
+                cx = x + 1;
+                cy = y;
+            }
+        }
+        size_t bytes = out_.size();
+        flush();
+        ++stats_.frames;
+        stats_.bytes += bytes;
+        stats_.nanos += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        return bytes;
+    }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // "\x1b[r;cH" is 6 to 8 bytes here; reprinting a cell is 1.
+    static constexpr int kMaxGap = 4;
+
+    void moveTo(int x, int y) {
+        out_ += "\x1b[";
+        out_ += std::to_string(y + 1);
+        out_ += ';';
+        out_ += std::to_string(x + 1);
+        out_ += 'H';
+    }
+
+    void emit(const Cell& cell) {
+        if (cell.color != color_) {
+            out_ += "\x1b[";
+            if (cell.color == kDefault) {
+                out_ += '0';
+            } else {
+                out_ += '3';
+                out_ += static_cast<char>('0' + cell.color);
+            }
+            out_ += 'm';
+            color_ = cell.color;
+        }
+        out_ += cell.ch == '\0' ? ' ' : cell.ch;
+    }
+
+    // One write() unless the terminal takes less (a full pipe).
+    void flush() {
+        const char* p = out_.data();
+        size_t left = out_.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd_, p, left);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;  // the terminal is gone; nothing useful to do
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+    int fd_;
+    Frame front_;
+    Frame back_;
+    std::string out_;
+    uint8_t color_ = kDefault;
+    bool repaint_ = true;
+    Stats stats_;
+};
+
+}  // namespace term
@@ -0,0 +1,968 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <ctime>
+#include <optional>
+#include <utility>
+
+#include "cpu_topology.h"
+#include "timer_wheel.h"
+#include "trace.h"
+
+// Latency histogram in nanoseconds with four buckets per power of two, so
+// percentiles are within 25% of the true value.
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 252;  // bucketOf(UINT64_MAX) + 1
+
+    static size_t bucketOf(uint64_t ns) {
+        if(ns < 4)
+            return static_cast<size_t>(ns);
+        int e = 63 - __builtin_clzll(ns);
+        return static_cast<size_t>((e - 1) * 4 + ((ns >> (e - 2)) & 3));
+    }
+
+    // Smallest value that falls into bucket b.
+    static uint64_t lowerBound(size_t b) {
+        if(b < 4)
+            return b;
+        size_t e = b / 4 + 1;
+        return (uint64_t(4) | (b & 3)) << (e - 2);
+    }
+
+    void add(uint64_t ns) {
+        ++counts[bucketOf(ns)];
+        ++count;
+        sum += ns;
+        if(ns > max)
+            max = ns;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for(size_t b = 0; b < kBuckets; ++b)
+            counts[b] += other.counts[b];
+        count += other.count;
+        sum += other.sum;
+        if(other.max > max)
+            max = other.max;
+    }
+
+    double mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count); }
+
+    // Upper end of the bucket holding the q-th quantile (0 <= q <= 1).
+    uint64_t percentile(double q) const {
+        if(count == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+        for(size_t b = 0; b < kBuckets; ++b) {
+            seen += counts[b];
+            if(seen >= rank)
+                return b + 1 < kBuckets ? std::min(lowerBound(b + 1) - 1, max) : max;
+        }
+        return max;
+    }
+
+    uint64_t counts[kBuckets] = {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+};
+
+// Point-in-time view of a ThreadPool. Times are in nanoseconds.
+struct ThreadPoolStats {
+    struct Worker {
+        uint64_t tasks = 0;
+        uint64_t busyNs = 0;  // running tasks
+        uint64_t idleNs = 0;  // asleep waiting for work
+        int node = -1;        // NUMA node it is placed on, -1 if unplaced
+        LatencyHistogram wait;  // enqueue to start, sampled tasks only
+        LatencyHistogram run;   // start to finish, sampled tasks only
+
+        double utilization() const {
+            uint64_t total = busyNs + idleNs;
+            return total == 0 ? 0.0 : static_cast<double>(busyNs) / static_cast<double>(total);
+        }
+    };
+
+    size_t queueDepth = 0;
+    size_t maxQueueDepth = 0;  // with node queues, the deepest any one got
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t cancelled = 0;
+    uint64_t deadlineMisses = 0;  // tasks started after their deadline
+    size_t timers = 0;             // scheduleAfter/scheduleEvery timers pending
+    uint64_t timersFired = 0;      // runs handed to the workers
+    uint64_t timersSkipped = 0;    // periodic runs skipped, the previous one unfinished
+    uint64_t timersFailed = 0;     // runs whose callback threw
+    std::vector<Worker> workers;
+
+    LatencyHistogram wait() const {
+        LatencyHistogram all;
+        for(const Worker& w : workers)
+            all.merge(w.wait);
+        return all;
+    }
+
+    LatencyHistogram run() const {
+        LatencyHistogram all;
+        for(const Worker& w : workers)
+            all.merge(w.run);
+        return all;
+    }
+
+    double utilization() const {
+        uint64_t busy = 0, total = 0;
+        for(const Worker& w : workers) {
+            busy += w.busyNs;
+            total += w.busyNs + w.idleNs;
+        }
+        return total == 0 ? 0.0 : static_cast<double>(busy) / static_cast<double>(total);
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const ThreadPoolStats& s) {
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+    LatencyHistogram wait = s.wait(), run = s.run();
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1)
+       << "queue " << s.queueDepth << " (max " << s.maxQueueDepth << "), submitted " << s.submitted
+       << ", completed " << s.completed << ", cancelled " << s.cancelled << ", deadline misses "
+       << s.deadlineMisses << ", utilization " << 100.0 * s.utilization() << "%\n"
+       << "  wait us: p50 " << us(wait.percentile(0.5)) << "  p99 " << us(wait.percentile(0.99))
+       << "  max " << us(wait.max) << "\n"
+       << "  run us:  p50 " << us(run.percentile(0.5)) << "  p99 " << us(run.percentile(0.99))
+       << "  max " << us(run.max) << "\n";
+    if(s.timers != 0 || s.timersFired != 0)
+        os << "  timers: " << s.timers << " pending, " << s.timersFired << " fired, " << s.timersSkipped
+           << " periodic runs skipped, " << s.timersFailed << " threw\n";
+    for(size_t i = 0; i < s.workers.size(); ++i) {
+        const ThreadPoolStats::Worker& w = s.workers[i];
+        os << "  worker " << i;
+        if(w.node >= 0)
+            os << " (node " << w.node << ")";
+        os << ": " << w.tasks << " tasks, " << 100.0 * w.utilization() << "% busy\n";
+    }
+    os.flags(flags);
+    return os;
+}
+
+// Scheduling class of a task. Without a deadline, a task is ordered by
+// its enqueue time plus its class's slack (0, 20 ms or 500 ms), which ages
+// it: a Batch task is overtaken only by work submitted less than 480 ms
+// after it, so it cannot starve.
+enum class TaskPriority { Interactive, Normal, Batch };
+
+struct TaskOptions {
+    TaskPriority priority = TaskPriority::Normal;
+    // Earliest deadline first: replaces the class-based order when set.
+    std::chrono::steady_clock::time_point deadline{};
+    // With ThreadPoolOptions::nodeQueues, the NUMA node whose queue takes
+    // the task. -1 keeps a worker's tasks on its own node and spreads
+    // everyone else's round robin.
+    int node = -1;
+};
+
+template<class T>
+struct ScheduledTask {
+    std::future<T> future;
+    uint64_t id;  // for ThreadPool::cancel
+};
+
+// Where ThreadPool workers run. Pinned workers are spread over the NUMA
+// nodes in proportion to their CPUs; on one node that is just cores.
+enum class WorkerAffinity {
+    None,  // wherever the scheduler puts them
+    Core,  // one CPU each
+    Node,  // any CPU of one node, so the scheduler can still balance inside it
+};
+
+struct ThreadPoolOptions {
+    size_t threads = 0;  // 0: one per CPU
+    size_t latencySampleEvery = 8;
+    WorkerAffinity affinity = WorkerAffinity::None;
+    // Explicit placement: worker i runs on cpuSets[i % cpuSets.size()].
+    // Overrides affinity.
+    std::vector<std::vector<int>> cpuSets;
+    // One task queue per node, served by that node's workers, which steal
+    // from the other nodes only when their own queue is empty. Implies at
+    // least WorkerAffinity::Node.
+    bool nodeQueues = false;
+    // Detected from /sys and the cpuset when left empty.
+    CpuTopology topology;
+};
+
+// Thread pool with deadline-ordered scheduling and built-in metrics.
+// enqueue() submits at Normal priority, which on its own is FIFO.
+//
+// Task and queue counters are exact;
+// queue wait and run time are measured on every latencySampleEvery-th
+// task, because a clock read costs about as much as a microtask's other
+// bookkeeping. Worker busy time is derived from the time spent asleep.
+//
+// By default the workers share one queue and run wherever the OS puts
+// them. ThreadPoolOptions pins them to cores or nodes and can split the
+// queue per NUMA node, so that a task runs next to the memory it touches
+// (Linux places a page on the node of the thread that first writes it, so
+// data a task allocates and fills stays local to the tasks of its node).
+// Pinning is best effort: a worker the kernel refuses to pin stays
+// unpinned. Deadline order holds within each node's queue.
+class ThreadPool {
+public:
+    ThreadPool(size_t threads, size_t latencySampleEvery = 8);
+    explicit ThreadPool(ThreadPoolOptions options);
+    ~ThreadPool();
+
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+    template<class F, class... Args>
+    auto submit(const TaskOptions& options, F&& f, Args&&... args)
+        -> ScheduledTask<typename std::invoke_result<F, Args...>::type>;
+
+    // Runs f() on a worker without a future (for callbacks such as
+    // coroutine resumption, where the packaged_task would be wasted).
+    template<class F>
+    uint64_t post(F&& f, const TaskOptions& options = {});
+
+    // Removes a task that has not started; its future then throws
+    // std::future_error (broken_promise). Returns false if the task already
+    // started or is unknown. Linear in the queue length.
+    bool cancel(uint64_t id);
+
+    ThreadPoolStats stats();
+
+    // Writes stats() to os every interval, and once more from the
+    // destructor after the workers have finished.
+    void dumpStatsEvery(std::chrono::milliseconds interval, std::ostream& os);
+
+    // Runs f on a worker once delay has passed, rounded up to the next
+    // timer tick (1 ms). Returns an id for cancelTimer(). There is no
+    // future for an exception to go to: one thrown by f is dropped and
+    // counted in stats().timersFailed (for scheduleEvery too, whose later
+    // runs go on).
+    template<class F>
+    uint64_t scheduleAfter(std::chrono::nanoseconds delay, F&& f, const TaskOptions& options = {});
+
+    // Runs f every period, the first time one period from now. The rate is
+    // fixed; a run that is due while the previous one is still queued or
+    // running is skipped, so runs never overlap or pile up.
+    template<class F>
+    uint64_t scheduleEvery(std::chrono::nanoseconds period, F&& f, const TaskOptions& options = {});
+
+    // Stops a timer: true if a one-shot timer had not fired yet, or a
+    // periodic one was still active. A periodic run already queued is
+    // dropped; one already running finishes.
+    bool cancelTimer(uint64_t timer);
+
+    // NUMA node the calling worker is placed on; -1 outside a pool or for
+    // an unplaced worker.
+    static int currentNode() { return current.node; }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        uint64_t key;       // virtual deadline in ns; smaller runs first
+        uint64_t id;        // submission order, breaks ties
+        uint64_t deadline;  // explicit deadline in ns, or 0
+        uint64_t queued;    // nowNs() at enqueue for sampled tasks, otherwise 0
+    };
+
+    // Min-heap order for std::push_heap / std::pop_heap.
+    static bool later(const Task& a, const Task& b) {
+        return a.key != b.key ? a.key > b.key : a.id > b.id;
+    }
+
+    static constexpr uint64_t kSlackNs[] = {0, 20000000, 500000000};
+
+    // Whether a task goes to its group's FIFO rather than the heap.
+    static bool inOrder(const TaskOptions& options) {
+        return options.priority == TaskPriority::Normal &&
+               options.deadline == std::chrono::steady_clock::time_point{};
+    }
+
+    // Written only by its worker; stats() reads the relaxed atomics from
+    // other threads, so there are no read-modify-write operations here.
+    struct alignas(64) WorkerMetrics {
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> idleNs{0};
+        std::atomic<uint64_t> startedAt{0};
+        std::atomic<uint64_t> sleepingSince{0};  // 0 while awake
+        std::atomic<uint64_t> deadlineMisses{0};
+        std::atomic<uint64_t> wait[LatencyHistogram::kBuckets] = {};
+        std::atomic<uint64_t> run[LatencyHistogram::kBuckets] = {};
+        std::atomic<uint64_t> waitSum{0}, waitMax{0};
+        std::atomic<uint64_t> runSum{0}, runMax{0};
+    };
+
+    // A queue and the workers that serve it: the whole pool, or one NUMA
+    // node with nodeQueues.
+    struct alignas(64) Group {
+        std::mutex mutex;
+        std::condition_variable condition;
+        // Normal tasks without a deadline, the common case, queue in
+        // submission order, and their keys only grow, so they need no heap.
+        std::deque<Task> fifo;
+        std::vector<Task> tasks;  // everything else, heap ordered by later()
+        size_t maxQueueDepth = 0;
+        uint64_t submitted = 0;
+        uint64_t cancelled = 0;
+        bool stop = false;
+        bool poked = false;  // another group has work for an idle worker here
+        // Workers out of work, stealing or asleep. Only kept with several
+        // groups; see take().
+        std::atomic<size_t> idle{0};
+        int node = -1;
+    };
+
+    static bool empty(const Group& g) { return g.fifo.empty() && g.tasks.empty(); }
+
+    struct Placement {
+        std::vector<int> cpus;  // empty: unpinned
+        int node = -1;
+    };
+
+    struct WorkerContext {
+        const ThreadPool* pool = nullptr;
+        size_t group = 0;
+        int node = -1;
+    };
+
+    static thread_local WorkerContext current;
+
+    static uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Same epoch as steady_clock, at the kernel tick's resolution (a few ms)
+    // but several times cheaper; used for aging, where that is plenty.
+    static uint64_t coarseNowNs() {
+#ifdef CLOCK_MONOTONIC_COARSE
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+#else
+        return nowNs();
+#endif
+    }
+
+    static std::vector<Placement> place(ThreadPoolOptions& options);
+
+    static constexpr uint64_t kTimerTickNs = 1000000;
+
+    struct Periodic {
+        std::function<void()> fn;
+        uint64_t periodTicks = 1;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> running{false};  // a run is queued or running
+    };
+
+    struct Timer {
+        std::function<void()> fn;  // one-shot
+        std::shared_ptr<Periodic> periodic;
+        TaskOptions options;
+    };
+
+    template<class R>
+    ScheduledTask<R> push(const TaskOptions& options, std::shared_ptr<std::packaged_task<R()>> task);
+    uint64_t schedule(const TaskOptions& options, std::function<void()> fn);
+    Task makeTask(const TaskOptions& options, std::function<void()> fn);
+    void pushLocked(Group& g, Task task, bool inOrder);
+    void pokeThief(size_t target);
+    void scheduleBatch(std::vector<std::pair<TaskOptions, std::function<void()>>>& batch);
+    uint64_t addTimer(std::chrono::nanoseconds delay, Timer timer);
+    void timerLoop();
+    void runTimer(const std::function<void()>& fn) noexcept;
+    size_t pickGroup(int node);
+    bool take(size_t home, Task& task, WorkerMetrics& m);
+    bool steal(size_t home, Task& task);
+
+    // The more urgent of the FIFO's head and the heap's top.
+    static void popTop(Group& g, Task& task) {
+        if(g.tasks.empty() || (!g.fifo.empty() && later(g.tasks.front(), g.fifo.front()))) {
+            task = std::move(g.fifo.front());
+            g.fifo.pop_front();
+            return;
+        }
+        std::pop_heap(g.tasks.begin(), g.tasks.end(), later);
+        task = std::move(g.tasks.back());
+        g.tasks.pop_back();
+    }
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static void record(std::atomic<uint64_t>* buckets, std::atomic<uint64_t>& sum, std::atomic<uint64_t>& max,
+                       uint64_t ns) {
+        bump(buckets[LatencyHistogram::bucketOf(ns)], 1);
+        bump(sum, ns);
+        if(ns > max.load(std::memory_order_relaxed))
+            max.store(ns, std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<int> workerNodes;
+    std::unique_ptr<WorkerMetrics[]> metrics;
+    std::unique_ptr<Group[]> groups;
+    size_t groupCount = 1;
+    const size_t sampleEvery;
+    std::atomic<uint64_t> nextId{0};
+    std::atomic<size_t> nextGroup{0};  // round robin for submissions from outside
+
+    // Timers in ticks of kTimerTickNs since timerEpoch, and the thread that
+    // fires them; started by the first timer.
+    std::mutex timerMutex;
+    std::condition_variable timerWake;
+    TimerWheel<Timer> timers;
+    const uint64_t timerEpoch = nowNs();
+    uint64_t timerWaitUntil = 0;  // tick the timer thread sleeps until
+    uint64_t timersFired = 0;
+    uint64_t timersSkipped = 0;
+    std::atomic<uint64_t> timersFailed{0};  // counted on the workers
+    bool timerStop = false;
+    std::thread timerThread;
+
+    // Separate from the groups' conditions, so a notify_one for a new task
+    // can never wake the reporter instead of a worker.
+    std::mutex reporterMutex;
+    std::condition_variable reporterWake;
+    bool reporterStop = false;
+    std::thread reporter;
+    std::ostream* reportTo = nullptr;
+};
+
+inline thread_local ThreadPool::WorkerContext ThreadPool::current;
+
+inline ThreadPool::ThreadPool(size_t threads, size_t latencySampleEvery)
+    : ThreadPool([&] {
+          ThreadPoolOptions options;
+          options.threads = threads;
+          options.latencySampleEvery = latencySampleEvery;
+          return options;
+      }()) {}
+
+// Worker i's CPUs and node. Pinned workers take the CPUs in an order that
+// alternates between nodes, so any number of them is spread evenly.
+inline std::vector<ThreadPool::Placement> ThreadPool::place(ThreadPoolOptions& options) {
+    bool placed = options.affinity != WorkerAffinity::None || !options.cpuSets.empty() || options.nodeQueues;
+    if(placed && options.topology.cpuCount() == 0)
+        options.topology = CpuTopology::detect();
+    if(options.threads == 0)
+        options.threads = placed ? options.topology.cpuCount() : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Placement> placements(options.threads);
+    if(!placed)
+        return placements;
+    const CpuTopology& topology = options.topology;
+    std::vector<std::pair<int, size_t>> order;  // (cpu, node index)
+    for(size_t rank = 0; order.size() < topology.cpuCount(); ++rank) {
+        for(size_t n = 0; n < topology.nodes.size(); ++n) {
+            if(rank < topology.nodes[n].cpus.size())
+                order.emplace_back(topology.nodes[n].cpus[rank], n);
+        }
+    }
+    for(size_t i = 0; i < options.threads; ++i) {
+        Placement& p = placements[i];
+        if(!options.cpuSets.empty()) {
+            p.cpus = options.cpuSets[i % options.cpuSets.size()];
+            p.node = p.cpus.empty() ? -1 : topology.nodeOf(p.cpus.front());
+            continue;
+        }
+        const std::pair<int, size_t>& slot = order[i % order.size()];
+        const CpuTopology::Node& node = topology.nodes[slot.second];
+        p.node = node.id;
+        if(options.affinity == WorkerAffinity::Core)
+            p.cpus = {slot.first};
+        else
+            p.cpus = node.cpus;
+    }
+    return placements;
+}
+
+inline ThreadPool::ThreadPool(ThreadPoolOptions options)
+    : sampleEvery(options.latencySampleEvery == 0 ? 1 : options.latencySampleEvery) {
+    std::vector<Placement> placements = place(options);
+    size_t threads = placements.size();
+    metrics.reset(new WorkerMetrics[threads]);
+
+    // One group per node that has workers, in the order they first appear.
+    std::vector<size_t> home(threads, 0);
+    std::vector<int> nodes;
+    if(options.nodeQueues) {
+        for(size_t i = 0; i < threads; ++i) {
+            auto it = std::find(nodes.begin(), nodes.end(), placements[i].node);
+            home[i] = static_cast<size_t>(it - nodes.begin());
+            if(it == nodes.end())
+                nodes.push_back(placements[i].node);
+        }
+    }
+    groupCount = std::max<size_t>(1, nodes.size());
+    groups.reset(new Group[groupCount]);
+    for(size_t g = 0; g < nodes.size(); ++g)
+        groups[g].node = nodes[g];
+
+    for(size_t i = 0; i < threads; ++i) {
+        workerNodes.push_back(placements[i].node);
+        metrics[i].startedAt.store(nowNs(), std::memory_order_relaxed);
+        workers.emplace_back([this, i, group = home[i], placement = std::move(placements[i])] {
+            TRACE_THREAD_NAME("ThreadPool worker " + std::to_string(i));
+            if(!placement.cpus.empty())
+                pinThisThread(placement.cpus);
+            current = WorkerContext{this, group, placement.node};
+            WorkerMetrics& m = this->metrics[i];
+            for(;;) {
+                Task task;
+                if(!this->take(group, task, m))
+                    return;
+
+                if(task.deadline != 0 && nowNs() > task.deadline)
+                    bump(m.deadlineMisses, 1);
+
+                if(task.queued != 0) {
+                    uint64_t start = nowNs();
+                    task.fn();
+                    uint64_t end = nowNs();
+                    record(m.wait, m.waitSum, m.waitMax, start - task.queued);
+                    record(m.run, m.runSum, m.runMax, end - start);
+                } else {
+                    task.fn();
+                }
+                bump(m.tasks, 1);
+            }
+        });
+    }
+}
+
+inline ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        timerStop = true;
+    }
+    timerWake.notify_all();
+    if(timerThread.joinable())
+        timerThread.join();
+    for(size_t g = 0; g < groupCount; ++g) {
+        {
+            std::unique_lock<std::mutex> lock(groups[g].mutex);
+            groups[g].stop = true;
+        }
+        groups[g].condition.notify_all();
+    }
+    {
+        std::unique_lock<std::mutex> lock(reporterMutex);
+        reporterStop = true;
+    }
+    reporterWake.notify_all();
+    if(reporter.joinable())
+        reporter.join();
+    for(std::thread &worker: workers)
+        worker.join();
+    if(reportTo)
+        *reportTo << stats() << std::flush;
+}
+
+// Next task for a worker of group home; false once the pool stops and the
+// group's queue is drained. With several groups, a worker out of work
+// counts itself idle before it looks at the other queues, and schedule()
+// checks that count after pushing: either the steal sees the new task, or
+// schedule() sees the idle worker and pokes it awake to look again.
+inline bool ThreadPool::take(size_t home, Task& task, WorkerMetrics& m) {
+    Group& g = groups[home];
+    std::unique_lock<std::mutex> lock(g.mutex);
+    for(;;) {
+        if(!empty(g)) {
+            popTop(g, task);
+            return true;
+        }
+        if(g.stop)
+            return false;
+        if(groupCount > 1) {
+            g.idle.fetch_add(1);
+            g.poked = false;
+            lock.unlock();
+            bool stolen = steal(home, task);
+            lock.lock();
+            if(stolen || !empty(g) || g.stop || g.poked) {
+                g.idle.fetch_sub(1);
+                if(stolen)
+                    return true;
+                continue;
+            }
+        }
+        uint64_t asleep = nowNs();
+        m.sleepingSince.store(asleep, std::memory_order_relaxed);
+        g.condition.wait(lock, [&g] { return g.stop || !empty(g) || g.poked; });
+        m.sleepingSince.store(0, std::memory_order_relaxed);
+        bump(m.idleNs, nowNs() - asleep);
+        if(groupCount > 1)
+            g.idle.fetch_sub(1);
+    }
+}
+
+// Takes the most urgent task of the first other group that has one.
+inline bool ThreadPool::steal(size_t home, Task& task) {
+    for(size_t k = 1; k < groupCount; ++k) {
+        Group& victim = groups[(home + k) % groupCount];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+        if(!empty(victim)) {
+            popTop(victim, task);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline size_t ThreadPool::pickGroup(int node) {
+    if(groupCount == 1)
+        return 0;
+    if(node >= 0) {
+        for(size_t g = 0; g < groupCount; ++g) {
+            if(groups[g].node == node)
+                return g;
+        }
+    }
+    if(current.pool == this)
+        return current.group;
+    return nextGroup.fetch_add(1, std::memory_order_relaxed) % groupCount;
+}
+
+template<class F, class... Args>
+auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    return push(TaskOptions{}, std::move(task)).future;
+}
+
+template<class F, class... Args>
+auto ThreadPool::submit(const TaskOptions& options, F&& f, Args&&... args)
+    -> ScheduledTask<typename std::invoke_result<F, Args...>::type> {
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    return push(options, std::move(task));
+}
+
+template<class R>
+ScheduledTask<R> ThreadPool::push(const TaskOptions& options, std::shared_ptr<std::packaged_task<R()>> task) {
+    std::future<R> res = task->get_future();
+    uint64_t id = schedule(options, [task]() { (*task)(); });
+    return ScheduledTask<R>{std::move(res), id};
+}
+
+template<class F>
+uint64_t ThreadPool::post(F&& f, const TaskOptions& options) {
+    return schedule(options, std::function<void()>(std::forward<F>(f)));
+}
+
+inline ThreadPool::Task ThreadPool::makeTask(const TaskOptions& options, std::function<void()> fn) {
+    uint64_t deadline = 0;
+    if(options.deadline != std::chrono::steady_clock::time_point{})
+        deadline = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            options.deadline.time_since_epoch()).count());
+    uint64_t key = deadline != 0 ? deadline : coarseNowNs() + kSlackNs[static_cast<int>(options.priority)];
+    uint64_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    uint64_t queued = id % sampleEvery == 0 ? nowNs() : 0;
+#ifdef CPP30_TRACE
+    // Queue wait runs from here until a worker picks the task up.
+    return Task{[fn = std::move(fn), traceQueued = trace::now()]() {
+        trace::recordAsync("ThreadPool queue wait", traceQueued, trace::now());
+        TRACE_SCOPE("ThreadPool task");
+        fn();
+    }, key, id, deadline, queued};
+#else
+    return Task{std::move(fn), key, id, deadline, queued};
+#endif
+}
+
+// With g.mutex held.
+inline void ThreadPool::pushLocked(Group& g, Task task, bool inOrder) {
+    if(inOrder) {
+        // Keys are read before the lock, so two submitters can arrive out
+        // of order; the later one inherits the earlier one's key.
+        if(!g.fifo.empty() && g.fifo.back().key > task.key)
+            task.key = g.fifo.back().key;
+        g.fifo.push_back(std::move(task));
+    } else {
+        g.tasks.push_back(std::move(task));
+        std::push_heap(g.tasks.begin(), g.tasks.end(), later);
+    }
+    ++g.submitted;
+    if(g.fifo.size() + g.tasks.size() > g.maxQueueDepth)
+        g.maxQueueDepth = g.fifo.size() + g.tasks.size();
+}
+
+// Nobody in group target is free: wakes an idle worker of another node
+// to steal.
+inline void ThreadPool::pokeThief(size_t target) {
+    if(groupCount == 1 || groups[target].idle.load() != 0)
+        return;
+    for(size_t k = 1; k < groupCount; ++k) {
+        Group& other = groups[(target + k) % groupCount];
+        if(other.idle.load() != 0) {
+            {
+                std::unique_lock<std::mutex> lock(other.mutex);
+                other.poked = true;
+            }
+            other.condition.notify_one();
+            return;
+        }
+    }
+}
+
+inline uint64_t ThreadPool::schedule(const TaskOptions& options, std::function<void()> fn) {
+    size_t target = pickGroup(options.node);
+    Group& g = groups[target];
+    Task task = makeTask(options, std::move(fn));
+    uint64_t id = task.id;
+    {
+        std::unique_lock<std::mutex> lock(g.mutex);
+
+        if(g.stop)
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+
+        pushLocked(g, std::move(task), inOrder(options));
+    }
+    g.condition.notify_one();
+    pokeThief(target);
+    return id;
+}
+
+// Queues the timer thread's due tasks with one lock per group.
+inline void ThreadPool::scheduleBatch(std::vector<std::pair<TaskOptions, std::function<void()>>>& batch) {
+    std::vector<size_t> targets;
+    for(const auto& item : batch)
+        targets.push_back(pickGroup(item.first.node));
+    for(size_t g = 0; g < groupCount; ++g) {
+        Group& group = groups[g];
+        size_t pushed = 0;
+        {
+            std::unique_lock<std::mutex> lock(group.mutex);
+            for(size_t i = 0; i < batch.size(); ++i) {
+                if(targets[i] == g) {
+                    pushLocked(group, makeTask(batch[i].first, std::move(batch[i].second)), inOrder(batch[i].first));
+                    ++pushed;
+                }
+            }
+        }
+        if(pushed == 1)
+            group.condition.notify_one();
+        else if(pushed > 1)
+            group.condition.notify_all();
+        if(pushed != 0)
+            pokeThief(g);
+    }
+}
+
+template<class F>
+uint64_t ThreadPool::scheduleAfter(std::chrono::nanoseconds delay, F&& f, const TaskOptions& options) {
+    Timer timer;
+    timer.fn = std::function<void()>(std::forward<F>(f));
+    timer.options = options;
+    return addTimer(delay, std::move(timer));
+}
+
+template<class F>
+uint64_t ThreadPool::scheduleEvery(std::chrono::nanoseconds period, F&& f, const TaskOptions& options) {
+    auto periodic = std::make_shared<Periodic>();
+    periodic->fn = std::function<void()>(std::forward<F>(f));
+    periodic->periodTicks = std::max<uint64_t>(1, (static_cast<uint64_t>(std::max<int64_t>(0, period.count())) +
+                                                   kTimerTickNs - 1) / kTimerTickNs);
+    Timer timer;
+    timer.periodic = std::move(periodic);
+    timer.options = options;
+    return addTimer(period, std::move(timer));
+}
+
+inline uint64_t ThreadPool::addTimer(std::chrono::nanoseconds delay, Timer timer) {
+    // Rounded up, so a timer never fires early.
+    uint64_t at = nowNs() - timerEpoch + static_cast<uint64_t>(std::max<int64_t>(0, delay.count()));
+    uint64_t expiry = (at + kTimerTickNs - 1) / kTimerTickNs;
+    uint64_t id;
+    bool wake;
+    {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        if(timerStop)
+            throw std::runtime_error("timer on stopped ThreadPool");
+        if(!timerThread.joinable())
+            timerThread = std::thread([this] { timerLoop(); });
+        id = timers.insert(expiry, std::move(timer));
+        wake = expiry < timerWaitUntil;
+    }
+    if(wake)
+        timerWake.notify_one();
+    return id;
+}
+
+inline bool ThreadPool::cancelTimer(uint64_t timer) {
+    std::optional<Timer> removed;
+    {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        removed = timers.cancel(timer);
+    }
+    if(!removed)
+        return false;
+    if(removed->periodic)
+        removed->periodic->cancelled.store(true);
+    return true;
+}
+
+// Sleeps until the wheel's next expiry, fires everything due and hands it
+// to the workers in one batch. A periodic timer re-arms itself one period
+// after the tick it was due, so its rate does not drift with the timer
+// thread's lateness, and skips a run while the previous one is still
+// queued or running.
+inline void ThreadPool::timerLoop() {
+    TRACE_THREAD_NAME("ThreadPool timer");
+    std::vector<std::pair<TaskOptions, std::function<void()>>> batch;
+    std::unique_lock<std::mutex> lock(timerMutex);
+    while(!timerStop) {
+        uint64_t now = (nowNs() - timerEpoch) / kTimerTickNs;
+        timers.advance(now, [this, &batch](uint64_t, Timer& timer) -> uint64_t {
+            if(!timer.periodic) {
+                batch.emplace_back(timer.options, [this, fn = std::move(timer.fn)] { runTimer(fn); });
+                return 0;
+            }
+            Periodic& p = *timer.periodic;
+            if(!p.running.exchange(true)) {
+                batch.emplace_back(timer.options, [this, periodic = timer.periodic] {
+                    if(!periodic->cancelled.load())
+                        runTimer(periodic->fn);
+                    periodic->running.store(false);
+                });
+            } else {
+                ++timersSkipped;
+            }
+            return timers.now() + p.periodTicks;
+        });
+        if(!batch.empty()) {
+            timersFired += batch.size();
+            lock.unlock();
+            scheduleBatch(batch);
+            batch.clear();
+            lock.lock();
+            continue;
+        }
+        uint64_t next = timers.nextExpiry();
+        timerWaitUntil = next;
+        if(next == TimerWheel<Timer>::kNever)
+            timerWake.wait(lock);
+        else
+            timerWake.wait_until(lock, std::chrono::steady_clock::time_point(
+                std::chrono::nanoseconds(timerEpoch + next * kTimerTickNs)));
+        timerWaitUntil = 0;
+    }
+}
+
+// A worker would call std::terminate on an exception escaping a task.
+inline void ThreadPool::runTimer(const std::function<void()>& fn) noexcept {
+    try {
+        fn();
+    } catch(...) {
+        timersFailed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline bool ThreadPool::cancel(uint64_t id) {
+    Task removed;
+    for(size_t g = 0; g < groupCount && !removed.fn; ++g) {
+        Group& group = groups[g];
+        std::unique_lock<std::mutex> lock(group.mutex);
+        auto matches = [id](const Task& t) { return t.id == id; };
+        auto queued = std::find_if(group.fifo.begin(), group.fifo.end(), matches);
+        if(queued != group.fifo.end()) {
+            removed = std::move(*queued);
+            group.fifo.erase(queued);
+            ++group.cancelled;
+            continue;
+        }
+        auto it = std::find_if(group.tasks.begin(), group.tasks.end(), matches);
+        if(it == group.tasks.end())
+            continue;
+        removed = std::move(*it);
+        *it = std::move(group.tasks.back());
+        group.tasks.pop_back();
+        std::make_heap(group.tasks.begin(), group.tasks.end(), later);
+        ++group.cancelled;
+    }
+    // removed is destroyed here, outside the lock: dropping the last
+    // reference to the packaged_task breaks its promise.
+    return static_cast<bool>(removed.fn);
+}
+
+inline ThreadPoolStats ThreadPool::stats() {
+    ThreadPoolStats s;
+    for(size_t g = 0; g < groupCount; ++g) {
+        Group& group = groups[g];
+        std::unique_lock<std::mutex> lock(group.mutex);
+        s.queueDepth += group.fifo.size() + group.tasks.size();
+        s.maxQueueDepth = std::max(s.maxQueueDepth, group.maxQueueDepth);
+        s.submitted += group.submitted;
+        s.cancelled += group.cancelled;
+    }
+    {
+        std::unique_lock<std::mutex> lock(timerMutex);
+        s.timers = timers.size();
+        s.timersFired = timersFired;
+        s.timersSkipped = timersSkipped;
+    }
+    s.timersFailed = timersFailed.load(std::memory_order_relaxed);
+    uint64_t now = nowNs();
+    s.workers.resize(workers.size());
+    for(size_t i = 0; i < workers.size(); ++i) {
+        const WorkerMetrics& m = metrics[i];
+        ThreadPoolStats::Worker& w = s.workers[i];
+        w.node = workerNodes[i];
+        w.tasks = m.tasks.load(std::memory_order_relaxed);
+        // Busy is everything but sleep, so it includes taking the lock.
+        uint64_t elapsed = now - m.startedAt.load(std::memory_order_relaxed);
+        uint64_t sleeping = m.sleepingSince.load(std::memory_order_relaxed);
+        w.idleNs = m.idleNs.load(std::memory_order_relaxed) + (sleeping != 0 && now > sleeping ? now - sleeping : 0);
+        w.idleNs = std::min(w.idleNs, elapsed);
+        w.busyNs = elapsed - w.idleNs;
+        for(size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+            w.wait.counts[b] = m.wait[b].load(std::memory_order_relaxed);
+            w.run.counts[b] = m.run[b].load(std::memory_order_relaxed);
+            w.wait.count += w.wait.counts[b];
+            w.run.count += w.run.counts[b];
+        }
+        w.wait.sum = m.waitSum.load(std::memory_order_relaxed);
+        w.wait.max = m.waitMax.load(std::memory_order_relaxed);
+        w.run.sum = m.runSum.load(std::memory_order_relaxed);
+        w.run.max = m.runMax.load(std::memory_order_relaxed);
+        s.completed += w.tasks;
+        s.deadlineMisses += m.deadlineMisses.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+inline void ThreadPool::dumpStatsEvery(std::chrono::milliseconds interval, std::ostream& os) {
+    if(reporter.joinable())
+        throw std::logic_error("ThreadPool stats dump already running");
+    reportTo = &os;
+    reporter = std::thread([this, interval, &os] {
+        std::unique_lock<std::mutex> lock(reporterMutex);
+        while(!reporterWake.wait_for(lock, interval, [this] { return reporterStop; })) {
+            lock.unlock();
+            os << stats() << std::flush;
+            lock.lock();
+        }
+    });
+}
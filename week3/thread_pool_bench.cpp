@@ -0,0 +1,220 @@
+// ThreadPool with metrics against the original metrics-free pool on
+// microtasks (the worst case for per-task bookkeeping). enqueue() takes the
+// FIFO path, so its row is the cost of the metrics; the row with mixed
+// classes adds the cost of ordering them in the heap.
+// Build: g++ -std=c++17 -O2 thread_pool_bench.cpp -o thread_pool_bench -pthread
+// Usage: ./thread_pool_bench [tasks] [threads]   (default 200000 tasks, 4 threads)
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+// The ThreadPool from before the metrics were added.
+class BaselinePool {
+public:
+    explicit BaselinePool(size_t threads) : stop(false) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex);
+                        condition.wait(lock, [this] { return stop || !tasks.empty(); });
+                        if (stop && tasks.empty())
+                            return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~BaselinePool() {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    template <class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type> {
+        using return_type = typename std::result_of<F(Args...)>::type;
+        auto task = std::make_shared<std::packaged_task<return_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (stop)
+                throw std::runtime_error("enqueue on stopped ThreadPool");
+            tasks.emplace([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        return res;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    bool stop;
+};
+
+// Submits alternately at Interactive and Batch priority, so every task
+// goes through the heap.
+struct MixedClasses {
+    ThreadPool& pool;
+    size_t submitted = 0;
+
+    template <class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) {
+        TaskOptions options;
+        options.priority = submitted++ % 2 == 0 ? TaskPriority::Interactive : TaskPriority::Batch;
+        return pool.submit(options, std::forward<F>(f), std::forward<Args>(args)...).future;
+    }
+};
+
+// Enqueues n trivial tasks in batches of 1000 and waits for each batch;
+// returns nanoseconds per task.
+template <typename Pool>
+double microtasks(Pool& pool, size_t n) {
+    std::vector<std::future<size_t>> results;
+    results.reserve(1000);
+    size_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < n; done += 1000) {
+        results.clear();
+        for (size_t i = 0; i < 1000; ++i) {
+            results.push_back(pool.enqueue([](size_t x) { return x + 1; }, i));
+        }
+        for (auto& r : results) {
+            sum += r.get();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sum == 0) {
+        std::cerr << "tasks did not run" << std::endl;
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(n);
+}
+
+bool checkHistogram() {
+    LatencyHistogram h;
+    for (uint64_t v = 0; v < 100000; ++v) {
+        h.add(v);
+    }
+    for (double q : {0.5, 0.9, 0.99}) {
+        double exact = q * 99999.0;
+        double approx = static_cast<double>(h.percentile(q));
+        if (approx < exact || approx > exact * 1.25 + 1) {
+            std::cerr << "p" << q * 100 << " = " << approx << ", exact " << exact << std::endl;
+            return false;
+        }
+    }
+    for (uint64_t v : {0ull, 3ull, 4ull, 7ull, 8ull, 1000ull, 123456789ull, ~0ull}) {
+        size_t b = LatencyHistogram::bucketOf(v);
+        if (b >= LatencyHistogram::kBuckets || LatencyHistogram::lowerBound(b) > v ||
+            (b + 1 < LatencyHistogram::kBuckets && LatencyHistogram::lowerBound(b + 1) <= v)) {
+            std::cerr << "bucket of " << v << " is wrong" << std::endl;
+            return false;
+        }
+    }
+    return h.count == 100000 && h.max == 99999 && h.mean() == 49999.5;
+}
+
+bool checkStats(size_t threads, size_t sampleEvery) {
+    ThreadPool pool(threads, sampleEvery);
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 200; ++i) {
+        results.push_back(pool.enqueue([] { std::this_thread::sleep_for(std::chrono::microseconds(100)); }));
+    }
+    for (auto& r : results) {
+        r.get();
+    }
+    // A task's future is ready just before its worker updates the counters.
+    ThreadPoolStats s = pool.stats();
+    for (int spin = 0; s.completed != 200 && spin < 1000; ++spin) {
+        std::this_thread::yield();
+        s = pool.stats();
+    }
+    uint64_t tasks = 0;
+    for (const auto& w : s.workers) {
+        tasks += w.tasks;
+    }
+    LatencyHistogram run = s.run();
+    uint64_t sampled = (200 + sampleEvery - 1) / sampleEvery;
+    return s.submitted == 200 && s.completed == 200 && tasks == 200 && s.queueDepth == 0 &&
+           s.maxQueueDepth >= 1 && run.count == sampled && run.percentile(0.5) >= 100000 &&
+           s.wait().count == sampled && s.utilization() > 0.0 && s.utilization() <= 1.0;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? std::stoull(argv[1]) : 200000;
+    size_t threads = argc > 2 ? std::stoull(argv[2]) : 4;
+    n = std::max<size_t>(1000, n / 1000 * 1000);
+    if (!checkHistogram() || !checkStats(threads, 1) || !checkStats(threads, 8)) {
+        std::cerr << "ThreadPool metrics are wrong" << std::endl;
+        return 1;
+    }
+    std::cout << "Histogram and ThreadPool counters check out." << std::endl;
+
+    // Alternate the pools and keep the best of five runs each, so that
+    // drift in machine load affects them alike.
+    double baseline = 1e300, measured = 1e300, mixed = 1e300;
+    ThreadPoolStats stats;
+    for (int run = 0; run < 5; ++run) {
+        {
+            BaselinePool pool(threads);
+            baseline = std::min(baseline, microtasks(pool, n));
+        }
+        {
+            ThreadPool pool(threads);
+            measured = std::min(measured, microtasks(pool, n));
+            stats = pool.stats();
+        }
+        {
+            ThreadPool pool(threads);
+            MixedClasses classes{pool};
+            mixed = std::min(mixed, microtasks(classes, n));
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1) << "\n"
+              << n << " microtasks on " << threads << " threads, best of 5, ns per task\n"
+              << "  without metrics  " << std::setw(8) << baseline << "\n"
+              << "  with metrics     " << std::setw(8) << measured << "  (" << std::showpos
+              << 100.0 * (measured / baseline - 1.0) << std::noshowpos << "%)\n"
+              << "  + mixed classes  " << std::setw(8) << mixed << "  (" << std::showpos
+              << 100.0 * (mixed / baseline - 1.0) << std::noshowpos << "%)\n\n"
+              << "Last run: " << stats;
+
+    // The periodic dump, on a short interval; the pool's destructor adds
+    // a final snapshot.
+    std::ostringstream dump;
+    {
+        ThreadPool pool(threads);
+        pool.dumpStatsEvery(std::chrono::milliseconds(5), dump);
+        microtasks(pool, 10000);
+    }
+    if (dump.str().find("completed 10000,") == std::string::npos) {
+        std::cerr << "periodic dump did not report the finished tasks" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,353 @@
+// Timers: the hierarchical TimerWheel against a std::multimap and a binary
+// heap with lazy cancellation, at a million pending timers, and
+// ThreadPool::scheduleAfter end to end (how late timers start on a worker).
+// Build: g++ -std=c++17 -O2 timer_bench.cpp -o timer_bench -pthread
+// Usage: ./timer_bench [timers] [pool timers]   (default 1000000, 100000)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+// Random inserts, cancels and advances, checked against a multimap.
+bool checkWheel() {
+    using Wheel = TimerWheel<uint64_t>;
+    std::mt19937_64 rng(42);
+    Wheel wheel(1000);
+    std::map<Wheel::Id, uint64_t> pending;  // id -> expiry
+    std::vector<Wheel::Id> stale;
+    std::set<Wheel::Id> rearmed;
+    for (int round = 0; round < 20000; ++round) {
+        int op = static_cast<int>(rng() % 10);
+        if (op < 5) {
+            static const uint64_t spans[] = {4, 300, 70000, 1u << 24, uint64_t(1) << 34};
+            uint64_t span = spans[rng() % (op == 0 ? 5 : 4)];
+            uint64_t expiry = wheel.now() + rng() % span;
+            Wheel::Id id = wheel.insert(expiry, expiry);
+            pending[id] = expiry;
+        } else if (op < 7 && !pending.empty()) {
+            auto it = std::next(pending.begin(), static_cast<long>(rng() % pending.size()));
+            std::optional<uint64_t> value = wheel.cancel(it->first);
+            if (!value || *value != it->second) {
+                return bench::fail("cancel lost a pending timer");
+            }
+            stale.push_back(it->first);
+            pending.erase(it);
+        } else if (op == 7 && !stale.empty()) {
+            if (wheel.cancel(stale[rng() % stale.size()])) {
+                return bench::fail("cancel matched a timer that already fired or was cancelled");
+            }
+        } else {
+            static const uint64_t steps[] = {1, 50, 5000, 1u << 20, uint64_t(1) << 33};
+            uint64_t to = wheel.now() + rng() % steps[rng() % 5];
+            uint64_t next = wheel.nextExpiry();
+            uint64_t earliest = Wheel::kNever;
+            for (const auto& p : pending) {
+                earliest = std::min(earliest, std::max(p.second, wheel.now()));
+            }
+            if (next > earliest || (pending.empty() && next != Wheel::kNever)) {
+                return bench::fail("nextExpiry() is past a pending timer");
+            }
+            uint64_t last = 0;
+            bool ok = true;
+            wheel.advance(to, [&](Wheel::Id id, uint64_t& expiry) -> uint64_t {
+                auto it = pending.find(id);
+                ok = ok && it != pending.end() && it->second == expiry && expiry <= wheel.now() &&
+                     wheel.now() <= std::max(expiry, to) && expiry >= last;
+                last = expiry;
+                // Every third timer re-arms once under the same id.
+                if (id % 3 == 0 && it != pending.end() && rearmed.insert(id).second) {
+                    expiry = wheel.now() + 1 + rng() % 1000;
+                    it->second = expiry;
+                    return expiry;
+                }
+                if (it != pending.end()) {
+                    pending.erase(it);
+                }
+                stale.push_back(id);
+                return 0;
+            });
+            if (!ok) {
+                return bench::fail("advance() fired a timer early, late, twice or out of order");
+            }
+            for (const auto& p : pending) {
+                if (p.second <= to) {
+                    return bench::fail("advance() skipped a due timer");
+                }
+            }
+        }
+        if (wheel.size() != pending.size()) {
+            return bench::fail("size() disagrees with the pending timers");
+        }
+    }
+    return !rearmed.empty() || bench::fail("nothing re-armed");
+}
+
+bool checkPool() {
+    ThreadPool pool(2);
+    std::mutex mutex;
+    std::vector<int> order;
+    auto start = Clock::now();
+    std::atomic<int64_t> firstAtMs{-1};
+    auto record = [&](int tag) {
+        return [&, tag] {
+            if (tag == 20) {
+                firstAtMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(tag);
+        };
+    };
+    pool.scheduleAfter(60ms, record(60));
+    pool.scheduleAfter(20ms, record(20));
+    uint64_t cancelled = pool.scheduleAfter(40ms, record(40));
+    pool.scheduleAfter(100ms, record(100));
+    if (!pool.cancelTimer(cancelled) || pool.cancelTimer(cancelled)) {
+        return bench::fail("cancelTimer() must stop a pending timer, once");
+    }
+
+    // Periodic, with runs slower than the period: they are skipped, never
+    // overlapped.
+    std::atomic<int> runs{0}, inside{0}, overlap{0};
+    uint64_t every = pool.scheduleEvery(2ms, [&] {
+        if (inside.fetch_add(1) != 0) {
+            overlap = 1;
+        }
+        ++runs;
+        std::this_thread::sleep_for(5ms);
+        inside.fetch_sub(1);
+    });
+    std::this_thread::sleep_for(150ms);
+    if (!pool.cancelTimer(every)) {
+        return bench::fail("cancelTimer() must stop a periodic timer");
+    }
+    std::this_thread::sleep_for(20ms);
+    int after = runs.load();
+    std::this_thread::sleep_for(30ms);
+    ThreadPoolStats s = pool.stats();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (order != std::vector<int>{20, 60, 100}) {
+            return bench::fail("one-shot timers ran out of order or a cancelled one ran");
+        }
+    }
+    if (firstAtMs < 20) {
+        return bench::fail("a 20 ms timer ran after " + std::to_string(firstAtMs.load()) + " ms");
+    }
+    if (overlap != 0 || runs.load() < 5 || runs.load() != after || s.timersSkipped == 0 || s.timers != 0) {
+        return bench::fail("periodic timer: " + std::to_string(runs.load()) + " runs, overlap " +
+                           std::to_string(overlap.load()) + ", " + std::to_string(s.timersSkipped) + " skipped, " +
+                           std::to_string(s.timers) + " pending");
+    }
+
+    // A callback that throws is counted, not fatal, and a periodic one
+    // keeps running.
+    std::atomic<int> throwingRuns{0};
+    pool.scheduleAfter(1ms, [] { throw std::runtime_error("one-shot"); });
+    uint64_t throwing = pool.scheduleEvery(2ms, [&] {
+        ++throwingRuns;
+        throw std::runtime_error("periodic");
+    });
+    std::this_thread::sleep_for(50ms);
+    pool.cancelTimer(throwing);
+    std::this_thread::sleep_for(10ms);
+    ThreadPoolStats failed = pool.stats();
+    if (throwingRuns.load() < 3 || failed.timersFailed != static_cast<uint64_t>(throwingRuns.load()) + 1) {
+        return bench::fail("throwing timers: " + std::to_string(throwingRuns.load()) + " periodic runs, " +
+                           std::to_string(failed.timersFailed) + " counted");
+    }
+
+    // Pending timers do not hold up the destructor.
+    {
+        ThreadPool shortLived(1);
+        shortLived.scheduleAfter(std::chrono::hours(1), [] {});
+        shortLived.scheduleEvery(std::chrono::hours(1), [] {});
+    }
+    return true;
+}
+
+struct Costs {
+    double insert, cancel, expire;  // ns per timer
+};
+
+template <typename F>
+double nsPer(size_t n, F f) {
+    auto start = Clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(n);
+}
+
+// n timers up to 60 s out in ms ticks; every other one cancelled, the rest
+// run to expiry.
+Costs wheelCosts(const std::vector<uint64_t>& expiries) {
+    size_t n = expiries.size();
+    TimerWheel<uint64_t> wheel;
+    std::vector<TimerWheel<uint64_t>::Id> ids(n);
+    Costs c;
+    c.insert = nsPer(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = wheel.insert(expiries[i], i);
+        }
+    });
+    c.cancel = nsPer(n / 2, [&] {
+        for (size_t i = 0; i < n; i += 2) {
+            wheel.cancel(ids[i]);
+        }
+    });
+    uint64_t sum = 0;
+    c.expire = nsPer(n - n / 2, [&] {
+        for (uint64_t t = 0; !wheel.empty(); t += 1) {
+            wheel.advance(t, [&sum](TimerWheel<uint64_t>::Id, uint64_t& v) -> uint64_t {
+                sum += v;
+                return 0;
+            });
+        }
+    });
+    if (sum == 0 && n > 2) {
+        std::abort();
+    }
+    return c;
+}
+
+Costs mapCosts(const std::vector<uint64_t>& expiries) {
+    size_t n = expiries.size();
+    std::multimap<uint64_t, uint64_t> timers;
+    std::vector<std::multimap<uint64_t, uint64_t>::iterator> ids(n);
+    Costs c;
+    c.insert = nsPer(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = timers.emplace(expiries[i], i);
+        }
+    });
+    c.cancel = nsPer(n / 2, [&] {
+        for (size_t i = 0; i < n; i += 2) {
+            timers.erase(ids[i]);
+        }
+    });
+    uint64_t sum = 0;
+    c.expire = nsPer(n - n / 2, [&] {
+        for (uint64_t t = 0; !timers.empty(); t += 1) {
+            while (!timers.empty() && timers.begin()->first <= t) {
+                sum += timers.begin()->second;
+                timers.erase(timers.begin());
+            }
+        }
+    });
+    if (sum == 0 && n > 2) {
+        std::abort();
+    }
+    return c;
+}
+
+// Cancel marks the timer; the mark is checked when it reaches the top.
+Costs heapCosts(const std::vector<uint64_t>& expiries) {
+    size_t n = expiries.size();
+    using Entry = std::pair<uint64_t, uint64_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> timers;
+    std::vector<char> cancelled(n, 0);
+    Costs c;
+    c.insert = nsPer(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            timers.emplace(expiries[i], i);
+        }
+    });
+    c.cancel = nsPer(n / 2, [&] {
+        for (size_t i = 0; i < n; i += 2) {
+            cancelled[i] = 1;
+        }
+    });
+    uint64_t sum = 0;
+    c.expire = nsPer(n - n / 2, [&] {
+        for (uint64_t t = 0; !timers.empty(); t += 1) {
+            while (!timers.empty() && timers.top().first <= t) {
+                if (!cancelled[timers.top().second]) {
+                    sum += timers.top().second;
+                }
+                timers.pop();
+            }
+        }
+    });
+    if (sum == 0 && n > 2) {
+        std::abort();
+    }
+    return c;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t poolTimers = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+    if (!checkWheel() || !checkPool()) {
+        return 1;
+    }
+    std::cout << "Timer wheel model, ordering, cancellation and periodic checks pass." << std::endl;
+
+    std::vector<uint64_t> expiries(n);
+    std::mt19937_64 rng(7);
+    for (uint64_t& e : expiries) {
+        e = rng() % 60000;
+    }
+    std::cout << "\n" << n << " timers over 60 s of 1 ms ticks, half cancelled; ns per timer, best of 3\n"
+              << std::setw(22) << "" << std::setw(10) << "insert" << std::setw(10) << "cancel" << std::setw(10)
+              << "expire" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    auto row = [&](const char* name, Costs (*measure)(const std::vector<uint64_t>&)) {
+        Costs best{1e30, 1e30, 1e30};
+        for (int rep = 0; rep < 3; ++rep) {
+            Costs c = measure(expiries);
+            best = Costs{std::min(best.insert, c.insert), std::min(best.cancel, c.cancel),
+                         std::min(best.expire, c.expire)};
+        }
+        std::cout << std::setw(22) << name << std::setw(10) << best.insert << std::setw(10) << best.cancel
+                  << std::setw(10) << best.expire << std::endl;
+    };
+    row("TimerWheel", wheelCosts);
+    row("std::multimap", mapCosts);
+    row("heap, lazy cancel", heapCosts);
+
+    // Timers spread over one second: how late each starts on a worker.
+    ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    LatencyHistogram late;
+    std::mutex mutex;
+    std::atomic<size_t> done{0};
+    auto start = Clock::now();
+    for (size_t i = 0; i < poolTimers; ++i) {
+        auto delay = std::chrono::microseconds(1000000 * i / poolTimers);
+        Clock::time_point due = start + delay;
+        pool.scheduleAfter(due - Clock::now(), [due, &late, &mutex, &done] {
+            uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - due).count());
+            std::lock_guard<std::mutex> lock(mutex);
+            late.add(ns);
+            ++done;
+        });
+    }
+    while (done.load() < poolTimers) {
+        std::this_thread::sleep_for(10ms);
+    }
+    ThreadPoolStats s = pool.stats();
+    std::cout << "\n" << poolTimers << " scheduleAfter() timers over 1 s, lateness past due (1 ms ticks) us: p50 "
+              << static_cast<double>(late.percentile(0.5)) / 1000 << "  p99 "
+              << static_cast<double>(late.percentile(0.99)) / 1000 << "  max " << static_cast<double>(late.max) / 1000
+              << "\n"
+              << s;
+    return 0;
+}
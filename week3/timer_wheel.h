@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel (Varghese and Lauck): pending timers keyed by
+// an integer tick, with O(1) insert and cancel however many are pending.
+//
+//   TimerWheel<Job> wheel;
+//   TimerWheel<Job>::Id id = wheel.insert(now + 250, job);
+//   wheel.cancel(id);                                  // the job, or nullopt if it already fired
+//   wheel.advance(now, [](TimerWheel<Job>::Id, Job& job) { run(job); return 0; });
+//
+// Four levels of 256 slots cover 2^32 ticks (49 days of milliseconds).
+// A timer sits in the lowest level whose slots still tell its expiry
+// apart from the current tick: level 0 holds one tick per slot, level 1
+// one 256-tick block per slot, and so on. When the current tick enters a
+// block, advance() moves that block's timers down a level, so each timer
+// is moved at most three times. Timers further out than 2^32 ticks wait
+// in an overflow list until the current tick gets within range. Each slot
+// is a doubly linked list threaded through one node array by index, so
+// cancel unlinks in place, and a bitmap of non-empty slots per level lets
+// nextExpiry() and advance() skip empty stretches instead of visiting
+// every tick.
+//
+// Not thread-safe.
+template <class T>
+class TimerWheel {
+public:
+    // Slot index in the low 32 bits, a generation in the high 32, so the
+    // id of a fired or cancelled timer never matches a later one. Never 0.
+    using Id = uint64_t;
+
+    static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+    explicit TimerWheel(uint64_t now = 0) : now_(now) {
+        nodes_.resize(kLists);
+        for (uint32_t i = 0; i < kLists; ++i) {
+            nodes_[i].prev = nodes_[i].next = i;
+        }
+    }
+
+    uint64_t now() const { return now_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // A timer at or before now() is due at the next advance().
+    Id insert(uint64_t expiry, T value) {
+        uint32_t index;
+        if (free_ != kNil) {
+            index = free_;
+            free_ = nodes_[index].next;
+        } else {
+            index = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+        Node& n = nodes_[index];
+        n.expiry = expiry;
+        n.value = std::move(value);
+        link(index);
+        ++size_;
+        return (static_cast<uint64_t>(n.generation) << 32) | index;
+    }
+
+    // Removes a pending timer and returns its value.
+    std::optional<T> cancel(Id id) {
+        uint32_t index = static_cast<uint32_t>(id);
+        if (index < kLists || index >= nodes_.size() || nodes_[index].generation != id >> 32 ||
+            nodes_[index].list >= kFree) {
+            return std::nullopt;
+        }
+        unlink(index);
+        std::optional<T> value(std::move(nodes_[index].value));
+        release(index);
+        return value;
+    }
+
+    // Earliest tick at which advance() has something to do: a timer to
+    // fire, or a block to move down a level. kNever if nothing is pending.
+    uint64_t nextExpiry() const {
+        if (!empty(kDue)) {
+            return now_;
+        }
+        uint64_t next = kNever;
+        for (unsigned level = 0; level < kLevels; ++level) {
+            unsigned shift = level * kBits;
+            unsigned digit = static_cast<unsigned>(now_ >> shift) & kMask;
+            int slot = nextOccupied(level, digit + 1);
+            if (slot >= 0) {
+                uint64_t above = (now_ >> (shift + kBits)) << (shift + kBits);
+                next = std::min(next, above | (static_cast<uint64_t>(slot) << shift));
+            }
+        }
+        if (!empty(kOverflow)) {
+            next = std::min(next, ((now_ >> kRange) + 1) << kRange);
+        }
+        return next;
+    }
+
+    // Moves the current tick to `to`, calling fire(id, value) for every timer
+    // that expires on the way, in expiry order. fire returns 0 to drop the
+    // timer, or a later tick to re-arm it under the same id. It must not
+    // insert or cancel.
+    template <class Fire>
+    void advance(uint64_t to, Fire&& fire) {
+        fireList(kDue, fire);
+        while (now_ < to) {
+            uint64_t next = nextExpiry();
+            if (next > to) {
+                now_ = to;
+                break;
+            }
+            now_ = next;
+            if ((now_ & ((uint64_t(1) << kRange) - 1)) == 0) {
+                cascade(kOverflow);
+            }
+            for (unsigned level = kLevels - 1; level > 0; --level) {
+                unsigned shift = level * kBits;
+                if ((now_ & ((uint64_t(1) << shift) - 1)) == 0) {
+                    cascade(listOf(level, static_cast<unsigned>(now_ >> shift) & kMask));
+                }
+            }
+            fireList(listOf(0, static_cast<unsigned>(now_) & kMask), fire);
+            fireList(kDue, fire);
+        }
+    }
+
+private:
+    static constexpr unsigned kBits = 8;
+    static constexpr unsigned kSlots = 1u << kBits;
+    static constexpr unsigned kMask = kSlots - 1;
+    static constexpr unsigned kLevels = 4;
+    static constexpr unsigned kRange = kBits * kLevels;  // ticks covered: 2^kRange
+    static constexpr uint32_t kOverflow = kLevels * kSlots;
+    static constexpr uint32_t kDue = kOverflow + 1;
+    static constexpr uint32_t kLists = kDue + 1;  // list heads, at the start of nodes_
+    static constexpr uint32_t kFree = kLists;     // list of a node on the free list
+    static constexpr uint32_t kFiring = kLists + 1;
+    static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+
+    struct Node {
+        uint64_t expiry = 0;
+        uint32_t prev = kNil, next = kNil;
+        uint32_t list = kFree;  // which list head it hangs off
+        uint32_t generation = 1;
+        T value{};
+    };
+
+    static uint32_t listOf(unsigned level, unsigned slot) { return level * kSlots + slot; }
+
+    bool empty(uint32_t list) const { return nodes_[list].next == list; }
+
+    // First non-empty slot of level at or after from, or -1.
+    int nextOccupied(unsigned level, unsigned from) const {
+        for (unsigned word = from / 64; word < kSlots / 64; ++word) {
+            uint64_t bits = occupied_[level][word];
+            if (word == from / 64) {
+                bits &= ~uint64_t(0) << (from % 64);
+            }
+            if (bits != 0) {
+                return static_cast<int>(word * 64 + static_cast<unsigned>(__builtin_ctzll(bits)));
+            }
+        }
+        return -1;
+    }
+
+    // Picks the list for a node's expiry relative to now_ and appends it.
+    void link(uint32_t index) {
+        uint64_t expiry = nodes_[index].expiry;
+        uint32_t list = kDue;
+        if (expiry > now_) {
+            list = kOverflow;
+            for (unsigned level = 0; level < kLevels; ++level) {
+                unsigned above = (level + 1) * kBits;
+                if (above >= 64 || (expiry >> above) == (now_ >> above)) {
+                    list = listOf(level, static_cast<unsigned>(expiry >> (level * kBits)) & kMask);
+                    break;
+                }
+            }
+        }
+        Node& n = nodes_[index];
+        Node& head = nodes_[list];
+        n.list = list;
+        n.prev = head.prev;
+        n.next = list;
+        nodes_[head.prev].next = index;
+        head.prev = index;
+        if (list < kOverflow) {
+            occupied_[list / kSlots][(list % kSlots) / 64] |= uint64_t(1) << (list % 64);
+        }
+    }
+
+    void unlink(uint32_t index) {
+        Node& n = nodes_[index];
+        nodes_[n.prev].next = n.next;
+        nodes_[n.next].prev = n.prev;
+        if (n.list < kOverflow && empty(n.list)) {
+            occupied_[n.list / kSlots][(n.list % kSlots) / 64] &= ~(uint64_t(1) << (n.list % 64));
+        }
+    }
+
+    void release(uint32_t index) {
+        Node& n = nodes_[index];
+        n.value = T{};
+        n.list = kFree;
+        ++n.generation;
+        n.next = free_;
+        free_ = index;
+        --size_;
+    }
+
+    // Detaches a whole list, leaving its head empty, and returns its first node.
+    uint32_t take(uint32_t list) {
+        Node& head = nodes_[list];
+        if (head.next == list) {
+            return kNil;
+        }
+        uint32_t first = head.next;
+        nodes_[head.prev].next = kNil;
+        head.prev = head.next = list;
+        if (list < kOverflow) {
+            occupied_[list / kSlots][(list % kSlots) / 64] &= ~(uint64_t(1) << (list % 64));
+        }
+        return first;
+    }
+
+    void cascade(uint32_t list) {
+        for (uint32_t index = take(list); index != kNil;) {
+            uint32_t next = nodes_[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+    template <class Fire>
+    void fireList(uint32_t list, Fire& fire) {
+        for (uint32_t index = take(list); index != kNil;) {
+            uint32_t next = nodes_[index].next;
+            Id id = (static_cast<uint64_t>(nodes_[index].generation) << 32) | index;
+            nodes_[index].list = kFiring;
+            uint64_t again = fire(id, nodes_[index].value);
+            if (again != 0) {
+                nodes_[index].expiry = again;
+                link(index);
+            } else {
+                release(index);
+            }
+            index = next;
+        }
+    }
+
+    std::vector<Node> nodes_;
+    uint64_t occupied_[kLevels][kSlots / 64] = {};
+    uint32_t free_ = kNil;
+    size_t size_ = 0;
+    uint64_t now_;
+};
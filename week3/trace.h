@@ -0,0 +1,293 @@
+#pragma once
+
+// Scoped-zone instrumentation with Chrome trace export.
+//
+//   trace::Session session("day21.trace.json");   // written when it goes out of scope
+//   void work() {
+//       TRACE_SCOPE("work");                       // one complete event per call
+//       ...
+//   }
+//
+// Open the file in chrome://tracing or https://ui.perfetto.dev.
+//
+// Everything is compiled in only when CPP30_TRACE is defined (cmake
+// -DCPP30_TRACE=ON, or -DCPP30_TRACE on the command line). Otherwise the
+// macros expand to nothing, Session is empty and now() returns 0.
+//
+// Each thread appends to its own fixed-size buffer; the only shared write
+// is a release store of the event count, so zones on different threads
+// never contend. A full buffer drops further events and counts them.
+// Timestamps are raw TSC ticks on x86 (assumes an invariant TSC, which any
+// recent x86 CPU has) and steady_clock nanoseconds elsewhere; they are
+// converted to microseconds only at export.
+#include <cstddef>
+#include <cstdint>
+
+#ifdef CPP30_TRACE
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef CPP30_TRACE
+
+// Times the rest of the enclosing scope as a zone called name (a string
+// literal or other string that outlives the export).
+#define TRACE_SCOPE(name) ::trace::Zone TRACE_CONCAT(traceZone_, __LINE__)(name)
+// Names the calling thread in the exported trace.
+#define TRACE_THREAD_NAME(name) ::trace::setThreadName(name)
+
+namespace trace {
+
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+}
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    bool async;  // may overlap other events on its thread
+};
+
+namespace detail {
+
+constexpr std::size_t kEventsPerThread = 1 << 16;
+
+struct ThreadBuffer {
+    // Value-initialized so the pages are touched here, not on the hot path.
+    explicit ThreadBuffer(uint32_t tid) : tid(tid), events(new Event[kEventsPerThread]()) {}
+
+    // Called only by the owning thread.
+    void push(const char* name, uint64_t start, uint64_t end, bool async) {
+        std::size_t n = count.load(std::memory_order_relaxed);
+        if (n == kEventsPerThread) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        events[n] = Event{name, start, end, async};
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    const uint32_t tid;
+    std::unique_ptr<Event[]> events;
+    std::atomic<std::size_t> count{0};
+    std::atomic<uint64_t> dropped{0};
+    std::string name;  // guarded by Registry::mutex
+};
+
+// Owns every thread's buffer, so events survive the threads that wrote
+// them (ThreadPool workers are usually joined before the export).
+struct Registry {
+    Registry() : baseTicks(now()), baseTime(std::chrono::steady_clock::now()) {}
+
+    std::shared_ptr<ThreadBuffer> add() {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_shared<ThreadBuffer>(static_cast<uint32_t>(buffers.size() + 1)));
+        return buffers.back();
+    }
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    const uint64_t baseTicks;
+    const std::chrono::steady_clock::time_point baseTime;
+};
+
+inline Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+inline ThreadBuffer& localBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = registry().add();
+    return *buffer;
+}
+
+inline void writeJsonString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            out << '\\' << *s;
+        } else if (c < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec
+                << std::setfill(' ');
+        } else {
+            out << *s;
+        }
+    }
+    out << '"';
+}
+
+}  // namespace detail
+
+// Records an interval that does not map to one scope. Nested zones are
+// drawn on the thread's own track.
+inline void record(const char* name, uint64_t start, uint64_t end) {
+    detail::localBuffer().push(name, start, end, false);
+}
+
+// Records an interval that may overlap the thread's other zones, such as
+// a task's queue wait that began on another thread. It is exported as an
+// async slice, which trace viewers draw on a separate track.
+inline void recordAsync(const char* name, uint64_t start, uint64_t end) {
+    detail::localBuffer().push(name, start, end, true);
+}
+
+inline void setThreadName(std::string name) {
+    detail::ThreadBuffer& buffer = detail::localBuffer();
+    std::lock_guard<std::mutex> lock(detail::registry().mutex);
+    buffer.name = std::move(name);
+}
+
+class Zone {
+public:
+    explicit Zone(const char* name) : name_(name), start_(now()) {}
+    ~Zone() { record(name_, start_, now()); }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// Timestamp ticks per microsecond, measured against steady_clock since the
+// first event. Waits until at least 10 ms have passed for a stable ratio.
+inline double ticksPerMicrosecond() {
+#if defined(__x86_64__) || defined(__i386__)
+    const detail::Registry& reg = detail::registry();
+    auto elapsed = std::chrono::steady_clock::now() - reg.baseTime;
+    if (elapsed < std::chrono::milliseconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+    }
+    uint64_t ticks = now() - reg.baseTicks;
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reg.baseTime).count();
+    return static_cast<double>(ticks) / us;
+#else
+    return 1000.0;
+#endif
+}
+
+// Writes every event recorded so far as Chrome trace JSON ("X" complete
+// events, "b"/"e" async pairs and thread_name metadata). Threads may keep recording; events
+// pushed after their buffer was read are left out.
+inline void writeChromeTrace(std::ostream& out) {
+    detail::Registry& reg = detail::registry();
+    const double perUs = ticksPerMicrosecond();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    std::size_t asyncId = 0;
+    auto separator = [&] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    out << std::fixed << std::setprecision(3);
+    for (const auto& buffer : reg.buffers) {
+        if (!buffer->name.empty()) {
+            separator();
+            out << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+            detail::writeJsonString(out, buffer->name.c_str());
+            out << "}}";
+        }
+        std::size_t n = buffer->count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i) {
+            const Event& e = buffer->events[i];
+            // A timestamp taken before the registry existed (a queued task's
+            // enqueue time, say) would wrap around; clamp it to zero.
+            uint64_t start = e.start > reg.baseTicks ? e.start - reg.baseTicks : 0;
+            uint64_t duration = e.end > e.start ? e.end - e.start : 0;
+            if (e.async) {
+                ++asyncId;
+                for (const char* phase : {"b", "e"}) {
+                    separator();
+                    out << "{\"ph\":\"" << phase << "\",\"cat\":\"async\",\"id\":" << asyncId
+                        << ",\"pid\":1,\"tid\":" << buffer->tid << ",\"name\":";
+                    detail::writeJsonString(out, e.name);
+                    uint64_t ts = *phase == 'b' ? start : start + duration;
+                    out << ",\"ts\":" << static_cast<double>(ts) / perUs << "}";
+                }
+                continue;
+            }
+            separator();
+            out << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ",\"name\":";
+            detail::writeJsonString(out, e.name);
+            out << ",\"ts\":" << static_cast<double>(start) / perUs << ",\"dur\":" << static_cast<double>(duration) / perUs
+                << "}";
+        }
+        uint64_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+        if (dropped != 0) {
+            separator();
+            out << "{\"ph\":\"C\",\"pid\":1,\"tid\":" << buffer->tid << ",\"name\":\"dropped events\",\"ts\":0"
+                << ",\"args\":{\"dropped\":" << dropped << "}}";
+        }
+    }
+    out << "\n]}\n";
+    out.unsetf(std::ios::floatfield);
+}
+
+inline bool writeChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    writeChromeTrace(out);
+    return static_cast<bool>(out);
+}
+
+// Writes the trace to path when destroyed. Declare it first in main() so
+// it outlives thread pools and other objects that record events.
+class Session {
+public:
+    explicit Session(std::string path) : path_(std::move(path)) { detail::registry(); }
+    ~Session() { writeChromeTrace(path_); }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+private:
+    std::string path_;
+};
+
+}  // namespace trace
+
+#else
+
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#define TRACE_THREAD_NAME(name) static_cast<void>(0)
+
+namespace trace {
+
+inline uint64_t now() { return 0; }
+inline void record(const char*, uint64_t, uint64_t) {}
+inline void recordAsync(const char*, uint64_t, uint64_t) {}
+
+class Session {
+public:
+    explicit Session(const char*) {}
+};
+
+}  // namespace trace
+
+#endif
@@ -0,0 +1,438 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATRIX_HAVE_X86 1
+#else
+#define MATRIX_HAVE_X86 0
+#endif
+
+#include "../week3/thread_pool.h"
+
+// Storage is aligned to a cache line, and every row starts on one (the row
+// stride is padded), so SIMD loads never split lines.
+constexpr std::size_t kMatrixAlignment = 64;
+
+struct AlignedFree {
+    void operator()(void* p) const noexcept { std::free(p); }
+};
+
+template <typename T>
+std::unique_ptr<T[], AlignedFree> allocateAligned(std::size_t count) {
+    std::size_t bytes = (count * sizeof(T) + kMatrixAlignment - 1) / kMatrixAlignment * kMatrixAlignment;
+    void* p = std::aligned_alloc(kMatrixAlignment, bytes == 0 ? kMatrixAlignment : bytes);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return std::unique_ptr<T[], AlignedFree>(static_cast<T*>(p));
+}
+
+// Row-major dense matrix (文档/章节四/手写STL.md, 数学库).
+template <typename T>
+class Matrix {
+    static_assert(std::is_arithmetic<T>::value, "Matrix<T> needs an arithmetic T");
+
+public:
+    Matrix() = default;
+
+    Matrix(std::size_t rows, std::size_t cols)
+        : rows_(rows), cols_(cols), stride_(paddedStride(cols)),
+          data_(allocateAligned<T>(rows * paddedStride(cols))) {
+        std::fill(data_.get(), data_.get() + rows_ * stride_, T{});
+    }
+
+    Matrix(std::initializer_list<std::initializer_list<T>> init)
+        : Matrix(init.size(), init.size() ? init.begin()->size() : 0) {
+        std::size_t r = 0;
+        for (const auto& row : init) {
+            if (row.size() != cols_) {
+                throw std::invalid_argument("Matrix: ragged initializer list");
+            }
+            std::copy(row.begin(), row.end(), this->row(r++));
+        }
+    }
+
+    Matrix(const Matrix& other) : Matrix(other.rows_, other.cols_) {
+        std::copy(other.data_.get(), other.data_.get() + rows_ * stride_, data_.get());
+    }
+
+    Matrix(Matrix&& other) noexcept = default;
+
+    Matrix& operator=(const Matrix& other) {
+        if (this != &other) {
+            Matrix tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    Matrix& operator=(Matrix&& other) noexcept = default;
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    // Distance in elements between the starts of two consecutive rows.
+    std::size_t stride() const { return stride_; }
+
+    T* data() { return data_.get(); }
+    const T* data() const { return data_.get(); }
+    T* row(std::size_t r) { return data_.get() + r * stride_; }
+    const T* row(std::size_t r) const { return data_.get() + r * stride_; }
+
+    T& operator()(std::size_t r, std::size_t c) { return data_[r * stride_ + c]; }
+    const T& operator()(std::size_t r, std::size_t c) const { return data_[r * stride_ + c]; }
+
+    void fill(T value) {
+        for (std::size_t r = 0; r < rows_; ++r) {
+            std::fill(row(r), row(r) + cols_, value);
+        }
+    }
+
+    Matrix operator+(const Matrix& other) const {
+        validateDimensions(other.rows_ == rows_ && other.cols_ == cols_, "add");
+        Matrix result(rows_, cols_);
+        for (std::size_t r = 0; r < rows_; ++r) {
+            const T* a = row(r);
+            const T* b = other.row(r);
+            T* c = result.row(r);
+            for (std::size_t j = 0; j < cols_; ++j) {
+                c[j] = a[j] + b[j];
+            }
+        }
+        return result;
+    }
+
+    Matrix operator*(const Matrix& other) const;
+
+    Matrix transpose() const {
+        Matrix result(cols_, rows_);
+        constexpr std::size_t kTile = 32;
+        for (std::size_t i0 = 0; i0 < rows_; i0 += kTile) {
+            for (std::size_t j0 = 0; j0 < cols_; j0 += kTile) {
+                for (std::size_t i = i0; i < std::min(i0 + kTile, rows_); ++i) {
+                    for (std::size_t j = j0; j < std::min(j0 + kTile, cols_); ++j) {
+                        result(j, i) = (*this)(i, j);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    void validateDimensions(bool ok, const std::string& op) const {
+        if (!ok) {
+            throw std::invalid_argument("Matrix: dimension mismatch in " + op);
+        }
+    }
+
+private:
+    static std::size_t paddedStride(std::size_t cols) {
+        constexpr std::size_t perLine = kMatrixAlignment / sizeof(T);
+        return (cols + perLine - 1) / perLine * perLine;
+    }
+
+    std::size_t rows_ = 0;
+    std::size_t cols_ = 0;
+    std::size_t stride_ = 0;
+    std::unique_ptr<T[], AlignedFree> data_;
+};
+
+// ---------------------------------------------------------------------------
+// GEMM: C += A * B
+//
+// BLIS-style loop nest. B is packed into KC x NC panels of NR-wide slivers
+// (kept in L3/L2), A into MC x KC blocks of MR-tall slivers (kept in L2), and
+// an MR x NR register-tiled micro-kernel streams both slivers from L1.
+
+enum class GemmBackend { Auto, Scalar, Avx2 };
+
+namespace gemm_detail {
+
+template <typename T>
+struct Blocking {
+    static constexpr std::size_t MR = 4, NR = 4, MC = 64, KC = 256, NC = 4096;
+};
+template <>
+struct Blocking<double> {
+    // 6 x 8 doubles = 12 ymm accumulators + 2 B vectors + 1 broadcast.
+    static constexpr std::size_t MR = 6, NR = 8, MC = 72, KC = 256, NC = 4080;
+};
+template <>
+struct Blocking<float> {
+    static constexpr std::size_t MR = 6, NR = 16, MC = 72, KC = 256, NC = 4080;
+};
+
+// Micro-kernel contract: C[0..MR)[0..NR) += Apack * Bpack over kc steps.
+template <typename T>
+using MicroKernel = void (*)(std::size_t kc, const T* a, const T* b, T* c, std::size_t ldc);
+
+template <typename T>
+void microKernelScalar(std::size_t kc, const T* a, const T* b, T* c, std::size_t ldc) {
+    constexpr std::size_t MR = Blocking<T>::MR, NR = Blocking<T>::NR;
+    T acc[MR][NR] = {};
+    for (std::size_t p = 0; p < kc; ++p) {
+        for (std::size_t i = 0; i < MR; ++i) {
+            T ai = a[p * MR + i];
+            for (std::size_t j = 0; j < NR; ++j) {
+                acc[i][j] += ai * b[p * NR + j];
+            }
+        }
+    }
+    for (std::size_t i = 0; i < MR; ++i) {
+        for (std::size_t j = 0; j < NR; ++j) {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+#if MATRIX_HAVE_X86
+// row[0..2 vectors) += lo, hi
+__attribute__((target("avx2,fma")))
+inline void accumulateRow(double* row, __m256d lo, __m256d hi) {
+    _mm256_storeu_pd(row, _mm256_add_pd(_mm256_loadu_pd(row), lo));
+    _mm256_storeu_pd(row + 4, _mm256_add_pd(_mm256_loadu_pd(row + 4), hi));
+}
+
+__attribute__((target("avx2,fma")))
+inline void accumulateRow(float* row, __m256 lo, __m256 hi) {
+    _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), lo));
+    _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), hi));
+}
+
+__attribute__((target("avx2,fma")))
+inline void microKernelAvx2(std::size_t kc, const double* a, const double* b, double* c, std::size_t ldc) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    for (std::size_t p = 0; p < kc; ++p) {
+        __m256d b0 = _mm256_load_pd(b);
+        __m256d b1 = _mm256_load_pd(b + 4);
+        __m256d ai;
+        ai = _mm256_broadcast_sd(a + 0); c00 = _mm256_fmadd_pd(ai, b0, c00); c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1); c10 = _mm256_fmadd_pd(ai, b0, c10); c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2); c20 = _mm256_fmadd_pd(ai, b0, c20); c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3); c30 = _mm256_fmadd_pd(ai, b0, c30); c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4); c40 = _mm256_fmadd_pd(ai, b0, c40); c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5); c50 = _mm256_fmadd_pd(ai, b0, c50); c51 = _mm256_fmadd_pd(ai, b1, c51);
+        a += 6;
+        b += 8;
+    }
+    accumulateRow(c + 0 * ldc, c00, c01);
+    accumulateRow(c + 1 * ldc, c10, c11);
+    accumulateRow(c + 2 * ldc, c20, c21);
+    accumulateRow(c + 3 * ldc, c30, c31);
+    accumulateRow(c + 4 * ldc, c40, c41);
+    accumulateRow(c + 5 * ldc, c50, c51);
+}
+
+__attribute__((target("avx2,fma")))
+inline void microKernelAvx2(std::size_t kc, const float* a, const float* b, float* c, std::size_t ldc) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (std::size_t p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        __m256 ai;
+        ai = _mm256_broadcast_ss(a + 0); c00 = _mm256_fmadd_ps(ai, b0, c00); c01 = _mm256_fmadd_ps(ai, b1, c01);
+        ai = _mm256_broadcast_ss(a + 1); c10 = _mm256_fmadd_ps(ai, b0, c10); c11 = _mm256_fmadd_ps(ai, b1, c11);
+        ai = _mm256_broadcast_ss(a + 2); c20 = _mm256_fmadd_ps(ai, b0, c20); c21 = _mm256_fmadd_ps(ai, b1, c21);
+        ai = _mm256_broadcast_ss(a + 3); c30 = _mm256_fmadd_ps(ai, b0, c30); c31 = _mm256_fmadd_ps(ai, b1, c31);
+        ai = _mm256_broadcast_ss(a + 4); c40 = _mm256_fmadd_ps(ai, b0, c40); c41 = _mm256_fmadd_ps(ai, b1, c41);
+        ai = _mm256_broadcast_ss(a + 5); c50 = _mm256_fmadd_ps(ai, b0, c50); c51 = _mm256_fmadd_ps(ai, b1, c51);
+        a += 6;
+        b += 16;
+    }
+    accumulateRow(c + 0 * ldc, c00, c01);
+    accumulateRow(c + 1 * ldc, c10, c11);
+    accumulateRow(c + 2 * ldc, c20, c21);
+    accumulateRow(c + 3 * ldc, c30, c31);
+    accumulateRow(c + 4 * ldc, c40, c41);
+    accumulateRow(c + 5 * ldc, c50, c51);
+}
+
+inline bool cpuHasAvx2Fma() {
+    static const bool has = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return has;
+}
+#else
+inline bool cpuHasAvx2Fma() { return false; }
+#endif
+
+// Picks the micro-kernel once per call; AVX2 only exists for float/double.
+template <typename T>
+MicroKernel<T> selectKernel(GemmBackend backend) {
+#if MATRIX_HAVE_X86
+    if constexpr (std::is_same<T, double>::value || std::is_same<T, float>::value) {
+        bool avx2 = cpuHasAvx2Fma();
+        if (backend == GemmBackend::Avx2 && !avx2) {
+            throw std::runtime_error("GemmBackend::Avx2 requested but the CPU lacks AVX2/FMA");
+        }
+        if (backend != GemmBackend::Scalar && avx2) {
+            return static_cast<MicroKernel<T>>(&microKernelAvx2);
+        }
+    }
+#endif
+    if (backend == GemmBackend::Avx2) {
+        throw std::runtime_error("GemmBackend::Avx2 is only available for float and double");
+    }
+    return &microKernelScalar<T>;
+}
+
+// Packs A[0..mc)[0..kc) into MR-tall slivers, k-major, zero-padding the last sliver.
+template <typename T>
+void packA(std::size_t mc, std::size_t kc, const T* a, std::size_t lda, T* out) {
+    constexpr std::size_t MR = Blocking<T>::MR;
+    for (std::size_t i0 = 0; i0 < mc; i0 += MR) {
+        std::size_t mr = std::min(MR, mc - i0);
+        for (std::size_t p = 0; p < kc; ++p) {
+            for (std::size_t i = 0; i < mr; ++i) {
+                out[i] = a[(i0 + i) * lda + p];
+            }
+            for (std::size_t i = mr; i < MR; ++i) {
+                out[i] = T{};
+            }
+            out += MR;
+        }
+    }
+}
+
+// Packs B[0..kc)[0..nc) into NR-wide slivers, k-major, zero-padding the last sliver.
+template <typename T>
+void packB(std::size_t kc, std::size_t nc, const T* b, std::size_t ldb, T* out) {
+    constexpr std::size_t NR = Blocking<T>::NR;
+    for (std::size_t j0 = 0; j0 < nc; j0 += NR) {
+        std::size_t nr = std::min(NR, nc - j0);
+        for (std::size_t p = 0; p < kc; ++p) {
+            const T* src = b + p * ldb + j0;
+            for (std::size_t j = 0; j < nr; ++j) {
+                out[j] = src[j];
+            }
+            for (std::size_t j = nr; j < NR; ++j) {
+                out[j] = T{};
+            }
+            out += NR;
+        }
+    }
+}
+
+// Single-threaded blocked GEMM on raw row-major operands.
+template <typename T>
+void gemmBlocked(std::size_t m, std::size_t n, std::size_t k,
+                 const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc,
+                 MicroKernel<T> kernel) {
+    using B = Blocking<T>;
+    auto packedA = allocateAligned<T>(B::MC * B::KC);
+    auto packedB = allocateAligned<T>(B::KC * ((std::min(B::NC, n) + B::NR - 1) / B::NR * B::NR));
+    alignas(kMatrixAlignment) T edge[B::MR * B::NR];
+
+    for (std::size_t jc = 0; jc < n; jc += B::NC) {
+        std::size_t nc = std::min(B::NC, n - jc);
+        for (std::size_t pc = 0; pc < k; pc += B::KC) {
+            std::size_t kc = std::min(B::KC, k - pc);
+            packB(kc, nc, b + pc * ldb + jc, ldb, packedB.get());
+            for (std::size_t ic = 0; ic < m; ic += B::MC) {
+                std::size_t mc = std::min(B::MC, m - ic);
+                packA(mc, kc, a + ic * lda + pc, lda, packedA.get());
+                for (std::size_t jr = 0; jr < nc; jr += B::NR) {
+                    std::size_t nr = std::min(B::NR, nc - jr);
+                    const T* bp = packedB.get() + jr * kc;
+                    for (std::size_t ir = 0; ir < mc; ir += B::MR) {
+                        std::size_t mr = std::min(B::MR, mc - ir);
+                        const T* ap = packedA.get() + ir * kc;
+                        T* cTile = c + (ic + ir) * ldc + jc + jr;
+                        if (mr == B::MR && nr == B::NR) {
+                            kernel(kc, ap, bp, cTile, ldc);
+                        } else {
+                            // Edge tile: run the full kernel on a scratch tile, copy back the valid part.
+                            std::fill(edge, edge + B::MR * B::NR, T{});
+                            kernel(kc, ap, bp, edge, B::NR);
+                            for (std::size_t i = 0; i < mr; ++i) {
+                                for (std::size_t j = 0; j < nr; ++j) {
+                                    cTile[i * ldc + j] += edge[i * B::NR + j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace gemm_detail
+
+// C += A * B. With a pool, C is split into bands of rows (multiples of MC)
+// and each band runs the blocked GEMM as its own task.
+template <typename T>
+void gemm(const Matrix<T>& a, const Matrix<T>& b, Matrix<T>& c,
+          ThreadPool* pool = nullptr, std::size_t threads = 1,
+          GemmBackend backend = GemmBackend::Auto) {
+    a.validateDimensions(a.cols() == b.rows() && c.rows() == a.rows() && c.cols() == b.cols(), "gemm");
+    using B = gemm_detail::Blocking<T>;
+    auto kernel = gemm_detail::selectKernel<T>(backend);
+    std::size_t m = a.rows(), n = b.cols(), k = a.cols();
+    if (m == 0 || n == 0 || k == 0) {
+        return;
+    }
+
+    std::size_t bands = pool ? std::min(threads, (m + B::MC - 1) / B::MC) : 1;
+    if (bands <= 1) {
+        gemm_detail::gemmBlocked(m, n, k, a.data(), a.stride(), b.data(), b.stride(), c.data(), c.stride(), kernel);
+        return;
+    }
+
+    std::size_t blocksPerBand = ((m + B::MC - 1) / B::MC + bands - 1) / bands;
+    std::vector<std::future<void>> pending;
+    for (std::size_t row0 = 0; row0 < m; row0 += blocksPerBand * B::MC) {
+        std::size_t rowsInBand = std::min(blocksPerBand * B::MC, m - row0);
+        pending.push_back(pool->enqueue([&, row0, rowsInBand] {
+            gemm_detail::gemmBlocked(rowsInBand, n, k, a.row(row0), a.stride(), b.data(), b.stride(),
+                                     c.row(row0), c.stride(), kernel);
+        }));
+    }
+    for (auto& f : pending) {
+        f.get();
+    }
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::operator*(const Matrix& other) const {
+    validateDimensions(cols_ == other.rows_, "multiply");
+    Matrix result(rows_, other.cols_);
+    gemm(*this, other, result);
+    return result;
+}
+
+// Textbook i-j-k triple loop, kept as the reference and the baseline.
+template <typename T>
+void gemmNaive(const Matrix<T>& a, const Matrix<T>& b, Matrix<T>& c) {
+    a.validateDimensions(a.cols() == b.rows() && c.rows() == a.rows() && c.cols() == b.cols(), "gemmNaive");
+    for (std::size_t i = 0; i < a.rows(); ++i) {
+        for (std::size_t j = 0; j < b.cols(); ++j) {
+            T sum{};
+            for (std::size_t p = 0; p < a.cols(); ++p) {
+                sum += a(i, p) * b(p, j);
+            }
+            c(i, j) += sum;
+        }
+    }
+}
@@ -0,0 +1,124 @@
+// GEMM GFLOPS: naive triple loop vs blocked scalar vs blocked AVX2/FMA (+ ThreadPool).
+// Build: g++ -std=c++17 -O2 matrix_bench.cpp -o matrix_bench -pthread
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "matrix.h"
+
+template <typename T>
+Matrix<T> randomMatrix(std::size_t rows, std::size_t cols, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix<T> m(rows, cols);
+    for (std::size_t r = 0; r < rows; ++r) {
+        for (std::size_t c = 0; c < cols; ++c) {
+            m(r, c) = std::is_integral<T>::value ? static_cast<T>(rng() % 11) - 5 : static_cast<T>(dist(rng));
+        }
+    }
+    return m;
+}
+
+template <typename T>
+double maxAbsDiff(const Matrix<T>& x, const Matrix<T>& y) {
+    double diff = 0;
+    for (std::size_t r = 0; r < x.rows(); ++r) {
+        for (std::size_t c = 0; c < x.cols(); ++c) {
+            diff = std::max(diff, std::abs(static_cast<double>(x(r, c)) - static_cast<double>(y(r, c))));
+        }
+    }
+    return diff;
+}
+
+// Best-of-runs GFLOPS for one C = A * B implementation.
+template <typename F>
+double gflops(std::size_t n, F&& multiply) {
+    double flops = 2.0 * static_cast<double>(n) * static_cast<double>(n) * static_cast<double>(n);
+    int runs = n <= 256 ? 5 : (n <= 1024 ? 3 : 1);
+    double best = 1e300;
+    for (int r = 0; r < runs; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        multiply();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return flops / best / 1e9;
+}
+
+// Odd shapes exercise every edge-tile path against the naive reference.
+template <typename T>
+bool checkShapes(ThreadPool& pool, std::size_t threads) {
+    const std::size_t shapes[][3] = {{1, 1, 1}, {7, 5, 3}, {13, 17, 11}, {73, 9, 300}, {150, 161, 257}, {200, 40, 1}};
+    double tolerance = std::is_same<T, float>::value ? 1e-3 : 1e-9;
+    for (const auto& s : shapes) {
+        auto a = randomMatrix<T>(s[0], s[2], 1);
+        auto b = randomMatrix<T>(s[2], s[1], 2);
+        Matrix<T> expected(s[0], s[1]);
+        gemmNaive(a, b, expected);
+        for (GemmBackend backend : {GemmBackend::Scalar, GemmBackend::Auto}) {
+            Matrix<T> got(s[0], s[1]);
+            gemm(a, b, got, &pool, threads, backend);
+            if (maxAbsDiff(got, expected) > tolerance * static_cast<double>(s[2])) {
+                std::cerr << "GEMM mismatch at " << s[0] << "x" << s[1] << "x" << s[2] << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void benchmark(const char* type, const std::vector<std::size_t>& sizes, ThreadPool& pool, std::size_t threads) {
+    bool avx2 = gemm_detail::cpuHasAvx2Fma();
+    std::cout << "\n" << type << " GEMM (GFLOPS), " << threads << " thread(s)" << std::endl;
+    std::cout << std::setw(6) << "n" << std::setw(10) << "naive" << std::setw(10) << "scalar"
+              << std::setw(10) << "avx2" << std::setw(12) << "avx2+pool" << std::setw(10) << "vs naive" << std::endl;
+    for (std::size_t n : sizes) {
+        auto a = randomMatrix<T>(n, n, 3);
+        auto b = randomMatrix<T>(n, n, 4);
+        Matrix<T> c(n, n);
+
+        // The naive loop is O(n^3) with a cache miss per step of p; skip it when it would take minutes.
+        double naive = n <= 1024 ? gflops(n, [&] { gemmNaive(a, b, c); }) : 0.0;
+        double scalar = gflops(n, [&] { gemm(a, b, c, nullptr, 1, GemmBackend::Scalar); });
+        double simd = avx2 ? gflops(n, [&] { gemm(a, b, c, nullptr, 1, GemmBackend::Avx2); }) : 0.0;
+        double pooled = gflops(n, [&] { gemm(a, b, c, &pool, threads); });
+
+        std::cout << std::fixed << std::setprecision(2) << std::setw(6) << n << std::setw(10) << naive
+                  << std::setw(10) << scalar << std::setw(10) << simd << std::setw(12) << pooled;
+        if (naive > 0) {
+            std::cout << std::setw(9) << pooled / naive << "x";
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::size_t> sizes = {64, 128, 256, 512, 1024};
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i) {
+            sizes.push_back(std::stoul(argv[i]));
+        }
+    }
+
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads);
+    std::cout << "AVX2/FMA kernel: " << (gemm_detail::cpuHasAvx2Fma() ? "yes" : "no (scalar fallback)") << std::endl;
+
+    if (!checkShapes<double>(pool, threads) || !checkShapes<float>(pool, threads) ||
+        !checkShapes<int>(pool, threads)) {
+        return 1;
+    }
+    std::cout << "Results match the naive reference." << std::endl;
+
+    benchmark<double>("double", sizes, pool, threads);
+    benchmark<float>("float", sizes, pool, threads);
+    return 0;
+}
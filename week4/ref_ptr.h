@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "vector.h"
+
+// Reference-counted pointers that do less than std::shared_ptr.
+//
+// shared_ptr<T>(new T) allocates twice (the object, then a control block
+// with a vtable, a use count and a weak count); make_shared allocates once
+// but still carries the control block, and the pointer itself is two words.
+// Every copy and destroy is an atomic read-modify-write on the count.
+//
+//   - IntrusivePtr<T>: T derives from RefCounted, so the count lives in the
+//     object. One word per pointer, one allocation, no control block, and
+//     a pointer can be made again from a raw T* (e.g. `this` in a member
+//     function, but not in the constructor). The count is still atomic:
+//     objects may be shared across threads.
+//   - LocalPtr<T>: make_local<T>(...) puts a plain count in front of any T,
+//     in one allocation. Copies are an increment, not a locked instruction,
+//     so every copy, and the object, must stay on one thread.
+//
+// Neither has weak pointers or custom deleters: a cycle leaks unless it is
+// broken by hand, and the object is destroyed with delete on the pointer's
+// own type (IntrusivePtr<Base> to a Derived needs a virtual destructor).
+// Both are a single pointer, so Vector relocates them with memcpy.
+
+// Base for objects owned through IntrusivePtr. The count starts at 0 and
+// the first IntrusivePtr takes it to 1. Copying an object does not copy
+// its count. A constructor must not make an IntrusivePtr to `this`:
+// make_intrusive sets the count to 1 when the constructor returns.
+class RefCounted {
+protected:
+    RefCounted() noexcept = default;
+    RefCounted(const RefCounted&) noexcept {}
+    RefCounted& operator=(const RefCounted&) noexcept { return *this; }
+    ~RefCounted() = default;
+
+private:
+    template <typename T>
+    friend class IntrusivePtr;
+
+    mutable std::atomic<std::uint32_t> refs_{0};
+};
+
+template <typename T>
+class IntrusivePtr {
+public:
+    using element_type = T;
+
+    constexpr IntrusivePtr() noexcept = default;
+    constexpr IntrusivePtr(std::nullptr_t) noexcept {}
+
+    // Adds a reference to p, which may already be owned elsewhere.
+    explicit IntrusivePtr(T* p) noexcept : p_(p) {
+        if (p_) {
+            add_ref(p_);
+        }
+    }
+
+    IntrusivePtr(const IntrusivePtr& other) noexcept : IntrusivePtr(other.p_) {}
+    IntrusivePtr(IntrusivePtr&& other) noexcept : p_(std::exchange(other.p_, nullptr)) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    IntrusivePtr(const IntrusivePtr<U>& other) noexcept : IntrusivePtr(other.get()) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    IntrusivePtr(IntrusivePtr<U>&& other) noexcept : p_(other.detach()) {}
+
+    ~IntrusivePtr() {
+        if (p_) {
+            release(p_);
+        }
+    }
+
+    IntrusivePtr& operator=(IntrusivePtr other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void reset() noexcept { IntrusivePtr().swap(*this); }
+    void reset(T* p) noexcept { IntrusivePtr(p).swap(*this); }
+    void swap(IntrusivePtr& other) noexcept { std::swap(p_, other.p_); }
+
+    // Gives up ownership without releasing: the caller owns one reference.
+    T* detach() noexcept { return std::exchange(p_, nullptr); }
+
+    T* get() const noexcept { return p_; }
+    T& operator*() const noexcept { return *p_; }
+    T* operator->() const noexcept { return p_; }
+    explicit operator bool() const noexcept { return p_ != nullptr; }
+
+    // A snapshot: other threads may change it at any time.
+    std::uint32_t use_count() const noexcept { return p_ ? p_->refs_.load(std::memory_order_relaxed) : 0; }
+
+private:
+    template <typename U, typename... Args>
+    friend IntrusivePtr<U> make_intrusive(Args&&... args);
+
+    // Takes the first reference to a new object, which nothing else can
+    // reach yet, with a plain store instead of a locked instruction (as
+    // make_shared does).
+    static IntrusivePtr adopt_new(T* p) noexcept {
+        p->refs_.store(1, std::memory_order_relaxed);
+        IntrusivePtr ptr;
+        ptr.p_ = p;
+        return ptr;
+    }
+
+    static void add_ref(const T* p) noexcept { p->refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    // The last owner deletes. A count of 1 is ours alone, so that case
+    // skips the locked instruction (libstdc++'s shared_ptr does the same).
+    // Acquire-release orders every owner's writes to the object before the
+    // delete.
+    static void release(const T* p) noexcept {
+        if (p->refs_.load(std::memory_order_acquire) == 1 ||
+            p->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete p;
+        }
+    }
+
+    T* p_ = nullptr;
+};
+
+template <typename T, typename... Args>
+IntrusivePtr<T> make_intrusive(Args&&... args) {
+    return IntrusivePtr<T>::adopt_new(new T(std::forward<Args>(args)...));
+}
+
+template <typename T, typename U>
+bool operator==(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) noexcept { return a.get() == b.get(); }
+template <typename T, typename U>
+bool operator!=(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) noexcept { return a.get() != b.get(); }
+template <typename T>
+bool operator==(const IntrusivePtr<T>& a, std::nullptr_t) noexcept { return !a; }
+template <typename T>
+bool operator!=(const IntrusivePtr<T>& a, std::nullptr_t) noexcept { return static_cast<bool>(a); }
+
+template <typename T>
+void swap(IntrusivePtr<T>& a, IntrusivePtr<T>& b) noexcept { a.swap(b); }
+
+namespace ref_ptr_detail {
+
+// The count in front of the object, allocated together by make_local.
+template <typename T>
+struct LocalBlock {
+    template <typename... Args>
+    explicit LocalBlock(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+    std::uint32_t refs = 1;
+    T value;
+};
+
+} // namespace ref_ptr_detail
+
+template <typename T>
+class LocalPtr {
+public:
+    using element_type = T;
+
+    constexpr LocalPtr() noexcept = default;
+    constexpr LocalPtr(std::nullptr_t) noexcept {}
+
+    LocalPtr(const LocalPtr& other) noexcept : block_(other.block_) {
+        if (block_) {
+            ++block_->refs;
+        }
+    }
+
+    LocalPtr(LocalPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {}
+
+    ~LocalPtr() {
+        if (block_ && --block_->refs == 0) {
+            delete block_;
+        }
+    }
+
+    LocalPtr& operator=(LocalPtr other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void reset() noexcept { LocalPtr().swap(*this); }
+    void swap(LocalPtr& other) noexcept { std::swap(block_, other.block_); }
+
+    T* get() const noexcept { return block_ ? &block_->value : nullptr; }
+    T& operator*() const noexcept { return block_->value; }
+    T* operator->() const noexcept { return &block_->value; }
+    explicit operator bool() const noexcept { return block_ != nullptr; }
+    std::uint32_t use_count() const noexcept { return block_ ? block_->refs : 0; }
+
+    bool operator==(const LocalPtr& other) const noexcept { return block_ == other.block_; }
+    bool operator!=(const LocalPtr& other) const noexcept { return block_ != other.block_; }
+    bool operator==(std::nullptr_t) const noexcept { return block_ == nullptr; }
+    bool operator!=(std::nullptr_t) const noexcept { return block_ != nullptr; }
+
+private:
+    template <typename U, typename... Args>
+    friend LocalPtr<U> make_local(Args&&... args);
+
+    explicit LocalPtr(ref_ptr_detail::LocalBlock<T>* block) noexcept : block_(block) {}
+
+    ref_ptr_detail::LocalBlock<T>* block_ = nullptr;
+};
+
+template <typename T, typename... Args>
+LocalPtr<T> make_local(Args&&... args) {
+    return LocalPtr<T>(new ref_ptr_detail::LocalBlock<T>(std::forward<Args>(args)...));
+}
+
+template <typename T>
+void swap(LocalPtr<T>& a, LocalPtr<T>& b) noexcept { a.swap(b); }
+
+template <typename T>
+struct is_trivially_relocatable<IntrusivePtr<T>> : std::true_type {};
+
+template <typename T>
+struct is_trivially_relocatable<LocalPtr<T>> : std::true_type {};
+
+namespace std {
+
+template <typename T>
+struct hash<IntrusivePtr<T>> {
+    size_t operator()(const IntrusivePtr<T>& p) const noexcept { return hash<T*>()(p.get()); }
+};
+
+template <typename T>
+struct hash<LocalPtr<T>> {
+    size_t operator()(const LocalPtr<T>& p) const noexcept { return hash<T*>()(p.get()); }
+};
+
+} // namespace std
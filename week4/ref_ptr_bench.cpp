@@ -0,0 +1,303 @@
+// IntrusivePtr / LocalPtr correctness checks + benchmark against
+// std::shared_ptr (from new, and from make_shared): making, copying and
+// destroying pointers. The allocs and bytes columns of "make" are the heap
+// each object costs.
+// Build: g++ -std=c++17 -O2 ref_ptr_bench.cpp -o ref_ptr_bench -pthread
+// Usage: ./ref_ptr_bench [threads] [--filter=copy] [--samples=n] [--min-time=ms] [--json]   (default 4 threads)
+#define BENCH_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "ref_ptr.h"
+
+// Counts live objects so that the checks can catch leaks and double destroys.
+struct Node : RefCounted {
+    static std::atomic<int> live;
+    int value;
+    std::vector<IntrusivePtr<Node>> children;
+
+    explicit Node(int v = 0) : value(v) { ++live; }
+    virtual ~Node() { --live; }
+};
+std::atomic<int> Node::live{0};
+
+struct Leaf : Node {
+    explicit Leaf(int v) : Node(v) {}
+};
+
+struct LocalNode {
+    static int live;
+    int value;
+    std::vector<LocalPtr<LocalNode>> children;
+
+    explicit LocalNode(int v = 0) : value(v) { ++live; }
+    ~LocalNode() { --live; }
+};
+int LocalNode::live = 0;
+
+bool checkIntrusive() {
+    {
+        IntrusivePtr<Node> a = make_intrusive<Node>(1);
+        if (a.use_count() != 1 || a->value != 1 || Node::live != 1) {
+            return bench::fail("IntrusivePtr: make_intrusive");
+        }
+        IntrusivePtr<Node> b = a;
+        IntrusivePtr<Node> c(a.get());  // from a raw pointer: shares the count
+        if (a.use_count() != 3 || b != a || c != a) {
+            return bench::fail("IntrusivePtr: copy, or construction from a raw pointer");
+        }
+        b = b;
+        if (a.use_count() != 3) {
+            return bench::fail("IntrusivePtr: self-assignment changed the count");
+        }
+        IntrusivePtr<Node> d = std::move(b);
+        if (b || b != nullptr || a.use_count() != 3) {
+            return bench::fail("IntrusivePtr: move");
+        }
+        c.reset();
+        d.reset();
+        if (a.use_count() != 1 || Node::live != 1) {
+            return bench::fail("IntrusivePtr: reset");
+        }
+
+        IntrusivePtr<Node> base = make_intrusive<Leaf>(2);  // deleted through Node's virtual destructor
+        base.swap(a);
+        if (a->value != 2 || base->value != 1) {
+            return bench::fail("IntrusivePtr: swap");
+        }
+        std::unordered_set<IntrusivePtr<Node>> set{a, base, a};
+        if (set.size() != 2) {
+            return bench::fail("IntrusivePtr: hash / ==");
+        }
+    }
+    if (Node::live != 0) {
+        return bench::fail("IntrusivePtr: " + std::to_string(Node::live) + " nodes leaked");
+    }
+
+    // A tree dropped from its root.
+    {
+        IntrusivePtr<Node> root = make_intrusive<Node>(0);
+        for (int i = 0; i < 100; ++i) {
+            root->children.push_back(make_intrusive<Node>(i));
+            root->children.back()->children.push_back(make_intrusive<Leaf>(i));
+        }
+        if (Node::live != 201) {
+            return bench::fail("IntrusivePtr: tree of " + std::to_string(Node::live) + " nodes, expected 201");
+        }
+    }
+    if (Node::live != 0) {
+        return bench::fail("IntrusivePtr: dropping the root leaked " + std::to_string(Node::live) + " nodes");
+    }
+
+    // Threads copying and dropping one object: the count ends where it
+    // started, and the last owner, whichever thread it is, deletes it once.
+    {
+        IntrusivePtr<Node> shared = make_intrusive<Node>(7);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([shared] {
+                std::vector<IntrusivePtr<Node>> copies;
+                for (int round = 0; round < 100; ++round) {
+                    copies.assign(1000, shared);
+                    copies.clear();
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        if (shared.use_count() != 1) {
+            return bench::fail("IntrusivePtr: " + std::to_string(shared.use_count()) + " references after the threads");
+        }
+        std::thread last([p = std::move(shared)] {});
+        last.join();
+    }
+    if (Node::live != 0) {
+        return bench::fail("IntrusivePtr: the last release on another thread did not delete");
+    }
+
+    static_assert(sizeof(IntrusivePtr<Node>) == sizeof(void*), "IntrusivePtr is one pointer");
+    static_assert(Vector<IntrusivePtr<Node>>::relocates_with_memcpy, "IntrusivePtr should relocate with memcpy");
+    Vector<IntrusivePtr<Node>> v;
+    for (int i = 0; i < 1000; ++i) {
+        v.push_back(make_intrusive<Node>(i));
+    }
+    v.erase(v.begin(), v.begin() + 500);
+    if (v.size() != 500 || v[0]->value != 500 || v[0].use_count() != 1 || Node::live != 500) {
+        return bench::fail("Vector<IntrusivePtr<Node>>: erase");
+    }
+    v.clear();
+    if (Node::live != 0) {
+        return bench::fail("Vector<IntrusivePtr<Node>>: clear leaked");
+    }
+    std::cout << "  [ok] IntrusivePtr<Node>" << std::endl;
+    return true;
+}
+
+bool checkLocal() {
+    {
+        LocalPtr<LocalNode> a = make_local<LocalNode>(1);
+        if (a.use_count() != 1 || a->value != 1 || LocalNode::live != 1) {
+            return bench::fail("LocalPtr: make_local");
+        }
+        LocalPtr<LocalNode> b = a;
+        b = b;
+        if (a.use_count() != 2 || b != a) {
+            return bench::fail("LocalPtr: copy or self-assignment");
+        }
+        LocalPtr<LocalNode> c = std::move(b);
+        if (b || b != nullptr || a.use_count() != 2) {
+            return bench::fail("LocalPtr: move");
+        }
+        c.reset();
+        if (a.use_count() != 1) {
+            return bench::fail("LocalPtr: reset");
+        }
+
+        // A shared subtree: the node under both parents dies with the last.
+        LocalPtr<LocalNode> shared = make_local<LocalNode>(9);
+        for (int i = 0; i < 100; ++i) {
+            a->children.push_back(make_local<LocalNode>(i));
+            a->children.back()->children.push_back(shared);
+        }
+        if (shared.use_count() != 101 || LocalNode::live != 102) {
+            return bench::fail("LocalPtr: shared subtree");
+        }
+        shared.reset();
+        a->children.resize(1);
+        if (LocalNode::live != 3 || a->children[0]->children[0]->value != 9) {
+            return bench::fail("LocalPtr: the shared node died with a parent still holding it");
+        }
+    }
+    if (LocalNode::live != 0) {
+        return bench::fail("LocalPtr: " + std::to_string(LocalNode::live) + " nodes leaked");
+    }
+
+    static_assert(sizeof(LocalPtr<LocalNode>) == sizeof(void*), "LocalPtr is one pointer");
+    static_assert(Vector<LocalPtr<int>>::relocates_with_memcpy, "LocalPtr should relocate with memcpy");
+    Vector<LocalPtr<std::string>> v;
+    for (int i = 0; i < 1000; ++i) {
+        v.push_back(make_local<std::string>(std::to_string(i)));
+    }
+    v.erase(v.begin(), v.begin() + 999);
+    if (v.size() != 1 || *v[0] != "999") {
+        return bench::fail("Vector<LocalPtr<std::string>>: erase");
+    }
+    std::cout << "  [ok] LocalPtr<LocalNode>" << std::endl;
+    return true;
+}
+
+bool runChecks() {
+    std::cout << "Checks:" << std::endl;
+    return checkIntrusive() && checkLocal();
+}
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+
+// The object every pointer type owns: 16 bytes, plus the count for
+// IntrusivePtr.
+struct Payload {
+    std::uint64_t a = 1, b = 2;
+};
+
+struct IntrusivePayload : RefCounted {
+    std::uint64_t a = 1, b = 2;
+};
+
+struct SharedNew {
+    using Ptr = std::shared_ptr<Payload>;
+    static constexpr const char* name = "shared_ptr(new)";
+    static constexpr bool shareable = true;
+    static Ptr make() { return Ptr(new Payload); }
+};
+
+struct MakeShared {
+    using Ptr = std::shared_ptr<Payload>;
+    static constexpr const char* name = "make_shared";
+    static constexpr bool shareable = true;
+    static Ptr make() { return std::make_shared<Payload>(); }
+};
+
+struct Intrusive {
+    using Ptr = IntrusivePtr<IntrusivePayload>;
+    static constexpr const char* name = "IntrusivePtr";
+    static constexpr bool shareable = true;
+    static Ptr make() { return make_intrusive<IntrusivePayload>(); }
+};
+
+struct Local {
+    using Ptr = LocalPtr<Payload>;
+    static constexpr const char* name = "LocalPtr";
+    static constexpr bool shareable = false;
+    static Ptr make() { return make_local<Payload>(); }
+};
+
+template <typename P>
+void benchmark(bench::Runner& runner, unsigned threads) {
+    using Ptr = typename P::Ptr;
+    std::string name = P::name;
+    runner.run(name + " make + destroy", [] {
+        Ptr p = P::make();
+        bench::doNotOptimize(p);
+    });
+
+    // Copies of pointers to 4096 objects in turn, so each copy touches a
+    // different count, as walking a graph does.
+    std::vector<Ptr> objects;
+    for (int i = 0; i < 4096; ++i) {
+        objects.push_back(P::make());
+    }
+    size_t next = 0;
+    runner.run(name + " copy + destroy", [&objects, &next] {
+        Ptr copy = objects[next++ & 4095];
+        bench::doNotOptimize(copy);
+    });
+
+    // The same, while threads - 1 other threads copy and drop the same
+    // objects: every count bounces between cores.
+    if constexpr (P::shareable) {
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> others;
+        for (unsigned t = 1; t < threads; ++t) {
+            others.emplace_back([&objects, &stop, t] {
+                for (size_t i = t * 997; !stop.load(std::memory_order_relaxed); ++i) {
+                    Ptr copy = objects[i & 4095];
+                    bench::doNotOptimize(copy);
+                }
+            });
+        }
+        runner.run(name + " copy, " + std::to_string(threads) + " threads", [&objects, &next] {
+            Ptr copy = objects[next++ & 4095];
+            bench::doNotOptimize(copy);
+        });
+        stop = true;
+        for (std::thread& t : others) {
+            t.join();
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (!runChecks()) {
+        return 1;
+    }
+
+    bench::Runner runner(argc, argv);
+    unsigned threads = runner.args().empty() ? 4 : static_cast<unsigned>(std::stoul(runner.args()[0]));
+
+    std::cout << "\nPointer size: shared_ptr " << sizeof(SharedNew::Ptr) << ", IntrusivePtr " << sizeof(Intrusive::Ptr)
+              << ", LocalPtr " << sizeof(Local::Ptr) << " bytes; payload 16 bytes" << std::endl;
+    benchmark<SharedNew>(runner, threads);
+    benchmark<MakeShared>(runner, threads);
+    benchmark<Intrusive>(runner, threads);
+    benchmark<Local>(runner, threads);
+    return runner.finish();
+}
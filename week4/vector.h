@@ -0,0 +1,554 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// A type is trivially relocatable when moving it to a new address and
+// forgetting the old bytes is the same as move-construct + destroy.
+// Trivially copyable types qualify automatically; other types opt in by
+// specializing this trait. (libstdc++'s std::string does NOT qualify: its SSO
+// buffer is pointed to from inside the object.)
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+template <typename T, typename D>
+struct is_trivially_relocatable<std::unique_ptr<T, D>> : is_trivially_relocatable<D> {};
+
+template <typename T>
+struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+
+// Growth policy: the new capacity is capacity * Num / Den (at least +1 and
+// at least what the caller needs).
+template <std::size_t Num, std::size_t Den>
+struct GrowthFactor {
+    static_assert(Den > 0 && Num > Den, "growth factor must be greater than 1");
+
+    static std::size_t grow(std::size_t capacity, std::size_t required) {
+        std::size_t next = capacity + capacity / Den * (Num - Den) + capacity % Den * (Num - Den) / Den;
+        if (next <= capacity) {
+            next = capacity + 1;
+        }
+        return next < required ? required : next;
+    }
+};
+
+using DoubleGrowth = GrowthFactor<2, 1>;
+using GoldenGrowth = GrowthFactor<3, 2>;
+
+namespace vector_detail {
+
+// Inline element storage used by the small-capacity mode. The N == 0
+// specialization is empty so that Vector<T> pays nothing for it (EBO).
+template <typename T, std::size_t N>
+struct InlineStorage {
+    T* inline_data() noexcept { return reinterpret_cast<T*>(buffer_); }
+    const T* inline_data() const noexcept { return reinterpret_cast<const T*>(buffer_); }
+
+    alignas(T) unsigned char buffer_[sizeof(T) * N];
+};
+
+template <typename T>
+struct InlineStorage<T, 0> {
+    T* inline_data() noexcept { return nullptr; }
+    const T* inline_data() const noexcept { return nullptr; }
+};
+
+} // namespace vector_detail
+
+// Dynamic array from 文档/章节四/手写STL.md.
+//   - growth through trivially relocatable elements is a single memcpy
+//   - Growth picks the expansion factor (DoubleGrowth, GoldenGrowth, ...)
+//   - InlineCapacity > 0 keeps the first N elements inside the object
+//     (no heap allocation until the vector outgrows them)
+template <typename T,
+          typename Allocator = std::allocator<T>,
+          typename Growth = DoubleGrowth,
+          std::size_t InlineCapacity = 0>
+class Vector : private vector_detail::InlineStorage<T, InlineCapacity> {
+    using AllocTraits = std::allocator_traits<Allocator>;
+
+    static_assert(std::is_same<typename AllocTraits::value_type, T>::value,
+                  "Allocator::value_type must be T");
+    static_assert(std::is_same<typename AllocTraits::pointer, T*>::value,
+                  "Vector only supports allocators with raw pointers");
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    static constexpr size_type inline_capacity = InlineCapacity;
+    static constexpr bool relocates_with_memcpy = is_trivially_relocatable<T>::value;
+
+    // Constructors
+    Vector() noexcept(std::is_nothrow_default_constructible<Allocator>::value)
+        : impl_(Allocator(), this->inline_data(), InlineCapacity) {}
+
+    explicit Vector(const Allocator& alloc) noexcept
+        : impl_(alloc, this->inline_data(), InlineCapacity) {}
+
+    explicit Vector(size_type count, const Allocator& alloc = Allocator())
+        : Vector(alloc) {
+        resize(count);
+    }
+
+    Vector(size_type count, const T& value, const Allocator& alloc = Allocator())
+        : Vector(alloc) {
+        resize(count, value);
+    }
+
+    Vector(std::initializer_list<T> init, const Allocator& alloc = Allocator())
+        : Vector(alloc) {
+        assign(init.begin(), init.end());
+    }
+
+    template <typename InputIt,
+              typename = typename std::iterator_traits<InputIt>::iterator_category>
+    Vector(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+        : Vector(alloc) {
+        assign(first, last);
+    }
+
+    Vector(const Vector& other)
+        : Vector(AllocTraits::select_on_container_copy_construction(other.impl_)) {
+        assign(other.begin(), other.end());
+    }
+
+    Vector(Vector&& other) noexcept
+        : impl_(std::move(static_cast<Allocator&>(other.impl_)), this->inline_data(), InlineCapacity) {
+        steal(other);
+    }
+
+    ~Vector() {
+        destroy(begin(), end());
+        release();
+    }
+
+    Vector& operator=(const Vector& other) {
+        if (this != &other) {
+            if (AllocTraits::propagate_on_container_copy_assignment::value &&
+                static_cast<Allocator&>(impl_) != static_cast<const Allocator&>(other.impl_)) {
+                clear();
+                release();
+                reset_to_inline();
+                static_cast<Allocator&>(impl_) = other.impl_;
+            }
+            assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    Vector& operator=(Vector&& other) noexcept(
+        AllocTraits::propagate_on_container_move_assignment::value ||
+        AllocTraits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        if (AllocTraits::propagate_on_container_move_assignment::value) {
+            release();
+            reset_to_inline();
+            static_cast<Allocator&>(impl_) = std::move(static_cast<Allocator&>(other.impl_));
+            steal(other);
+        } else if (AllocTraits::is_always_equal::value ||
+                   static_cast<Allocator&>(impl_) == static_cast<Allocator&>(other.impl_)) {
+            release();
+            reset_to_inline();
+            steal(other);
+        } else {
+            // Unequal, non-propagating allocators: elements must be moved one by one.
+            assign(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+            other.clear();
+        }
+        return *this;
+    }
+
+    Vector& operator=(std::initializer_list<T> init) {
+        assign(init.begin(), init.end());
+        return *this;
+    }
+
+    template <typename InputIt,
+              typename = typename std::iterator_traits<InputIt>::iterator_category>
+    void assign(InputIt first, InputIt last) {
+        clear();
+        using Category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value) {
+            reserve(static_cast<size_type>(std::distance(first, last)));
+        }
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    }
+
+    allocator_type get_allocator() const { return impl_; }
+
+    // Element access
+    reference operator[](size_type pos) { return impl_.data[pos]; }
+    const_reference operator[](size_type pos) const { return impl_.data[pos]; }
+
+    reference at(size_type pos) {
+        check_range(pos);
+        return impl_.data[pos];
+    }
+
+    const_reference at(size_type pos) const {
+        check_range(pos);
+        return impl_.data[pos];
+    }
+
+    reference front() { return impl_.data[0]; }
+    const_reference front() const { return impl_.data[0]; }
+    reference back() { return impl_.data[impl_.size - 1]; }
+    const_reference back() const { return impl_.data[impl_.size - 1]; }
+    T* data() noexcept { return impl_.data; }
+    const T* data() const noexcept { return impl_.data; }
+
+    // Iterators
+    iterator begin() noexcept { return impl_.data; }
+    const_iterator begin() const noexcept { return impl_.data; }
+    const_iterator cbegin() const noexcept { return impl_.data; }
+    iterator end() noexcept { return impl_.data + impl_.size; }
+    const_iterator end() const noexcept { return impl_.data + impl_.size; }
+    const_iterator cend() const noexcept { return impl_.data + impl_.size; }
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+    // Capacity
+    bool empty() const noexcept { return impl_.size == 0; }
+    size_type size() const noexcept { return impl_.size; }
+    size_type capacity() const noexcept { return impl_.capacity; }
+    bool is_inline() const noexcept { return InlineCapacity != 0 && impl_.data == this->inline_data(); }
+
+    size_type max_size() const noexcept {
+        return std::min<size_type>(AllocTraits::max_size(impl_),
+                                   std::numeric_limits<difference_type>::max() / sizeof(T));
+    }
+
+    void reserve(size_type new_cap) {
+        if (new_cap > impl_.capacity) {
+            if (new_cap > max_size()) {
+                throw std::length_error("Vector::reserve");
+            }
+            reallocate(new_cap);
+        }
+    }
+
+    // Drops unused capacity. Falls back to the inline buffer when the
+    // elements fit in it.
+    void shrink_to_fit() {
+        if (impl_.size == impl_.capacity || is_inline()) {
+            return;
+        }
+        if (impl_.size == 0) {
+            release();
+            reset_to_inline();
+        } else if (impl_.size <= InlineCapacity) {
+            T* old_data = impl_.data;
+            size_type old_cap = impl_.capacity;
+            relocate(old_data, impl_.size, this->inline_data());
+            AllocTraits::deallocate(impl_, old_data, old_cap);
+            impl_.data = this->inline_data();
+            impl_.capacity = InlineCapacity;
+        } else {
+            reallocate(impl_.size);
+        }
+    }
+
+    // Modifiers
+    void clear() noexcept {
+        destroy(begin(), end());
+        impl_.size = 0;
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    template <typename... Args>
+    reference emplace_back(Args&&... args) {
+        if (impl_.size == impl_.capacity) {
+            return grow_and_emplace_back(std::forward<Args>(args)...);
+        }
+        T* slot = impl_.data + impl_.size;
+        AllocTraits::construct(impl_, slot, std::forward<Args>(args)...);
+        ++impl_.size;
+        return *slot;
+    }
+
+    void pop_back() {
+        --impl_.size;
+        AllocTraits::destroy(impl_, impl_.data + impl_.size);
+    }
+
+    iterator insert(const_iterator pos, const T& value) { return emplace(pos, value); }
+    iterator insert(const_iterator pos, T&& value) { return emplace(pos, std::move(value)); }
+
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        size_type index = static_cast<size_type>(pos - begin());
+        if (index == impl_.size) {
+            emplace_back(std::forward<Args>(args)...);
+            return begin() + index;
+        }
+        // Build the value first: args may refer to an element we are about to shift.
+        T tmp(std::forward<Args>(args)...);
+        if (impl_.size == impl_.capacity) {
+            reallocate(Growth::grow(impl_.capacity, impl_.size + 1));
+        }
+        T* slot = impl_.data + index;
+        T* last = impl_.data + impl_.size;
+        if constexpr (relocates_with_memcpy) {
+            size_type tail = static_cast<size_type>(last - slot) * sizeof(T);
+            std::memmove(static_cast<void*>(slot + 1), static_cast<const void*>(slot), tail);
+            try {
+                AllocTraits::construct(impl_, slot, std::move(tmp));
+            } catch (...) {
+                std::memmove(static_cast<void*>(slot), static_cast<const void*>(slot + 1), tail);
+                throw;
+            }
+        } else {
+            AllocTraits::construct(impl_, last, std::move(*(last - 1)));
+            std::move_backward(slot, last - 1, last);
+            *slot = std::move(tmp);
+        }
+        ++impl_.size;
+        return slot;
+    }
+
+    iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        T* from = begin() + (first - cbegin());
+        T* to = begin() + (last - cbegin());
+        if (from == to) {
+            return from;
+        }
+        size_type count = static_cast<size_type>(to - from);
+        if constexpr (relocates_with_memcpy) {
+            destroy(from, to);
+            std::memmove(static_cast<void*>(from), static_cast<const void*>(to),
+                         static_cast<size_type>(end() - to) * sizeof(T));
+        } else {
+            T* new_end = std::move(to, end(), from);
+            destroy(new_end, end());
+        }
+        impl_.size -= count;
+        return from;
+    }
+
+    void resize(size_type count) { resize_impl(count); }
+    void resize(size_type count, const T& value) { resize_impl(count, value); }
+
+    void swap(Vector& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        if (!is_inline() && !other.is_inline()) {
+            std::swap(impl_.data, other.impl_.data);
+            std::swap(impl_.size, other.impl_.size);
+            std::swap(impl_.capacity, other.impl_.capacity);
+            if (AllocTraits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(static_cast<Allocator&>(impl_), static_cast<Allocator&>(other.impl_));
+            }
+            return;
+        }
+        Vector tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+private:
+    // Allocator lives as an (empty) base so that std::allocator costs no space.
+    struct Impl : Allocator {
+        Impl(const Allocator& alloc, T* d, size_type cap) noexcept
+            : Allocator(alloc), data(d), capacity(cap) {}
+        Impl(Allocator&& alloc, T* d, size_type cap) noexcept
+            : Allocator(std::move(alloc)), data(d), capacity(cap) {}
+
+        T* data;
+        size_type size = 0;
+        size_type capacity;
+    };
+
+    void check_range(size_type pos) const {
+        if (pos >= impl_.size) {
+            throw std::out_of_range("Vector::at");
+        }
+    }
+
+    void reset_to_inline() noexcept {
+        impl_.data = this->inline_data();
+        impl_.capacity = InlineCapacity;
+    }
+
+    // Frees heap storage (never the inline buffer). Elements must already be destroyed.
+    void release() noexcept {
+        if (!is_inline() && impl_.data) {
+            AllocTraits::deallocate(impl_, impl_.data, impl_.capacity);
+        }
+    }
+
+    void destroy(T* first, T* last) noexcept {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            for (; first != last; ++first) {
+                AllocTraits::destroy(impl_, first);
+            }
+        }
+    }
+
+    // Moves n elements from src to uninitialized dst and ends their lifetime
+    // at src. Falls back to copying when the move constructor may throw, so
+    // a failed reallocation leaves the source untouched (strong guarantee).
+    void relocate(T* src, size_type n, T* dst) {
+        if constexpr (relocates_with_memcpy) {
+            if (n != 0) {
+                std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
+            }
+        } else {
+            size_type i = 0;
+            try {
+                for (; i < n; ++i) {
+                    AllocTraits::construct(impl_, dst + i, std::move_if_noexcept(src[i]));
+                }
+            } catch (...) {
+                destroy(dst, dst + i);
+                throw;
+            }
+            destroy(src, src + n);
+        }
+    }
+
+    void reallocate(size_type new_cap) {
+        T* new_data = AllocTraits::allocate(impl_, new_cap);
+        try {
+            relocate(impl_.data, impl_.size, new_data);
+        } catch (...) {
+            AllocTraits::deallocate(impl_, new_data, new_cap);
+            throw;
+        }
+        release();
+        impl_.data = new_data;
+        impl_.capacity = new_cap;
+    }
+
+    template <typename... Args>
+    reference grow_and_emplace_back(Args&&... args) {
+        if (impl_.size == max_size()) {
+            throw std::length_error("Vector::emplace_back");
+        }
+        size_type new_cap = std::min(Growth::grow(impl_.capacity, impl_.size + 1), max_size());
+        T* new_data = AllocTraits::allocate(impl_, new_cap);
+        T* slot = new_data + impl_.size;
+        // Construct the new element before relocating: args may alias an old element.
+        try {
+            AllocTraits::construct(impl_, slot, std::forward<Args>(args)...);
+        } catch (...) {
+            AllocTraits::deallocate(impl_, new_data, new_cap);
+            throw;
+        }
+        try {
+            relocate(impl_.data, impl_.size, new_data);
+        } catch (...) {
+            AllocTraits::destroy(impl_, slot);
+            AllocTraits::deallocate(impl_, new_data, new_cap);
+            throw;
+        }
+        release();
+        impl_.data = new_data;
+        impl_.capacity = new_cap;
+        ++impl_.size;
+        return *slot;
+    }
+
+    template <typename... Value>
+    void resize_impl(size_type count, const Value&... value) {
+        if (count < impl_.size) {
+            destroy(impl_.data + count, end());
+            impl_.size = count;
+            return;
+        }
+        if (count > impl_.capacity) {
+            // Geometric, like push_back: resize(size() + 1) in a loop must
+            // not reallocate every time.
+            size_type new_cap = std::max(count, std::min(Growth::grow(impl_.capacity, count), max_size()));
+            if constexpr (sizeof...(Value) != 0) {
+                // value may be an element, which reserve() frees: fill from
+                // a copy, as emplace does.
+                T copy(value...);
+                reserve(new_cap);
+                construct_up_to(count, copy);
+                return;
+            }
+            reserve(new_cap);
+        }
+        construct_up_to(count, value...);
+    }
+
+    template <typename... Value>
+    void construct_up_to(size_type count, const Value&... value) {
+        while (impl_.size < count) {
+            AllocTraits::construct(impl_, impl_.data + impl_.size, value...);
+            ++impl_.size;
+        }
+    }
+
+    // Takes other's elements; other must not share storage with *this.
+    void steal(Vector& other) noexcept {
+        if (other.is_inline()) {
+            // Inline elements cannot change owner, they have to be moved over.
+            relocate_nothrow(other.impl_.data, other.impl_.size, this->inline_data());
+            impl_.size = other.impl_.size;
+        } else {
+            impl_.data = other.impl_.data;
+            impl_.size = other.impl_.size;
+            impl_.capacity = other.impl_.capacity;
+            other.reset_to_inline();
+        }
+        other.impl_.size = 0;
+    }
+
+    void relocate_nothrow(T* src, size_type n, T* dst) noexcept {
+        static_assert(InlineCapacity == 0 || relocates_with_memcpy ||
+                          std::is_nothrow_move_constructible<T>::value,
+                      "inline mode needs a nothrow move constructor");
+        relocate(src, n, dst);
+    }
+
+    Impl impl_;
+};
+
+template <typename T, typename A, typename G, std::size_t N>
+bool operator==(const Vector<T, A, G, N>& lhs, const Vector<T, A, G, N>& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <typename T, typename A, typename G, std::size_t N>
+bool operator!=(const Vector<T, A, G, N>& lhs, const Vector<T, A, G, N>& rhs) {
+    return !(lhs == rhs);
+}
+
+template <typename T, typename A, typename G, std::size_t N>
+void swap(Vector<T, A, G, N>& lhs, Vector<T, A, G, N>& rhs) noexcept(noexcept(lhs.swap(rhs))) {
+    lhs.swap(rhs);
+}
+
+// Vector that stores up to N elements inline before touching the heap.
+template <typename T, std::size_t N, typename Allocator = std::allocator<T>>
+using SmallVector = Vector<T, Allocator, DoubleGrowth, N>;
@@ -0,0 +1,338 @@
+// Vector<T> correctness checks + benchmark against std::vector.
+// Build: g++ -std=c++17 -O2 vector_bench.cpp -o vector_bench
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../week2/bench.h"
+#include "vector.h"
+
+// Counts live objects so that the checks can catch leaks and double destroys.
+struct Tracked {
+    static int live;
+    int value;
+
+    Tracked(int v = 0) : value(v) { ++live; }
+    Tracked(const Tracked& other) : value(other.value) { ++live; }
+    Tracked(Tracked&& other) noexcept : value(other.value) { ++live; }
+    Tracked& operator=(const Tracked&) = default;
+    Tracked& operator=(Tracked&&) noexcept = default;
+    ~Tracked() { --live; }
+
+    bool operator==(const Tracked& other) const { return value == other.value; }
+};
+int Tracked::live = 0;
+
+template <typename T>
+T makeValue(int i);
+template <>
+int makeValue<int>(int i) { return i; }
+template <>
+std::string makeValue<std::string>(int i) { return "value-" + std::to_string(i) + std::string(static_cast<size_t>(i % 40), 'x'); }
+template <>
+Tracked makeValue<Tracked>(int i) { return Tracked(i); }
+
+template <typename V, typename S>
+bool sameContents(const V& mine, const S& reference) {
+    return mine.size() == reference.size() && std::equal(mine.begin(), mine.end(), reference.begin());
+}
+
+// Runs the same random operation sequence against Vector and std::vector.
+template <typename V>
+bool checkAgainstStd(const std::string& name) {
+    using T = typename V::value_type;
+    std::mt19937 rng(12345);
+    V mine;
+    std::vector<T> reference;
+
+    for (int step = 0; step < 20000; ++step) {
+        int op = static_cast<int>(rng() % 10);
+        T value = makeValue<T>(step);
+        if (op < 4) {
+            mine.push_back(value);
+            reference.push_back(value);
+        } else if (op < 6 && !reference.empty()) {
+            size_t pos = rng() % (reference.size() + 1);
+            mine.insert(mine.begin() + pos, value);
+            reference.insert(reference.begin() + static_cast<std::ptrdiff_t>(pos), value);
+        } else if (op < 8 && !reference.empty()) {
+            size_t first = rng() % reference.size();
+            size_t last = first + rng() % std::min<size_t>(3, reference.size() - first) + 1;
+            mine.erase(mine.begin() + first, mine.begin() + last);
+            reference.erase(reference.begin() + static_cast<std::ptrdiff_t>(first),
+                            reference.begin() + static_cast<std::ptrdiff_t>(last));
+        } else if (op == 8 && !reference.empty()) {
+            mine.pop_back();
+            reference.pop_back();
+        } else {
+            // Self-aliasing push_back must survive reallocation.
+            if (!reference.empty()) {
+                mine.push_back(mine.front());
+                reference.push_back(reference.front());
+            }
+        }
+        if (!sameContents(mine, reference)) {
+            return bench::fail(name + ": differs from std::vector after step " + std::to_string(step));
+        }
+    }
+
+    // Self-aliasing resize must survive reallocation too.
+    if (!reference.empty()) {
+        size_t grown = mine.capacity() + 3;
+        mine.resize(grown, mine.front());
+        reference.resize(grown, reference.front());
+        if (!sameContents(mine, reference)) {
+            return bench::fail(name + ": resize(n, v[0]) across a reallocation");
+        }
+    }
+
+    V copy = mine;
+    if (!(copy == mine)) {
+        return bench::fail(name + ": copy differs");
+    }
+    V moved = std::move(copy);
+    if (!(moved == mine) || !copy.empty()) {
+        return bench::fail(name + ": move");
+    }
+
+    mine.resize(5);
+    reference.resize(5);
+    mine.shrink_to_fit();
+    if (!sameContents(mine, reference) || mine.capacity() < 5) {
+        return bench::fail(name + ": shrink_to_fit");
+    }
+    mine.reserve(1000);
+    if (mine.capacity() < 1000 || !sameContents(mine, reference)) {
+        return bench::fail(name + ": reserve");
+    }
+    mine.clear();
+    mine.shrink_to_fit();
+    if (!mine.empty()) {
+        return bench::fail(name + ": clear");
+    }
+
+    std::cout << "  [ok] " << name << std::endl;
+    return true;
+}
+
+bool checkUniquePtr() {
+    static_assert(Vector<std::unique_ptr<int>>::relocates_with_memcpy, "unique_ptr should relocate with memcpy");
+    static_assert(!Vector<std::string>::relocates_with_memcpy || sizeof(std::string) == sizeof(void*),
+                  "std::string must take the move + destroy path");
+
+    Vector<std::unique_ptr<int>> v;
+    for (int i = 0; i < 1000; ++i) {
+        v.push_back(std::make_unique<int>(i));
+    }
+    v.erase(v.begin(), v.begin() + 500);
+    v.insert(v.begin(), std::make_unique<int>(-1));
+    if (v.size() != 501 || *v[0] != -1 || *v[1] != 500 || *v.back() != 999) {
+        return bench::fail("Vector<unique_ptr<int>>: erase / insert");
+    }
+    std::cout << "  [ok] Vector<unique_ptr<int>>" << std::endl;
+    return true;
+}
+
+bool checkSmallVector() {
+    SmallVector<Tracked, 8> v;
+    for (int i = 0; i < 8; ++i) {
+        v.push_back(Tracked(i));
+    }
+    if (!v.is_inline() || v.capacity() != 8) {
+        return bench::fail("SmallVector<Tracked, 8>: 8 elements left the inline buffer");
+    }
+    v.push_back(Tracked(8));
+    if (v.is_inline()) {
+        return bench::fail("SmallVector<Tracked, 8>: 9 elements stayed inline");
+    }
+    v.erase(v.begin() + 2, v.end());
+    v.shrink_to_fit();
+    if (!v.is_inline() || v.size() != 2 || v[1].value != 1) {
+        return bench::fail("SmallVector<Tracked, 8>: shrink_to_fit did not return to the inline buffer");
+    }
+
+    SmallVector<Tracked, 8> other = std::move(v);
+    if (other.size() != 2 || !v.empty()) {
+        return bench::fail("SmallVector<Tracked, 8>: move");
+    }
+    swap(v, other);
+    if (v.size() != 2 || !other.empty()) {
+        return bench::fail("SmallVector<Tracked, 8>: swap");
+    }
+    std::cout << "  [ok] SmallVector<Tracked, 8>" << std::endl;
+    return true;
+}
+
+bool checkGrowthPolicy() {
+    Vector<int, std::allocator<int>, GoldenGrowth> v;
+    std::vector<size_t> capacities;
+    for (int i = 0; i < 100; ++i) {
+        v.push_back(i);
+        if (capacities.empty() || capacities.back() != v.capacity()) {
+            capacities.push_back(v.capacity());
+        }
+    }
+    // 1, 2, 3, 4, 6, 9, 13, 19, ...
+    if (capacities[0] != 1 || capacities[4] != 6 || capacities[5] != 9 || capacities[6] != 13) {
+        return bench::fail("GoldenGrowth: unexpected capacities");
+    }
+    std::cout << "  [ok] GoldenGrowth capacities" << std::endl;
+
+    // Growing one element at a time through resize reallocates as rarely as
+    // push_back does.
+    Vector<int> grown;
+    size_t reallocations = 0;
+    for (int i = 0; i < 1000; ++i) {
+        size_t before = grown.capacity();
+        grown.resize(grown.size() + 1);
+        reallocations += grown.capacity() != before;
+    }
+    if (grown.size() != 1000 || reallocations > 11) {
+        return bench::fail("resize(size() + 1) reallocated " + std::to_string(reallocations) +
+                           " times for 1000 elements");
+    }
+    std::cout << "  [ok] resize(size() + 1) capacities" << std::endl;
+    return true;
+}
+
+bool runChecks() {
+    std::cout << "Checks:" << std::endl;
+    if (!checkAgainstStd<Vector<int>>("Vector<int>") || !checkAgainstStd<Vector<std::string>>("Vector<std::string>") ||
+        !checkAgainstStd<Vector<Tracked>>("Vector<Tracked>") ||
+        !checkAgainstStd<SmallVector<int, 16>>("SmallVector<int, 16>") ||
+        !checkAgainstStd<SmallVector<std::string, 4>>("SmallVector<std::string, 4>")) {
+        return false;
+    }
+    if (Tracked::live != 0) {
+        return bench::fail("Tracked objects leaked or destroyed twice");
+    }
+    if (!checkUniquePtr() || !checkSmallVector() || !checkGrowthPolicy()) {
+        return false;
+    }
+    return Tracked::live == 0 || bench::fail("Tracked objects leaked or destroyed twice");
+}
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+
+// Best of several runs, in milliseconds.
+template <typename F>
+double timeIt(F&& f, int runs = 5) {
+    double best = 1e300;
+    for (int r = 0; r < runs; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+volatile size_t sink;
+
+template <typename V>
+double pushBackInts(size_t n) {
+    return timeIt([n] {
+        V v;
+        for (size_t i = 0; i < n; ++i) {
+            v.push_back(static_cast<int>(i));
+        }
+        sink = v.size();
+    });
+}
+
+template <typename V>
+double pushBackUniquePtrs(size_t n) {
+    return timeIt([n] {
+        V v;
+        for (size_t i = 0; i < n; ++i) {
+            v.push_back(std::unique_ptr<int>());
+        }
+        sink = v.size();
+    });
+}
+
+// Many short-lived small vectors: where the inline mode avoids the heap.
+template <typename V>
+double manySmallVectors(size_t n) {
+    return timeIt([n] {
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i) {
+            V v;
+            for (int k = 0; k < 6; ++k) {
+                v.push_back(k);
+            }
+            total += v.size();
+        }
+        sink = total;
+    });
+}
+
+// Erase from the front until empty: dominated by shifting the tail down.
+template <typename V>
+double eraseFront(size_t n) {
+    return timeIt([n] {
+        V v;
+        for (size_t i = 0; i < n; ++i) {
+            v.emplace_back();
+        }
+        while (!v.empty()) {
+            v.erase(v.begin());
+        }
+        sink = v.size();
+    }, 3);
+}
+
+template <typename V>
+double eraseRandom(size_t n) {
+    return timeIt([n] {
+        V v;
+        for (size_t i = 0; i < n; ++i) {
+            v.emplace_back();
+        }
+        std::mt19937 rng(7);
+        while (!v.empty()) {
+            v.erase(v.begin() + static_cast<std::ptrdiff_t>(rng() % v.size()));
+        }
+        sink = v.size();
+    }, 3);
+}
+
+void report(const std::string& name, double stdMs, double mineMs) {
+    std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << stdMs << std::setw(12) << mineMs
+              << std::setw(9) << stdMs / mineMs << "x" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (!runChecks()) {
+        return 1;
+    }
+
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    size_t eraseN = argc > 2 ? std::stoul(argv[2]) : 50000;
+
+    std::cout << "\nBenchmark (best run, ms), n = " << n << ", erase n = " << eraseN << std::endl;
+    std::cout << std::left << std::setw(36) << "workload" << std::right << std::setw(12) << "std::vector"
+              << std::setw(12) << "Vector" << std::setw(10) << "speedup" << std::endl;
+
+    using UPtr = std::unique_ptr<int>;
+    report("push_back int", pushBackInts<std::vector<int>>(n), pushBackInts<Vector<int>>(n));
+    report("push_back int (1.5x growth)", pushBackInts<std::vector<int>>(n),
+           pushBackInts<Vector<int, std::allocator<int>, GoldenGrowth>>(n));
+    report("push_back unique_ptr", pushBackUniquePtrs<std::vector<UPtr>>(n), pushBackUniquePtrs<Vector<UPtr>>(n));
+    report("6 x push_back into fresh vector", manySmallVectors<std::vector<int>>(n / 6),
+           manySmallVectors<SmallVector<int, 8>>(n / 6));
+    report("erase front int", eraseFront<std::vector<int>>(eraseN), eraseFront<Vector<int>>(eraseN));
+    report("erase front unique_ptr", eraseFront<std::vector<UPtr>>(eraseN), eraseFront<Vector<UPtr>>(eraseN));
+    report("erase random unique_ptr", eraseRandom<std::vector<UPtr>>(eraseN), eraseRandom<Vector<UPtr>>(eraseN));
+    report("erase front string", eraseFront<std::vector<std::string>>(eraseN / 5),
+           eraseFront<Vector<std::string>>(eraseN / 5));
+
+    return 0;
+}